@@ -195,13 +195,17 @@ namespace mn
 		if (self.allocator == nullptr)
 			self.allocator = allocator_top();
 
-		Block new_block = alloc_from(self.allocator,
+		// realloc lets the allocator grow the block in place (or remap it) instead of always copying it
+		Block new_block{};
+		if(self.cap)
+			new_block = realloc_from(self.allocator,
+									 Block{ self.ptr, self.cap * sizeof(T) },
 									 new_count * sizeof(T),
 									 alignof(T));
-		if(self.count)
-			::memcpy(new_block.ptr, self.ptr, self.count * sizeof(T));
-		if(self.cap)
-			free_from(self.allocator, Block{ self.ptr, self.cap * sizeof(T) });
+		else
+			new_block = alloc_from(self.allocator,
+								   new_count * sizeof(T),
+								   alignof(T));
 		self.ptr = (T*)new_block.ptr;
 		self.cap = new_count;
 	}
@@ -0,0 +1,384 @@
+#pragma once
+
+#include "mn/Base.h"
+#include "mn/Memory.h"
+#include "mn/Buf.h"
+#include "mn/Map.h"
+#include "mn/Thread.h"
+#include "mn/Assert.h"
+
+namespace mn
+{
+	// a hash map which is safe to use from multiple threads at the same time
+	//
+	// the keys are distributed over a fixed number of shards using their hashes, each shard is guarded by its own
+	// reader writer mutex so operations on different shards don't contend, and readers of the same shard don't block
+	// each other
+	//
+	// each shard is a chained hash table which grows incrementally, when it grows a bigger bucket array is allocated and
+	// the following writes move the entries from the old array a few buckets at a time, lookups check both arrays while
+	// the move is in progress, so no operation has to wait for the whole table to be rehashed
+
+	// the default number of shards, it should be more than the number of threads which access the map
+	constexpr static size_t CONCURRENT_MAP_DEFAULT_SHARDS_COUNT = 64;
+	// the number of old buckets which each write moves to the new bucket array while the shard is growing
+	constexpr static size_t CONCURRENT_MAP_MIGRATE_STEP = 8;
+	// shards are kept in separate cache lines because their mutexes are written by each operation
+	constexpr static size_t CONCURRENT_MAP_SHARD_SIZE = 64;
+
+	template<typename TKey, typename TValue>
+	struct Concurrent_Map_Node
+	{
+		Concurrent_Map_Node* next;
+		size_t hash;
+		Key_Value<TKey, TValue> kv;
+	};
+
+	template<typename TKey, typename TValue>
+	struct alignas(CONCURRENT_MAP_SHARD_SIZE) Concurrent_Map_Shard
+	{
+		Mutex_RW mtx;
+		Buf<Concurrent_Map_Node<TKey, TValue>*> buckets;
+		// the bucket array which is being moved to buckets, buckets before migrate_index are already moved
+		Buf<Concurrent_Map_Node<TKey, TValue>*> old_buckets;
+		size_t migrate_index;
+		size_t count;
+	};
+
+	template<typename TKey, typename TValue, typename THash = Hash<TKey>>
+	struct IConcurrent_Map
+	{
+		Allocator allocator;
+		Block shards_memory;
+		Concurrent_Map_Shard<TKey, TValue>* shards;
+		size_t shards_count;
+		// shards are selected using the high bits of the hash, this is the shift which leaves them
+		size_t shards_shift;
+	};
+	template<typename TKey, typename TValue, typename THash = Hash<TKey>>
+	using Concurrent_Map = IConcurrent_Map<TKey, TValue, THash>*;
+
+	template<typename TKey, typename TValue, typename THash>
+	inline static Concurrent_Map_Shard<TKey, TValue>&
+	_concurrent_map_shard(Concurrent_Map<TKey, TValue, THash> self, size_t hash)
+	{
+		if (self->shards_count == 1)
+			return self->shards[0];
+
+		// fibonacci hashing spreads the hash bits because some hash functions (like the integer ones) are the identity
+		auto index = (uint64_t(hash) * 11400714819323198485ull) >> self->shards_shift;
+		return self->shards[index];
+	}
+
+	template<typename TKey, typename TValue>
+	inline static Concurrent_Map_Node<TKey, TValue>**
+	_concurrent_map_shard_find(Buf<Concurrent_Map_Node<TKey, TValue>*>& buckets, const TKey& key, size_t hash)
+	{
+		if (buckets.count == 0)
+			return nullptr;
+
+		auto it = &buckets[hash & (buckets.count - 1)];
+		for (; *it; it = &(*it)->next)
+			if ((*it)->hash == hash && (*it)->kv.key == key)
+				return it;
+		return nullptr;
+	}
+
+	// returns the link which points to the node of the given key, or nullptr if it doesn't exist
+	template<typename TKey, typename TValue>
+	inline static Concurrent_Map_Node<TKey, TValue>**
+	_concurrent_map_shard_find(Concurrent_Map_Shard<TKey, TValue>& shard, const TKey& key, size_t hash)
+	{
+		if (auto it = _concurrent_map_shard_find(shard.buckets, key, hash))
+			return it;
+
+		// the key is still in the old buckets if its bucket isn't moved yet
+		if (shard.old_buckets.count > 0 && (hash & (shard.old_buckets.count - 1)) >= shard.migrate_index)
+			return _concurrent_map_shard_find(shard.old_buckets, key, hash);
+		return nullptr;
+	}
+
+	// moves the given number of old buckets to the new bucket array, it's called with the write lock held
+	template<typename TKey, typename TValue>
+	inline static void
+	_concurrent_map_shard_migrate(Concurrent_Map_Shard<TKey, TValue>& shard, size_t buckets_count)
+	{
+		if (shard.old_buckets.count == 0)
+			return;
+
+		auto mask = shard.buckets.count - 1;
+		for (size_t i = 0; i < buckets_count && shard.migrate_index < shard.old_buckets.count; ++i)
+		{
+			auto it = shard.old_buckets[shard.migrate_index];
+			while (it)
+			{
+				auto next = it->next;
+				auto& bucket = shard.buckets[it->hash & mask];
+				it->next = bucket;
+				bucket = it;
+				it = next;
+			}
+			shard.old_buckets[shard.migrate_index] = nullptr;
+			++shard.migrate_index;
+		}
+
+		if (shard.migrate_index == shard.old_buckets.count)
+		{
+			buf_free(shard.old_buckets);
+			shard.old_buckets = buf_with_allocator<Concurrent_Map_Node<TKey, TValue>*>(shard.buckets.allocator);
+			shard.migrate_index = 0;
+		}
+	}
+
+	// grows the shard if it's full, the old buckets are moved incrementally by the following writes
+	template<typename TKey, typename TValue>
+	inline static void
+	_concurrent_map_shard_maintain_space_complexity(Concurrent_Map_Shard<TKey, TValue>& shard)
+	{
+		if (shard.count + 1 <= shard.buckets.count)
+			return;
+
+		// the previous growth should be finished first, it's only the case when most writes were removals
+		_concurrent_map_shard_migrate(shard, shard.old_buckets.count);
+
+		auto buckets = buf_with_allocator<Concurrent_Map_Node<TKey, TValue>*>(shard.buckets.allocator);
+		buf_resize_fill(buckets, shard.buckets.count > 0 ? shard.buckets.count * 2 : 8, nullptr);
+
+		buf_free(shard.old_buckets);
+		shard.old_buckets = shard.buckets;
+		shard.buckets = buckets;
+		shard.migrate_index = 0;
+	}
+
+	// creates a new concurrent map, shards_count is rounded up to a power of 2 and 0 means the default shards count
+	template<typename TKey, typename TValue, typename THash = Hash<TKey>>
+	inline static Concurrent_Map<TKey, TValue, THash>
+	concurrent_map_new(size_t shards_count = 0, Allocator allocator = allocator_top())
+	{
+		if (shards_count == 0)
+			shards_count = CONCURRENT_MAP_DEFAULT_SHARDS_COUNT;
+
+		size_t shards_bits = 0;
+		while ((size_t(1) << shards_bits) < shards_count)
+			++shards_bits;
+
+		auto self = alloc_from<IConcurrent_Map<TKey, TValue, THash>>(allocator);
+		self->allocator = allocator;
+		self->shards_count = size_t(1) << shards_bits;
+		self->shards_shift = 64 - shards_bits;
+
+		// allocators don't guarantee cache line alignment so we over allocate and align the shards ourselves
+		using Shard = Concurrent_Map_Shard<TKey, TValue>;
+		self->shards_memory = alloc_from(allocator, (self->shards_count + 1) * sizeof(Shard), alignof(Shard));
+		auto ptr = (uintptr_t(self->shards_memory.ptr) + CONCURRENT_MAP_SHARD_SIZE - 1) & ~uintptr_t(CONCURRENT_MAP_SHARD_SIZE - 1);
+		self->shards = (Shard*)ptr;
+		for (size_t i = 0; i < self->shards_count; ++i)
+		{
+			auto& shard = self->shards[i];
+			shard.mtx = mutex_rw_new("Concurrent_Map Shard");
+			shard.buckets = buf_with_allocator<Concurrent_Map_Node<TKey, TValue>*>(allocator);
+			shard.old_buckets = buf_with_allocator<Concurrent_Map_Node<TKey, TValue>*>(allocator);
+			shard.migrate_index = 0;
+			shard.count = 0;
+		}
+		return self;
+	}
+
+	// frees the given concurrent map, the keys and values are not destructed
+	template<typename TKey, typename TValue, typename THash>
+	inline static void
+	concurrent_map_free(Concurrent_Map<TKey, TValue, THash>& self)
+	{
+		if (self == nullptr)
+			return;
+
+		auto allocator = self->allocator;
+		for (size_t i = 0; i < self->shards_count; ++i)
+		{
+			auto& shard = self->shards[i];
+			for (auto buckets: {&shard.buckets, &shard.old_buckets})
+			{
+				for (auto it: *buckets)
+				{
+					while (it)
+					{
+						auto next = it->next;
+						free_from(allocator, it);
+						it = next;
+					}
+				}
+				buf_free(*buckets);
+			}
+			mutex_rw_free(shard.mtx);
+		}
+		free_from(allocator, self->shards_memory);
+		free_from(allocator, self);
+		self = nullptr;
+	}
+
+	// destruct overload for the concurrent map, it destructs the keys and values then frees the map
+	template<typename TKey, typename TValue, typename THash>
+	inline static void
+	destruct(Concurrent_Map<TKey, TValue, THash>& self)
+	{
+		if (self == nullptr)
+			return;
+
+		for (size_t i = 0; i < self->shards_count; ++i)
+		{
+			auto& shard = self->shards[i];
+			for (auto buckets: {&shard.buckets, &shard.old_buckets})
+				for (auto it: *buckets)
+					for (; it; it = it->next)
+						destruct(it->kv);
+		}
+		concurrent_map_free(self);
+	}
+
+	// returns the number of keys in the map, it's not a snapshot because each shard is counted at a different time
+	template<typename TKey, typename TValue, typename THash>
+	inline static size_t
+	concurrent_map_count(Concurrent_Map<TKey, TValue, THash> self)
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < self->shards_count; ++i)
+		{
+			auto& shard = self->shards[i];
+			mutex_read_lock(shard.mtx);
+			res += shard.count;
+			mutex_read_unlock(shard.mtx);
+		}
+		return res;
+	}
+
+	// calls the given function with the value of the given key while holding the read lock of its shard, the function
+	// shouldn't keep references to the value or access the map, returns whether the key exists
+	template<typename TKey, typename TValue, typename THash, typename TFunc>
+	inline static bool
+	concurrent_map_read(Concurrent_Map<TKey, TValue, THash> self, const TKey& key, TFunc&& fn)
+	{
+		auto hash = THash()(key);
+		auto& shard = _concurrent_map_shard(self, hash);
+		mutex_read_lock(shard.mtx);
+		mn_defer{mutex_read_unlock(shard.mtx);};
+
+		auto it = _concurrent_map_shard_find(shard, key, hash);
+		if (it == nullptr)
+			return false;
+		fn((const TValue&)(*it)->kv.value);
+		return true;
+	}
+
+	// searches for the given key, if it exists a clone of its value is written to the given value (if it's not
+	// nullptr), returns whether the key exists
+	template<typename TKey, typename TValue, typename THash>
+	inline static bool
+	concurrent_map_lookup(Concurrent_Map<TKey, TValue, THash> self, const TKey& key, TValue* value = nullptr)
+	{
+		return concurrent_map_read(self, key, [value](const TValue& v) {
+			if (value)
+				*value = clone(v);
+		});
+	}
+
+	// inserts the given key value pair if the key doesn't exist, returns whether it was inserted, if it wasn't then the
+	// given key and value are not owned by the map
+	template<typename TKey, typename TValue, typename THash>
+	inline static bool
+	concurrent_map_insert(Concurrent_Map<TKey, TValue, THash> self, const TKey& key, const TValue& value)
+	{
+		auto hash = THash()(key);
+		auto& shard = _concurrent_map_shard(self, hash);
+		mutex_write_lock(shard.mtx);
+		mn_defer{mutex_write_unlock(shard.mtx);};
+
+		_concurrent_map_shard_migrate(shard, CONCURRENT_MAP_MIGRATE_STEP);
+		if (_concurrent_map_shard_find(shard, key, hash))
+			return false;
+
+		_concurrent_map_shard_maintain_space_complexity(shard);
+		auto node = alloc_from<Concurrent_Map_Node<TKey, TValue>>(self->allocator);
+		node->hash = hash;
+		node->kv = Key_Value<TKey, TValue>{key, value};
+		auto& bucket = shard.buckets[hash & (shard.buckets.count - 1)];
+		node->next = bucket;
+		bucket = node;
+		++shard.count;
+		return true;
+	}
+
+	// calls the given function with a reference to the value of the given key while holding the write lock of its
+	// shard, if the key doesn't exist it's inserted with a zero initialized value first, the function's signature is
+	// fn(TValue& value, bool inserted), it shouldn't access the map, returns whether the key was inserted
+	template<typename TKey, typename TValue, typename THash, typename TFunc>
+	inline static bool
+	concurrent_map_insert_or_update(Concurrent_Map<TKey, TValue, THash> self, const TKey& key, TFunc&& fn)
+	{
+		auto hash = THash()(key);
+		auto& shard = _concurrent_map_shard(self, hash);
+		mutex_write_lock(shard.mtx);
+		mn_defer{mutex_write_unlock(shard.mtx);};
+
+		_concurrent_map_shard_migrate(shard, CONCURRENT_MAP_MIGRATE_STEP);
+		if (auto it = _concurrent_map_shard_find(shard, key, hash))
+		{
+			fn((*it)->kv.value, false);
+			return false;
+		}
+
+		_concurrent_map_shard_maintain_space_complexity(shard);
+		auto node = alloc_from<Concurrent_Map_Node<TKey, TValue>>(self->allocator);
+		node->hash = hash;
+		node->kv = Key_Value<TKey, TValue>{key, TValue{}};
+		auto& bucket = shard.buckets[hash & (shard.buckets.count - 1)];
+		node->next = bucket;
+		bucket = node;
+		++shard.count;
+		fn(node->kv.value, true);
+		return true;
+	}
+
+	// removes the given key, returns whether it existed, the removed key and value are not destructed
+	template<typename TKey, typename TValue, typename THash>
+	inline static bool
+	concurrent_map_remove(Concurrent_Map<TKey, TValue, THash> self, const TKey& key)
+	{
+		auto hash = THash()(key);
+		auto& shard = _concurrent_map_shard(self, hash);
+		mutex_write_lock(shard.mtx);
+		mn_defer{mutex_write_unlock(shard.mtx);};
+
+		_concurrent_map_shard_migrate(shard, CONCURRENT_MAP_MIGRATE_STEP);
+		auto it = _concurrent_map_shard_find(shard, key, hash);
+		if (it == nullptr)
+			return false;
+
+		auto node = *it;
+		*it = node->next;
+		free_from(self->allocator, node);
+		--shard.count;
+		return true;
+	}
+
+	// returns a map with clones of the keys and values, each shard is copied while holding its read lock so the
+	// snapshot is consistent per shard but writes to other shards might happen while it's being taken
+	template<typename TKey, typename TValue, typename THash>
+	inline static Map<TKey, TValue, THash>
+	concurrent_map_snapshot(Concurrent_Map<TKey, TValue, THash> self, Allocator allocator = allocator_top())
+	{
+		auto res = map_with_allocator<TKey, TValue, THash>(allocator);
+		for (size_t i = 0; i < self->shards_count; ++i)
+		{
+			auto& shard = self->shards[i];
+			mutex_read_lock(shard.mtx);
+			mn_defer{mutex_read_unlock(shard.mtx);};
+
+			map_reserve(res, shard.count);
+			for (auto buckets: {&shard.buckets, &shard.old_buckets})
+				for (auto it: *buckets)
+					for (; it; it = it->next)
+						map_insert(res, clone(it->kv.key), clone(it->kv.value));
+		}
+		return res;
+	}
+}
@@ -4,6 +4,7 @@
 #include "mn/memory/Arena.h"
 
 #include <stddef.h>
+#include <atomic>
 
 namespace mn
 {
@@ -23,11 +24,21 @@ namespace mn
 		Allocator _allocator_stack[ALLOCATOR_CAPACITY];
 		size_t _allocator_stack_count;
 
-		//tmp allocator
-		memory::Arena _allocator_tmp = {4ULL * 1024ULL * 1024ULL, memory::clib()};
+		//tmp allocator, it reserves a virtual address range and commits it on demand, each thread has its own range
+		//so it's kept at 4GB which allows tens of thousands of threads within a 47-bit address space
+		inline static constexpr size_t TMP_RESERVE_SIZE = sizeof(void*) == 8 ? 4ULL * 1024ULL * 1024ULL * 1024ULL : 256ULL * 1024ULL * 1024ULL;
+		memory::Arena _allocator_tmp = {memory::Arena::Reserve{TMP_RESERVE_SIZE}};
 
 		//Local tmp stream
 		Reader reader_tmp;
+
+		Context() = default;
+
+		//constructs a context whose tmp allocator chains blocks of the given size instead of reserving the big
+		//virtual address range
+		explicit Context(size_t tmp_block_size)
+			: _allocator_tmp(tmp_block_size)
+		{}
 	};
 
 	MN_EXPORT void
@@ -45,6 +56,16 @@ namespace mn
 	MN_EXPORT Context*
 	context_local(Context* new_context = nullptr);
 
+	// creates a new heap allocated context, unlike the threads contexts its tmp allocator chains blocks of the given
+	// size instead of reserving a big virtual address range, so it can be used for contexts which are created in big
+	// numbers (like fibers contexts)
+	MN_EXPORT Context*
+	context_new(size_t tmp_block_size);
+
+	// frees the given context which was created by context_new
+	MN_EXPORT void
+	context_delete(Context* self);
+
 	// allocators are organized in a per thread stack so that you can default/top used allocator by calling
 	// mn::allocator_push and mn::allocator_pop, at the base of the stack is the clib allocator and it can't be popped
 	// it returns the current default/top allocator of the calling thread
@@ -163,6 +184,16 @@ namespace mn
 	MN_EXPORT Thread_Profile_Interface
 	thread_profile_interface_set(Thread_Profile_Interface self);
 
+	// set while any of the mutex hooks is set, the mutex implementations check it before calling the hooks so that
+	// they cost a single predictable branch when there's no profiler
+	MN_EXPORT extern std::atomic<bool> _THREAD_PROFILE_MUTEX_HOOKS;
+
+	inline static bool
+	_thread_profile_mutex_hooks()
+	{
+		return _THREAD_PROFILE_MUTEX_HOOKS.load(std::memory_order_relaxed);
+	}
+
 	MN_EXPORT void
 	_thread_new(Thread handle, const char* name);
 
@@ -0,0 +1,509 @@
+#pragma once
+
+#include "mn/Fabric.h"
+#include "mn/Socket.h"
+
+#if !defined(__cpp_impl_coroutine)
+	#error "mn/Coroutine.h requires c++20 coroutines support"
+#endif
+
+#include <coroutine>
+#include <utility>
+
+// stackless c++20 coroutines which run on fabric workers, unlike the blocking api a coroutine which awaits a future,
+// channel, waitgroup, or socket is suspended and its worker runs other tasks until the wait is satisfied, then the
+// coroutine is resumed by a resume task in the queue of the worker which satisfied the wait if it belongs to the same
+// fabric (this keeps communicating coroutines on the same worker), otherwise in the queue of the worker it was
+// suspended on
+//
+// coroutines run inside the scoped tmp region of their resume task, so they shouldn't keep tmp memory across
+// co_await expressions
+namespace mn
+{
+	// resumes the coroutine whose handle address is given, used as the resume function of coroutine tasks
+	inline static void
+	_coroutine_resume(void* handle)
+	{
+		std::coroutine_handle<>::from_address(handle).resume();
+	}
+
+	// creates a fabric task which resumes the given coroutine
+	inline static Fabric_Task
+	_coroutine_resume_task(std::coroutine_handle<> handle)
+	{
+		Fabric_Task res{};
+		res.kind = Fabric_Task::KIND_COROUTINE;
+		res.as_coroutine.resume = _coroutine_resume;
+		res.as_coroutine.handle = handle.address();
+		return res;
+	}
+
+	// the async waiter of a suspended coroutine
+	struct _Coroutine_Wait
+	{
+		Async_Waiter waiter;
+		Fabric_Resume_Point point;
+		std::coroutine_handle<> handle;
+	};
+
+	inline static void
+	_coroutine_wait_notify(Async_Waiter* waiter)
+	{
+		auto self = (_Coroutine_Wait*)waiter->user_data;
+		// the wait lives in the coroutine frame, so we shouldn't touch it after the coroutine is scheduled
+		auto point = self->point;
+		auto handle = self->handle;
+
+		auto local = fabric_resume_point_local();
+		if (local.worker && local.fabric == point.fabric && (point.fabric || local.worker == point.worker))
+			point = local;
+		fabric_resume_point_task_do(point, _coroutine_resume_task(handle));
+	}
+
+	inline static void
+	_coroutine_wait_init(_Coroutine_Wait& self, std::coroutine_handle<> handle)
+	{
+		self.waiter.notify = _coroutine_wait_notify;
+		self.waiter.user_data = &self;
+		self.waiter.next = nullptr;
+		self.point = fabric_resume_point_local();
+		self.handle = handle;
+	}
+
+	template<typename T>
+	struct Fabric_Coroutine;
+
+	// resumes the awaiting coroutine (if any) when a coroutine finishes, detached coroutines destroy themselves
+	struct _Fabric_Coroutine_Final_Awaiter
+	{
+		bool
+		await_ready() noexcept
+		{
+			return false;
+		}
+
+		template<typename TPromise>
+		std::coroutine_handle<>
+		await_suspend(std::coroutine_handle<TPromise> handle) noexcept
+		{
+			auto& promise = handle.promise();
+			if (promise.continuation)
+				return promise.continuation;
+			if (promise.detached)
+				handle.destroy();
+			return std::noop_coroutine();
+		}
+
+		void
+		await_resume() noexcept
+		{}
+	};
+
+	struct _Fabric_Coroutine_Promise_Base
+	{
+		// the coroutine which awaits this one, it's resumed once this coroutine finishes
+		std::coroutine_handle<> continuation;
+		// detached coroutines are owned by no one so they destroy themselves when they finish
+		bool detached;
+
+		// coroutine frames are allocated from the frame pool of the worker which starts them
+		static void*
+		operator new(size_t size)
+		{
+			return _fabric_block_alloc(size);
+		}
+
+		static void
+		operator delete(void* ptr, size_t size)
+		{
+			_fabric_block_free(ptr, size);
+		}
+
+		std::suspend_always
+		initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		_Fabric_Coroutine_Final_Awaiter
+		final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void
+		unhandled_exception()
+		{
+			panic("unhandled exception in fabric coroutine");
+		}
+	};
+
+	template<typename T>
+	struct _Fabric_Coroutine_Promise: _Fabric_Coroutine_Promise_Base
+	{
+		T result{};
+
+		Fabric_Coroutine<T>
+		get_return_object();
+
+		template<typename R>
+		void
+		return_value(R&& value)
+		{
+			result = std::forward<R>(value);
+		}
+	};
+
+	template<>
+	struct _Fabric_Coroutine_Promise<void>: _Fabric_Coroutine_Promise_Base
+	{
+		Fabric_Coroutine<void>
+		get_return_object();
+
+		void
+		return_void()
+		{}
+	};
+
+	// a lazy coroutine task which runs on fabric workers, it starts once it's awaited by another coroutine or once
+	// it's scheduled using coroutine_go, it owns its frame and destroys it when it goes out of scope
+	template<typename T = void>
+	struct [[nodiscard]] Fabric_Coroutine
+	{
+		using promise_type = _Fabric_Coroutine_Promise<T>;
+
+		std::coroutine_handle<promise_type> handle;
+
+		Fabric_Coroutine()
+			: handle(nullptr)
+		{}
+
+		explicit Fabric_Coroutine(std::coroutine_handle<promise_type> h)
+			: handle(h)
+		{}
+
+		Fabric_Coroutine(const Fabric_Coroutine&) = delete;
+
+		Fabric_Coroutine(Fabric_Coroutine&& other)
+			: handle(std::exchange(other.handle, nullptr))
+		{}
+
+		Fabric_Coroutine&
+		operator=(const Fabric_Coroutine&) = delete;
+
+		Fabric_Coroutine&
+		operator=(Fabric_Coroutine&& other)
+		{
+			if (handle)
+				handle.destroy();
+			handle = std::exchange(other.handle, nullptr);
+			return *this;
+		}
+
+		~Fabric_Coroutine()
+		{
+			if (handle)
+				handle.destroy();
+		}
+
+		// awaiting a coroutine starts it on the awaiting worker and resumes the awaiting coroutine when it finishes
+		auto
+		operator co_await() && noexcept
+		{
+			struct Awaiter
+			{
+				std::coroutine_handle<promise_type> handle;
+
+				bool
+				await_ready() noexcept
+				{
+					return false;
+				}
+
+				std::coroutine_handle<>
+				await_suspend(std::coroutine_handle<> continuation) noexcept
+				{
+					handle.promise().continuation = continuation;
+					return handle;
+				}
+
+				T
+				await_resume()
+				{
+					if constexpr (std::is_same_v<T, void> == false)
+						return std::move(handle.promise().result);
+				}
+			};
+			return Awaiter{handle};
+		}
+	};
+
+	template<typename T>
+	inline Fabric_Coroutine<T>
+	_Fabric_Coroutine_Promise<T>::get_return_object()
+	{
+		return Fabric_Coroutine<T>{std::coroutine_handle<_Fabric_Coroutine_Promise<T>>::from_promise(*this)};
+	}
+
+	inline Fabric_Coroutine<void>
+	_Fabric_Coroutine_Promise<void>::get_return_object()
+	{
+		return Fabric_Coroutine<void>{std::coroutine_handle<_Fabric_Coroutine_Promise<void>>::from_promise(*this)};
+	}
+
+	// the detached root of a scheduled coroutine which runs it and signals its future
+	template<typename T>
+	inline static Fabric_Coroutine<void>
+	_coroutine_root(Fabric_Coroutine<T> coroutine, _IFuture<T>* future)
+	{
+		if constexpr (std::is_same_v<T, void>)
+			co_await std::move(coroutine);
+		else
+			future->result = co_await std::move(coroutine);
+		_future_complete(future);
+		_future_release(future);
+	}
+
+	template<typename T>
+	inline static Future<T>
+	_coroutine_go(Fabric_Coroutine<T> coroutine, Fabric_Task& task)
+	{
+		Future<T> self{};
+		// owned by the future and the root coroutine
+		self._internal_future = _future_state_new<T>(2);
+
+		auto root = _coroutine_root(std::move(coroutine), self._internal_future);
+		root.handle.promise().detached = true;
+		task = _coroutine_resume_task(std::exchange(root.handle, nullptr));
+		return self;
+	}
+
+	// schedules the given coroutine to run on the given fabric, and returns the future of its result
+	template<typename T>
+	inline static Future<T>
+	coroutine_go(Fabric f, Fabric_Coroutine<T> coroutine)
+	{
+		Fabric_Task task{};
+		auto res = _coroutine_go(std::move(coroutine), task);
+		fabric_task_do(f, task);
+		return res;
+	}
+
+	// schedules the given coroutine to run on the given worker, and returns the future of its result
+	template<typename T>
+	inline static Future<T>
+	coroutine_go(Worker w, Fabric_Coroutine<T> coroutine)
+	{
+		Fabric_Task task{};
+		auto res = _coroutine_go(std::move(coroutine), task);
+		worker_task_do(w, task);
+		return res;
+	}
+
+	struct _Waitgroup_Awaiter
+	{
+		Waitgroup wg;
+		_Coroutine_Wait wait;
+
+		bool
+		await_ready()
+		{
+			return waitgroup_count(wg) == 0;
+		}
+
+		bool
+		await_suspend(std::coroutine_handle<> handle)
+		{
+			_coroutine_wait_init(wait, handle);
+			return waitgroup_wait_async(wg, &wait.waiter);
+		}
+
+		void
+		await_resume()
+		{}
+	};
+
+	// suspends the awaiting coroutine until the waitgroup count reaches 0
+	// `co_await co_waitgroup_wait(wg);`
+	inline static _Waitgroup_Awaiter
+	co_waitgroup_wait(Waitgroup wg)
+	{
+		return _Waitgroup_Awaiter{wg, {}};
+	}
+
+	template<typename T>
+	struct _Future_Awaiter
+	{
+		Future<T> future;
+		_Coroutine_Wait wait;
+
+		bool
+		await_ready()
+		{
+			return future_is_done(future);
+		}
+
+		bool
+		await_suspend(std::coroutine_handle<> handle)
+		{
+			_coroutine_wait_init(wait, handle);
+			auto waiter = &wait.waiter;
+			auto continuation = _future_continuation_new(nullptr, Task<void()>::make([waiter]{ waiter->notify(waiter); }));
+			if (_future_continuation_push(future._internal_future, continuation))
+				return true;
+			_future_continuation_free(continuation);
+			return false;
+		}
+
+		decltype(auto)
+		await_resume()
+		{
+			if constexpr (std::is_same_v<T, void> == false)
+				return *future;
+		}
+	};
+
+	// suspends the awaiting coroutine until the future is done and returns a reference to its result, the future
+	// should still be freed using future_free
+	// `int& x = co_await my_future;`
+	template<typename T>
+	inline static _Future_Awaiter<T>
+	operator co_await(Future<T> self)
+	{
+		return _Future_Awaiter<T>{self, {}};
+	}
+
+	template<typename T>
+	struct _Chan_Recv_Awaiter
+	{
+		Chan<T> chan;
+		Chan_Waiter<T> receiver;
+		_Coroutine_Wait wait;
+
+		bool
+		await_ready()
+		{
+			return false;
+		}
+
+		bool
+		await_suspend(std::coroutine_handle<> handle)
+		{
+			chan_ref(chan);
+			_coroutine_wait_init(wait, handle);
+			receiver.waiter = &wait.waiter;
+			return chan_recv_async(chan, &receiver);
+		}
+
+		Recv_Result<T>
+		await_resume()
+		{
+			chan_unref(chan);
+			if (receiver.ok)
+				return { receiver.value, true };
+			return { T{}, false };
+		}
+	};
+
+	// suspends the awaiting coroutine until it receives a value from the given channel
+	// `auto [value, more] = co_await co_chan_recv(chan);`
+	template<typename T>
+	inline static _Chan_Recv_Awaiter<T>
+	co_chan_recv(Chan<T> chan)
+	{
+		return _Chan_Recv_Awaiter<T>{chan, {}, {}};
+	}
+
+	template<typename T>
+	struct _Chan_Send_Awaiter
+	{
+		Chan<T> chan;
+		Chan_Waiter<T> sender;
+		_Coroutine_Wait wait;
+
+		bool
+		await_ready()
+		{
+			return false;
+		}
+
+		bool
+		await_suspend(std::coroutine_handle<> handle)
+		{
+			chan_ref(chan);
+			_coroutine_wait_init(wait, handle);
+			sender.waiter = &wait.waiter;
+			return chan_send_async(chan, &sender);
+		}
+
+		void
+		await_resume()
+		{
+			chan_unref(chan);
+			if (sender.ok == false)
+				panic("cannot send in a closed channel");
+		}
+	};
+
+	// suspends the awaiting coroutine until the given value is sent to the given channel
+	// `co_await co_chan_send(chan, value);`
+	template<typename T>
+	inline static _Chan_Send_Awaiter<T>
+	co_chan_send(Chan<T> chan, const T& value)
+	{
+		return _Chan_Send_Awaiter<T>{chan, Chan_Waiter<T>{nullptr, nullptr, value, false, nullptr}, {}};
+	}
+
+	struct _Socket_Ready_Awaiter
+	{
+		Socket socket;
+		Timeout timeout;
+		Poll_Wait poll;
+		_Coroutine_Wait wait;
+		bool ready;
+
+		bool
+		await_ready()
+		{
+			return false;
+		}
+
+		bool
+		await_suspend(std::coroutine_handle<> handle)
+		{
+			_coroutine_wait_init(wait, handle);
+			poll = Poll_Wait{};
+			poll.fd = socket_fd(socket);
+			poll.write = false;
+			poll.deadline_in_ms = UINT64_MAX;
+			if (timeout != INFINITE_TIMEOUT)
+				poll.deadline_in_ms = time_in_millis() + timeout.milliseconds;
+			poll.user_data = this;
+			poll.on_done = [](Poll_Wait* poll, bool ready) {
+				auto self = (_Socket_Ready_Awaiter*)poll->user_data;
+				self->ready = ready;
+				_coroutine_wait_notify(&self->wait.waiter);
+			};
+
+			// if the socket can't be waited on (e.g. the platform doesn't have a poller) we report it as ready and
+			// the following read blocks with its own timeout instead
+			ready = true;
+			return _poll_wait_start(&poll);
+		}
+
+		bool
+		await_resume()
+		{
+			return ready;
+		}
+	};
+
+	// suspends the awaiting coroutine until the given socket is ready to be read from, or until the timeout expires,
+	// returns whether the socket is ready
+	// `if (co_await co_socket_ready(socket, {1000})) socket_read(socket, data, NO_TIMEOUT);`
+	inline static _Socket_Ready_Awaiter
+	co_socket_ready(Socket socket, Timeout timeout)
+	{
+		return _Socket_Ready_Awaiter{socket, timeout, {}, {}, false};
+	}
+}
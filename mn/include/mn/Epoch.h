@@ -0,0 +1,160 @@
+#pragma once
+
+#include "mn/Exports.h"
+#include "mn/Base.h"
+#include "mn/Memory.h"
+
+#include <atomic>
+
+namespace mn
+{
+	// epoch based memory reclamation, it's used to free the memory of lock free data structures (and published
+	// snapshots) which readers might still be reading
+	//
+	// readers access the shared memory inside a read side critical section (between epoch_enter and epoch_leave),
+	// and writers unlink the memory first then retire it using defer_free, the retired memory is freed once all the
+	// readers which were inside a critical section at the time of the retirement leave it
+	//
+	// fabric workers enter a critical section before each job and leave it after the job so the jobs don't need to
+	// do it themselves, but pointers read inside a job shouldn't be kept after the job finishes, and the worker leaves
+	// its critical section while the job blocks (or the fiber parks) so pointers read in it shouldn't be kept across
+	// blocking calls either, jobs which need to keep them should enter their own critical section which stays
+	// entered while they block, fibers which park inside their own critical section keep it while they're parked
+	// and take it with them to the worker which resumes them
+	//
+	// critical sections are cheap but they delay the reclamation so they shouldn't block for long
+
+	// enters a read side critical section on the calling thread, critical sections can be nested
+	MN_EXPORT void
+	epoch_enter();
+
+	// leaves the read side critical section entered by epoch_enter, when the outermost critical section is left the
+	// thread might free some of its retired memory
+	MN_EXPORT void
+	epoch_leave();
+
+	// returns whether the calling thread is inside a read side critical section
+	MN_EXPORT bool
+	epoch_active();
+
+	// retires the given pointer, the given function is called with the pointer and the given allocator once no
+	// reader can be accessing it, it might be called from another thread
+	MN_EXPORT void
+	epoch_defer(void (*fn)(void* ptr, Allocator allocator), void* ptr, Allocator allocator = allocator_top());
+
+	// tries to advance the global epoch and frees the retired memory of the calling thread (and the exited threads)
+	// which is safe to free
+	MN_EXPORT void
+	epoch_collect();
+
+	// waits until all the readers which are inside a critical section leave it then frees the retired memory of the
+	// calling thread (and the exited threads), it shouldn't be called from inside a critical section, except for the
+	// one fabric workers enter for their jobs which it leaves while it waits
+	MN_EXPORT void
+	epoch_synchronize();
+
+	struct Epoch_Thread;
+
+	// the critical sections a fiber entered when it parked, the parked record keeps the epoch the fiber observed
+	// published until the fiber is resumed
+	struct _Epoch_Parked
+	{
+		Epoch_Thread* record;
+		size_t depth;
+	};
+
+	// enters the critical section a fabric worker keeps while it runs a job
+	MN_EXPORT void
+	_epoch_worker_enter();
+
+	// leaves the critical section entered by _epoch_worker_enter
+	MN_EXPORT void
+	_epoch_worker_leave();
+
+	// leaves the worker critical section before the job blocks so it doesn't stall the reclamation, returns false and
+	// does nothing if the job entered its own critical section or the worker critical section is already left
+	MN_EXPORT bool
+	_epoch_worker_suspend();
+
+	// enters the worker critical section again after the job stops blocking
+	MN_EXPORT void
+	_epoch_worker_resume();
+
+	// moves the critical sections the fiber entered on top of the worker critical section out of the calling worker
+	// when the fiber switches out, so they neither stay entered on the worker nor get freed while the fiber is parked
+	MN_EXPORT _Epoch_Parked
+	_epoch_fiber_park();
+
+	// moves the critical sections the fiber parked with into the calling worker before the fiber switches in
+	MN_EXPORT void
+	_epoch_fiber_resume(_Epoch_Parked& parked);
+
+	// retires the given pointer and frees it using the top/default allocator once no reader can be accessing it
+	template<typename T>
+	inline static void
+	defer_free(T* ptr)
+	{
+		if (ptr == nullptr)
+			return;
+		epoch_defer([](void* p, Allocator allocator) { free_from(allocator, (T*)p); }, ptr);
+	}
+
+	// retires the given pointer and destructs and frees it using the top/default allocator once no reader can be
+	// accessing it
+	template<typename T>
+	inline static void
+	defer_free_destruct(T* ptr)
+	{
+		if (ptr == nullptr)
+			return;
+		epoch_defer([](void* p, Allocator allocator) {
+			((T*)p)->~T();
+			free_from(allocator, (T*)p);
+		}, ptr);
+	}
+
+	// read side critical section scope, it enters the critical section on construction and leaves it on destruction
+	struct Epoch_Scope
+	{
+		Epoch_Scope() { epoch_enter(); }
+		~Epoch_Scope() { epoch_leave(); }
+
+		Epoch_Scope(const Epoch_Scope&) = delete;
+		Epoch_Scope& operator=(const Epoch_Scope&) = delete;
+	};
+
+	// a pointer which is read by lots of readers and replaced by writers, readers always see either the old or the
+	// new value in full, it's meant for publishing immutable snapshots of data (e.g. configuration tables)
+	template<typename T>
+	struct Rcu_Pointer
+	{
+		std::atomic<T*> ptr;
+	};
+
+	// reads the current value of the pointer, it should be called from inside a critical section and the returned
+	// value is only valid until the critical section is left
+	template<typename T>
+	inline static T*
+	rcu_pointer_read(const Rcu_Pointer<T>& self)
+	{
+		mn_assert_msg(epoch_active(), "rcu pointer is read outside an epoch critical section");
+		return self.ptr.load(std::memory_order_acquire);
+	}
+
+	// publishes the given value and returns the old one, the old value should be retired using defer_free (or
+	// freed after epoch_synchronize) because readers might still be using it
+	template<typename T>
+	inline static T*
+	rcu_pointer_publish(Rcu_Pointer<T>& self, T* value)
+	{
+		return self.ptr.exchange(value, std::memory_order_acq_rel);
+	}
+
+	// publishes the given value and retires the old one using defer_free_destruct
+	template<typename T>
+	inline static void
+	rcu_pointer_replace(Rcu_Pointer<T>& self, T* value)
+	{
+		defer_free_destruct(rcu_pointer_publish(self, value));
+	}
+}
@@ -5,6 +5,7 @@
 #include "mn/Task.h"
 #include "mn/Ring.h"
 #include "mn/Thread.h"
+#include "mn/Fiber.h"
 #include "mn/Defer.h"
 #include "mn/OS.h"
 #include "mn/Stream.h"
@@ -46,6 +47,20 @@ namespace mn
 		Compute_Dims tile_size;
 	};
 
+	// fabric task priority classes, each worker keeps a separate queue for each class, workers run the critical tasks
+	// first but a task which waited in its queue beyond the latency budget of its class runs ahead of the tasks which
+	// were queued after that, so no class starves
+	enum FABRIC_PRIORITY
+	{
+		// the default priority, it's the first so that zero initialized tasks are normal
+		FABRIC_PRIORITY_NORMAL,
+		// latency sensitive tasks (e.g. request handlers), they don't have a latency budget
+		FABRIC_PRIORITY_CRITICAL,
+		// throughput tasks (e.g. batch compute), they only run ahead of the other classes when they wait too long
+		FABRIC_PRIORITY_BACKGROUND,
+		FABRIC_PRIORITY_COUNT,
+	};
+
 	// represents a single task in the fabric's worker task queue
 	struct Fabric_Task
 	{
@@ -55,9 +70,20 @@ namespace mn
 			KIND_ONESHOT,
 			// a compute task, usually invoked via compute function
 			KIND_COMPUTE,
+			// a task which runs on its own fiber, usually invoked via go_fiber function, a task with a fiber and
+			// without a function resumes a parked fiber
+			KIND_FIBER,
+			// a task which resumes a suspended coroutine, usually scheduled by the coroutine awaitables in
+			// mn/Coroutine.h
+			KIND_COROUTINE,
 		};
 
 		KIND kind;
+		FABRIC_PRIORITY priority;
+		// optional soft deadline in milliseconds relative to the time the task is queued, 0 means no deadline, tasks
+		// with a deadline run ahead of the tasks of their class which are due later, and they're counted as missed
+		// in the fabric queue stats if they start after it
+		uint32_t deadline_in_ms;
 		union
 		{
 			struct
@@ -71,6 +97,18 @@ namespace mn
 				Compute_Args args;
 				Waitgroup wg;
 			} as_compute;
+
+			struct
+			{
+				Task<void()> task;
+				Fiber fiber;
+			} as_fiber;
+
+			struct
+			{
+				void (*resume)(void* handle);
+				void* handle;
+			} as_coroutine;
 		};
 	};
 
@@ -87,6 +125,13 @@ namespace mn
 			self.as_compute.task(self.as_compute.args);
 			if (self.as_compute.wg) waitgroup_done(self.as_compute.wg);
 			break;
+		case Fabric_Task::KIND_FIBER:
+			// fiber tasks are started by the workers, if the task is run elsewhere it runs on the caller stack
+			if (self.as_fiber.task) self.as_fiber.task();
+			break;
+		case Fabric_Task::KIND_COROUTINE:
+			self.as_coroutine.resume(self.as_coroutine.handle);
+			break;
 		default:
 			break;
 		}
@@ -104,6 +149,9 @@ namespace mn
 		case Fabric_Task::KIND_COMPUTE:
 			task_free(self.as_compute.task);
 			break;
+		case Fabric_Task::KIND_FIBER:
+			task_free(self.as_fiber.task);
+			break;
 		default:
 			break;
 		}
@@ -216,6 +264,18 @@ namespace mn
 	typedef struct IFabric* Fabric;
 
 	// fabric construction settings, which is used to customize fabric behavior on creation
+	// fabric workers placement policy
+	enum FABRIC_PLACEMENT
+	{
+		// workers are not pinned, if an affinity set is provided all of them run on it
+		FABRIC_PLACEMENT_NONE,
+		// each worker is pinned to a single cpu, workers are distributed over the numa nodes in contiguous ranges
+		FABRIC_PLACEMENT_CORE,
+		// each worker is pinned to all the cpus of a numa node, workers are distributed over the numa nodes in
+		// contiguous ranges
+		FABRIC_PLACEMENT_NUMA_NODE,
+	};
+
 	struct Fabric_Settings
 	{
 		// fabric instance name
@@ -240,8 +300,92 @@ namespace mn
 		Task<void()> after_each_job;
 		// function which will be executed when a new worker is started
 		Task<void()> on_worker_start;
+		// amount of tmp memory in bytes each worker keeps warm between jobs, jobs run inside a scoped tmp region so
+		// their tmp allocations are freed when they finish but the memory itself is kept for the next jobs
+		// default: 4MB
+		size_t tmp_retain_size;
+		// how many milliseconds a worker keeps its tmp memory above tmp_retain_size after the last job which needed it
+		// before returning it to the os, this applies to idle workers as well
+		// default: 1000
+		uint32_t tmp_decay_in_ms;
+		// workers placement policy, pinned workers allocate their tmp memory and job queue after they're pinned so
+		// the os places them in the local memory of their numa node, and sysmon steals jobs for idle workers from
+		// workers on the same numa node first
+		// default: FABRIC_PLACEMENT_NONE
+		FABRIC_PLACEMENT placement;
+		// cpus the workers are allowed to run on
+		// default: empty which means all the cpus
+		Cpu_Set affinity;
+		// stack size in bytes of the fibers created by go_fiber, each worker keeps a cache of finished fibers so
+		// their stacks are reused by the next fibers
+		// default: 64KB
+		size_t fiber_stack_size;
+		// how many milliseconds a normal task waits in its queue before it runs ahead of the critical tasks which
+		// were queued after that
+		// default: 10
+		uint32_t normal_latency_budget_in_ms;
+		// how many milliseconds a background task waits in its queue before it runs ahead of the critical and
+		// normal tasks which were queued after that
+		// default: 100
+		uint32_t background_latency_budget_in_ms;
+	};
+
+	// fabric workers tmp memory statistics
+	struct Fabric_Tmp_Stats
+	{
+		// number of times the workers returned tmp memory to the os/meta allocator
+		size_t release_count;
+		// total amount of tmp memory in bytes the workers returned to the os/meta allocator
+		size_t release_mem;
+		// amount of tmp memory in bytes the workers are currently keeping warm
+		size_t retained_mem;
+	};
+
+	// number of buckets in the queue latency histogram, bucket i counts the latencies in [2^i, 2^(i + 1))
+	// microseconds, except the first which starts from 0 and the last which counts everything above
+	constexpr static size_t FABRIC_LATENCY_BUCKETS_COUNT = 24;
+
+	// queue latency statistics of a priority class, the queue latency of a task is the time from queueing it until a
+	// worker starts running it
+	struct Fabric_Priority_Stats
+	{
+		// number of tasks which started running
+		size_t tasks_count;
+		// sum of the queue latencies in microseconds
+		uint64_t total_latency_in_us;
+		uint64_t max_latency_in_us;
+		// number of tasks with a deadline which started running after it
+		size_t missed_deadlines_count;
+		size_t latency_histogram[FABRIC_LATENCY_BUCKETS_COUNT];
+	};
+
+	// fabric queue latency statistics of each priority class
+	struct Fabric_Queue_Stats
+	{
+		Fabric_Priority_Stats priorities[FABRIC_PRIORITY_COUNT];
 	};
 
+	// returns an upper bound of the given percentile [0, 1] of the queue latency in microseconds using the histogram
+	inline static uint64_t
+	fabric_priority_stats_latency_percentile(const Fabric_Priority_Stats& self, double percentile)
+	{
+		if (self.tasks_count == 0)
+			return 0;
+
+		auto target = size_t(percentile * double(self.tasks_count));
+		if (target >= self.tasks_count)
+			target = self.tasks_count - 1;
+
+		size_t count = 0;
+		for (size_t i = 0; i + 1 < FABRIC_LATENCY_BUCKETS_COUNT; ++i)
+		{
+			count += self.latency_histogram[i];
+			if (count > target)
+				return uint64_t(1) << (i + 1);
+		}
+		return self.max_latency_in_us;
+	}
+
 	// creates a new fabric instance with the given construction settings
 	MN_EXPORT Fabric
 	fabric_new(Fabric_Settings settings);
@@ -275,6 +419,47 @@ namespace mn
 		fabric_task_do(self, entry);
 	}
 
+	// a handle to a fabric timer, a zero initialized handle doesn't refer to any timer, and the handles of fired oneshot
+	// timers and cancelled timers are no longer valid
+	struct Fabric_Timer
+	{
+		uint64_t handle;
+	};
+
+	// schedules the given task (a oneshot or a fiber task) into the fabric after the given delay in milliseconds, and
+	// then every period milliseconds if the period isn't 0, the timers are kept in a hierarchical timer wheel so
+	// adding and cancelling them is O(1), sysmon dispatches the expired timers to the workers in batches, and timers
+	// are coalesced by rounding their expiry time up by at most 1/32 of their delay
+	MN_EXPORT Fabric_Timer
+	fabric_timer_task_do(Fabric self, uint32_t delay_in_ms, uint32_t period_in_ms, const Fabric_Task& task);
+
+	// cancels the given timer, returns whether it was cancelled before it fired, periodic timers calls which were
+	// already dispatched still run
+	MN_EXPORT bool
+	fabric_timer_cancel(Fabric self, Fabric_Timer timer);
+
+	// schedules the given callable into the fabric after the given delay in milliseconds
+	template<typename TFunc>
+	inline static Fabric_Timer
+	fabric_do_after(Fabric self, uint32_t delay_in_ms, TFunc&& f)
+	{
+		Fabric_Task entry{};
+		entry.as_oneshot.task = Task<void()>::make(std::forward<TFunc>(f));
+		return fabric_timer_task_do(self, delay_in_ms, 0, entry);
+	}
+
+	// schedules the given callable into the fabric every period milliseconds until the timer is cancelled, calls are
+	// dispatched even if the previous ones didn't finish, and calls missed while the fabric was late are skipped
+	template<typename TFunc>
+	inline static Fabric_Timer
+	fabric_do_every(Fabric self, uint32_t period_in_ms, TFunc&& f)
+	{
+		mn_assert(period_in_ms > 0);
+		Fabric_Task entry{};
+		entry.as_oneshot.task = Task<void()>::make(std::forward<TFunc>(f));
+		return fabric_timer_task_do(self, period_in_ms, period_in_ms, entry);
+	}
+
 	// returns the local fabric of the calling thread if it has one, if it doesn't it will return nullptr
 	MN_EXPORT Fabric
 	fabric_local();
@@ -283,6 +468,44 @@ namespace mn
 	MN_EXPORT size_t
 	fabric_workers_count(Fabric self);
 
+	// returns the tmp memory statistics of the workers of the given fabric instance
+	MN_EXPORT Fabric_Tmp_Stats
+	fabric_tmp_stats(Fabric self);
+
+	// returns the queue latency statistics of the given fabric instance, workers report their statistics in batches
+	// (and whenever they go idle) so the latest tasks might not be counted yet
+	MN_EXPORT Fabric_Queue_Stats
+	fabric_queue_stats(Fabric self);
+
+	// the worker a suspended task is resumed on, tasks of a fabric are resumed on the worker of the same index (sysmon
+	// might have replaced the worker they were suspended on by then), and tasks of standalone workers are resumed on
+	// the same worker
+	struct Fabric_Resume_Point
+	{
+		Fabric fabric;
+		size_t fabric_index;
+		Worker worker;
+	};
+
+	// returns the resume point of the calling worker, it's empty if the calling thread isn't a worker
+	MN_EXPORT Fabric_Resume_Point
+	fabric_resume_point_local();
+
+	// schedules the given task into the worker of the given resume point, if the resume point is empty the task is
+	// run on the calling thread right away
+	MN_EXPORT void
+	fabric_resume_point_task_do(Fabric_Resume_Point self, const Fabric_Task& task);
+
+	// allocates a small block (e.g. a coroutine frame or a future state) of the given size from the calling worker's
+	// pool, blocks are freed into the pool of the worker which frees them, and threads without a worker use the c
+	// allocator
+	MN_EXPORT void*
+	_fabric_block_alloc(size_t size);
+
+	// frees the given small block, size should be the same size it was allocated with
+	MN_EXPORT void
+	_fabric_block_free(void* ptr, size_t size);
+
 	// schedules the given callable into the given fabric
 	template<typename TFunc>
 	inline static void
@@ -303,6 +526,43 @@ namespace mn
 		worker_task_do(worker, entry);
 	}
 
+	// schedules the given callable into the given fabric with the given priority and an optional soft deadline in
+	// milliseconds (0 means no deadline)
+	template<typename TFunc>
+	inline static void
+	go(Fabric f, FABRIC_PRIORITY priority, uint32_t deadline_in_ms, TFunc&& fn)
+	{
+		Fabric_Task entry{};
+		entry.priority = priority;
+		entry.deadline_in_ms = deadline_in_ms;
+		entry.as_oneshot.task = Task<void()>::make(std::forward<TFunc>(fn));
+		fabric_task_do(f, entry);
+	}
+
+	// schedules the given callable to run on its own fiber in the given fabric, unlike go the worker isn't blocked
+	// when the callable waits on a mutex, condition variable, waitgroup, channel, or socket read, instead the fiber is
+	// parked and the worker runs other tasks until the wait is satisfied
+	template<typename TFunc>
+	inline static void
+	go_fiber(Fabric f, TFunc&& fn)
+	{
+		Fabric_Task entry{};
+		entry.kind = Fabric_Task::KIND_FIBER;
+		entry.as_fiber.task = Task<void()>::make(std::forward<TFunc>(fn));
+		fabric_task_do(f, entry);
+	}
+
+	// schedules the given callable to run on its own fiber in the given worker
+	template<typename TFunc>
+	inline static void
+	go_fiber(Worker worker, TFunc&& fn)
+	{
+		Fabric_Task entry{};
+		entry.kind = Fabric_Task::KIND_FIBER;
+		entry.as_fiber.task = Task<void()>::make(std::forward<TFunc>(fn));
+		worker_task_do(worker, entry);
+	}
+
 	// tries to schedule the given callable into the local worker/fabric
 	// if it doesn't find any it will panic
 	template<typename TFunc>
@@ -330,10 +590,29 @@ namespace mn
 	// a message passing primitive used to communicate between fabric tasks
 	// this one is built around messages being simple byte streams
 	// which is useful if you're going to do work like encryption/compression
+	//
+	// it works in one of two modes, a rendezvous mode (created using chan_stream_new) where the writer blocks until the
+	// reader consumes all of its bytes directly from the writer's memory, and a buffered mode (created using
+	// chan_stream_buffered_new) where the stream owns a ring of buffers and the writer returns as soon as its bytes are
+	// copied, which lets the writer and the reader run concurrently
 	typedef struct IChan_Stream* Chan_Stream;
 	struct IChan_Stream final: IStream
 	{
+		// the writer's memory in rendezvous mode
 		Block data_blob;
+		// the memory of the ring buffers in buffered mode, it's empty in rendezvous mode
+		Block ring_memory;
+		// the committed size of each buffer in the ring
+		Buf<size_t> ring_sizes;
+		size_t ring_buffer_size;
+		// index of the oldest filled buffer, and the number of filled buffers
+		size_t ring_head;
+		size_t ring_count;
+		// number of consumed bytes of the oldest filled buffer
+		size_t ring_read_offset;
+		// set while a writer (or a reader) holds an acquired buffer
+		bool writer_busy;
+		bool reader_busy;
 		Mutex mtx;
 		Cond_Var read_cv;
 		Cond_Var write_cv;
@@ -373,6 +652,11 @@ namespace mn
 	MN_EXPORT Chan_Stream
 	chan_stream_new();
 
+	// creates a new buffered channel stream which owns a ring of the given number of buffers each of the given size, a
+	// write only blocks when all the buffers are filled
+	MN_EXPORT Chan_Stream
+	chan_stream_buffered_new(size_t buffers_count, size_t buffer_size);
+
 	// frees the given channel stream, by decrementing its reference count and only freeing it if it reaches 0
 	MN_EXPORT void
 	chan_stream_free(Chan_Stream self);
@@ -399,6 +683,26 @@ namespace mn
 	MN_EXPORT bool
 	chan_stream_closed(Chan_Stream self);
 
+	// acquires the next free buffer of a buffered channel stream to write into without copying, it blocks until a buffer
+	// is free, the written bytes are published by calling chan_stream_write_commit, returns an empty block if the stream
+	// is closed
+	MN_EXPORT Block
+	chan_stream_write_acquire(Chan_Stream self);
+
+	// publishes the first size bytes of the buffer acquired by chan_stream_write_acquire to the reader
+	MN_EXPORT void
+	chan_stream_write_commit(Chan_Stream self, size_t size);
+
+	// acquires the unread bytes of the oldest filled buffer to read them without copying, it blocks until there's data
+	// to read, the read bytes are consumed by calling chan_stream_read_release, returns an empty block if the stream is
+	// closed and there's no data left
+	MN_EXPORT Block
+	chan_stream_read_acquire(Chan_Stream self);
+
+	// consumes the first size bytes of the block acquired by chan_stream_read_acquire
+	MN_EXPORT void
+	chan_stream_read_release(Chan_Stream self, size_t size);
+
 	// automatic wrapper around channel stream which uses RAII to handle the reference counting
 	// useful for scoped usage of channel streams
 	struct Auto_Chan_Stream
@@ -449,6 +753,10 @@ namespace mn
 		operator Chan_Stream() const { return handle; }
 	};
 
+	// the ring size of the channel streams created by lazy_stream
+	constexpr inline size_t LAZY_STREAM_BUFFERS_COUNT = 4;
+	constexpr inline size_t LAZY_STREAM_BUFFER_SIZE = 64 * 1024;
+
 	// converts a given stream from an active one to a lazy one which is much suitable for piping a
 	// single stream through different processing functions
 	// for example if i have a file stream which is streamed from disk, ex. `auto file = file_open(...);`
@@ -473,11 +781,14 @@ namespace mn
 	// copy_stream(encrypted_stream, my_output_stream);
 	// ```
 	// this way you won't need to load the entire file into memory in order to process it
+	// the returned stream is buffered so each stage of the pipeline runs concurrently with the next one
 	template<typename TFunc, typename ... TArgs>
 	inline static Auto_Chan_Stream
 	lazy_stream(Fabric f, TFunc&& func, mn::Stream stream_in, TArgs&& ... args)
 	{
-		Auto_Chan_Stream res;
+		auto stream = chan_stream_buffered_new(LAZY_STREAM_BUFFERS_COUNT, LAZY_STREAM_BUFFER_SIZE);
+		Auto_Chan_Stream res{stream};
+		chan_stream_free(stream);
 		mn::go(f, [=]{
 			func(stream_in, res, args...);
 			chan_stream_close(res);
@@ -485,21 +796,107 @@ namespace mn
 		return res;
 	}
 
+	// a continuation of a future, it runs once the future is done
+	struct _Future_Continuation
+	{
+		Task<void()> task;
+		// the fabric the continuation is scheduled onto, it runs on the thread which completes the future if it's null
+		Fabric fabric;
+		_Future_Continuation* next;
+	};
+
+	// the type erased part of the future state, the result follows it in the same block
+	struct _IFuture_Base
+	{
+		// the owners of the state (the future itself, the function which produces its result, and the continuations
+		// which read it), the state goes back to the block pool once all of them release it
+		std::atomic<int> _refs;
+		// lock free stack of the continuations which wait for the future, it's set to _future_done_mark() once the
+		// future is done so continuations attached afterwards run right away
+		std::atomic<_Future_Continuation*> _continuations;
+		// destructs the result and frees the state
+		void (*_free)(_IFuture_Base* self);
+	};
+
 	template<typename T>
-	struct _IFuture
+	struct _IFuture: _IFuture_Base
 	{
-		Waitgroup _wg;
 		T result;
 	};
 
 	template<>
-	struct _IFuture<void>
+	struct _IFuture<void>: _IFuture_Base
+	{};
+
+	inline static _Future_Continuation*
+	_future_done_mark()
 	{
-		Waitgroup _wg;
-	};
+		return (_Future_Continuation*)uintptr_t(1);
+	}
+
+	// allocates a continuation from the block pool
+	MN_EXPORT _Future_Continuation*
+	_future_continuation_new(Fabric fabric, const Task<void()>& task);
+
+	// frees the given continuation without running it
+	MN_EXPORT void
+	_future_continuation_free(_Future_Continuation* self);
+
+	// attaches the given continuation to the given future, returns false without attaching it if the future is done
+	MN_EXPORT bool
+	_future_continuation_push(_IFuture_Base* self, _Future_Continuation* continuation);
+
+	// runs the given continuation on the calling thread (or schedules it onto its fabric) then frees it
+	MN_EXPORT void
+	_future_continuation_run(_Future_Continuation* self);
+
+	// marks the given future as done and runs its continuations in the order they were attached, it should be called
+	// once the result is written
+	MN_EXPORT void
+	_future_complete(_IFuture_Base* self);
+
+	// blocks until the given future is done
+	MN_EXPORT void
+	_future_wait(_IFuture_Base* self);
+
+	// attaches the given task to the given future, it runs right away if the future is done
+	inline static void
+	_future_continuation_add(_IFuture_Base* self, Fabric fabric, const Task<void()>& task)
+	{
+		auto continuation = _future_continuation_new(fabric, task);
+		if (_future_continuation_push(self, continuation) == false)
+			_future_continuation_run(continuation);
+	}
+
+	inline static void
+	_future_release(_IFuture_Base* self)
+	{
+		if (self->_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			self->_free(self);
+	}
+
+	// allocates a future state from the block pool with the given number of owners
+	template<typename T>
+	inline static _IFuture<T>*
+	_future_state_new(int refs)
+	{
+		static_assert(alignof(_IFuture<T>) <= alignof(std::max_align_t), "future result is over aligned");
+
+		auto self = ::new (_fabric_block_alloc(sizeof(_IFuture<T>))) _IFuture<T>();
+		self->_refs.store(refs, std::memory_order_relaxed);
+		self->_continuations.store(nullptr, std::memory_order_relaxed);
+		self->_free = [](_IFuture_Base* base) {
+			auto self = (_IFuture<T>*)base;
+			if constexpr (std::is_same_v<T, void> == false)
+				destruct(self->result);
+			_fabric_block_free(self, sizeof(_IFuture<T>));
+		};
+		return self;
+	}
 
 	// future is a wrapper around the result of any function which called in an async way using fabric
-	// it's useful in case you want to track the completion of this function
+	// it's useful in case you want to track the completion of this function, or to chain other functions after it
+	// using future_then, future_when_all, and future_when_any without blocking
 	template<typename T>
 	struct Future
 	{
@@ -528,21 +925,22 @@ namespace mn
 	future_go(Fabric f, TFunc&& fn, TArgs&& ... args)
 	{
 		using return_type = std::invoke_result_t<TFunc, TArgs...>;
-		Future<return_type> self{};
-		self._internal_future = mn::alloc_zerod<_IFuture<return_type>>();
-		self._internal_future->_wg = waitgroup_new();
-		waitgroup_add(self._internal_future->_wg, 1);
+		// owned by the future and the scheduled function
+		auto state = _future_state_new<return_type>(2);
 
 		Fabric_Task entry{};
 		entry.as_oneshot.task = Task<void()>::make([=]() mutable {
 			if constexpr (std::is_same_v<return_type, void>)
 				fn(args...);
 			else
-				self._internal_future->result = fn(args...);
-			waitgroup_done(self._internal_future->_wg);
+				state->result = fn(args...);
+			_future_complete(state);
+			_future_release(state);
 		});
 		fabric_task_do(f, entry);
 
+		Future<return_type> self{};
+		self._internal_future = state;
 		return self;
 	}
 
@@ -553,25 +951,27 @@ namespace mn
 	future_go(Worker w, TFunc&& fn, TArgs&& ... args)
 	{
 		using return_type = std::invoke_result_t<TFunc, TArgs...>;
-		Future<return_type> self{};
-		self._internal_future = mn::alloc_zerod<_IFuture<return_type>>();
-		self._internal_future->_wg = waitgroup_new();
-		waitgroup_add(self._internal_future->_wg, 1);
+		// owned by the future and the scheduled function
+		auto state = _future_state_new<return_type>(2);
 
 		Fabric_Task entry{};
 		entry.as_oneshot.task = Task<void()>::make([=]() mutable {
 			if constexpr (std::is_same_v<return_type, void>)
 				fn(args...);
 			else
-				self._internal_future->result = fn(args...);
-			waitgroup_done(self._internal_future->_wg);
+				state->result = fn(args...);
+			_future_complete(state);
+			_future_release(state);
 		});
 		worker_task_do(w, entry);
 
+		Future<return_type> self{};
+		self._internal_future = state;
 		return self;
 	}
 
-	// frees the given future, if it's not done yet we wait before freeing it
+	// frees the given future, if it's not done yet we wait before freeing it, the continuations attached to it keep
+	// its result alive until they finish
 	template<typename T>
 	inline static void
 	future_free(Future<T>& self)
@@ -579,13 +979,21 @@ namespace mn
 		if (self._internal_future == nullptr)
 			return;
 
-		waitgroup_wait(self._internal_future->_wg);
-		waitgroup_free(self._internal_future->_wg);
+		_future_wait(self._internal_future);
+		_future_release(self._internal_future);
+		self._internal_future = nullptr;
+	}
 
-		if constexpr (std::is_same_v<T, void> == false)
-			destruct(self._internal_future->result);
+	// drops the given future without waiting for it, its result is freed once it's done and the continuations attached
+	// to it finish, it's useful to end chains of continuations without blocking
+	template<typename T>
+	inline static void
+	future_detach(Future<T>& self)
+	{
+		if (self._internal_future == nullptr)
+			return;
 
-		free(self._internal_future);
+		_future_release(self._internal_future);
 		self._internal_future = nullptr;
 	}
 
@@ -602,7 +1010,7 @@ namespace mn
 	inline static bool
 	future_is_done(Future<T> self)
 	{
-		return waitgroup_count(self._internal_future->_wg) == 0;
+		return self._internal_future->_continuations.load(std::memory_order_acquire) == _future_done_mark();
 	}
 
 	// waits for the given future to be done, in case it's done already we don't sleep/wait
@@ -610,7 +1018,7 @@ namespace mn
 	inline static void
 	future_wait(Future<T> self)
 	{
-		waitgroup_wait(self._internal_future->_wg);
+		_future_wait(self._internal_future);
 	}
 
 	// returns whether the future is null/empty
@@ -621,6 +1029,293 @@ namespace mn
 		return self._internal_future == nullptr;
 	}
 
+	template<typename T, typename TFunc>
+	struct _Future_Then_Result
+	{
+		using type = std::invoke_result_t<TFunc, T&>;
+	};
+
+	template<typename TFunc>
+	struct _Future_Then_Result<void, TFunc>
+	{
+		using type = std::invoke_result_t<TFunc>;
+	};
+
+	// attaches a continuation to the given future and returns the future of its result, the continuation is called
+	// with a reference to the result of the given future (or without arguments if it's a void future) once it's done,
+	// it's scheduled onto the given fabric, or if fabric is null it runs on the thread which completes the future
+	// (which should be reserved for short functions), the given future is still owned by the caller
+	// `auto len = future_then(name, fabric, [](Str& name) { return name.count; });`
+	template<typename T, typename TFunc>
+	inline static Future<typename _Future_Then_Result<T, std::decay_t<TFunc>>::type>
+	future_then(Future<T> self, Fabric fabric, TFunc&& fn)
+	{
+		using return_type = typename _Future_Then_Result<T, std::decay_t<TFunc>>::type;
+		// owned by the returned future and the continuation
+		auto state = _future_state_new<return_type>(2);
+		// the continuation keeps the result it reads alive
+		auto parent = self._internal_future;
+		parent->_refs.fetch_add(1, std::memory_order_relaxed);
+
+		_future_continuation_add(parent, fabric, Task<void()>::make([state, parent, fn = std::forward<TFunc>(fn)]() mutable {
+			if constexpr (std::is_same_v<T, void>)
+			{
+				if constexpr (std::is_same_v<return_type, void>)
+					fn();
+				else
+					state->result = fn();
+			}
+			else
+			{
+				if constexpr (std::is_same_v<return_type, void>)
+					fn(parent->result);
+				else
+					state->result = fn(parent->result);
+			}
+			_future_release(parent);
+			_future_complete(state);
+			_future_release(state);
+		}));
+
+		Future<return_type> res{};
+		res._internal_future = state;
+		return res;
+	}
+
+	// futures(i) returns the state of the i-th future
+	template<typename TFutures>
+	inline static Future<void>
+	_future_when_all(TFutures&& futures, size_t count)
+	{
+		Future<void> res{};
+		if (count == 0)
+		{
+			res._internal_future = _future_state_new<void>(1);
+			_future_complete(res._internal_future);
+			return res;
+		}
+
+		// owned by the returned future and the continuation of the last future to finish
+		auto state = _future_state_new<void>(2);
+		auto remaining = ::new (_fabric_block_alloc(sizeof(std::atomic<size_t>))) std::atomic<size_t>(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			_future_continuation_add(futures(i), nullptr, Task<void()>::make([state, remaining]{
+				if (remaining->fetch_sub(1, std::memory_order_acq_rel) != 1)
+					return;
+				_fabric_block_free(remaining, sizeof(std::atomic<size_t>));
+				_future_complete(state);
+				_future_release(state);
+			}));
+		}
+
+		res._internal_future = state;
+		return res;
+	}
+
+	// returns a future which is done once all of the given futures are done, the given futures are still owned by
+	// the caller
+	template<typename T>
+	inline static Future<void>
+	future_when_all(const Future<T>* futures, size_t count)
+	{
+		return _future_when_all([futures](size_t i) { return futures[i]._internal_future; }, count);
+	}
+
+	// returns a future which is done once all of the given futures are done, the given futures are still owned by
+	// the caller
+	template<typename T>
+	inline static Future<void>
+	future_when_all(const Buf<Future<T>>& futures)
+	{
+		return future_when_all(futures.ptr, futures.count);
+	}
+
+	// returns a future which is done once all of the given futures are done, the given futures are still owned by
+	// the caller
+	// `auto both = future_when_all(user, orders);`
+	template<typename T, typename ... TRest>
+	inline static Future<void>
+	future_when_all(Future<T> first, Future<TRest>... rest)
+	{
+		_IFuture_Base* states[] = {first._internal_future, rest._internal_future...};
+		return _future_when_all([&states](size_t i) { return states[i]; }, 1 + sizeof...(TRest));
+	}
+
+	// the shared state of the continuations of a future_when_any
+	struct _Future_When_Any
+	{
+		// continuations which didn't run yet, the last one frees this state
+		std::atomic<size_t> remaining;
+		// set by the continuation of the first future to finish, it completes the returned future
+		std::atomic<bool> claimed;
+	};
+
+	// futures(i) returns the state of the i-th future
+	template<typename TFutures>
+	inline static Future<size_t>
+	_future_when_any(TFutures&& futures, size_t count)
+	{
+		mn_assert_msg(count > 0, "future_when_any needs at least one future");
+
+		// owned by the returned future and the continuation of the first future to finish
+		auto state = _future_state_new<size_t>(2);
+		auto any = ::new (_fabric_block_alloc(sizeof(_Future_When_Any))) _Future_When_Any{};
+		any->remaining.store(count, std::memory_order_relaxed);
+		any->claimed.store(false, std::memory_order_relaxed);
+		for (size_t i = 0; i < count; ++i)
+		{
+			_future_continuation_add(futures(i), nullptr, Task<void()>::make([state, any, i]{
+				if (any->claimed.exchange(true, std::memory_order_acq_rel) == false)
+				{
+					state->result = i;
+					_future_complete(state);
+					_future_release(state);
+				}
+				if (any->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					_fabric_block_free(any, sizeof(_Future_When_Any));
+			}));
+		}
+
+		Future<size_t> res{};
+		res._internal_future = state;
+		return res;
+	}
+
+	// returns a future of the index of the first of the given futures to be done, the given futures are still owned
+	// by the caller
+	template<typename T>
+	inline static Future<size_t>
+	future_when_any(const Future<T>* futures, size_t count)
+	{
+		return _future_when_any([futures](size_t i) { return futures[i]._internal_future; }, count);
+	}
+
+	// returns a future of the index of the first of the given futures to be done, the given futures are still owned
+	// by the caller
+	template<typename T>
+	inline static Future<size_t>
+	future_when_any(const Buf<Future<T>>& futures)
+	{
+		return future_when_any(futures.ptr, futures.count);
+	}
+
+	// returns a future of the index of the first of the given futures to be done, the given futures are still owned
+	// by the caller
+	// `auto first = future_when_any(primary_replica, secondary_replica);`
+	template<typename T, typename ... TRest>
+	inline static Future<size_t>
+	future_when_any(Future<T> first, Future<TRest>... rest)
+	{
+		_IFuture_Base* states[] = {first._internal_future, rest._internal_future...};
+		return _future_when_any([&states](size_t i) { return states[i]; }, 1 + sizeof...(TRest));
+	}
+
+	// a channel send or receive which waits asynchronously (e.g. a suspended coroutine) instead of blocking, its waiter
+	// is notified once the value is handed to it (or taken from it) or once the channel is closed
+	template<typename T>
+	struct Chan_Waiter
+	{
+		Async_Waiter* waiter;
+		// the waiters of a select share a claim flag, the channel which completes one of them claims it first so the
+		// select completes exactly once, the other waiters are stale and are skipped by their channels
+		std::atomic<bool>* claim;
+		// the received value, or the value to send
+		T value;
+		// false if the channel was closed before the operation completed
+		bool ok;
+		Chan_Waiter* next;
+	};
+
+	// a fifo queue of channel waiters
+	template<typename T>
+	struct Chan_Wait_Queue
+	{
+		Chan_Waiter<T>* head;
+		Chan_Waiter<T>* tail;
+	};
+
+	// adds the given waiter to the back of the queue
+	template<typename T>
+	inline static void
+	_chan_wait_queue_push(Chan_Wait_Queue<T>& self, Chan_Waiter<T>* waiter)
+	{
+		waiter->next = nullptr;
+		if (self.tail)
+			self.tail->next = waiter;
+		else
+			self.head = waiter;
+		self.tail = waiter;
+	}
+
+	// removes the first waiter which isn't stale from the front of the queue and returns it after claiming it, returns
+	// nullptr if the queue is empty, it should be called while the channel mutex is locked
+	template<typename T>
+	inline static Chan_Waiter<T>*
+	_chan_wait_queue_pop(Chan_Wait_Queue<T>& self)
+	{
+		while (auto res = self.head)
+		{
+			self.head = res->next;
+			if (self.head == nullptr)
+				self.tail = nullptr;
+			if (res->claim == nullptr || res->claim->exchange(true) == false)
+				return res;
+		}
+		return nullptr;
+	}
+
+	// removes the given waiter from the queue if it's still in it
+	template<typename T>
+	inline static void
+	_chan_wait_queue_remove(Chan_Wait_Queue<T>& self, Chan_Waiter<T>* waiter)
+	{
+		Chan_Waiter<T>* prev = nullptr;
+		for (auto it = self.head; it; prev = it, it = it->next)
+		{
+			if (it != waiter)
+				continue;
+
+			if (prev)
+				prev->next = it->next;
+			else
+				self.head = it->next;
+			if (self.tail == it)
+				self.tail = prev;
+			return;
+		}
+	}
+
+	// removes all the waiters from the queue, claims them, and returns them as a chain which should be passed to
+	// _chan_waiters_notify after the channel mutex is unlocked
+	template<typename T>
+	inline static Chan_Waiter<T>*
+	_chan_wait_queue_pop_all(Chan_Wait_Queue<T>& self, bool ok)
+	{
+		Chan_Waiter<T>* res = nullptr;
+		while (auto waiter = _chan_wait_queue_pop(self))
+		{
+			waiter->ok = ok;
+			waiter->next = res;
+			res = waiter;
+		}
+		return res;
+	}
+
+	// notifies all the waiters in the given chain
+	template<typename T>
+	inline static void
+	_chan_waiters_notify(Chan_Waiter<T>* waiters)
+	{
+		while (waiters)
+		{
+			// the waiter might be freed once it's notified
+			auto waiter = waiters;
+			waiters = waiters->next;
+			waiter->waiter->notify(waiter->waiter);
+		}
+	}
+
 	// a generic message passing primitive used to communicate between fabric tasks
 	template<typename T>
 	struct IChan
@@ -631,6 +1326,9 @@ namespace mn
 		Cond_Var write_cv;
 		std::atomic<int32_t> atomic_limit;
 		std::atomic<int32_t> atomic_arc;
+		// async receivers only wait while the channel is empty, and async senders only wait while it's full
+		Chan_Wait_Queue<T> recv_waiters;
+		Chan_Wait_Queue<T> send_waiters;
 	};
 	template<typename T>
 	using Chan = IChan<T>*;
@@ -650,6 +1348,8 @@ namespace mn
 		self->write_cv = cond_var_new();
 		self->atomic_limit = limit;
 		self->atomic_arc = 1;
+		self->recv_waiters = Chan_Wait_Queue<T>{};
+		self->send_waiters = Chan_Wait_Queue<T>{};
 		return self;
 	}
 
@@ -733,9 +1433,48 @@ namespace mn
 	{
 		mutex_lock(self->mtx);
 		self->atomic_limit.exchange(0);
-		mutex_unlock(self->mtx);
+		auto recv_waiters = _chan_wait_queue_pop_all(self->recv_waiters, false);
+		auto send_waiters = _chan_wait_queue_pop_all(self->send_waiters, false);
+		// the condition variables are notified while the mutex is locked because a woken up receiver might free the
+		// channel as soon as it sees it closed
 		cond_var_notify_all(self->read_cv);
 		cond_var_notify_all(self->write_cv);
+		mutex_unlock(self->mtx);
+		_chan_waiters_notify(recv_waiters);
+		_chan_waiters_notify(send_waiters);
+	}
+
+	// pushes the given value into the channel while its mutex is locked, the value is handed directly to the first
+	// async receiver if there's one, the receiver is returned so that it's notified after the mutex is unlocked
+	template<typename T>
+	inline static Chan_Waiter<T>*
+	_chan_push_locked(Chan<T> self, const T& v)
+	{
+		if (auto receiver = _chan_wait_queue_pop(self->recv_waiters))
+		{
+			receiver->value = v;
+			receiver->ok = true;
+			return receiver;
+		}
+		ring_push_back(self->r, v);
+		return nullptr;
+	}
+
+	// pops the front value of the channel while its mutex is locked, the value of the first async sender takes the
+	// freed slot, the sender is returned so that it's notified after the mutex is unlocked
+	template<typename T>
+	inline static Chan_Waiter<T>*
+	_chan_pop_locked(Chan<T> self, T& v)
+	{
+		v = ring_front(self->r);
+		ring_pop_front(self->r);
+		if (auto sender = _chan_wait_queue_pop(self->send_waiters))
+		{
+			ring_push_back(self->r, sender->value);
+			sender->ok = true;
+			return sender;
+		}
+		return nullptr;
 	}
 
 	// checks whether you can send to the given channel
@@ -756,20 +1495,18 @@ namespace mn
 	{
 		mutex_lock(self->mtx);
 
-		bool notify = false;
-		mn_defer
+		if (self->r.count < self->atomic_limit)
 		{
+			auto receiver = _chan_push_locked(self, v);
 			mutex_unlock(self->mtx);
-			if (notify)
+			if (receiver)
+				receiver->waiter->notify(receiver->waiter);
+			else
 				cond_var_notify(self->read_cv);
-		};
-
-		if (self->r.count < self->atomic_limit)
-		{
-			ring_push_back(self->r, v);
-			notify = true;
 			return true;
 		}
+
+		mutex_unlock(self->mtx);
 		return false;
 	}
 
@@ -790,10 +1527,46 @@ namespace mn
 		if (chan_closed(self))
 			panic("cannot send in a closed channel");
 
-		ring_push_back(self->r, v);
+		auto receiver = _chan_push_locked(self, v);
 		mutex_unlock(self->mtx);
 
-		cond_var_notify(self->read_cv);
+		if (receiver)
+			receiver->waiter->notify(receiver->waiter);
+		else
+			cond_var_notify(self->read_cv);
+	}
+
+	// sends the waiter's value to the given channel asynchronously, if the channel has space (or it's closed) the send
+	// completes right away and false is returned, otherwise the waiter is queued until a receiver takes its value (or
+	// the channel is closed) and true is returned, ok is set to false if the channel is closed
+	template<typename T>
+	inline static bool
+	chan_send_async(Chan<T> self, Chan_Waiter<T>* sender)
+	{
+		mutex_lock(self->mtx);
+
+		if (chan_closed(self))
+		{
+			mutex_unlock(self->mtx);
+			sender->ok = false;
+			return false;
+		}
+
+		if (self->r.count < size_t(self->atomic_limit.load()))
+		{
+			auto receiver = _chan_push_locked(self, sender->value);
+			mutex_unlock(self->mtx);
+			sender->ok = true;
+			if (receiver)
+				receiver->waiter->notify(receiver->waiter);
+			else
+				cond_var_notify(self->read_cv);
+			return false;
+		}
+
+		_chan_wait_queue_push(self->send_waiters, sender);
+		mutex_unlock(self->mtx);
+		return true;
 	}
 
 	// checks whether you can recieve from the given channel
@@ -824,21 +1597,19 @@ namespace mn
 	{
 		mutex_lock(self->mtx);
 
-		bool notify = false;
-		mn_defer
+		if (self->r.count > 0)
 		{
+			T res{};
+			auto sender = _chan_pop_locked(self, res);
 			mutex_unlock(self->mtx);
-			if (notify)
+			if (sender)
+				sender->waiter->notify(sender->waiter);
+			else
 				cond_var_notify(self->write_cv);
-		};
-
-		if (self->r.count > 0)
-		{
-			T res = ring_front(self->r);
-			ring_pop_front(self->r);
-			notify = true;
 			return { res, true };
 		}
+
+		mutex_unlock(self->mtx);
 		return { T{}, false };
 	}
 
@@ -857,11 +1628,14 @@ namespace mn
 
 		if(self->r.count > 0)
 		{
-			T res = ring_front(self->r);
-			ring_pop_front(self->r);
+			T res{};
+			auto sender = _chan_pop_locked(self, res);
 			mutex_unlock(self->mtx);
 
-			cond_var_notify(self->write_cv);
+			if (sender)
+				sender->waiter->notify(sender->waiter);
+			else
+				cond_var_notify(self->write_cv);
 			return { res, true };
 		}
 		else if(chan_closed(self))
@@ -875,6 +1649,331 @@ namespace mn
 		}
 	}
 
+	// receives a value from the given channel asynchronously into the waiter's value, if the channel has a value (or
+	// it's closed) the receive completes right away and false is returned, otherwise the waiter is queued until a
+	// sender hands it a value (or the channel is closed) and true is returned, ok is set to false if the channel is
+	// closed
+	template<typename T>
+	inline static bool
+	chan_recv_async(Chan<T> self, Chan_Waiter<T>* receiver)
+	{
+		mutex_lock(self->mtx);
+
+		if (self->r.count > 0)
+		{
+			auto sender = _chan_pop_locked(self, receiver->value);
+			mutex_unlock(self->mtx);
+			receiver->ok = true;
+			if (sender)
+				sender->waiter->notify(sender->waiter);
+			else
+				cond_var_notify(self->write_cv);
+			return false;
+		}
+
+		if (chan_closed(self))
+		{
+			mutex_unlock(self->mtx);
+			receiver->ok = false;
+			return false;
+		}
+
+		_chan_wait_queue_push(self->recv_waiters, receiver);
+		mutex_unlock(self->mtx);
+		return true;
+	}
+
+	// returns the mutex and condition variable which chan_select waits on in the calling thread, they're created once
+	// per thread and reused by all of its selects
+	MN_EXPORT void
+	_chan_select_sync(Mutex& mtx, Cond_Var& cv);
+
+	// the shared state of a chan_select call which registered waiters on its channels
+	struct _Chan_Select
+	{
+		// claimed by the first channel which completes one of the select cases (or by the select itself when it times
+		// out), the waiters of the other cases become stale once it's set
+		std::atomic<bool> claimed;
+		// the waiting thread's mutex and condition variable, they outlive the select so the notifying thread can
+		// unlock the mutex after the waiting thread has returned
+		Mutex mtx;
+		Cond_Var cv;
+		// the waiter of the case which completed, it's protected by the mutex
+		Async_Waiter* fired;
+	};
+
+	inline static void
+	_chan_select_notify(Async_Waiter* waiter)
+	{
+		auto self = (_Chan_Select*)waiter->user_data;
+		// the select state might be freed once fired is set and the mutex is unlocked, so we don't touch it after that
+		auto mtx = self->mtx;
+		mutex_lock(mtx);
+		self->fired = waiter;
+		cond_var_notify(self->cv);
+		mutex_unlock(mtx);
+	}
+
+	// the result of starting a select case
+	enum _CHAN_SELECT_CASE
+	{
+		// the waiter of the case was registered in the channel
+		_CHAN_SELECT_CASE_PENDING,
+		// the case completed right away
+		_CHAN_SELECT_CASE_COMPLETED,
+		// the case was ready but another case of the select completed first
+		_CHAN_SELECT_CASE_ABORTED,
+	};
+
+	// a receive case of chan_select, it's created using chan_select_recv
+	template<typename T>
+	struct Chan_Select_Recv
+	{
+		Chan<T> chan;
+		Recv_Result<T>* result;
+		Chan_Waiter<T> receiver;
+		Async_Waiter waiter;
+	};
+
+	// creates a receive case for chan_select which stores the received value into the given result, result.more is
+	// false if the channel is closed
+	template<typename T>
+	inline static Chan_Select_Recv<T>
+	chan_select_recv(Chan<T> chan, Recv_Result<T>& result)
+	{
+		return Chan_Select_Recv<T>{chan, &result, Chan_Waiter<T>{}, Async_Waiter{}};
+	}
+
+	// a send case of chan_select, it's created using chan_select_send
+	template<typename T>
+	struct Chan_Select_Send
+	{
+		Chan<T> chan;
+		Chan_Waiter<T> sender;
+		Async_Waiter waiter;
+	};
+
+	// creates a send case for chan_select which sends a copy of the given value
+	template<typename T>
+	inline static Chan_Select_Send<T>
+	chan_select_send(Chan<T> chan, const T& value)
+	{
+		return Chan_Select_Send<T>{chan, Chan_Waiter<T>{nullptr, nullptr, value, false, nullptr}, Async_Waiter{}};
+	}
+
+	// tries to complete the receive case right away, if it's not ready and a select is given the case waiter is
+	// registered in the channel instead
+	template<typename T>
+	inline static _CHAN_SELECT_CASE
+	_chan_select_case_start(Chan_Select_Recv<T>& self, _Chan_Select* select)
+	{
+		auto chan = self.chan;
+		mutex_lock(chan->mtx);
+
+		if (chan->r.count > 0 || chan_closed(chan))
+		{
+			if (select && select->claimed.exchange(true))
+			{
+				mutex_unlock(chan->mtx);
+				return _CHAN_SELECT_CASE_ABORTED;
+			}
+
+			if (chan->r.count > 0)
+			{
+				T res{};
+				auto sender = _chan_pop_locked(chan, res);
+				mutex_unlock(chan->mtx);
+				*self.result = Recv_Result<T>{res, true};
+				if (sender)
+					sender->waiter->notify(sender->waiter);
+				else
+					cond_var_notify(chan->write_cv);
+			}
+			else
+			{
+				mutex_unlock(chan->mtx);
+				*self.result = Recv_Result<T>{T{}, false};
+			}
+			return _CHAN_SELECT_CASE_COMPLETED;
+		}
+
+		if (select)
+		{
+			self.waiter.notify = _chan_select_notify;
+			self.waiter.user_data = select;
+			self.receiver.waiter = &self.waiter;
+			self.receiver.claim = &select->claimed;
+			_chan_wait_queue_push(chan->recv_waiters, &self.receiver);
+		}
+		mutex_unlock(chan->mtx);
+		return _CHAN_SELECT_CASE_PENDING;
+	}
+
+	// tries to complete the send case right away, if it's not ready and a select is given the case waiter is
+	// registered in the channel instead
+	template<typename T>
+	inline static _CHAN_SELECT_CASE
+	_chan_select_case_start(Chan_Select_Send<T>& self, _Chan_Select* select)
+	{
+		auto chan = self.chan;
+		mutex_lock(chan->mtx);
+
+		if (chan_closed(chan))
+		{
+			mutex_unlock(chan->mtx);
+			panic("cannot send in a closed channel");
+		}
+
+		if (chan->r.count < size_t(chan->atomic_limit.load()))
+		{
+			if (select && select->claimed.exchange(true))
+			{
+				mutex_unlock(chan->mtx);
+				return _CHAN_SELECT_CASE_ABORTED;
+			}
+
+			auto receiver = _chan_push_locked(chan, self.sender.value);
+			mutex_unlock(chan->mtx);
+			if (receiver)
+				receiver->waiter->notify(receiver->waiter);
+			else
+				cond_var_notify(chan->read_cv);
+			return _CHAN_SELECT_CASE_COMPLETED;
+		}
+
+		if (select)
+		{
+			self.waiter.notify = _chan_select_notify;
+			self.waiter.user_data = select;
+			self.sender.waiter = &self.waiter;
+			self.sender.claim = &select->claimed;
+			_chan_wait_queue_push(chan->send_waiters, &self.sender);
+		}
+		mutex_unlock(chan->mtx);
+		return _CHAN_SELECT_CASE_PENDING;
+	}
+
+	// removes the case waiter from its channel if it's still registered
+	template<typename T>
+	inline static void
+	_chan_select_case_stop(Chan_Select_Recv<T>& self)
+	{
+		mutex_lock(self.chan->mtx);
+		_chan_wait_queue_remove(self.chan->recv_waiters, &self.receiver);
+		mutex_unlock(self.chan->mtx);
+	}
+
+	template<typename T>
+	inline static void
+	_chan_select_case_stop(Chan_Select_Send<T>& self)
+	{
+		mutex_lock(self.chan->mtx);
+		_chan_wait_queue_remove(self.chan->send_waiters, &self.sender);
+		mutex_unlock(self.chan->mtx);
+	}
+
+	// completes the case after its waiter was notified
+	template<typename T>
+	inline static void
+	_chan_select_case_finish(Chan_Select_Recv<T>& self)
+	{
+		*self.result = Recv_Result<T>{self.receiver.value, self.receiver.ok};
+	}
+
+	template<typename T>
+	inline static void
+	_chan_select_case_finish(Chan_Select_Send<T>& self)
+	{
+		if (self.sender.ok == false)
+			panic("cannot send in a closed channel");
+	}
+
+	template<typename T>
+	inline static Async_Waiter*
+	_chan_select_case_waiter(Chan_Select_Recv<T>& self)
+	{
+		return &self.waiter;
+	}
+
+	template<typename T>
+	inline static Async_Waiter*
+	_chan_select_case_waiter(Chan_Select_Send<T>& self)
+	{
+		return &self.waiter;
+	}
+
+	// waits on multiple channel operations (created using chan_select_recv and chan_select_send) and performs exactly
+	// one of them, returns the index of the case which completed, or -1 if the timeout expired first, the cases are
+	// tried in order so the first ready case wins, otherwise a waiter is registered once on every channel and the
+	// calling thread sleeps until one of the channels completes its case, no polling is involved
+	// `chan_select(Timeout{100}, chan_select_recv(a, a_res), chan_select_send(b, 42))`
+	template<typename... TCases>
+	inline static int
+	chan_select(Timeout timeout, TCases&&... cases)
+	{
+		static_assert(sizeof...(cases) > 0, "chan_select needs at least one case");
+
+		// fast path, tries the cases in order without registering any waiters
+		int res = -1;
+		int index = 0;
+		((res == -1 && _chan_select_case_start(cases, nullptr) == _CHAN_SELECT_CASE_COMPLETED ? res = index : 0, ++index), ...);
+		if (res != -1 || timeout.milliseconds == NO_TIMEOUT.milliseconds)
+			return res;
+
+		_Chan_Select select{};
+		select.claimed.store(false);
+		_chan_select_sync(select.mtx, select.cv);
+
+		// registers the case waiters in order until one of the cases completes or finds the select claimed already
+		index = 0;
+		bool aborted = false;
+		((res == -1 && aborted == false ? [&]{
+			auto state = _chan_select_case_start(cases, &select);
+			if (state == _CHAN_SELECT_CASE_COMPLETED)
+				res = index;
+			else if (state == _CHAN_SELECT_CASE_ABORTED)
+				aborted = true;
+		}() : void(), ++index), ...);
+
+		bool wait_fired = false;
+		if (res == -1)
+		{
+			mutex_lock(select.mtx);
+			if (aborted || timeout.milliseconds == INFINITE_TIMEOUT.milliseconds)
+			{
+				wait_fired = true;
+			}
+			else
+			{
+				auto deadline = time_in_millis() + timeout.milliseconds;
+				while (select.fired == nullptr)
+				{
+					auto now = time_in_millis();
+					if (now >= deadline)
+						break;
+					auto millis = deadline - now;
+					cond_var_wait_timeout(select.cv, select.mtx, millis > UINT32_MAX ? UINT32_MAX : uint32_t(millis));
+				}
+
+				// if a channel claimed the select before we did then its notification is on the way
+				wait_fired = select.fired != nullptr || select.claimed.exchange(true);
+			}
+
+			if (wait_fired)
+				cond_var_wait(select.cv, select.mtx, [&]{ return select.fired != nullptr; });
+			mutex_unlock(select.mtx);
+		}
+
+		(_chan_select_case_stop(cases), ...);
+
+		if (wait_fired)
+		{
+			index = 0;
+			((_chan_select_case_waiter(cases) == select.fired ? (_chan_select_case_finish(cases), res = index) : 0, ++index), ...);
+		}
+		return res;
+	}
+
 	// an iterator wrapper over the channel which allows you to use it in a range for loop
 	// `for (auto value: my_channel)`
 	template<typename T>
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "mn/Exports.h"
+#include "mn/Base.h"
+
+#include <atomic>
+
+namespace mn
+{
+	// fibers are fabric tasks which run on their own small stack, when a fiber waits (on a mutex, condition
+	// variable, waitgroup, channel, or socket read) it's parked and its worker runs other tasks until the wait is
+	// satisfied, then it's scheduled again as a resume task in the worker queue, fibers are created using go_fiber
+	//
+	// each fiber has its own context (allocators stack and tmp allocator), and it may be resumed on a different
+	// worker thread than the one it was parked on (e.g. when its resume task is stolen by an idle worker), so it
+	// shouldn't keep thread local state across blocking calls
+	typedef struct IFiber* Fiber;
+
+	// returns the fiber of the calling code if it's running on one, nullptr otherwise
+	MN_EXPORT Fiber
+	fiber_local();
+
+	// parks the calling fiber until fiber_ready is called on it, if fiber_ready is called before the fiber parks
+	// (e.g. the fiber registered itself in a wait list which got signaled right away) this returns immediately
+	MN_EXPORT void
+	fiber_park();
+
+	// schedules the given parked fiber to be resumed, it's safe to call it from any thread and on fibers which are
+	// about to park
+	MN_EXPORT void
+	fiber_ready(Fiber self);
+
+	// puts the calling fiber at the back of its worker queue which lets the other queued tasks run first
+	MN_EXPORT void
+	fiber_yield();
+
+	// parks the calling fiber until the given fd (or socket) is ready to be read from (or written to if write is
+	// true), or until the timeout expires, returns 1 if the fd is ready, 0 if it timed out, and -1 if the fd
+	// can't be waited on this way (e.g. not called from a fiber, or another fiber is already waiting on it) in
+	// which case the caller should block instead
+	MN_EXPORT int
+	fiber_wait_fd(int64_t fd, bool write, Timeout timeout);
+
+	// an intrusive list of fibers waiting on some synchronization primitive, it's protected by a spin lock because
+	// it's only held for a few instructions
+	struct Fiber_Wait_List
+	{
+		std::atomic<bool> locked;
+		std::atomic<size_t> count;
+		Fiber head;
+		Fiber tail;
+	};
+
+	// initializes the given wait list to an empty list
+	inline static void
+	_fiber_wait_list_init(Fiber_Wait_List& self)
+	{
+		self.locked.store(false);
+		self.count.store(0);
+		self.head = nullptr;
+		self.tail = nullptr;
+	}
+
+	// adds the given fiber to the back of the wait list
+	MN_EXPORT void
+	_fiber_wait_list_push(Fiber_Wait_List& self, Fiber fiber);
+
+	// removes the given fiber from the wait list, returns false if it's not in the list (it was popped already)
+	MN_EXPORT bool
+	_fiber_wait_list_remove(Fiber_Wait_List& self, Fiber fiber);
+
+	// pops the fiber at the front of the wait list, returns nullptr if the list is empty
+	MN_EXPORT Fiber
+	_fiber_wait_list_pop(Fiber_Wait_List& self);
+
+	// takes all the fibers off the wait list and returns them as a chain which should be passed to _fiber_ready_all
+	MN_EXPORT Fiber
+	_fiber_wait_list_pop_all(Fiber_Wait_List& self);
+
+	// makes all the fibers in the given chain (returned by _fiber_wait_list_pop_all) ready
+	MN_EXPORT void
+	_fiber_ready_all(Fiber fibers);
+
+	// locks a mutex from a fiber by parking it until the mutex is unlocked instead of blocking its worker thread,
+	// the given try lock function should try to lock the os mutex and return whether it succeeded, and the mutex
+	// unlock should call _fiber_mutex_unlock after it unlocks the os mutex
+	template<typename TFunc>
+	inline static void
+	_fiber_mutex_lock(Fiber_Wait_List& waiters, Fiber fiber, TFunc&& try_lock)
+	{
+		while (true)
+		{
+			_fiber_wait_list_push(waiters, fiber);
+			// the push should be visible before we try the lock so that an unlock which happens after our failed
+			// try lock finds us in the wait list
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (try_lock())
+			{
+				// if an unlock took us off the list it's going to wake us up, so we park to consume this wake
+				if (_fiber_wait_list_remove(waiters, fiber) == false)
+					fiber_park();
+				return;
+			}
+			fiber_park();
+		}
+	}
+
+	// wakes up a single fiber waiting on a mutex, it should be called after unlocking the os mutex
+	inline static void
+	_fiber_mutex_unlock(Fiber_Wait_List& waiters)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters.count.load(std::memory_order_relaxed) == 0)
+			return;
+
+		if (auto fiber = _fiber_wait_list_pop(waiters))
+			fiber_ready(fiber);
+	}
+
+	// saved execution state of a fiber (or the scheduler of a worker thread) used for user space context switching
+	struct Fiber_Context
+	{
+		// saved stack pointer of the suspended context
+		void* sp;
+		// os specific handle (windows fiber, or ucontext on platforms without an assembly implementation)
+		void* handle;
+		// stack memory of the fiber, empty for thread contexts
+		Block stack;
+		void (*entry)(void*);
+		void* arg;
+	};
+
+	// prepares the calling thread to switch to fibers, the given context is used to save the thread's own execution
+	// state when it switches to a fiber
+	MN_EXPORT bool
+	_fiber_context_thread_init(Fiber_Context& self);
+
+	// frees the thread context created by _fiber_context_thread_init
+	MN_EXPORT void
+	_fiber_context_thread_free(Fiber_Context& self);
+
+	// creates a new fiber context with a stack of the given size (it's rounded up to the page size and has a guard
+	// page below it) which calls the given entry function with the given argument when it's first switched to, the
+	// entry function should never return, returns false if the stack can't be allocated
+	MN_EXPORT bool
+	_fiber_context_init(Fiber_Context& self, size_t stack_size, void (*entry)(void*), void* arg);
+
+	// frees the given fiber context and its stack
+	MN_EXPORT void
+	_fiber_context_free(Fiber_Context& self);
+
+	// saves the current execution state into from and continues execution from the state saved in to
+	MN_EXPORT void
+	_fiber_context_switch(Fiber_Context& from, Fiber_Context& to);
+
+	// a wait on the readiness of an fd which is handled by the process wide poller thread
+	struct Poll_Wait
+	{
+		int64_t fd;
+		// waits for the fd to be writable instead of readable
+		bool write;
+		// the deadline of the wait in time_in_millis clock, UINT64_MAX if it doesn't have one
+		uint64_t deadline_in_ms;
+		// called once from the poller thread with ready = true when the fd is ready, or ready = false when the
+		// deadline passes, the poller doesn't touch the wait after it calls this function
+		void (*on_done)(Poll_Wait* self, bool ready);
+		void* user_data;
+		// poller bookkeeping
+		Poll_Wait* prev;
+		Poll_Wait* next;
+	};
+
+	// starts the given wait, returns false if the fd can't be waited on (e.g. the platform doesn't have a poller or
+	// another wait is already registered on the same fd) in which case on_done is never called
+	MN_EXPORT bool
+	_poll_wait_start(Poll_Wait* self);
+}
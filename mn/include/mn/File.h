@@ -4,6 +4,7 @@
 #include "mn/Stream.h"
 #include "mn/Str.h"
 #include "mn/Assert.h"
+#include "mn/Virtual_Memory.h"
 
 namespace mn
 {
@@ -235,6 +236,71 @@ namespace mn
 	MN_EXPORT bool
 	file_read_unlock(File handle, int64_t offset, int64_t size);
 
+	// reads from the file at the given offset into the given block of bytes without using the file cursor,
+	// and returns the read amount of bytes which is less than the block size only at the end of the file or on error
+	// it's safe to call it from multiple threads on the same file handle
+	MN_EXPORT size_t
+	file_read_at(File handle, int64_t offset, Block data);
+
+	// writes the given block of bytes to the file at the given offset without using the file cursor,
+	// and returns the written amount of bytes
+	// it's safe to call it from multiple threads on the same file handle
+	MN_EXPORT size_t
+	file_write_at(File handle, int64_t offset, Block data);
+
+	// reads from the file at the given offset and scatters the data into the given blocks in order
+	// without using the file cursor, and returns the read amount of bytes
+	MN_EXPORT size_t
+	file_readv_at(File handle, int64_t offset, const Block* blocks, size_t blocks_count);
+
+	// reads from the file at the given offset and scatters the data into the given blocks in order
+	// without using the file cursor, and returns the read amount of bytes
+	inline static size_t
+	file_readv_at(File handle, int64_t offset, const Buf<Block>& blocks)
+	{
+		return file_readv_at(handle, offset, blocks.ptr, blocks.count);
+	}
+
+	// gathers the given blocks in order and writes them to the file at the given offset without using
+	// the file cursor, and returns the written amount of bytes
+	MN_EXPORT size_t
+	file_writev_at(File handle, int64_t offset, const Block* blocks, size_t blocks_count);
+
+	// gathers the given blocks in order and writes them to the file at the given offset without using
+	// the file cursor, and returns the written amount of bytes
+	inline static size_t
+	file_writev_at(File handle, int64_t offset, const Buf<Block>& blocks)
+	{
+		return file_writev_at(handle, offset, blocks.ptr, blocks.count);
+	}
+
+	// allocates the disk space of the given file region ahead of time so that later writes don't fail
+	// with out of space errors and the file is less fragmented, the file is extended if the region goes
+	// beyond its end, and returns whether it succeeded
+	MN_EXPORT bool
+	file_preallocate(File handle, int64_t offset, int64_t size);
+
+	// file access pattern hints
+	enum FILE_ACCESS_HINT
+	{
+		// no special treatment
+		FILE_ACCESS_HINT_NORMAL,
+		// the region will be read sequentially, so the os can read ahead more aggressively
+		FILE_ACCESS_HINT_SEQUENTIAL,
+		// the region will be read in random order, so the os should disable read ahead
+		FILE_ACCESS_HINT_RANDOM,
+		// the region will be needed soon, so the os should start reading it into the page cache
+		FILE_ACCESS_HINT_WILL_NEED,
+		// the region won't be needed soon, so the os can drop it from the page cache
+		FILE_ACCESS_HINT_DONT_NEED,
+	};
+
+	// advises the os about the expected access pattern of the given file region, if size = 0 the hint
+	// extends to the end of the file, and returns whether the hint was accepted
+	// hints are best effort, unsupported hints are ignored and reported as accepted
+	MN_EXPORT bool
+	file_access_hint(File handle, int64_t offset, int64_t size, FILE_ACCESS_HINT hint);
+
 	// represents a memory mapped file
 	struct Mapped_File
 	{
@@ -243,23 +309,24 @@ namespace mn
 
 	// memory maps a given file region into memory and returns a mapped file structure
 	// if size = 0 this will map the file starting from the offset to the end of the file
+	// the options can be used to prefault, lock, or hint the access pattern of the mapping
 	// returns a nullptr in case of failure
 	MN_EXPORT Mapped_File*
-	file_mmap(File file, int64_t offset, int64_t size, IO_MODE io_mode);
+	file_mmap(File file, int64_t offset, int64_t size, IO_MODE io_mode, const Virtual_Map_Options& options = {});
 
 	// tries to open a file and maps the specified region into memory
 	// if size = 0 this will map the file starting from the offset to the end of the file
 	// returns a nullptr in case of failure
 	MN_EXPORT Mapped_File*
-	file_mmap(const Str& filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode = SHARE_MODE_ALL);
+	file_mmap(const Str& filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode = SHARE_MODE_ALL, const Virtual_Map_Options& options = {});
 
 	// tries to open a file and maps the specified region into memory
 	// if size = 0 this will map the file starting from the offset to the end of the file
 	// returns a nullptr in case of failure
 	inline static Mapped_File*
-	file_mmap(const char* filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode = SHARE_MODE_ALL)
+	file_mmap(const char* filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode = SHARE_MODE_ALL, const Virtual_Map_Options& options = {})
 	{
-		return file_mmap(str_lit(filename), offset, size, io_mode, open_mode, share_mode);
+		return file_mmap(str_lit(filename), offset, size, io_mode, open_mode, share_mode, options);
 	}
 
 	// unmaps the given mapped file, and returns whether the unmap was successful
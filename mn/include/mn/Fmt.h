@@ -98,7 +98,7 @@ namespace mn
 	{
 		fmt::memory_buffer buf;
 		// TODO: maybe implement back inserter iterator for stream or string
-		fmt::format_to(std::back_inserter(buf), format_str, args...);
+		fmt::format_to(std::back_inserter(buf), fmt::runtime(format_str), args...);
 		str_block_push(out, Block{buf.data(), buf.size()});
 		return out;
 	}
@@ -134,7 +134,7 @@ namespace mn
 	{
 		fmt::memory_buffer buf;
 		// TODO: maybe implement back inserter iterator for stream or string
-		fmt::format_to(std::back_inserter(buf), format_str, args...);
+		fmt::format_to(std::back_inserter(buf), fmt::runtime(format_str), args...);
 		return stream_write(stream, Block{buf.data(), buf.size()});
 	}
 
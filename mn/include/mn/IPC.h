@@ -4,6 +4,9 @@
 #include "mn/Str.h"
 #include "mn/Stream.h"
 #include "mn/Assert.h"
+#include "mn/memory/Interface.h"
+
+#include <atomic>
 
 namespace mn::ipc
 {
@@ -147,4 +150,225 @@ namespace mn::ipc
 	// allocates and reads a single message
 	MN_EXPORT Str
 	sputnik_msg_read_alloc(Sputnik self, Timeout timeout, Allocator allocator = allocator_top());
-}
\ No newline at end of file
+
+	// futex primitives
+	// a futex is a 32-bit word which processes/threads can wait on until its value changes, the word can live in
+	// shared memory in which case the wait/wake pair will work across processes, on linux this maps directly to
+	// the futex syscall, on other platforms it falls back to polling the word
+
+	// waits while the given word is equal to the expected value, or until the timeout expires
+	// returns false if the wait timed out, it might return true spuriously so you should re-check your condition
+	MN_EXPORT bool
+	futex_wait(std::atomic<uint32_t>* word, uint32_t expected, Timeout timeout = INFINITE_TIMEOUT);
+
+	// wakes a single waiter on the given word
+	MN_EXPORT void
+	futex_wake_one(std::atomic<uint32_t>* word);
+
+	// wakes all the waiters on the given word
+	MN_EXPORT void
+	futex_wake_all(std::atomic<uint32_t>* word);
+
+	// shared memory
+
+	// a named memory segment which can be mapped into multiple processes
+	typedef struct IShared_Memory* Shared_Memory;
+
+	struct IShared_Memory
+	{
+		union
+		{
+			void* winos_handle;
+			int linux_handle;
+			int macos_handle;
+		};
+		Str name;
+		// the mapped memory of the segment
+		Block data;
+		// whether this instance created the segment, which means it will remove the name when it's freed
+		bool owner;
+	};
+
+	// creates a new shared memory segment with the given name and size, if a segment with the same name exists it
+	// fails (use shared_memory_open to attach to it), if it fails it will return nullptr
+	MN_EXPORT Shared_Memory
+	shared_memory_new(const Str& name, size_t size);
+
+	// creates a new shared memory segment with the given name and size, if a segment with the same name exists it
+	// fails (use shared_memory_open to attach to it), if it fails it will return nullptr
+	inline static Shared_Memory
+	shared_memory_new(const char* name, size_t size)
+	{
+		return shared_memory_new(str_lit(name), size);
+	}
+
+	// opens an existing shared memory segment with the given name, if it fails it will return nullptr
+	MN_EXPORT Shared_Memory
+	shared_memory_open(const Str& name);
+
+	// opens an existing shared memory segment with the given name, if it fails it will return nullptr
+	inline static Shared_Memory
+	shared_memory_open(const char* name)
+	{
+		return shared_memory_open(str_lit(name));
+	}
+
+	// unmaps the given shared memory segment, and removes its name if this instance created it
+	MN_EXPORT void
+	shared_memory_free(Shared_Memory self);
+
+	// destruct overload for shared memory free
+	inline static void
+	destruct(Shared_Memory self)
+	{
+		shared_memory_free(self);
+	}
+
+	// pointers are not valid across processes because each process maps the segment at a different address
+	// so you should exchange offsets instead, this function converts a pointer inside the segment to an offset
+	inline static uint64_t
+	shared_memory_offset(Shared_Memory self, const void* ptr)
+	{
+		mn_assert(ptr >= self->data.ptr && (const char*)ptr < (const char*)self->data.ptr + self->data.size);
+		return (const char*)ptr - (const char*)self->data.ptr;
+	}
+
+	// converts an offset inside the segment to a pointer in the calling process address space
+	inline static void*
+	shared_memory_ptr(Shared_Memory self, uint64_t offset)
+	{
+		mn_assert(offset < self->data.size);
+		return (char*)self->data.ptr + offset;
+	}
+
+	// an allocator which allocates from a shared memory segment, it keeps its state inside the segment itself so
+	// multiple processes can allocate from the same segment concurrently, blocks can be freed in any order, freed
+	// blocks are kept in an offset sorted free list where they're merged with their neighbours and reused first fit,
+	// the rest of the segment is allocated by bumping a head, all of it is guarded by a futex lock in the segment
+	struct Shared_Allocator: memory::Interface
+	{
+		Shared_Memory segment;
+		struct IShared_Allocator_Header* header;
+
+		// attaches the allocator to the given segment and initializes its state if it's not initialized
+		MN_EXPORT
+		Shared_Allocator(Shared_Memory segment);
+
+		// allocates a block with the given size and alignment, returns an empty block if the segment is full
+		MN_EXPORT Block
+		alloc(size_t size, uint8_t alignment) override;
+
+		// frees the given block, it should be freed with the same size it was allocated with
+		MN_EXPORT void
+		free(Block block) override;
+
+		// returns the number of bytes used by the allocated blocks (rounded up to 16 bytes each)
+		MN_EXPORT size_t
+		used_mem() const;
+	};
+
+	// creates a new shared memory allocator over the given shared memory segment
+	inline static Shared_Allocator*
+	shared_allocator_new(Shared_Memory segment)
+	{
+		return alloc_construct<Shared_Allocator>(segment);
+	}
+
+	// shared queue mode options
+	enum SHARED_QUEUE_MODE
+	{
+		// single producer single consumer
+		SHARED_QUEUE_MODE_SPSC,
+		// multiple producers single consumer, each write that fits in the queue capacity is delivered as a single
+		// contiguous run of bytes without being interleaved with other producers writes
+		SHARED_QUEUE_MODE_MPSC,
+	};
+
+	// a cross-process byte queue which lives inside a shared memory segment, producers and the consumer block on
+	// futexes in the segment so there's no polling and no data goes through the kernel
+	typedef struct IShared_Queue* Shared_Queue;
+
+	struct IShared_Queue final: IStream
+	{
+		Shared_Memory segment;
+		struct IShared_Queue_Header* header;
+		uint8_t* ring;
+
+		MN_EXPORT void
+		dispose() override;
+
+		MN_EXPORT size_t
+		read(Block data) override;
+
+		MN_EXPORT size_t
+		write(Block data) override;
+
+		MN_EXPORT int64_t
+		size() override;
+
+		virtual int64_t
+		cursor_operation(STREAM_CURSOR_OP, int64_t) override
+		{
+			mn_unreachable_msg("shared queue doesn't support cursor operations");
+			return STREAM_CURSOR_ERROR;
+		}
+	};
+
+	// creates a new shared queue with the given name and capacity in bytes (rounded up to a power of 2)
+	// if it fails (e.g. a segment with the same name exists) it will return nullptr
+	MN_EXPORT Shared_Queue
+	shared_queue_new(const Str& name, size_t capacity, SHARED_QUEUE_MODE mode = SHARED_QUEUE_MODE_SPSC);
+
+	// creates a new shared queue with the given name and capacity in bytes (rounded up to a power of 2)
+	// if it fails (e.g. a segment with the same name exists) it will return nullptr
+	inline static Shared_Queue
+	shared_queue_new(const char* name, size_t capacity, SHARED_QUEUE_MODE mode = SHARED_QUEUE_MODE_SPSC)
+	{
+		return shared_queue_new(str_lit(name), capacity, mode);
+	}
+
+	// opens an existing shared queue with the given name, if it fails it will return nullptr
+	MN_EXPORT Shared_Queue
+	shared_queue_open(const Str& name);
+
+	// opens an existing shared queue with the given name, if it fails it will return nullptr
+	inline static Shared_Queue
+	shared_queue_open(const char* name)
+	{
+		return shared_queue_open(str_lit(name));
+	}
+
+	// frees the given shared queue instance
+	MN_EXPORT void
+	shared_queue_free(Shared_Queue self);
+
+	// destruct overload for shared queue free
+	inline static void
+	destruct(Shared_Queue self)
+	{
+		shared_queue_free(self);
+	}
+
+	// writes the given block of bytes into the queue within the given timeout window and returns the number of
+	// written bytes, writes larger than the queue capacity are split, returns 0 if the queue is closed
+	MN_EXPORT size_t
+	shared_queue_write(Shared_Queue self, Block data, Timeout timeout = INFINITE_TIMEOUT);
+
+	// reads available bytes from the queue within the given timeout window and returns the number of read bytes
+	// returns 0 if it timed out or if the queue is closed and empty
+	MN_EXPORT size_t
+	shared_queue_read(Shared_Queue self, Block data, Timeout timeout = INFINITE_TIMEOUT);
+
+	// closes the given queue which means that any subsequent writes will fail and readers will drain the remaining
+	// bytes then read 0
+	MN_EXPORT void
+	shared_queue_close(Shared_Queue self);
+
+	// returns whether the given queue is closed
+	MN_EXPORT bool
+	shared_queue_closed(Shared_Queue self);
+
+	// returns the number of bytes which are available to read
+	MN_EXPORT size_t
+	shared_queue_count(Shared_Queue self);
+}
@@ -33,6 +33,22 @@ namespace mn
 		self->free(block);
 	}
 
+	// tries to grow the given block in place using the given allocator, returns false if it can't be grown without
+	// moving it, in which case the block is left untouched
+	inline static bool
+	try_grow_from(Allocator self, Block& block, size_t new_size)
+	{
+		return self->try_grow(block, new_size);
+	}
+
+	// reallocates the given block to the new size using the given allocator while preserving its content, the
+	// returned block might have a different address
+	inline static Block
+	realloc_from(Allocator self, Block block, size_t new_size, uint8_t alignment)
+	{
+		return self->realloc(block, new_size, alignment);
+	}
+
 
 	// allocates from the given allocator a single instance of the given type
 	template<typename T>
@@ -159,12 +175,13 @@ namespace mn
 		return alloc_construct<memory::Arena>(block_size, meta);
 	}
 
-	// creates a new buddy allocator with the given heap size and meta allocator
+	// creates a new buddy allocator with the given heap size and meta allocator, if the stripes count is more than 1
+	// the buddy can be used from multiple threads
 	// read more about buddy allocator in Buddy.h
 	inline static memory::Buddy*
-	allocator_buddy_new(size_t heap_size = 1ULL * 1024ULL * 1024ULL, Allocator meta = memory::virtual_mem())
+	allocator_buddy_new(size_t heap_size = 1ULL * 1024ULL * 1024ULL, Allocator meta = memory::virtual_mem(), size_t stripes_count = 1)
 	{
-		return alloc_construct<memory::Buddy>(heap_size, meta);
+		return alloc_construct<memory::Buddy>(heap_size, meta, stripes_count);
 	}
 
 	// frees the given allocator
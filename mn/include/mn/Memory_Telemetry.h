@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mn/Exports.h"
+#include "mn/Memory.h"
+#include "mn/Buf.h"
+
+namespace mn
+{
+	// a snapshot of a single allocator's telemetry
+	//
+	// all the allocators (including each thread's tmp arena) register themselves in a global registry when they're
+	// created and keep always on atomic counters for their allocations, you can take a snapshot of all the live
+	// allocators at any time from any thread and export it to your metrics pipeline without attaching a profiler
+	struct Allocator_Telemetry
+	{
+		const char* name;
+		Allocator allocator;
+		size_t allocations_count;
+		size_t frees_count;
+		// total number of allocated bytes over the lifetime of the allocator
+		size_t allocated_bytes;
+		// number of bytes currently in use
+		size_t live_bytes;
+		// peak number of bytes in use
+		size_t highwater_bytes;
+		// allocations count per size class, use memory_telemetry_size_class_max to get the size class range
+		size_t size_classes[memory::TELEMETRY_SIZE_CLASSES_COUNT];
+	};
+
+	// returns a snapshot of the telemetry of all the live allocators, the snapshot is allocated using the given allocator
+	MN_EXPORT Buf<Allocator_Telemetry>
+	memory_telemetry_snapshot(Allocator allocator = allocator_top());
+
+	// returns the telemetry snapshot of the given allocator
+	MN_EXPORT Allocator_Telemetry
+	memory_telemetry_of(Allocator self);
+
+	// returns the maximum allocation size in bytes of the given size class, the last class has no maximum so it
+	// returns SIZE_MAX
+	inline static size_t
+	memory_telemetry_size_class_max(size_t size_class)
+	{
+		if (size_class + 1 >= memory::TELEMETRY_SIZE_CLASSES_COUNT)
+			return SIZE_MAX;
+		return size_t(16) << size_class;
+	}
+
+	// sets the name which the given allocator reports in the telemetry, the name should be a string literal or
+	// outlive the allocator
+	inline static void
+	allocator_name_set(Allocator self, const char* name)
+	{
+		self->telemetry.name = name;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "mn/Exports.h"
+#include "mn/Thread.h"
+#include "mn/Buf.h"
+
+namespace mn
+{
+	// a numa node, which is a group of cpus sharing the same local memory
+	struct Numa_Node
+	{
+		// os id of the node
+		size_t id;
+		// cpus which belong to this node
+		Cpu_Set cpus;
+	};
+
+	// returns the numa nodes of the system, on linux it's discovered from /sys/devices/system/node, systems without
+	// numa support report a single node which contains all the cpus
+	MN_EXPORT Buf<Numa_Node>
+	numa_nodes(Allocator allocator = allocator_top());
+
+	// returns the index of the node which contains the given cpu in the given nodes list, or SIZE_MAX if none does
+	inline static size_t
+	numa_node_of_cpu(const Buf<Numa_Node>& nodes, size_t cpu)
+	{
+		for (size_t i = 0; i < nodes.count; ++i)
+			if (cpu_set_has(nodes[i].cpus, cpu))
+				return i;
+		return SIZE_MAX;
+	}
+}
@@ -3,9 +3,16 @@
 #include "mn/Exports.h"
 #include "mn/Base.h"
 #include "mn/Str.h"
+#include "mn/Task.h"
+#include "mn/Defer.h"
 
 namespace mn
 {
+	typedef struct IFabric* Fabric;
+
+	template<typename T>
+	struct IChan;
+
 	// a helper function which given the filename will load the content of it into the resulting string
 	MN_EXPORT Str
 	file_content_str(const char* filename, Allocator allocator = allocator_top());
@@ -136,7 +143,11 @@ namespace mn
 		enum KIND
 		{
 			KIND_FILE,
-			KIND_FOLDER
+			KIND_FOLDER,
+			// symbolic link, the kind of its target is not resolved
+			KIND_SYMLINK,
+			// devices, pipes, sockets, etc.
+			KIND_OTHER,
 		};
 
 		KIND kind;
@@ -168,6 +179,104 @@ namespace mn
 		return path_entries(path.ptr, allocator);
 	}
 
+	// matches the given path against a glob pattern, it supports "?", "*" (which doesn't cross "/"),
+	// "**" (which does), and "[a-z]"/"[!a-z]" character classes
+	// patterns without "/" are matched against the last component of the path only
+	// path_glob_match("*.cpp", "src/mn/Path.cpp") == true
+	// path_glob_match("src/**/*.cpp", "src/mn/Path.cpp") == true
+	MN_EXPORT bool
+	path_glob_match(const char* pattern, const char* path);
+
+	// matches the given path against a glob pattern
+	inline static bool
+	path_glob_match(const Str& pattern, const Str& path)
+	{
+		return path_glob_match(pattern.ptr, path.ptr);
+	}
+
+	// represents an entry visited by the path walker
+	struct Path_Walk_Entry
+	{
+		Path_Entry::KIND kind;
+		// path of the entry, it's the walk root joined with the relative path
+		Str path;
+		// path of the entry relative to the walk root, it points into the path string
+		Str relative_path;
+		// direct children of the walk root have depth 1
+		size_t depth;
+	};
+
+	// frees the given path walk entry
+	inline static void
+	path_walk_entry_free(Path_Walk_Entry& self)
+	{
+		str_free(self.path);
+	}
+
+	// destruct overload of path walk entry free
+	inline static void
+	destruct(Path_Walk_Entry& self)
+	{
+		path_walk_entry_free(self);
+	}
+
+	// path walker settings, all the filters are matched against the relative path of entries
+	struct Path_Walk_Settings
+	{
+		// glob patterns, if not empty only the non folder entries which match one of them are reported
+		Buf<Str> include;
+		// glob patterns, entries which match one of them are not reported and matched folders are not descended into
+		Buf<Str> exclude;
+		// maximum depth of the reported entries, 0 means unlimited
+		size_t max_depth;
+		// whether to descend into symlinks which point to folders, such symlinks are reported as folders
+		// cycles are cut after 40 nested symlinks so you'd better combine it with max_depth
+		bool follow_symlinks;
+		// if set the sub folders are traversed in parallel on this fabric, otherwise the walk
+		// happens on the calling thread
+		Fabric fabric;
+	};
+
+	// walks the folder tree rooted at the given path and calls on_entry for each visited entry
+	// the directory entries are read in large batches into an arena which is reused as the walk goes on
+	// so the entry strings are only valid during the on_entry call
+	// if a fabric is set in settings on_entry will be called concurrently from the fabric workers
+	// and this function returns after all the sub folders are visited
+	// returns false if the root folder couldn't be read
+	MN_EXPORT bool
+	path_walk(const char* root, const Path_Walk_Settings& settings, Task<void(const Path_Walk_Entry&)>& on_entry);
+
+	// walks the folder tree rooted at the given path and calls on_entry for each visited entry
+	template<typename TFunc>
+	inline static bool
+	path_walk(const char* root, const Path_Walk_Settings& settings, TFunc&& on_entry)
+	{
+		auto task = Task<void(const Path_Walk_Entry&)>::make(std::forward<TFunc>(on_entry));
+		mn_defer{task_free(task);};
+		return path_walk(root, settings, task);
+	}
+
+	// walks the folder tree rooted at the given path and calls on_entry for each visited entry
+	template<typename TFunc>
+	inline static bool
+	path_walk(const Str& root, const Path_Walk_Settings& settings, TFunc&& on_entry)
+	{
+		return path_walk(root.ptr, settings, std::forward<TFunc>(on_entry));
+	}
+
+	// walks the folder tree rooted at the given path and sends a copy of each visited entry to the given channel
+	// you're responsible for freeing the received entries, it doesn't close the channel
+	// so you'll usually run it in a go call then close the channel after it returns
+	MN_EXPORT bool
+	path_walk(const char* root, const Path_Walk_Settings& settings, IChan<Path_Walk_Entry>* chan);
+
+	// walks the folder tree rooted at the given path and sends a copy of each visited entry to the given channel
+	inline static bool
+	path_walk(const Str& root, const Path_Walk_Settings& settings, IChan<Path_Walk_Entry>* chan)
+	{
+		return path_walk(root.ptr, settings, chan);
+	}
+
 	// returns the absolute path of the executable
 	MN_EXPORT Str
 	path_executable(Allocator allocator = allocator_top());
@@ -186,7 +295,8 @@ namespace mn
 	}
 
 
-	// copies a file from src to dst, and returns whether the operation is successful
+	// copies a file from src to dst, and returns whether the operation is successful, symlinks are followed and on
+	// linux the holes of sparse files aren't allocated in the copy
 	MN_EXPORT bool
 	file_copy(const char* src, const char* dst);
 
@@ -305,7 +415,8 @@ namespace mn
 		auto normal_path = path_normalize(str_clone(path, memory::tmp()));
 		auto folders = str_split(normal_path, "/", true, memory::tmp());
 
-		auto folder_to_make = str_tmp();
+		// keep absolute paths absolute
+		auto folder_to_make = str_tmp(str_prefix(normal_path, "/") ? "/" : nullptr);
 		for (const auto& folder : folders)
 		{
 			folder_to_make = path_join(folder_to_make, folder);
@@ -334,7 +445,8 @@ namespace mn
 		return folder_remove(path.ptr);
 	}
 
-	// copies a folder and the contained files/folders from src to dst, and returns whether it succeeded
+	// copies a folder and the contained files/folders from src to dst, and returns whether it succeeded, on linux
+	// and mac the symlinks inside the folder are recreated as symlinks with the same target
 	MN_EXPORT bool
 	folder_copy(const char* src, const char* dst);
 
@@ -359,6 +471,20 @@ namespace mn
 		return folder_copy(src.ptr, dst.ptr);
 	}
 
+	// copies a folder and the contained files/folders from src to dst using the given fabric, the folder tree
+	// is walked once on the calling thread while the file copies are scheduled on the fabric with at most
+	// max_in_flight copies running at the same time (0 means twice the fabric workers count),
+	// and returns whether it succeeded
+	MN_EXPORT bool
+	folder_copy(const char* src, const char* dst, Fabric fabric, size_t max_in_flight = 0);
+
+	// copies a folder and the contained files/folders from src to dst using the given fabric, and returns whether it succeeded
+	inline static bool
+	folder_copy(const Str& src, const Str& dst, Fabric fabric, size_t max_in_flight = 0)
+	{
+		return folder_copy(src.ptr, dst.ptr, fabric, max_in_flight);
+	}
+
 	// moves a folder and the contained files/folders from src to dst, and returns whether it succeeded
 	inline static bool
 	folder_move(const char* src, const char* dst)
@@ -88,20 +88,27 @@ namespace mn
 		size_t next_cap = size_t(self.cap * 1.5f);
 		size_t accurate_cap = self.count + added_size;
 		size_t request_cap = next_cap > accurate_cap ? next_cap : accurate_cap;
-		Block new_block = alloc_from(self.allocator, request_cap * sizeof(T), alignof(T));
-		if(self.count)
+		if(self.cap == 0)
 		{
-			const size_t first_copy_size = (self.cap - self.head) * sizeof(T);
-			::memcpy(new_block.ptr, self.ptr + self.head, first_copy_size);
-			::memcpy((char*)new_block.ptr + first_copy_size, self.ptr, self.head * sizeof(T));
+			Block new_block = alloc_from(self.allocator, request_cap * sizeof(T), alignof(T));
+			self.ptr = (T*)new_block.ptr;
+			self.cap = request_cap;
+			self.head = 0;
+			return;
 		}
 
-		if(self.cap)
-			free_from(self.allocator, Block { self.ptr, self.cap * sizeof(T) });
-
+		// realloc lets the allocator grow the block in place, then if the ring is wrapped we only move the
+		// front segment (from head to the old end) to the end of the new block
+		Block new_block = realloc_from(self.allocator, Block { self.ptr, self.cap * sizeof(T) }, request_cap * sizeof(T), alignof(T));
 		self.ptr = (T*)new_block.ptr;
+		if(self.head + self.count > self.cap)
+		{
+			const size_t front_count = self.cap - self.head;
+			const size_t new_head = request_cap - front_count;
+			::memmove(self.ptr + new_head, self.ptr + self.head, front_count * sizeof(T));
+			self.head = new_head;
+		}
 		self.cap = request_cap;
-		self.head = 0;
 	}
 
 	// pushes a value to the end of the ring buffer
@@ -77,12 +77,12 @@ namespace mn
 		};
 
 		static constexpr size_t SMALL_SIZE = sizeof(void*) * 7;
-		alignas(Concept) unsigned char concept[SMALL_SIZE];
+		alignas(Concept) unsigned char concept_storage[SMALL_SIZE];
 		bool isSet;
 
 		Concept& _self()
 		{
-			return *static_cast<Concept*>(static_cast<void*>(concept));
+			return *static_cast<Concept*>(static_cast<void*>(concept_storage));
 		}
 
 		R operator()(Args... args)
@@ -108,7 +108,7 @@ namespace mn
 		{
 			constexpr bool is_small = sizeof(Model<F, true>) <= SMALL_SIZE;
 			Task<R(Args...)> self{};
-			::new (&self.concept) Model<F, is_small>(std::forward<F>(f));
+			::new (&self.concept_storage) Model<F, is_small>(std::forward<F>(f));
 			self.isSet = true;
 			return self;
 		}
@@ -120,7 +120,7 @@ namespace mn
 		{
 			constexpr bool is_small = sizeof(Model<F, true>) <= SMALL_SIZE;
 			Task<R(Args...)> self{};
-			::new (&self.concept) Model<F, is_small>(allocator, std::forward<F>(f));
+			::new (&self.concept_storage) Model<F, is_small>(allocator, std::forward<F>(f));
 			self.isSet = true;
 			return self;
 		}
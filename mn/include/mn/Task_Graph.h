@@ -0,0 +1,70 @@
+#pragma once
+
+#include "mn/Exports.h"
+#include "mn/Base.h"
+#include "mn/Str.h"
+#include "mn/Task.h"
+#include "mn/Fabric.h"
+
+namespace mn
+{
+	// a task graph is a reusable set of tasks (nodes) and dependencies (edges) which runs on a fabric
+	//
+	// each node has an atomic counter of its unfinished predecessors, when a node finishes the worker which ran it
+	// decrements the counters of its successors, it runs the most critical successor which became ready right away
+	// and pushes the rest into its own queue so they run close to the data their predecessor just touched
+	//
+	// nodes are ordered by their critical path (the cost of the longest path from the node to the end of the graph)
+	// so the nodes which hold back the most work run first, the cost of a node is either given when it's added or
+	// measured in the previous run of the graph
+	typedef struct ITask_Graph* Task_Graph;
+
+	// index of a node within its task graph
+	typedef size_t Task_Graph_Node;
+
+	// creates a new task graph
+	MN_EXPORT Task_Graph
+	task_graph_new(const char* name = "Task_Graph");
+
+	// frees the given task graph, it shouldn't be running
+	MN_EXPORT void
+	task_graph_free(Task_Graph self);
+
+	// destruct overload for task_graph_free
+	inline static void
+	destruct(Task_Graph self)
+	{
+		task_graph_free(self);
+	}
+
+	// adds a node which runs the given task, cost is an estimate of its run time in microseconds which is used to
+	// compute the critical paths, 0 means that it's measured in each run (and it's 1 before the first run)
+	MN_EXPORT Task_Graph_Node
+	task_graph_node_add(Task_Graph self, const char* name, const Task<void()>& task, uint64_t cost = 0);
+
+	// adds a node which runs the given callable
+	template<typename TFunc>
+	inline static Task_Graph_Node
+	task_graph_node(Task_Graph self, const char* name, TFunc&& fn, uint64_t cost = 0)
+	{
+		return task_graph_node_add(self, name, Task<void()>::make(std::forward<TFunc>(fn)), cost);
+	}
+
+	// adds a dependency between the given nodes, after only runs once before finishes
+	MN_EXPORT void
+	task_graph_edge(Task_Graph self, Task_Graph_Node before, Task_Graph_Node after);
+
+	// starts running the given task graph on the given fabric and returns right away, the graph shouldn't be
+	// changed or run again until the run finishes, it panics if the graph has a cycle
+	MN_EXPORT void
+	task_graph_run(Task_Graph self, Fabric fabric);
+
+	// waits until the current run of the given task graph finishes
+	MN_EXPORT void
+	task_graph_wait(Task_Graph self);
+
+	// returns the trace of the last finished run of the given task graph in the chrome trace event format (which
+	// can be loaded in chrome://tracing or perfetto), each node is an event on the thread of the worker which ran it
+	MN_EXPORT Str
+	task_graph_trace(Task_Graph self, Allocator allocator = allocator_top());
+}
@@ -42,6 +42,10 @@ namespace mn
 	MN_EXPORT const Source_Location*
 	mutex_source_location(Mutex mutex);
 
+	// returns the name the mutex was created with
+	MN_EXPORT const char*
+	mutex_name(Mutex mutex);
+
 	// destruct overload for mutex free
 	inline static void
 	destruct(Mutex mutex)
@@ -61,6 +65,13 @@ namespace mn
 	MN_EXPORT Mutex_RW
 	mutex_rw_new(const char* name = "Mutex_RW");
 
+	// creates a new reader biased mutex with the given name, it's meant for read mostly data which is read by lots of
+	// threads at the same time (e.g. configuration tables), readers only touch a per cpu counter so they don't contend
+	// on a shared cache line, while writers are more expensive because they have to wait for all the per cpu
+	// counters to drain, on platforms other than linux it's the same as mutex_rw_new
+	MN_EXPORT Mutex_RW
+	mutex_rw_reader_biased_new(const char* name = "Mutex_RW");
+
 	// frees the mutex
 	MN_EXPORT void
 	mutex_rw_free(Mutex_RW mutex);
@@ -92,6 +103,10 @@ namespace mn
 	MN_EXPORT const Source_Location*
 	mutex_rw_source_location(Mutex_RW mutex);
 
+	// returns the name the mutex was created with
+	MN_EXPORT const char*
+	mutex_rw_name(Mutex_RW mutex);
+
 
 	//Thread API
 
@@ -128,6 +143,63 @@ namespace mn
 	MN_EXPORT void*
 	thread_id();
 
+	// maximum number of logical cpus which can be represented in a cpu set
+	constexpr static size_t CPU_SET_CAPACITY = 1024;
+
+	// a set of logical cpus, used to express thread affinity
+	struct Cpu_Set
+	{
+		uint64_t bits[CPU_SET_CAPACITY / 64];
+	};
+
+	// adds the given cpu to the set
+	inline static void
+	cpu_set_add(Cpu_Set& self, size_t cpu)
+	{
+		if (cpu < CPU_SET_CAPACITY)
+			self.bits[cpu / 64] |= uint64_t(1) << (cpu % 64);
+	}
+
+	// returns whether the given cpu is in the set
+	inline static bool
+	cpu_set_has(const Cpu_Set& self, size_t cpu)
+	{
+		if (cpu >= CPU_SET_CAPACITY)
+			return false;
+		return (self.bits[cpu / 64] & (uint64_t(1) << (cpu % 64))) != 0;
+	}
+
+	// returns the number of cpus in the set
+	inline static size_t
+	cpu_set_count(const Cpu_Set& self)
+	{
+		size_t res = 0;
+		for (auto word: self.bits)
+			for (; word != 0; word &= word - 1)
+				++res;
+		return res;
+	}
+
+	// returns the n-th cpu in the set, or SIZE_MAX if the set has n or less cpus
+	inline static size_t
+	cpu_set_nth(const Cpu_Set& self, size_t n)
+	{
+		for (size_t cpu = 0; cpu < CPU_SET_CAPACITY; ++cpu)
+		{
+			if (cpu_set_has(self, cpu))
+			{
+				if (n == 0)
+					return cpu;
+				--n;
+			}
+		}
+		return SIZE_MAX;
+	}
+
+	// sets the cpu affinity of the calling thread, returns false if the os doesn't support it or refused the set
+	MN_EXPORT bool
+	thread_affinity_set(const Cpu_Set& cpus);
+
 
 	// returns time in milliseonds
 	MN_EXPORT uint64_t
@@ -204,6 +276,7 @@ namespace mn
 					return false;
 			}
 		}
+		return true;
 	}
 
 	// signals a condition variable waiter
@@ -214,6 +287,18 @@ namespace mn
 	MN_EXPORT void
 	cond_var_notify_all(Cond_Var self);
 
+	// an asynchronous waiter (e.g. a suspended coroutine) which is notified by calling its notify function instead of
+	// blocking a thread
+	struct Async_Waiter
+	{
+		// called once when the wait is satisfied, the waited on primitive doesn't touch the waiter after it calls
+		// this function
+		void (*notify)(Async_Waiter* self);
+		void* user_data;
+		// bookkeeping of the waited on primitive
+		Async_Waiter* next;
+	};
+
 	// a waitgroup is a sync primitive which is a counter you can wait on until it reaches zero
 	typedef struct IWaitgroup* Waitgroup;
 
@@ -229,6 +314,11 @@ namespace mn
 	MN_EXPORT void
 	waitgroup_wait(Waitgroup self);
 
+	// registers the given waiter to be notified when the waitgroup count reaches 0 instead of blocking the calling
+	// thread, returns false without registering it if the count is 0 already
+	MN_EXPORT bool
+	waitgroup_wait_async(Waitgroup self, Async_Waiter* waiter);
+
 	// adds c to the waitgroup counter
 	MN_EXPORT void
 	waitgroup_add(Waitgroup self, int c);
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "mn/Exports.h"
+#include "mn/Base.h"
+#include "mn/Str.h"
+#include "mn/Buf.h"
+
+#include <atomic>
+
+namespace mn
+{
+	// the tracer is a built in low overhead profiler which records the thread profiling hooks (thread creation, mutex
+	// lock waits and holds), the memory profiling hooks (allocations and frees), fabric jobs, and sysmon decisions,
+	// then exports them on demand in the chrome trace event format which can be loaded in chrome://tracing or perfetto
+	//
+	// each thread appends its events to its own chunked buffer without any synchronization, chunks are published
+	// using release stores so the trace can be exported while the threads are still recording, uncontended locks
+	// are only counted in the per thread lock stats, and locks which waited longer than the contention threshold are
+	// recorded as events as well
+	//
+	// the tracer installs its own profiling hooks while it's recording and forwards the calls to the hooks which were
+	// installed before it, which are restored once it stops
+	struct Tracer_Settings
+	{
+		// maximum number of events each thread records, the events after that are dropped and counted
+		// default: 1M
+		size_t events_per_thread_limit;
+		// locks which waited less than this are only counted in the lock stats
+		// default: 1000
+		uint64_t contention_threshold_in_ns;
+		// don't record the mutex hooks
+		bool ignore_mutexes;
+		// don't record the memory hooks
+		bool ignore_memory;
+		// don't record fabric jobs and sysmon decisions
+		bool ignore_fabric;
+	};
+
+	// starts recording using the given settings, the events of the previous recording are discarded, it shouldn't
+	// be called while a trace is being exported
+	MN_EXPORT void
+	tracer_start(const Tracer_Settings& settings = {});
+
+	// stops recording and restores the profiling hooks which were installed before tracer_start, the recorded
+	// events are kept until the next tracer_start
+	MN_EXPORT void
+	tracer_stop();
+
+	// returns whether the tracer is recording
+	MN_EXPORT bool
+	tracer_is_recording();
+
+	// returns the recorded events in the chrome trace event json format, each thread is a track of its own
+	MN_EXPORT Str
+	tracer_chrome_trace(Allocator allocator = allocator_top());
+
+	// lock stats of all the mutexes which share the same source location (or the same name if they were created
+	// without a source location)
+	struct Tracer_Lock_Stats
+	{
+		const Source_Location* srcloc;
+		const char* name;
+		uint64_t locks_count;
+		// number of locks which waited longer than the contention threshold
+		uint64_t contended_count;
+		uint64_t total_wait_in_ns;
+		uint64_t max_wait_in_ns;
+		uint64_t total_hold_in_ns;
+	};
+
+	// returns the lock stats of the recorded threads merged by mutex source location, sorted by their total wait
+	// time
+	MN_EXPORT Buf<Tracer_Lock_Stats>
+	tracer_lock_stats(Allocator allocator = allocator_top());
+
+	struct Tracer_Thread_Stats
+	{
+		char name[64];
+		// index of the thread's track in the chrome trace
+		uint64_t id;
+		uint64_t jobs_count;
+		// time spent running fabric jobs
+		uint64_t busy_time_in_ns;
+		// busy time over the recording time, it's the utilization of the worker if the thread is a fabric worker
+		double utilization;
+		uint64_t lock_wait_in_ns;
+		uint64_t allocations_count;
+		uint64_t allocated_bytes;
+		uint64_t frees_count;
+		uint64_t freed_bytes;
+		uint64_t dropped_events_count;
+	};
+
+	// returns the stats of the recorded threads
+	MN_EXPORT Buf<Tracer_Thread_Stats>
+	tracer_thread_stats(Allocator allocator = allocator_top());
+
+	// set while the tracer records fabric events, fabric checks it before calling the tracer so that it costs a
+	// single predictable branch when the tracer isn't recording
+	MN_EXPORT extern std::atomic<bool> _TRACER_FABRIC;
+
+	inline static bool
+	_tracer_fabric()
+	{
+		return _TRACER_FABRIC.load(std::memory_order_relaxed);
+	}
+
+	// called by fabric workers around each job, worker_name names the thread's track if it has no name yet
+	MN_EXPORT void
+	_tracer_job_begin(const char* worker_name);
+
+	MN_EXPORT void
+	_tracer_job_end();
+
+	// called by sysmon when it acts on a worker, count is the number of jobs it moved (if any)
+	MN_EXPORT void
+	_tracer_sysmon_decision(const char* sysmon_name, const char* decision, size_t worker_index, size_t count);
+}
@@ -5,11 +5,70 @@
 
 namespace mn
 {
+	// access pattern hints for virtual memory mappings
+	enum VIRTUAL_ACCESS
+	{
+		// no special treatment
+		VIRTUAL_ACCESS_NORMAL,
+		// pages will be accessed in random order, so the os should disable read ahead
+		VIRTUAL_ACCESS_RANDOM,
+		// pages will be accessed sequentially, so the os can read ahead aggressively
+		VIRTUAL_ACCESS_SEQUENTIAL,
+		// pages will be needed soon, so the os should start paging them in
+		VIRTUAL_ACCESS_WILL_NEED,
+	};
+
+	// options for virtual memory mappings (virtual_alloc and file_mmap)
+	struct Virtual_Map_Options
+	{
+		// prefaults the whole mapping at map time so the first access to each page doesn't take a page fault
+		bool populate;
+		// asks the os to back the mapping with transparent huge pages (linux only) to reduce TLB misses
+		bool transparent_huge_pages;
+		// backs the mapping with explicit huge pages from the os reserved pool (MAP_HUGETLB on linux,
+		// MEM_LARGE_PAGES on windows), the allocation fails if the pool is exhausted, it only applies to
+		// anonymous memory so it's ignored by file_mmap
+		bool huge_pages;
+		// locks the pages in physical memory so they're never swapped out, the mapping fails if they can't be locked
+		bool lock;
+		// access pattern hint
+		VIRTUAL_ACCESS access;
+	};
+
 	// allocates a block of memory using OS virtual memory, it will commit it as well
 	MN_EXPORT Block
-	virtual_alloc(void* address_hint, size_t size);
+	virtual_alloc(void* address_hint, size_t size, const Virtual_Map_Options& options = {});
 
 	// frees a block from OS virtual memory
 	MN_EXPORT void
 	virtual_free(Block block);
+
+	// resizes a block from OS virtual memory while preserving its content, if can_move is false the block is only
+	// resized in place, otherwise the os is allowed to move it to a new address (by remapping its pages when
+	// possible instead of copying them), returns an empty block on failure in which case the original block is
+	// left untouched
+	MN_EXPORT Block
+	virtual_realloc(Block block, size_t new_size, bool can_move);
+
+	// reserves a range of virtual address space without committing any physical memory to it, pages should be
+	// committed using virtual_commit before they're accessed, and the whole range is released using virtual_free
+	MN_EXPORT Block
+	virtual_reserve(void* address_hint, size_t size);
+
+	// commits the given page aligned range of reserved memory so that it can be read and written
+	// returns false if the os couldn't commit it
+	MN_EXPORT bool
+	virtual_commit(Block block);
+
+	// decommits the given page aligned range of reserved memory, which returns its physical pages back to the os
+	// while keeping the address range reserved
+	MN_EXPORT void
+	virtual_decommit(Block block);
+
+	// applies the transparent huge pages, lock, and access options to an already mapped block
+	// the populate and huge pages options only make sense at map time so they're ignored here
+	// the normal access hint doesn't issue any call, so it doesn't reset a hint which was applied before
+	// returns false if the lock option is set and the pages couldn't be locked
+	MN_EXPORT bool
+	virtual_advise(Block block, const Virtual_Map_Options& options);
 }
@@ -15,8 +15,18 @@ namespace mn::memory
 	// we noticed that most of the time we free the entire arena at once, that's why arena doesn't free
 	// individual elements, which simplifies internal book keeping a lot, also this is symmetric to
 	// the way it does allocation. in short arena is a bulk allocator, it allocates in bulk and frees in bulk
+	//
+	// an arena can also be created in reserved mode, in which it reserves a single contiguous range of virtual address
+	// space up front and commits pages from it on demand (in block size granularity), this way it never chains nodes,
+	// owns and checkpoint/restore are O(1), and clear_all decommits the pages above the highwater mark
 	struct Arena : Interface
 	{
+		// used to create an arena in reserved mode with the given size of virtual address space in bytes
+		struct Reserve
+		{
+			size_t size;
+		};
+
 		struct Node
 		{
 			Block mem;
@@ -49,11 +59,26 @@ namespace mn::memory
 		size_t clear_all_readjust_threshold;
 		size_t clear_all_current_highwater;
 		size_t clear_all_previous_highwater;
+		// reserved address range in reserved mode, empty otherwise
+		Block reserved;
+		// reserved mode allocation head, memory between the start of the reserved range and this head is in use
+		uint8_t* reserved_alloc_head;
+		// reserved mode commit head, memory between the start of the reserved range and this head is committed
+		uint8_t* reserved_commit_head;
+		// number of times the arena returned memory to the meta allocator (or decommitted it in reserved mode)
+		size_t release_count;
+		// total amount of memory in bytes returned to the meta allocator (or decommitted in reserved mode)
+		size_t release_mem;
 
 		// creates a new arena allocator with the given block size (in bytes), and the meta allocator (defaults to system malloc)
 		MN_EXPORT
 		Arena(size_t block_size, Interface* meta = clib());
 
+		// creates a new arena allocator in reserved mode which reserves the given size of virtual address space, and
+		// commits it on demand in the given block size granularity (in bytes)
+		MN_EXPORT
+		Arena(Reserve reserve, size_t block_size = 64ULL * 1024ULL);
+
 		// frees the given arena
 		MN_EXPORT
 		~Arena() override;
@@ -66,18 +91,30 @@ namespace mn::memory
 		MN_EXPORT void
 		free(Block block) override;
 
+		// grows the given block in place if it's the most recent allocation and the current arena block has enough
+		// free memory to hold the new size
+		MN_EXPORT bool
+		try_grow(Block& block, size_t new_size) override;
+
 		// reserves the given amount of memory
 		MN_EXPORT void
 		grow(size_t size);
 
-		// frees the entire arena to the meta allocator
+		// frees the entire arena to the meta allocator, in reserved mode it decommits the entire reserved range
 		MN_EXPORT void
 		free_all();
 
 		// resets the allocation state back but doesn't free the memory to the meta allocator, which is useful for memory reuse
+		// in reserved mode it decommits the memory above the highwater mark
 		MN_EXPORT void
 		clear_all();
 
+		// returns the unused memory above the given retain size back to the meta allocator, in reserved mode it
+		// decommits the pages above max(used memory, retain size), in chained mode it can only free the nodes when
+		// the arena is empty
+		MN_EXPORT void
+		trim(size_t retain_size);
+
 		// checks whether this arena owns this pointer, which is useful for debugging and various assertions
 		MN_EXPORT bool
 		owns(void* ptr) const;
@@ -88,6 +125,29 @@ namespace mn::memory
 		MN_EXPORT void
 		restore(State state);
 	};
+
+	// a scoped arena region, it checkpoints the arena at construction and restores it when it goes out of scope
+	// which frees all the allocations made inside the scope in bulk without returning the memory to the meta allocator
+	struct Arena_Scope
+	{
+		Arena* arena;
+		Arena::State state;
+
+		Arena_Scope(Arena* arena)
+			: arena(arena),
+			  state(arena->checkpoint())
+		{}
+
+		Arena_Scope(const Arena_Scope&) = delete;
+		Arena_Scope(Arena_Scope&&) = delete;
+		Arena_Scope& operator=(const Arena_Scope&) = delete;
+		Arena_Scope& operator=(Arena_Scope&&) = delete;
+
+		~Arena_Scope()
+		{
+			this->arena->restore(this->state);
+		}
+	};
 }
 
 namespace mn
@@ -106,6 +166,13 @@ namespace mn
 		self->clear_all();
 	}
 
+	// returns the unused memory above the given retain size back to the meta allocator
+	inline static void
+	allocator_arena_trim(memory::Arena* self, size_t retain_size)
+	{
+		self->trim(retain_size);
+	}
+
 	// checks whether this arena owns this pointer, which is useful for debugging and various assertions
 	inline static bool
 	allocator_arena_owns(const memory::Arena* self, void* ptr)
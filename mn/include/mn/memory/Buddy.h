@@ -4,97 +4,103 @@
 #include "mn/memory/Interface.h"
 #include "mn/memory/Virtual.h"
 
+#include <atomic>
+
 namespace mn::memory
 {
-	// a general purpose buddy allocator, which acts as a containerized malloc
-	// implementation, with a log(N) complexity for both alloc and free
+	// a general purpose buddy allocator, which acts as a containerized malloc implementation
+	//
+	// the heap is a binary tree of power of two blocks, level 0 is the entire heap and each following level splits
+	// the blocks of the previous one in half down to the minimum allocation size (16 bytes), each level has a bitmap
+	// of its free blocks and the buddy keeps a mask of the levels which have at least one free block, so finding the
+	// level to allocate from is a single find-last-set instruction and finding a free block inside it is a
+	// find-first-set over the level bitmap starting from a search hint
+	//
+	// blocks don't have headers, free uses the size of the given block to find its level, so you should free blocks
+	// with the same size you allocated them with (which is what the containers do anyway)
+	//
+	// in concurrent mode the heap is striped into multiple independent heaps each with its own lock, threads
+	// allocate from their own stripe and fallback to the other stripes when it's full, so the maximum allocation
+	// size is the stripe size (heap_size / stripes_count)
 	struct Buddy : Interface
 	{
-		struct Node
+		// the maximum number of levels, which is enough for any 64-bit heap
+		constexpr static size_t MAX_LEVELS = 64;
+
+		// an independent buddy heap with its own lock, a non concurrent buddy has a single stripe and doesn't lock it
+		struct Stripe
+		{
+			std::atomic<bool> locked;
+			uint8_t* base;
+			// free blocks bitmaps of all the levels, level L has (1 << L) bits starting at word level_word_offset[L]
+			uint64_t* free_bits;
+			// bit L is set if level L has at least one free block
+			uint64_t free_levels_mask;
+			size_t free_count[MAX_LEVELS];
+			// index of the first word in the level bitmap which might have a set bit
+			size_t search_hint[MAX_LEVELS];
+			// bytes used by allocated blocks after rounding up to power of two sizes
+			size_t used_mem;
+			// bytes requested by the callers
+			size_t requested_mem;
+			size_t allocations_count;
+		};
+
+		// allocator statistics
+		struct Stats
 		{
-			Node* prev;
-			Node* next;
+			size_t heap_size;
+			// bytes used by allocated blocks after rounding up to power of two sizes
+			size_t used_mem;
+			// bytes requested by the callers
+			size_t requested_mem;
+			size_t allocations_count;
+			size_t free_blocks_count;
+			// size of the largest block which can be allocated right now
+			size_t largest_free_block;
+			// ratio of the used memory wasted because of power of two rounding
+			float internal_fragmentation;
+			// ratio of the free memory which can't be allocated in a single block (1 - largest free block / free memory)
+			float external_fragmentation;
 		};
 
 		Interface* meta;
 		Block memory;
-
-		// maximum allocation size is set to (2**max_alloc_log2)
-		size_t max_alloc_log2;
+		size_t heap_size;
+		// maximum allocation size which is the size of a single stripe
 		size_t max_alloc;
+		size_t max_alloc_log2;
+		// number of levels in each stripe
+		size_t levels_count;
+		size_t level_word_offset[MAX_LEVELS];
+		Stripe* stripes;
+		size_t stripes_count;
 
-		// Allocations are done in powers of two starting from MIN_ALLOC and ending at
-		// MAX_ALLOC inclusive. Each allocation size has a bucket that stores the free
-		// list for that allocation size.
-		//
-		// Given a bucket index, the size of the allocations in that bucket can be
-		// found with "(size_t)1 << (MAX_ALLOC_LOG2 - bucket)"
-		size_t bucket_max;
-
-		// Each bucket corresponds to a certain allocation size and stores a free list
-		// for that size. The bucket at index 0 corresponds to an allocation size of
-		// MAX_ALLOC (i.e. the whole address space)
-		Node*  buckets;
-		// Free lists are stored as circular doubly-linked lists. Every possible
-		// allocation size has an associated free list that is threaded through all
-		// currently free blocks of that size.
-		//
-		// We could initialize the allocator by giving it one free block the size of
-		// the entire address space. However, this would cause us to instantly reserve
-		// half of the entire address space on the first allocation, since the first
-		// split would store a free list entry at the start of the right child of the
-		// root. Instead, we have the tree start out small and grow the size of the
-		// tree as we use more memory. The size of the tree is tracked by this value
-		size_t bucket_count;
-
-		// This array represents a linearized binary tree of bits. Every possible
-		// allocation larger than MIN_ALLOC has a node in this tree (and therefore a
-		// bit in this array).
-		//
-		// Given the index for a node, lineraized binary trees allow you to traverse to
-		// the parent node or the child nodes just by doing simple arithmetic on the
-		// index:
-		// - Move to parent:         index = (index - 1) / 2;
-		// - Move to left child:     index = index * 2 + 1;
-		// - Move to right child:    index = index * 2 + 2;
-		// - Move to sibling:        index = ((index - 1) ^ 1) + 1;
-		//
-		// Each node in this tree can be in one of several states:
-		//
-		// - UNUSED (both children are UNUSED)
-		// - SPLIT (one child is UNUSED and the other child isn't)
-		// - USED (neither children are UNUSED)
-		//
-		// These states take two bits to store. However, it turns out we have enough
-		// information to distinguish between UNUSED and USED from context, so we only
-		// need to store SPLIT or not, which only takes a single bit.
-		//
-		// Note that we don't need to store any nodes for allocations of size MIN_ALLOC
-		// since we only ever care about parent nodes.
-		uint8_t* node_is_split;
-
-		// This is the starting address of the address range for this allocator. Every
-		// returned allocation will be an offset of this pointer from 0 to MAX_ALLOC.
-		uint8_t* base_ptr;
-
-		// This is the maximum address that has ever been used by the allocator. It's
-		// used to know when to call "brk" to request more memory from the kernel.
-		uint8_t* max_ptr;
-
-		// creates a new instance of buddy allocator
+		// creates a new instance of buddy allocator, the heap size is rounded up to a power of two, if the stripes
+		// count is more than 1 the buddy works in concurrent mode and can be used from multiple threads
 		MN_EXPORT
-		Buddy(size_t heap_size, Interface* meta = virtual_mem());
+		Buddy(size_t heap_size, Interface* meta = virtual_mem(), size_t stripes_count = 1);
 
 		// frees the given instance of the allocator
 		MN_EXPORT
-		~Buddy();
+		~Buddy() override;
 
-		// allocates a block with the given size and alignement
+		// allocates a block with the given size and alignement, the block is aligned to its power of two size, or to
+		// the alignment if it's bigger, and it should be freed with the given size
 		MN_EXPORT Block
 		alloc(size_t size, uint8_t alignment) override;
 
-		// frees the given block, in case the block is empty it does nothing
+		// frees the given block, in case the block is empty it does nothing, the block size should be the size it
+		// was allocated with
 		MN_EXPORT void
 		free(Block block) override;
+
+		// grows the given block in place if its power of two block has enough slack to hold the new size
+		MN_EXPORT bool
+		try_grow(Block& block, size_t new_size) override;
+
+		// returns the occupancy and fragmentation statistics of the allocator
+		MN_EXPORT Stats
+		stats();
 	};
 }
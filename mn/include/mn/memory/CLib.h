@@ -12,6 +12,10 @@ namespace mn::memory
 	// a wrapper around system's libc allocator
 	struct CLib : Interface
 	{
+		CLib()
+			: Interface("clib")
+		{}
+
 		// uses malloc to allocate the given block
 		MN_EXPORT Block
 		alloc(size_t size, uint8_t alignment) override;
@@ -19,6 +23,14 @@ namespace mn::memory
 		// frees the given block, if the block is empty it does nothing
 		MN_EXPORT void
 		free(Block block) override;
+
+		// grows the given block in place if the underlying malloc chunk is already big enough to hold the new size
+		MN_EXPORT bool
+		try_grow(Block& block, size_t new_size) override;
+
+		// uses realloc to resize the given block, which might grow it in place or remap it instead of copying it
+		MN_EXPORT Block
+		realloc(Block block, size_t new_size, uint8_t alignment) override;
 	};
 
 	// returns the global instance of the libc allocator
@@ -35,6 +35,14 @@ namespace mn::memory
 		// frees the given block of memory, and untracks it, if the block is empty it does nothing
 		MN_EXPORT void
 		free(Block block) override;
+
+		// grows the given block in place if the underlying malloc chunk is already big enough to hold the new size
+		MN_EXPORT bool
+		try_grow(Block& block, size_t new_size) override;
+
+		// uses realloc to resize the given block, and tracks the new size
+		MN_EXPORT Block
+		realloc(Block block, size_t new_size, uint8_t alignment) override;
 	};
 
 	// returns the global instance of the fast leak allocator
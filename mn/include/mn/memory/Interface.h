@@ -1,17 +1,61 @@
 #pragma once
 
+#include "mn/Exports.h"
 #include "mn/Base.h"
+#include "mn/memory/Telemetry.h"
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 namespace mn::memory
 {
 	// memory allocators interface, all memory allocators should implement this interface
+	// every allocator registers itself in the global allocators registry on construction with the given name, and
+	// unregisters on destruction, read more about allocators telemetry in Memory_Telemetry.h
 	struct Interface
 	{
-		virtual ~Interface() = default;
+		Telemetry telemetry;
+
+		MN_EXPORT
+		Interface(const char* name = "allocator");
+
+		Interface(const Interface&) = delete;
+
+		Interface&
+		operator=(const Interface&) = delete;
+
+		MN_EXPORT virtual
+		~Interface();
+
 		virtual Block alloc(size_t size, uint8_t alignment) = 0;
 		virtual void free(Block block) = 0;
+
+		// tries to grow the given block in place to the new size without moving it, on success it updates the block
+		// size and returns true, otherwise it returns false and the block is left untouched, allocators which can't
+		// grow blocks in place don't need to override it
+		virtual bool
+		try_grow(Block&, size_t)
+		{
+			return false;
+		}
+
+		// reallocates the given block to the new size while preserving its content, the returned block might have
+		// a different address, the default implementation tries to grow the block in place and falls back to
+		// alloc, copy, and free
+		virtual Block
+		realloc(Block block, size_t new_size, uint8_t alignment)
+		{
+			if (try_grow(block, new_size))
+				return block;
+
+			auto res = alloc(new_size, alignment);
+			if (block_is_empty(block) == false)
+			{
+				::memcpy(res.ptr, block.ptr, block.size < new_size ? block.size : new_size);
+				free(block);
+			}
+			return res;
+		}
 	};
 }
@@ -45,6 +45,10 @@ namespace mn::memory
 		MN_EXPORT void
 		free(Block block) override;
 
+		// uses realloc to resize the given block, and keeps tracking it along with its original allocation callstack
+		MN_EXPORT Block
+		realloc(Block block, size_t new_size, uint8_t alignment) override;
+
 		// prints the memory leak report, it's useful in case you want to report alive memory in a custom point before
 		// program exit, and you can indicate to it that you don't want it to report memory leaks on program exit by
 		// setting the report_on_destruct boolean to false, if you set it to true it will still report memory leaks
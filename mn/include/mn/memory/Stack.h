@@ -35,6 +35,11 @@ namespace mn::memory
 		MN_EXPORT void
 		free(Block block) override;
 
+		// grows the given block in place if it's the most recently allocated block (top of stack) and the stack has
+		// enough free memory to hold the new size
+		MN_EXPORT bool
+		try_grow(Block& block, size_t new_size) override;
+
 		// resets the entire stack back to its initial state, thus freeing the entire memory
 		MN_EXPORT void
 		free_all();
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+#if MN_COMPILER_MSVC
+#include <intrin.h>
+#endif
+
+namespace mn::memory
+{
+	struct Interface;
+
+	// number of allocation size classes, class 0 holds sizes up to 16 bytes, class i holds sizes up to (16 << i)
+	// bytes, and the last class holds everything bigger
+	constexpr static size_t TELEMETRY_SIZE_CLASSES_COUNT = 16;
+
+	// always on allocation counters, every allocator has one and registers it in the global allocators registry
+	// all the counters are relaxed atomics so they can be read from any thread while the allocator is in use
+	struct Telemetry
+	{
+		// name of the allocator, it should be a string literal or outlive the allocator
+		const char* name;
+		// set by allocators which are only used by one thread at a time (like arenas and stacks), their counters
+		// are updated with relaxed load and store pairs instead of read-modify-write atomics which keeps the
+		// allocation hot path cheap, readers on other threads might observe slightly stale values
+		bool single_owner;
+		std::atomic<size_t> allocations_count;
+		std::atomic<size_t> frees_count;
+		// total number of allocated bytes over the lifetime of the allocator
+		std::atomic<size_t> allocated_bytes;
+		// number of bytes currently in use
+		std::atomic<size_t> live_bytes;
+		// peak number of bytes in use
+		std::atomic<size_t> highwater_bytes;
+		// allocations count per size class
+		std::atomic<size_t> size_classes[TELEMETRY_SIZE_CLASSES_COUNT];
+
+		// registry links, protected by the registry lock
+		Interface* allocator;
+		Telemetry* prev;
+		Telemetry* next;
+	};
+
+	// returns the size class of the given allocation size
+	inline static size_t
+	telemetry_size_class(size_t size)
+	{
+		if (size <= 16)
+			return 0;
+
+		auto v = uint64_t(size - 1) >> 4;
+	#if MN_COMPILER_MSVC
+		unsigned long index = 0;
+		_BitScanReverse64(&index, v);
+		size_t res = size_t(index) + 1;
+	#else
+		size_t res = 64 - size_t(__builtin_clzll(v));
+	#endif
+		return res < TELEMETRY_SIZE_CLASSES_COUNT ? res : TELEMETRY_SIZE_CLASSES_COUNT - 1;
+	}
+
+	// adds the given value to the counter, single owner counters skip the read-modify-write atomic and return
+	// the new value
+	inline static size_t
+	_telemetry_add(const Telemetry& self, std::atomic<size_t>& counter, size_t value)
+	{
+		if (self.single_owner)
+		{
+			auto res = counter.load(std::memory_order_relaxed) + value;
+			counter.store(res, std::memory_order_relaxed);
+			return res;
+		}
+		return counter.fetch_add(value, std::memory_order_relaxed) + value;
+	}
+
+	// subtracts the given value from the counter, single owner counters skip the read-modify-write atomic
+	inline static void
+	_telemetry_sub(const Telemetry& self, std::atomic<size_t>& counter, size_t value)
+	{
+		if (self.single_owner)
+			counter.store(counter.load(std::memory_order_relaxed) - value, std::memory_order_relaxed);
+		else
+			counter.fetch_sub(value, std::memory_order_relaxed);
+	}
+
+	// raises the highwater mark to the given live bytes if it's bigger
+	inline static void
+	_telemetry_highwater(Telemetry& self, size_t live)
+	{
+		auto highwater = self.highwater_bytes.load(std::memory_order_relaxed);
+		if (self.single_owner)
+		{
+			if (live > highwater)
+				self.highwater_bytes.store(live, std::memory_order_relaxed);
+			return;
+		}
+		while (live > highwater && self.highwater_bytes.compare_exchange_weak(highwater, live, std::memory_order_relaxed) == false)
+		{}
+	}
+
+	// records an allocation of the given size
+	inline static void
+	_telemetry_alloc(Telemetry& self, size_t size)
+	{
+		_telemetry_add(self, self.allocations_count, 1);
+		_telemetry_add(self, self.allocated_bytes, size);
+		_telemetry_add(self, self.size_classes[telemetry_size_class(size)], 1);
+		auto live = _telemetry_add(self, self.live_bytes, size);
+		_telemetry_highwater(self, live);
+	}
+
+	// records a free of the given size
+	inline static void
+	_telemetry_free(Telemetry& self, size_t size)
+	{
+		_telemetry_add(self, self.frees_count, 1);
+		_telemetry_sub(self, self.live_bytes, size);
+	}
+
+	// records an in place resize of an allocation
+	inline static void
+	_telemetry_resize(Telemetry& self, size_t old_size, size_t new_size)
+	{
+		if (new_size >= old_size)
+		{
+			_telemetry_add(self, self.allocated_bytes, new_size - old_size);
+			auto live = _telemetry_add(self, self.live_bytes, new_size - old_size);
+			_telemetry_highwater(self, live);
+		}
+		else
+		{
+			_telemetry_sub(self, self.live_bytes, old_size - new_size);
+		}
+	}
+
+	// sets the live bytes directly, it's used by allocators which free in bulk (like arenas)
+	inline static void
+	_telemetry_live(Telemetry& self, size_t live)
+	{
+		self.live_bytes.store(live, std::memory_order_relaxed);
+		_telemetry_highwater(self, live);
+	}
+}
@@ -12,6 +12,10 @@ namespace mn::memory
 	// virtual memory allocator which allocates memory directly from the OS's virtual table
 	struct Virtual : Interface
 	{
+		Virtual()
+			: Interface("virtual")
+		{}
+
 		~Virtual() = default;
 
 		// allocates and commits a new memory block with the given size and alignment
@@ -21,6 +25,14 @@ namespace mn::memory
 		// frees the given memory block, if the block is empty it does nothing
 		MN_EXPORT void
 		free(Block block) override;
+
+		// grows the given block in place by extending its mapping if the following address range is free
+		MN_EXPORT bool
+		try_grow(Block& block, size_t new_size) override;
+
+		// resizes the given block by remapping its pages instead of copying its content when the os supports it
+		MN_EXPORT Block
+		realloc(Block block, size_t new_size, uint8_t alignment) override;
 	};
 
 	// returns the global virtual memory allocator instance
@@ -1,5 +1,6 @@
 #include "mn/Context.h"
 #include "mn/Memory.h"
+#include "mn/Memory_Telemetry.h"
 #include "mn/memory/Leak.h"
 #include "mn/memory/Fast_Leak.h"
 #include "mn/Stream.h"
@@ -9,12 +10,14 @@
 #include "mn/Assert.h"
 
 #include <stdio.h>
+#include <new>
 
 namespace mn
 {
 	static Memory_Profile_Interface MEMORY;
 	static Log_Interface LOG;
 	static Thread_Profile_Interface THREAD;
+	std::atomic<bool> _THREAD_PROFILE_MUTEX_HOOKS = false;
 	thread_local bool PROFILING_DISABLED = false;
 
 	struct Context_Wrapper
@@ -64,6 +67,8 @@ namespace mn
 			#endif
 		self->_allocator_stack_count = 1;
 
+		allocator_name_set(&self->_allocator_tmp, "tmp");
+
 		self->reader_tmp = reader_new(nullptr, memory::clib());
 	}
 
@@ -88,6 +93,23 @@ namespace mn
 		return res;
 	}
 
+	Context*
+	context_new(size_t tmp_block_size)
+	{
+		auto self = (Context*)memory::clib()->alloc(sizeof(Context), alignof(Context)).ptr;
+		new (self) Context(tmp_block_size);
+		context_init(self);
+		return self;
+	}
+
+	void
+	context_delete(Context* self)
+	{
+		context_free(self);
+		self->~Context();
+		memory::clib()->free(Block{self, sizeof(Context)});
+	}
+
 	Allocator
 	allocator_top()
 	{
@@ -212,6 +234,12 @@ namespace mn
 	{
 		auto res = THREAD;
 		THREAD = self;
+		_THREAD_PROFILE_MUTEX_HOOKS.store(
+			self.mutex_before_lock || self.mutex_after_lock || self.mutex_after_unlock ||
+			self.mutex_before_read_lock || self.mutex_after_read_lock ||
+			self.mutex_before_write_lock || self.mutex_after_write_lock ||
+			self.mutex_after_read_unlock || self.mutex_after_write_unlock
+		);
 		return res;
 	}
 
@@ -0,0 +1,356 @@
+#include "mn/Epoch.h"
+#include "mn/Buf.h"
+#include "mn/Thread.h"
+#include "mn/Defer.h"
+
+namespace mn
+{
+	// the number of retired pointers a thread keeps before it tries to free them when it leaves a critical section
+	constexpr static size_t EPOCH_COLLECT_THRESHOLD = 64;
+
+	struct Epoch_Retired
+	{
+		void (*fn)(void* ptr, Allocator allocator);
+		void* ptr;
+		Allocator allocator;
+		// the global epoch at the time of retirement, the pointer is safe to free once the global epoch is 2 epochs
+		// ahead of it
+		uint64_t epoch;
+	};
+
+	// a registered thread, records are never freed, they're reused by new threads once their thread exits
+	struct Epoch_Thread
+	{
+		// the global epoch observed when the thread entered its critical section, 0 if it's not in one
+		std::atomic<uint64_t> epoch;
+		std::atomic<bool> in_use;
+		Epoch_Thread* next;
+		// keeps each record in its own cache line because it's written on each critical section
+		char _padding[64 - sizeof(std::atomic<uint64_t>) - sizeof(std::atomic<bool>) - sizeof(Epoch_Thread*)];
+	};
+
+	// the retired pointers of exited threads, they're freed by the other threads collections
+	struct Epoch_Orphans
+	{
+		Buf<Epoch_Retired> retired;
+		Epoch_Orphans* next;
+	};
+
+	// the global epoch starts from 1 because 0 means that the thread is not in a critical section
+	static std::atomic<uint64_t> EPOCH_GLOBAL = 1;
+	static std::atomic<Epoch_Thread*> EPOCH_THREADS = nullptr;
+	static std::atomic<Epoch_Orphans*> EPOCH_ORPHANS = nullptr;
+
+	struct Epoch_Local
+	{
+		Epoch_Thread* record;
+		size_t depth;
+		// the outermost critical section is the one a fabric worker keeps while it runs a job
+		bool worker;
+		// the worker critical section was left while the job blocks, the depth still counts it
+		bool suspended;
+		Buf<Epoch_Retired> retired;
+
+		~Epoch_Local();
+	};
+
+	thread_local Epoch_Local EPOCH_LOCAL;
+
+	inline static void
+	_epoch_orphans_push(Epoch_Orphans* orphans)
+	{
+		auto head = EPOCH_ORPHANS.load();
+		do
+		{
+			orphans->next = head;
+		} while (EPOCH_ORPHANS.compare_exchange_weak(head, orphans) == false);
+	}
+
+	Epoch_Local::~Epoch_Local()
+	{
+		if (record == nullptr)
+			return;
+
+		if (retired.count > 0)
+		{
+			auto orphans = alloc_from<Epoch_Orphans>(memory::clib());
+			orphans->retired = retired;
+			orphans->next = nullptr;
+			_epoch_orphans_push(orphans);
+		}
+		else
+		{
+			buf_free(retired);
+		}
+		retired = Buf<Epoch_Retired>{};
+
+		record->epoch.store(0);
+		record->in_use.store(false);
+		record = nullptr;
+	}
+
+	inline static Epoch_Thread*
+	_epoch_thread_register()
+	{
+		// reuse the record of an exited thread if there's one
+		for (auto it = EPOCH_THREADS.load(); it; it = it->next)
+		{
+			auto in_use = false;
+			if (it->in_use.load() == false && it->in_use.compare_exchange_strong(in_use, true))
+				return it;
+		}
+
+		auto self = alloc_from<Epoch_Thread>(memory::clib());
+		self->epoch.store(0);
+		self->in_use.store(true);
+		auto head = EPOCH_THREADS.load();
+		do
+		{
+			self->next = head;
+		} while (EPOCH_THREADS.compare_exchange_weak(head, self) == false);
+		return self;
+	}
+
+	inline static Epoch_Local&
+	_epoch_local()
+	{
+		auto& self = EPOCH_LOCAL;
+		if (self.record == nullptr)
+		{
+			self.record = _epoch_thread_register();
+			self.retired = buf_with_allocator<Epoch_Retired>(memory::clib());
+		}
+		return self;
+	}
+
+	// advances the global epoch if all the threads in a critical section have observed it
+	inline static uint64_t
+	_epoch_try_advance()
+	{
+		auto epoch = EPOCH_GLOBAL.load();
+		for (auto it = EPOCH_THREADS.load(); it; it = it->next)
+		{
+			auto thread_epoch = it->epoch.load();
+			if (thread_epoch != 0 && thread_epoch != epoch)
+				return epoch;
+		}
+
+		if (EPOCH_GLOBAL.compare_exchange_strong(epoch, epoch + 1))
+			return epoch + 1;
+		return epoch;
+	}
+
+	// frees the pointers which were retired 2 epochs before the given one, the retired pointers are sorted by epoch
+	inline static void
+	_epoch_retired_free(Buf<Epoch_Retired>& retired, uint64_t epoch)
+	{
+		size_t count = 0;
+		while (count < retired.count && retired[count].epoch + 2 <= epoch)
+			++count;
+
+		if (count == 0)
+			return;
+
+		// the pointers are removed before their functions are called because they might retire other pointers
+		auto safe = buf_with_allocator<Epoch_Retired>(memory::clib());
+		mn_defer{buf_free(safe);};
+		for (size_t i = 0; i < count; ++i)
+			buf_push(safe, retired[i]);
+		for (size_t i = count; i < retired.count; ++i)
+			retired[i - count] = retired[i];
+		buf_resize(retired, retired.count - count);
+
+		for (const auto& it: safe)
+			it.fn(it.ptr, it.allocator);
+	}
+
+	inline static void
+	_epoch_orphans_collect(uint64_t epoch)
+	{
+		if (EPOCH_ORPHANS.load() == nullptr)
+			return;
+
+		auto orphans = EPOCH_ORPHANS.exchange(nullptr);
+		while (orphans)
+		{
+			auto next = orphans->next;
+			_epoch_retired_free(orphans->retired, epoch);
+			if (orphans->retired.count > 0)
+			{
+				_epoch_orphans_push(orphans);
+			}
+			else
+			{
+				buf_free(orphans->retired);
+				free_from(memory::clib(), orphans);
+			}
+			orphans = next;
+		}
+	}
+
+	inline static void
+	_epoch_publish(Epoch_Local& self)
+	{
+		// the store should be visible before any of the shared pointers are read
+		self.record->epoch.store(EPOCH_GLOBAL.load());
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	// API
+	void
+	epoch_enter()
+	{
+		auto& self = _epoch_local();
+		if (self.depth++ > 0 && self.suspended == false)
+			return;
+
+		// a job which enters its own critical section while its worker critical section is suspended needs it
+		self.suspended = false;
+		_epoch_publish(self);
+	}
+
+	void
+	epoch_leave()
+	{
+		auto& self = EPOCH_LOCAL;
+		mn_assert_msg(self.depth > 0, "epoch_leave is called without a matching epoch_enter");
+		if (--self.depth > 0)
+			return;
+
+		self.suspended = false;
+		self.record->epoch.store(0, std::memory_order_release);
+		if (self.retired.count >= EPOCH_COLLECT_THRESHOLD)
+			epoch_collect();
+	}
+
+	bool
+	epoch_active()
+	{
+		return EPOCH_LOCAL.depth > 0;
+	}
+
+	void
+	epoch_defer(void (*fn)(void* ptr, Allocator allocator), void* ptr, Allocator allocator)
+	{
+		auto& self = _epoch_local();
+		// the pointer is unlinked before it's retired, so readers which enter after this epoch can't reach it
+		buf_push(self.retired, Epoch_Retired{fn, ptr, allocator, EPOCH_GLOBAL.load()});
+
+		if (self.depth == 0 && self.retired.count >= EPOCH_COLLECT_THRESHOLD)
+			epoch_collect();
+	}
+
+	void
+	epoch_collect()
+	{
+		auto& self = _epoch_local();
+		auto epoch = _epoch_try_advance();
+		_epoch_retired_free(self.retired, epoch);
+		_epoch_orphans_collect(epoch);
+	}
+
+	void
+	epoch_synchronize()
+	{
+		auto& self = _epoch_local();
+		// jobs can synchronize, their worker critical section is left while we wait, but waiting inside any other
+		// critical section would wait for ourselves forever
+		auto worker_suspended = _epoch_worker_suspend();
+		mn_defer{
+			if (worker_suspended)
+				_epoch_worker_resume();
+		};
+		if (self.depth > 0 && self.suspended == false)
+			panic("epoch_synchronize is called from inside a critical section");
+
+		// once the epoch advances twice all the readers which were inside a critical section have left it
+		auto target = EPOCH_GLOBAL.load() + 2;
+		while (true)
+		{
+			auto epoch = _epoch_try_advance();
+			if (epoch >= target)
+				break;
+			thread_sleep(0);
+		}
+		epoch_collect();
+	}
+
+	void
+	_epoch_worker_enter()
+	{
+		auto& self = _epoch_local();
+		mn_assert_msg(self.depth == 0, "fabric worker enters a job while it's inside a critical section");
+		epoch_enter();
+		self.worker = true;
+	}
+
+	void
+	_epoch_worker_leave()
+	{
+		auto& self = EPOCH_LOCAL;
+		mn_assert_msg(self.worker && self.depth == 1, "fabric job didn't leave the critical sections it entered");
+		self.worker = false;
+		epoch_leave();
+	}
+
+	bool
+	_epoch_worker_suspend()
+	{
+		auto& self = EPOCH_LOCAL;
+		if (self.worker == false || self.depth != 1 || self.suspended)
+			return false;
+
+		self.suspended = true;
+		self.record->epoch.store(0, std::memory_order_release);
+		return true;
+	}
+
+	void
+	_epoch_worker_resume()
+	{
+		auto& self = EPOCH_LOCAL;
+		if (self.suspended == false)
+			return;
+
+		self.suspended = false;
+		_epoch_publish(self);
+	}
+
+	_Epoch_Parked
+	_epoch_fiber_park()
+	{
+		auto& self = EPOCH_LOCAL;
+		if (self.worker == false || self.depth <= 1)
+			return _Epoch_Parked{};
+
+		// the fiber entered its own critical section so the worker one isn't suspended
+		mn_assert(self.suspended == false);
+		auto record = _epoch_thread_register();
+		record->epoch.store(self.record->epoch.load());
+		_Epoch_Parked res{record, self.depth - 1};
+		self.depth = 1;
+		return res;
+	}
+
+	void
+	_epoch_fiber_resume(_Epoch_Parked& parked)
+	{
+		if (parked.record == nullptr)
+			return;
+
+		auto& self = _epoch_local();
+		mn_assert_msg(self.worker && self.depth == 1 && self.suspended == false, "fiber is resumed outside of a fabric job");
+
+		// the global epoch can't move more than one epoch past the parked one, and publishing the older epoch keeps
+		// the memory the fiber read before it parked from being freed
+		auto epoch = parked.record->epoch.load();
+		if (epoch < self.record->epoch.load())
+			self.record->epoch.store(epoch);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		self.depth += parked.depth;
+
+		parked.record->epoch.store(0);
+		parked.record->in_use.store(false);
+		parked = _Epoch_Parked{};
+	}
+}
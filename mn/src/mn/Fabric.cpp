@@ -1,18 +1,505 @@
 #include "mn/Fabric.h"
+#include "mn/Epoch.h"
 #include "mn/Memory.h"
 #include "mn/Pool.h"
 #include "mn/Buf.h"
 #include "mn/Log.h"
+#include "mn/Numa.h"
+#include "mn/Handle_Table.h"
+#include "mn/Tracer.h"
 #include "mn/Assert.h"
 
 #include <atomic>
 #include <chrono>
 #include <thread>
 
+#if MN_COMPILER_MSVC
+#include <intrin.h>
+#endif
+
 namespace mn
 {
 	constexpr static auto DEFAULT_COOP_BLOCKING_THRESHOLD = 10;
 	constexpr static auto DEFAULT_EXTR_BLOCKING_THRESHOLD = 1000;
+	constexpr static size_t DEFAULT_TMP_RETAIN_SIZE = 4ULL * 1024ULL * 1024ULL;
+	constexpr static uint32_t DEFAULT_TMP_DECAY = 1000;
+	constexpr static size_t CACHE_LINE_SIZE = 64;
+	constexpr static size_t DEFAULT_FIBER_STACK_SIZE = 64ULL * 1024ULL;
+	// maximum number of finished fibers each worker keeps for reuse
+	constexpr static size_t FIBER_CACHE_LIMIT = 64;
+	constexpr static size_t FIBER_TMP_BLOCK_SIZE = 64ULL * 1024ULL;
+	// small blocks (coroutine frames, future states, and future continuations) are pooled in power of two size classes
+	// starting from this size, bigger blocks use the c allocator directly
+	constexpr static size_t SMALL_BLOCK_MIN_SIZE = 64;
+	constexpr static size_t SMALL_BLOCK_CLASS_COUNT = 8;
+	// maximum number of free small blocks each worker keeps per size class
+	constexpr static size_t SMALL_BLOCK_CACHE_LIMIT = 256;
+	constexpr static uint32_t DEFAULT_NORMAL_LATENCY_BUDGET = 10;
+	constexpr static uint32_t DEFAULT_BACKGROUND_LATENCY_BUDGET = 100;
+	// number of jobs each worker runs before it reports its queue stats to the fabric, workers report them whenever
+	// they go idle as well
+	constexpr static size_t QUEUE_STATS_REPORT_JOBS_COUNT = 64;
+	// the timer wheel has 4 levels of 64 slots, level l slots span 64^l milliseconds so the wheel covers ~4.6 hours,
+	// timers beyond that are placed again each time they're cascaded from the last level
+	constexpr static size_t TIMER_WHEEL_LEVELS = 4;
+	constexpr static size_t TIMER_WHEEL_SLOT_BITS = 6;
+	constexpr static size_t TIMER_WHEEL_SLOTS = size_t(1) << TIMER_WHEEL_SLOT_BITS;
+	constexpr static uint32_t TIMER_NULL = UINT32_MAX;
+	// timers are coalesced by rounding their expiry time up to a power of 2 which is at most 1/32 of their delay
+	constexpr static uint32_t TIMER_SLACK_SHIFT = 5;
+
+	// fibers can be resumed on a different thread, so the code which reads thread locals around a fiber switch
+	// should do it through a function which isn't inlined, otherwise the compiler might reuse the thread local
+	// address it computed before the switch
+	#if MN_COMPILER_MSVC
+		#define MN_FIBER_NOINLINE __declspec(noinline)
+	#else
+		#define MN_FIBER_NOINLINE __attribute__((noinline))
+	#endif
+
+	// an atomic which occupies a whole cache line so that the threads updating it don't false share with the data
+	// which follows it, consecutive padded atomics always land in different cache lines regardless of the alignment
+	// of the allocation which contains them
+	template<typename T>
+	struct Padded_Atomic: std::atomic<T>
+	{
+		using std::atomic<T>::operator=;
+		char padding[CACHE_LINE_SIZE - sizeof(std::atomic<T>)];
+	};
+
+	// cpus and numa node assigned to a worker index within a fabric
+	struct Fabric_Worker_Placement
+	{
+		bool pinned;
+		Cpu_Set cpus;
+		// index of the numa node, workers on the same node steal from each other first
+		size_t node;
+	};
+
+	inline static uint64_t
+	_fabric_time_in_us()
+	{
+		auto now = std::chrono::steady_clock::now().time_since_epoch();
+		return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+	}
+
+	// a queued job along with its scheduling info
+	struct Worker_Job
+	{
+		Fabric_Task task;
+		uint64_t queue_time_in_us;
+		// jobs run in the order of their due times, it's the deadline of the task if it has one, otherwise it's the
+		// queue time plus the latency budget of its priority
+		uint64_t due_time_in_us;
+		// breaks the ties between the jobs with the same due time so they run in the order they were queued
+		uint64_t seq;
+	};
+
+	// the job queue of a worker, each priority has its own min heap of jobs ordered by due time, jobs are stolen from
+	// the end of the heaps which keeps them valid
+	struct Worker_Queue
+	{
+		Buf<Worker_Job> heaps[FABRIC_PRIORITY_COUNT];
+		size_t count;
+		uint64_t seq;
+	};
+
+	inline static Worker_Queue
+	_worker_queue_new()
+	{
+		Worker_Queue self{};
+		for (auto& heap: self.heaps)
+			heap = buf_new<Worker_Job>();
+		return self;
+	}
+
+	inline static void
+	_worker_queue_free(Worker_Queue& self)
+	{
+		for (auto& heap: self.heaps)
+		{
+			for (auto& job: heap)
+				fabric_task_free(job.task);
+			buf_free(heap);
+		}
+		self.count = 0;
+	}
+
+	inline static bool
+	_worker_job_less(const Worker_Job& a, const Worker_Job& b)
+	{
+		if (a.due_time_in_us != b.due_time_in_us)
+			return a.due_time_in_us < b.due_time_in_us;
+		return a.seq < b.seq;
+	}
+
+	inline static void
+	_worker_queue_push_job(Worker_Queue& self, const Worker_Job& job)
+	{
+		auto& heap = self.heaps[job.task.priority];
+		buf_push(heap, job);
+		for (size_t i = heap.count - 1; i > 0;)
+		{
+			auto parent = (i - 1) / 2;
+			if (_worker_job_less(heap[i], heap[parent]) == false)
+				break;
+			std::swap(heap[i], heap[parent]);
+			i = parent;
+		}
+		++self.count;
+	}
+
+	inline static void
+	_worker_queue_push(Worker_Queue& self, const Fabric_Task& task, uint64_t now_in_us, const Fabric_Settings* settings)
+	{
+		Worker_Job job{};
+		job.task = task;
+		if (job.task.priority >= FABRIC_PRIORITY_COUNT)
+			job.task.priority = FABRIC_PRIORITY_NORMAL;
+		job.queue_time_in_us = now_in_us;
+		job.seq = self.seq++;
+
+		uint64_t budget_in_ms = 0;
+		if (job.task.deadline_in_ms != 0)
+			budget_in_ms = job.task.deadline_in_ms;
+		else if (job.task.priority == FABRIC_PRIORITY_NORMAL)
+			budget_in_ms = settings ? settings->normal_latency_budget_in_ms : DEFAULT_NORMAL_LATENCY_BUDGET;
+		else if (job.task.priority == FABRIC_PRIORITY_BACKGROUND)
+			budget_in_ms = settings ? settings->background_latency_budget_in_ms : DEFAULT_BACKGROUND_LATENCY_BUDGET;
+		job.due_time_in_us = now_in_us + budget_in_ms * 1000;
+
+		_worker_queue_push_job(self, job);
+	}
+
+	// pops the job which is due first across all the priorities
+	inline static bool
+	_worker_queue_pop(Worker_Queue& self, Worker_Job& job)
+	{
+		Buf<Worker_Job>* heap = nullptr;
+		for (auto& it: self.heaps)
+			if (it.count > 0 && (heap == nullptr || _worker_job_less(it[0], (*heap)[0])))
+				heap = &it;
+
+		if (heap == nullptr)
+			return false;
+
+		job = (*heap)[0];
+		(*heap)[0] = buf_top(*heap);
+		buf_pop(*heap);
+		for (size_t i = 0;;)
+		{
+			auto smallest = i;
+			auto left = 2 * i + 1;
+			auto right = left + 1;
+			if (left < heap->count && _worker_job_less((*heap)[left], (*heap)[smallest]))
+				smallest = left;
+			if (right < heap->count && _worker_job_less((*heap)[right], (*heap)[smallest]))
+				smallest = right;
+			if (smallest == i)
+				break;
+			std::swap((*heap)[i], (*heap)[smallest]);
+			i = smallest;
+		}
+		--self.count;
+		return true;
+	}
+
+	// pops a job from the end of the biggest heap, it's used to steal jobs
+	inline static bool
+	_worker_queue_pop_back(Worker_Queue& self, Worker_Job& job)
+	{
+		Buf<Worker_Job>* heap = nullptr;
+		for (auto& it: self.heaps)
+			if (it.count > 0 && (heap == nullptr || it.count > heap->count))
+				heap = &it;
+
+		if (heap == nullptr)
+			return false;
+
+		job = buf_top(*heap);
+		buf_pop(*heap);
+		--self.count;
+		return true;
+	}
+
+	// queue stats of a priority class which are updated by the workers, the worker counters are reported in batches
+	struct Fabric_Atomic_Priority_Stats
+	{
+		std::atomic<size_t> tasks_count;
+		std::atomic<uint64_t> total_latency_in_us;
+		std::atomic<uint64_t> max_latency_in_us;
+		std::atomic<size_t> missed_deadlines_count;
+		std::atomic<size_t> latency_histogram[FABRIC_LATENCY_BUCKETS_COUNT];
+	};
+
+	// the function of a periodic timer, it's shared by the timer and its calls which are still queued or running
+	struct Fabric_Timer_Fn
+	{
+		Task<void()> task;
+		std::atomic<int32_t> atomic_arc;
+	};
+
+	inline static void
+	_fabric_timer_fn_unref(Fabric_Timer_Fn* self)
+	{
+		if (self->atomic_arc.fetch_sub(1) == 1)
+		{
+			task_free(self->task);
+			free(self);
+		}
+	}
+
+	// a call of a periodic timer function, it keeps the function alive until the task of the call is freed
+	struct Fabric_Timer_Call
+	{
+		Fabric_Timer_Fn* fn;
+
+		Fabric_Timer_Call(Fabric_Timer_Fn* f)
+			:fn(f)
+		{
+			fn->atomic_arc.fetch_add(1);
+		}
+
+		Fabric_Timer_Call(Fabric_Timer_Call&& other)
+			:fn(other.fn)
+		{
+			other.fn = nullptr;
+		}
+
+		Fabric_Timer_Call(const Fabric_Timer_Call&) = delete;
+
+		~Fabric_Timer_Call()
+		{
+			if (fn)
+				_fabric_timer_fn_unref(fn);
+		}
+
+		void
+		operator()()
+		{
+			fn->task();
+		}
+	};
+
+	struct Fabric_Timer_Node
+	{
+		// it's bumped each time the node is freed so the handles of the old timers become invalid
+		uint32_t generation;
+		// the index of the wheel slot the timer is in, TIMER_NULL if the node is free
+		uint32_t slot;
+		// links of the slot list, free nodes use next for the free list
+		uint32_t prev;
+		uint32_t next;
+		uint64_t expires_in_ms;
+		uint32_t period_in_ms;
+		// the task of oneshot timers, periodic timers use it as a template for the task of each call
+		Fabric_Task task;
+		Fabric_Timer_Fn* fn;
+	};
+
+	// hierarchical timer wheel, timers are placed in the lowest level which covers their expiry time and they're
+	// moved (cascaded) to the lower levels as the time advances, each slot is a doubly linked list of nodes so timers
+	// are inserted and cancelled in O(1)
+	struct Fabric_Timer_Wheel
+	{
+		Buf<Fabric_Timer_Node> nodes;
+		uint32_t free_head;
+		uint32_t slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+		// bitmap of the non empty slots of each level
+		uint64_t occupied[TIMER_WHEEL_LEVELS];
+		// the time the wheel advanced to, all the timers which expire up to it are dispatched
+		uint64_t current_in_ms;
+		size_t count;
+	};
+
+	inline static size_t
+	_timer_wheel_find_first_set(uint64_t v)
+	{
+	#if MN_COMPILER_MSVC
+		unsigned long index = 0;
+		_BitScanForward64(&index, v);
+		return index;
+	#else
+		return (size_t)__builtin_ctzll(v);
+	#endif
+	}
+
+	inline static Fabric_Timer_Wheel
+	_timer_wheel_new(uint64_t now_in_ms)
+	{
+		Fabric_Timer_Wheel self{};
+		self.nodes = buf_new<Fabric_Timer_Node>();
+		self.free_head = TIMER_NULL;
+		for (auto& slot: self.slots)
+			slot = TIMER_NULL;
+		self.current_in_ms = now_in_ms;
+		return self;
+	}
+
+	inline static void
+	_timer_wheel_node_free(Fabric_Timer_Wheel& self, uint32_t index)
+	{
+		auto& node = self.nodes[index];
+		// generation 0 is skipped so that zero initialized handles are never valid
+		if (++node.generation == 0)
+			node.generation = 1;
+		node.slot = TIMER_NULL;
+		node.prev = TIMER_NULL;
+		node.next = self.free_head;
+		node.task = Fabric_Task{};
+		node.fn = nullptr;
+		self.free_head = index;
+		--self.count;
+	}
+
+	inline static void
+	_timer_wheel_free(Fabric_Timer_Wheel& self)
+	{
+		for (auto& node: self.nodes)
+		{
+			if (node.slot == TIMER_NULL)
+				continue;
+			fabric_task_free(node.task);
+			if (node.fn)
+				_fabric_timer_fn_unref(node.fn);
+		}
+		buf_free(self.nodes);
+	}
+
+	// links the given node into the slot which covers its expiry time
+	inline static void
+	_timer_wheel_link(Fabric_Timer_Wheel& self, uint32_t index)
+	{
+		auto& node = self.nodes[index];
+		auto expires = node.expires_in_ms;
+		auto delta = expires > self.current_in_ms ? expires - self.current_in_ms : 0;
+
+		size_t level = 0;
+		while (level + 1 < TIMER_WHEEL_LEVELS && delta >= (uint64_t(1) << ((level + 1) * TIMER_WHEEL_SLOT_BITS)))
+			++level;
+
+		constexpr auto range = uint64_t(1) << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS);
+		if (delta >= range)
+			expires = self.current_in_ms + range - 1;
+		else if (delta == 0)
+			expires = self.current_in_ms;
+
+		auto slot_index = (expires >> (level * TIMER_WHEEL_SLOT_BITS)) & (TIMER_WHEEL_SLOTS - 1);
+		auto slot = uint32_t(level * TIMER_WHEEL_SLOTS + slot_index);
+		node.slot = slot;
+		node.prev = TIMER_NULL;
+		node.next = self.slots[slot];
+		if (node.next != TIMER_NULL)
+			self.nodes[node.next].prev = index;
+		self.slots[slot] = index;
+		self.occupied[level] |= uint64_t(1) << slot_index;
+	}
+
+	inline static void
+	_timer_wheel_unlink(Fabric_Timer_Wheel& self, uint32_t index)
+	{
+		auto& node = self.nodes[index];
+		if (node.prev != TIMER_NULL)
+			self.nodes[node.prev].next = node.next;
+		else
+			self.slots[node.slot] = node.next;
+		if (node.next != TIMER_NULL)
+			self.nodes[node.next].prev = node.prev;
+
+		if (self.slots[node.slot] == TIMER_NULL)
+			self.occupied[node.slot / TIMER_WHEEL_SLOTS] &= ~(uint64_t(1) << (node.slot % TIMER_WHEEL_SLOTS));
+		node.prev = TIMER_NULL;
+		node.next = TIMER_NULL;
+	}
+
+	// detaches the list of the given slot and returns its head
+	inline static uint32_t
+	_timer_wheel_slot_take(Fabric_Timer_Wheel& self, size_t level, size_t slot_index)
+	{
+		auto slot = level * TIMER_WHEEL_SLOTS + slot_index;
+		auto res = self.slots[slot];
+		self.slots[slot] = TIMER_NULL;
+		self.occupied[level] &= ~(uint64_t(1) << slot_index);
+		return res;
+	}
+
+	// advances the wheel to the given time and pushes the expired timers to the given buffer, the expired nodes are
+	// still allocated
+	inline static void
+	_timer_wheel_advance(Fabric_Timer_Wheel& self, uint64_t now_in_ms, Buf<uint32_t>& expired)
+	{
+		while (self.current_in_ms < now_in_ms)
+		{
+			// skip to the next cascade if there's nothing to expire before it
+			if (self.occupied[0] == 0)
+			{
+				auto next_cascade = (self.current_in_ms | (TIMER_WHEEL_SLOTS - 1)) + 1;
+				if (next_cascade > now_in_ms)
+				{
+					self.current_in_ms = now_in_ms;
+					break;
+				}
+				self.current_in_ms = next_cascade - 1;
+			}
+
+			auto tick = ++self.current_in_ms;
+
+			// the higher levels are cascaded first because their timers might land in the lower levels slots which
+			// are cascaded at the same tick
+			for (size_t level = TIMER_WHEEL_LEVELS - 1; level > 0; --level)
+			{
+				auto shift = level * TIMER_WHEEL_SLOT_BITS;
+				if ((tick & ((uint64_t(1) << shift) - 1)) != 0)
+					continue;
+
+				auto it = _timer_wheel_slot_take(self, level, (tick >> shift) & (TIMER_WHEEL_SLOTS - 1));
+				while (it != TIMER_NULL)
+				{
+					auto next = self.nodes[it].next;
+					_timer_wheel_link(self, it);
+					it = next;
+				}
+			}
+
+			auto it = _timer_wheel_slot_take(self, 0, tick & (TIMER_WHEEL_SLOTS - 1));
+			while (it != TIMER_NULL)
+			{
+				auto& node = self.nodes[it];
+				auto next = node.next;
+				node.prev = TIMER_NULL;
+				node.next = TIMER_NULL;
+				buf_push(expired, it);
+				it = next;
+			}
+		}
+	}
+
+	// returns the next time the wheel has timers to expire or cascade, UINT64_MAX if it's empty
+	inline static uint64_t
+	_timer_wheel_next_deadline(const Fabric_Timer_Wheel& self)
+	{
+		if (self.count == 0)
+			return UINT64_MAX;
+
+		auto res = UINT64_MAX;
+		for (size_t level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+		{
+			auto occupied = self.occupied[level];
+			if (occupied == 0)
+				continue;
+
+			// rotate the bitmap so that the slot after the current one is the first bit
+			auto shift = level * TIMER_WHEEL_SLOT_BITS;
+			auto current_index = (self.current_in_ms >> shift) & (TIMER_WHEEL_SLOTS - 1);
+			auto rotation = (current_index + 1) & (TIMER_WHEEL_SLOTS - 1);
+			auto rotated = rotation == 0 ? occupied : (occupied >> rotation) | (occupied << (TIMER_WHEEL_SLOTS - rotation));
+			auto distance = _timer_wheel_find_first_set(rotated) + 1;
+			auto deadline = ((self.current_in_ms >> shift) + distance) << shift;
+			if (deadline < res)
+				res = deadline;
+		}
+		return res;
+	}
 
 	// Worker
 	struct IWorker
@@ -29,18 +516,95 @@ namespace mn
 		Mutex mtx;
 		Cond_Var cv;
 		Fabric fabric;
-		Ring<Fabric_Task> job_q;
+		Worker_Queue job_q;
 		Thread thread;
 		// index within a fabric
 		size_t fabric_index;
-		std::atomic<Fabric_Task::KIND> atomic_current_job_kind;
-		std::atomic<uint64_t> atomic_job_start_time_in_ms;
-		std::atomic<uint64_t> atomic_block_start_time_in_ms;
-		std::atomic<STATE> atomic_state;
-		std::atomic<bool> atomic_disable_block_timing;
+		// the state published to sysmon, each atomic has its own cache line so that sysmon scanning them doesn't
+		// contend with the worker updating the others
+		char published_padding[CACHE_LINE_SIZE];
+		Padded_Atomic<Fabric_Task::KIND> atomic_current_job_kind;
+		Padded_Atomic<uint64_t> atomic_job_start_time_in_ms;
+		Padded_Atomic<uint64_t> atomic_block_start_time_in_ms;
+		// number of times the worker blocked, sysmon keeps watching the worker as long as it's changing
+		Padded_Atomic<uint64_t> atomic_block_count;
+		Padded_Atomic<STATE> atomic_state;
+		Padded_Atomic<bool> atomic_disable_block_timing;
+		// last time a job needed tmp memory above the retain size, 0 if the tmp memory is within the retain size
+		uint64_t tmp_excess_time_in_ms;
+		// tmp arena counters which were already reported to the fabric
+		size_t tmp_reported_release_count;
+		size_t tmp_reported_release_mem;
+		size_t tmp_reported_total_mem;
+		// the fabric index the worker is currently pinned to, SIZE_MAX if it's not pinned
+		size_t placement_index;
+		// the worker thread execution state while it's running a fiber
+		Fiber_Context fiber_scheduler;
+		bool fiber_scheduler_ready;
+		// finished fibers which are reused by the next fiber tasks
+		Buf<Fiber> fiber_cache;
+		// free small blocks of each size class which are reused by the next coroutines and futures
+		Buf<void*> small_blocks[SMALL_BLOCK_CLASS_COUNT];
+		// queue stats which weren't reported to the fabric yet
+		Fabric_Queue_Stats queue_stats;
+		size_t queue_stats_jobs_count;
 	};
 	thread_local Worker LOCAL_WORKER = nullptr;
 
+	// Fiber
+	struct IFiber
+	{
+		enum STATE
+		{
+			// the fiber is running or queued to run
+			STATE_RUNNING,
+			// the fiber switched out and waits for fiber_ready
+			STATE_PARKED,
+			// fiber_ready was called before the fiber switched out, so it should be resumed right away
+			STATE_WAKE_PENDING,
+		};
+
+		Fiber_Context exec_context;
+		// allocators stack and tmp allocator of the fiber
+		Context* context;
+		Task<void()> task;
+		// the worker which is currently running the fiber
+		Worker worker;
+		// the fiber is resumed on the worker of this index in its fabric, fibers of workers without a fabric are
+		// resumed on the same worker
+		Fabric fabric;
+		size_t fabric_index;
+		// the priority of the task which started the fiber, it's resumed with the same priority
+		FABRIC_PRIORITY priority;
+		std::atomic<STATE> atomic_state;
+		bool yield;
+		bool done;
+		// next fiber in the wait list the fiber is waiting in
+		Fiber next_waiter;
+		// the epoch critical sections the fiber entered before it switched out
+		_Epoch_Parked epoch;
+	};
+	thread_local Fiber LOCAL_FIBER = nullptr;
+
+	// the mutex and condition variable chan_select waits on, they're created on the first select which has to wait
+	// and live as long as the thread
+	struct Chan_Select_Local
+	{
+		Mutex mtx;
+		Cond_Var cv;
+
+		~Chan_Select_Local();
+	};
+	thread_local Chan_Select_Local CHAN_SELECT_LOCAL;
+
+	Chan_Select_Local::~Chan_Select_Local()
+	{
+		if (mtx)
+			mutex_free(mtx);
+		if (cv)
+			cond_var_free(cv);
+	}
+
 	struct IFabric
 	{
 		Fabric_Settings settings;
@@ -50,123 +614,612 @@ namespace mn
 		Buf<Worker> workers;
 		Buf<Worker> sleepy_side_workers;
 		Buf<Worker> ready_side_workers;
+		// placement of each worker index, side workers inherit the placement of the index they take over
+		Buf<Fabric_Worker_Placement> placements;
 
 		Mutex mtx;
-		Cond_Var cv;
-		bool is_running;
-		std::atomic<size_t> atomic_available_jobs;
 		size_t next_worker;
 		size_t worker_id_generator;
+		std::atomic<size_t> atomic_tmp_release_count;
+		std::atomic<size_t> atomic_tmp_release_mem;
+		std::atomic<size_t> atomic_tmp_retained_mem;
+		Fabric_Atomic_Priority_Stats queue_stats[FABRIC_PRIORITY_COUNT];
+
+		// timers are advanced and dispatched by sysmon
+		Mutex timers_mtx;
+		Fabric_Timer_Wheel timers;
+
+		// job queue depth of each worker index, it's updated under the worker mutex whenever the queue changes so that
+		// idle workers and sysmon can find work to steal without locking every worker
+		Padded_Atomic<size_t>* queue_depths;
+
+		// sysmon sleeps on its own mutex which is a leaf lock, so workers can wake it up while holding their mutex
+		Mutex sysmon_mtx;
+		Cond_Var sysmon_cv;
+		bool is_running;
+		char sysmon_padding[CACHE_LINE_SIZE];
+		// the time sysmon will wake up at, UINT64_MAX if it's sleeping until it's signaled, workers which need it
+		// earlier (e.g. a worker which is about to block) lower it and wake it up
+		Padded_Atomic<uint64_t> atomic_sysmon_deadline_in_ms;
+		// set by workers which need sysmon to do work now (e.g. an idle worker while other workers have queued jobs)
+		Padded_Atomic<bool> atomic_sysmon_signal;
 
 		Thread sysmon;
 	};
 
-	static void
-	_worker_main(void* worker)
+	// wakes sysmon up, the notify happens under the sysmon mutex so that it can't miss it
+	inline static void
+	_fabric_sysmon_wake(Fabric self)
 	{
-		auto self = (Worker)worker;
-		LOCAL_WORKER = self;
-
-		if (self->fabric)
-			if (self->fabric->settings.on_worker_start)
-				self->fabric->settings.on_worker_start();
+		// we don't want the sysmon mutex itself to count as a blocking call
+		auto worker = LOCAL_WORKER;
+		bool disable_block_timing = true;
+		if (worker)
+			disable_block_timing = worker->atomic_disable_block_timing.exchange(true);
+
+		mutex_lock(self->sysmon_mtx);
+		cond_var_notify(self->sysmon_cv);
+		mutex_unlock(self->sysmon_mtx);
+
+		if (worker)
+			worker->atomic_disable_block_timing.store(disable_block_timing);
+	}
 
-		while(true)
+	// arms a deadline at which sysmon should check on the fabric, sysmon is only woken up if it was going to sleep
+	// beyond this deadline
+	inline static void
+	_fabric_sysmon_arm(Fabric self, uint64_t deadline_in_ms)
+	{
+		auto armed = self->atomic_sysmon_deadline_in_ms.load();
+		while (deadline_in_ms < armed)
 		{
-			auto state = self->atomic_state.load();
-			if (state == IWorker::STATE_RUNNING)
+			if (self->atomic_sysmon_deadline_in_ms.compare_exchange_weak(armed, deadline_in_ms))
 			{
-				Fabric_Task job{};
-				{
-					mutex_lock(self->mtx);
-					mn_defer{mutex_unlock(self->mtx);};
-
-					if (self->job_q.count == 0)
-					{
-						cond_var_wait(self->cv, self->mtx, [&]{
-							return self->job_q.count > 0 ||
-								self->atomic_state.load() != IWorker::STATE_RUNNING;
-						});
-						state = self->atomic_state.load();
-					}
+				_fabric_sysmon_wake(self);
+				return;
+			}
+		}
+	}
 
-					if (state != IWorker::STATE_RUNNING)
-						continue;
+	// signals sysmon to do a pass now
+	inline static void
+	_fabric_sysmon_signal(Fabric self)
+	{
+		if (self->atomic_sysmon_signal.exchange(true) == false)
+			_fabric_sysmon_wake(self);
+	}
 
-					job = ring_front(self->job_q);
-					ring_pop_front(self->job_q);
-				}
+	// publishes the worker queue depth, it should be called under the worker mutex
+	inline static void
+	_worker_queue_depth_publish(Worker self)
+	{
+		if (self->fabric)
+			self->fabric->queue_depths[self->fabric_index].store(self->job_q.count);
+	}
 
-				self->atomic_job_start_time_in_ms.store(time_in_millis());
-				self->atomic_disable_block_timing = false;
-				self->atomic_current_job_kind.store(job.kind);
-				fabric_task_run(job);
-				self->atomic_disable_block_timing = true;
-				self->atomic_job_start_time_in_ms.store(0);
-				self->atomic_current_job_kind.store(Fabric_Task::KIND_ONESHOT);
-				fabric_task_free(job);
-				memory::tmp()->clear_all();
-				if (self->fabric)
-				{
-					if (self->fabric->settings.after_each_job)
-						self->fabric->settings.after_each_job();
-					self->fabric->atomic_available_jobs.fetch_sub(1);
-				}
-			}
-			else if (state == IWorker::STATE_PAUSED)
-			{
-				mutex_lock(self->mtx);
-				mn_defer{mutex_unlock(self->mtx);};
+	// asks sysmon to steal jobs for this worker if any other worker has queued jobs
+	inline static void
+	_worker_steal_request(Worker self)
+	{
+		auto fabric = self->fabric;
+		if (fabric == nullptr || fabric->atomic_sysmon_signal.load())
+			return;
 
-				if (self->atomic_state.load() == IWorker::STATE_PAUSED)
-				{
-					cond_var_wait(self->cv, self->mtx, [&]{
-						return self->atomic_state.load() != IWorker::STATE_PAUSED;
-					});
-				}
-			}
-			else if (state == IWorker::STATE_STOP_REQUEST)
-			{
-				break;
-			}
-			else
+		for (size_t i = 0; i < fabric->settings.workers_count; ++i)
+		{
+			if (i != self->fabric_index && fabric->queue_depths[i].load() > 0)
 			{
-				mn_unreachable();
+				_fabric_sysmon_signal(fabric);
+				return;
 			}
 		}
-
-		[[maybe_unused]] auto old_state = self->atomic_state.exchange(IWorker::STATE_STOP_ACKNOWLEDGED);
-		mn_assert(old_state == IWorker::STATE_STOP_REQUEST);
-		LOCAL_WORKER = nullptr;
 	}
 
+	// counts the queue latency of the given job which is about to run
 	inline static void
-	_worker_stop(Worker self)
+	_worker_queue_stats_add(Worker self, const Worker_Job& job, uint64_t now_in_us)
 	{
-		mutex_lock(self->mtx);
-		mn_defer{mutex_unlock(self->mtx);};
+		if (self->fabric == nullptr)
+			return;
 
-		self->atomic_state = IWorker::STATE_STOP_REQUEST;
-		cond_var_notify(self->cv);
+		auto latency = now_in_us > job.queue_time_in_us ? now_in_us - job.queue_time_in_us : 0;
+		size_t bucket = 0;
+		while (bucket + 1 < FABRIC_LATENCY_BUCKETS_COUNT && (latency >> (bucket + 1)) > 0)
+			++bucket;
+
+		auto& stats = self->queue_stats.priorities[job.task.priority];
+		++stats.tasks_count;
+		stats.total_latency_in_us += latency;
+		if (latency > stats.max_latency_in_us)
+			stats.max_latency_in_us = latency;
+		if (job.task.deadline_in_ms != 0 && now_in_us > job.due_time_in_us)
+			++stats.missed_deadlines_count;
+		++stats.latency_histogram[bucket];
+		++self->queue_stats_jobs_count;
 	}
 
+	// reports the queue stats the worker collected since the last report to its fabric
 	inline static void
-	_worker_pause(Worker self)
+	_worker_queue_stats_report(Worker self)
 	{
-		mutex_lock(self->mtx);
-		mn_defer{mutex_unlock(self->mtx);};
+		if (self->fabric == nullptr || self->queue_stats_jobs_count == 0)
+			return;
 
-		mn_assert(self->atomic_state == IWorker::STATE_RUNNING);
+		for (size_t i = 0; i < FABRIC_PRIORITY_COUNT; ++i)
+		{
+			auto& stats = self->queue_stats.priorities[i];
+			if (stats.tasks_count == 0)
+				continue;
+
+			auto& fabric_stats = self->fabric->queue_stats[i];
+			fabric_stats.tasks_count.fetch_add(stats.tasks_count);
+			fabric_stats.total_latency_in_us.fetch_add(stats.total_latency_in_us);
+			fabric_stats.missed_deadlines_count.fetch_add(stats.missed_deadlines_count);
+			auto max_latency = fabric_stats.max_latency_in_us.load();
+			while (stats.max_latency_in_us > max_latency && fabric_stats.max_latency_in_us.compare_exchange_weak(max_latency, stats.max_latency_in_us) == false)
+			{}
+			for (size_t j = 0; j < FABRIC_LATENCY_BUCKETS_COUNT; ++j)
+				if (stats.latency_histogram[j] > 0)
+					fabric_stats.latency_histogram[j].fetch_add(stats.latency_histogram[j]);
+			stats = Fabric_Priority_Stats{};
+		}
+		self->queue_stats_jobs_count = 0;
+	}
 
-		self->atomic_state = IWorker::STATE_PAUSED;
-		cond_var_notify(self->cv);
+	inline static size_t
+	_worker_tmp_retain_size(Worker self)
+	{
+		if (self->fabric)
+			return self->fabric->settings.tmp_retain_size;
+		return DEFAULT_TMP_RETAIN_SIZE;
 	}
 
+	inline static uint32_t
+	_worker_tmp_decay(Worker self)
+	{
+		if (self->fabric)
+			return self->fabric->settings.tmp_decay_in_ms;
+		return DEFAULT_TMP_DECAY;
+	}
+
+	// pins the worker to the cpus of its fabric index, it's called from the worker thread itself so that memory
+	// touched afterwards is allocated from the local numa node by the os first touch policy
 	inline static void
-	_worker_resume(Worker self)
+	_worker_placement_apply(Worker self)
 	{
-		mutex_lock(self->mtx);
-		mn_defer{mutex_unlock(self->mtx);};
+		if (self->fabric == nullptr || self->placement_index == self->fabric_index)
+			return;
+
+		const auto& placement = self->fabric->placements[self->fabric_index];
+		if (placement.pinned)
+		{
+			if (thread_affinity_set(placement.cpus) == false)
+				log_warning("worker '{}' failed to set its cpu affinity", self->name);
+		}
+		self->placement_index = self->fabric_index;
+	}
+
+	// reports the changes in the worker tmp arena counters to its fabric
+	inline static void
+	_worker_tmp_report(Worker self)
+	{
+		auto tmp = memory::tmp();
+		if (self->fabric)
+		{
+			self->fabric->atomic_tmp_release_count.fetch_add(tmp->release_count - self->tmp_reported_release_count);
+			self->fabric->atomic_tmp_release_mem.fetch_add(tmp->release_mem - self->tmp_reported_release_mem);
+			if (tmp->total_mem >= self->tmp_reported_total_mem)
+				self->fabric->atomic_tmp_retained_mem.fetch_add(tmp->total_mem - self->tmp_reported_total_mem);
+			else
+				self->fabric->atomic_tmp_retained_mem.fetch_sub(self->tmp_reported_total_mem - tmp->total_mem);
+		}
+		self->tmp_reported_release_count = tmp->release_count;
+		self->tmp_reported_release_mem = tmp->release_mem;
+		self->tmp_reported_total_mem = tmp->total_mem;
+	}
+
+	// applies the tmp memory retention policy, the tmp memory above the retain size is returned to the os after it
+	// stays unneeded for the decay duration, this way bursty jobs don't keep returning memory and taking it back
+	inline static void
+	_worker_tmp_decay_apply(Worker self)
+	{
+		auto tmp = memory::tmp();
+		auto now = time_in_millis();
+		// the arena tracks its peak usage since the last clear_all, which workers no longer call, so we use it to
+		// track the peak usage since the last decay check instead
+		auto job_needed_excess = tmp->clear_all_current_highwater > _worker_tmp_retain_size(self);
+		// the worker loop is the outermost user of its tmp arena and runs jobs and callbacks inside tmp scopes, so
+		// anything still allocated here was left by code outside the scopes, we clear it so it doesn't pile up and
+		// keep the chained arena from ever being trimmed
+		if (tmp->used_mem != 0)
+			tmp->clear_all();
+		tmp->clear_all_current_highwater = tmp->used_mem;
+		if (tmp->total_mem <= _worker_tmp_retain_size(self))
+		{
+			self->tmp_excess_time_in_ms = 0;
+		}
+		else if (job_needed_excess || self->tmp_excess_time_in_ms == 0)
+		{
+			self->tmp_excess_time_in_ms = now;
+		}
+		else if (now - self->tmp_excess_time_in_ms >= _worker_tmp_decay(self))
+		{
+			tmp->trim(_worker_tmp_retain_size(self));
+			self->tmp_excess_time_in_ms = 0;
+		}
+		_worker_tmp_report(self);
+	}
+
+	inline static size_t
+	_worker_fiber_stack_size(Worker self)
+	{
+		if (self->fabric)
+			return self->fabric->settings.fiber_stack_size;
+		return DEFAULT_FIBER_STACK_SIZE;
+	}
+
+	static void
+	_fiber_main(void* fiber)
+	{
+		auto self = (Fiber)fiber;
+		// the fiber stack is reused by the next fiber tasks, so the fiber never returns from this function, instead
+		// it switches back to its worker after each task
+		while (true)
+		{
+			self->task();
+			task_free(self->task);
+			self->done = true;
+			_fiber_context_switch(self->exec_context, self->worker->fiber_scheduler);
+		}
+	}
+
+	inline static Fiber
+	_fiber_new(size_t stack_size)
+	{
+		auto self = alloc_zerod<IFiber>();
+		if (_fiber_context_init(self->exec_context, stack_size, _fiber_main, self) == false)
+		{
+			free(self);
+			return nullptr;
+		}
+		self->context = context_new(FIBER_TMP_BLOCK_SIZE);
+		self->atomic_state = IFiber::STATE_RUNNING;
+		return self;
+	}
+
+	inline static void
+	_fiber_free(Fiber self)
+	{
+		_fiber_context_free(self->exec_context);
+		context_delete(self->context);
+		free(self);
+	}
+
+	// schedules a resume task of the given fiber into the worker of its fabric index
+	inline static void
+	_fiber_schedule(Fiber self)
+	{
+		Fabric_Task task{};
+		task.kind = Fabric_Task::KIND_FIBER;
+		task.priority = self->priority;
+		task.as_fiber.fiber = self;
+		fabric_resume_point_task_do(Fabric_Resume_Point{self->fabric, self->fabric_index, self->worker}, task);
+	}
+
+	inline static Fiber
+	_worker_fiber_acquire(Worker self)
+	{
+		if (self->fiber_scheduler_ready == false)
+		{
+			if (_fiber_context_thread_init(self->fiber_scheduler) == false)
+				return nullptr;
+			self->fiber_scheduler_ready = true;
+		}
+
+		if (self->fiber_cache.count > 0)
+		{
+			auto res = buf_top(self->fiber_cache);
+			buf_pop(self->fiber_cache);
+			return res;
+		}
+		return _fiber_new(_worker_fiber_stack_size(self));
+	}
+
+	inline static void
+	_worker_fiber_release(Worker self, Fiber fiber)
+	{
+		// reset the fiber context so the next task starts with a clean allocators stack and tmp allocator
+		fiber->context->_allocator_stack_count = 1;
+		fiber->context->_allocator_tmp.clear_all();
+		fiber->context->_allocator_tmp.trim(FIBER_TMP_BLOCK_SIZE);
+		fiber->done = false;
+		fiber->yield = false;
+		fiber->next_waiter = nullptr;
+		fiber->priority = FABRIC_PRIORITY_NORMAL;
+		fiber->atomic_state = IFiber::STATE_RUNNING;
+
+		if (self->fiber_cache.count < FIBER_CACHE_LIMIT)
+			buf_push(self->fiber_cache, fiber);
+		else
+			_fiber_free(fiber);
+	}
+
+	// runs the given fiber task until it finishes or parks
+	inline static void
+	_worker_fiber_run(Worker self, Fabric_Task& job)
+	{
+		auto fiber = job.as_fiber.fiber;
+		if (fiber == nullptr)
+		{
+			fiber = _worker_fiber_acquire(self);
+			if (fiber == nullptr)
+			{
+				log_warning("worker '{}' failed to create a fiber, running the task on the worker stack", self->name);
+				fabric_task_run(job);
+				return;
+			}
+			fiber->task = job.as_fiber.task;
+			fiber->priority = job.priority;
+			job.as_fiber.task = Task<void()>{};
+		}
+
+		while (true)
+		{
+			fiber->worker = self;
+			fiber->fabric = self->fabric;
+			fiber->fabric_index = self->fabric_index;
+
+			LOCAL_FIBER = fiber;
+			auto worker_context = context_local(fiber->context);
+			_epoch_fiber_resume(fiber->epoch);
+			_fiber_context_switch(self->fiber_scheduler, fiber->exec_context);
+			context_local(worker_context);
+			LOCAL_FIBER = nullptr;
+
+			if (fiber->done)
+			{
+				_worker_fiber_release(self, fiber);
+				return;
+			}
+
+			// the fiber might be resumed on another worker once it's scheduled or parked, so it takes its epoch
+			// critical sections with it
+			fiber->epoch = _epoch_fiber_park();
+
+			if (fiber->yield)
+			{
+				fiber->yield = false;
+				_fiber_schedule(fiber);
+				return;
+			}
+
+			// the fiber is parked unless it was made ready before it switched out, in which case we resume it now
+			auto state = IFiber::STATE_RUNNING;
+			if (fiber->atomic_state.compare_exchange_strong(state, IFiber::STATE_PARKED))
+				return;
+
+			mn_assert(state == IFiber::STATE_WAKE_PENDING);
+			fiber->atomic_state = IFiber::STATE_RUNNING;
+		}
+	}
+
+	inline static void
+	_worker_fiber_cache_free(Worker self)
+	{
+		for (auto fiber: self->fiber_cache)
+			_fiber_free(fiber);
+		buf_free(self->fiber_cache);
+
+		if (self->fiber_scheduler_ready)
+			_fiber_context_thread_free(self->fiber_scheduler);
+		self->fiber_scheduler_ready = false;
+	}
+
+	inline static size_t
+	_small_block_class(size_t size)
+	{
+		size_t res = 0;
+		for (size_t class_size = SMALL_BLOCK_MIN_SIZE; class_size < size; class_size <<= 1)
+			++res;
+		return res;
+	}
+
+	inline static void
+	_worker_small_blocks_free(Worker self)
+	{
+		for (size_t i = 0; i < SMALL_BLOCK_CLASS_COUNT; ++i)
+		{
+			for (auto block: self->small_blocks[i])
+				memory::clib()->free(Block{block, SMALL_BLOCK_MIN_SIZE << i});
+			buf_free(self->small_blocks[i]);
+		}
+	}
+
+	inline static void
+	_fiber_wait_list_lock(Fiber_Wait_List& self)
+	{
+		while (self.locked.exchange(true, std::memory_order_acquire))
+		{
+			while (self.locked.load(std::memory_order_relaxed))
+			{}
+		}
+	}
+
+	inline static void
+	_fiber_wait_list_unlock(Fiber_Wait_List& self)
+	{
+		self.locked.store(false, std::memory_order_release);
+	}
+
+	static void
+	_worker_main(void* worker)
+	{
+		auto self = (Worker)worker;
+		LOCAL_WORKER = self;
+
+		_worker_placement_apply(self);
+		{
+			// allocate the job queue from the worker thread so it's local to the worker numa node
+			mutex_lock(self->mtx);
+			mn_defer{mutex_unlock(self->mtx);};
+			for (auto& heap: self->job_q.heaps)
+				buf_reserve(heap, 64);
+		}
+
+		if (self->fabric && self->fabric->settings.on_worker_start)
+		{
+			memory::Arena_Scope tmp_scope{memory::tmp()};
+			self->fabric->settings.on_worker_start();
+		}
+
+		while(true)
+		{
+			auto state = self->atomic_state.load();
+			if (state == IWorker::STATE_RUNNING)
+			{
+				Worker_Job queued_job{};
+				bool has_job = false;
+				{
+					mutex_lock(self->mtx);
+					mn_defer{mutex_unlock(self->mtx);};
+
+					if (self->job_q.count == 0)
+					{
+						_worker_queue_stats_report(self);
+						_worker_steal_request(self);
+						auto wakeup = [&]{
+							return self->job_q.count > 0 ||
+								self->atomic_state.load() != IWorker::STATE_RUNNING;
+						};
+						// if we're keeping tmp memory above the retain size we wake up after the decay duration
+						// to return it to the os instead of holding it while idle
+						if (self->tmp_excess_time_in_ms != 0)
+							cond_var_wait_timeout(self->cv, self->mtx, _worker_tmp_decay(self), wakeup);
+						else
+							cond_var_wait(self->cv, self->mtx, wakeup);
+						state = self->atomic_state.load();
+					}
+
+					if (state != IWorker::STATE_RUNNING)
+						continue;
+
+					// a side worker might be moved to another index while it was paused
+					_worker_placement_apply(self);
+
+					if (_worker_queue_pop(self->job_q, queued_job))
+					{
+						_worker_queue_depth_publish(self);
+						has_job = true;
+					}
+				}
+
+				if (has_job == false)
+				{
+					_worker_tmp_decay_apply(self);
+					continue;
+				}
+
+				_worker_queue_stats_add(self, queued_job, _fabric_time_in_us());
+				if (self->queue_stats_jobs_count >= QUEUE_STATS_REPORT_JOBS_COUNT)
+					_worker_queue_stats_report(self);
+				auto& job = queued_job.task;
+
+				auto job_start_time = time_in_millis();
+				self->atomic_current_job_kind.store(job.kind);
+				self->atomic_job_start_time_in_ms.store(job_start_time);
+				self->atomic_disable_block_timing = false;
+				// sysmon checks on oneshot and fiber jobs once they exceed the external blocking threshold
+				if (self->fabric && job.kind != Fabric_Task::KIND_COMPUTE)
+					_fabric_sysmon_arm(self->fabric, job_start_time + self->fabric->settings.external_blocking_threshold_in_ms);
+				if (_tracer_fabric())
+					_tracer_job_begin(self->name.ptr);
+				{
+					// jobs, their task destructors, and the after each job callback run inside a scoped tmp region
+					// which frees their tmp allocations when they finish while keeping the memory warm for the next
+					// jobs, fibers have their own tmp allocator which lives as long as the fiber
+					memory::Arena_Scope tmp_scope{memory::tmp()};
+					// jobs run inside an epoch critical section so they can read epoch protected pointers directly,
+					// and leaving it after the job frees the memory they retired once it's safe, it's also left
+					// while the job blocks so that blocking jobs don't stall the reclamation
+					_epoch_worker_enter();
+					if (job.kind == Fabric_Task::KIND_FIBER)
+						_worker_fiber_run(self, job);
+					else
+						fabric_task_run(job);
+					_epoch_worker_leave();
+					if (_tracer_fabric())
+						_tracer_job_end();
+					self->atomic_disable_block_timing = true;
+					self->atomic_job_start_time_in_ms.store(0);
+					self->atomic_current_job_kind.store(Fabric_Task::KIND_ONESHOT);
+					fabric_task_free(job);
+					if (self->fabric && self->fabric->settings.after_each_job)
+						self->fabric->settings.after_each_job();
+				}
+				_worker_tmp_decay_apply(self);
+			}
+			else if (state == IWorker::STATE_PAUSED)
+			{
+				mutex_lock(self->mtx);
+				mn_defer{mutex_unlock(self->mtx);};
+
+				if (self->atomic_state.load() == IWorker::STATE_PAUSED)
+				{
+					cond_var_wait(self->cv, self->mtx, [&]{
+						return self->atomic_state.load() != IWorker::STATE_PAUSED;
+					});
+				}
+			}
+			else if (state == IWorker::STATE_STOP_REQUEST)
+			{
+				break;
+			}
+			else
+			{
+				mn_unreachable();
+			}
+		}
+
+		_worker_fiber_cache_free(self);
+		_worker_small_blocks_free(self);
+		_worker_queue_stats_report(self);
+
+		// the worker tmp memory is freed with the thread so it's no longer retained
+		if (self->fabric)
+			self->fabric->atomic_tmp_retained_mem.fetch_sub(self->tmp_reported_total_mem);
+
+		[[maybe_unused]] auto old_state = self->atomic_state.exchange(IWorker::STATE_STOP_ACKNOWLEDGED);
+		mn_assert(old_state == IWorker::STATE_STOP_REQUEST);
+		LOCAL_WORKER = nullptr;
+	}
+
+	inline static void
+	_worker_stop(Worker self)
+	{
+		mutex_lock(self->mtx);
+		mn_defer{mutex_unlock(self->mtx);};
+
+		self->atomic_state = IWorker::STATE_STOP_REQUEST;
+		cond_var_notify(self->cv);
+	}
+
+	inline static void
+	_worker_pause(Worker self)
+	{
+		mutex_lock(self->mtx);
+		mn_defer{mutex_unlock(self->mtx);};
+
+		mn_assert(self->atomic_state == IWorker::STATE_RUNNING);
+
+		self->atomic_state = IWorker::STATE_PAUSED;
+		cond_var_notify(self->cv);
+	}
+
+	inline static void
+	_worker_resume(Worker self)
+	{
+		mutex_lock(self->mtx);
+		mn_defer{mutex_unlock(self->mtx);};
 
 		mn_assert(self->atomic_state == IWorker::STATE_PAUSED);
 
@@ -175,7 +1228,7 @@ namespace mn
 	}
 
 	inline static Worker
-	_worker_new(Str name, Fabric fabric, size_t fabric_index = 0, Ring<Fabric_Task> stolen_jobs = ring_new<Fabric_Task>())
+	_worker_new(Str name, Fabric fabric, size_t fabric_index = 0, Worker_Queue stolen_jobs = _worker_queue_new())
 	{
 		auto self = alloc_zerod<IWorker>();
 		self->name = name;
@@ -184,6 +1237,10 @@ namespace mn
 		self->fabric = fabric;
 		self->job_q = stolen_jobs;
 		self->fabric_index = fabric_index;
+		self->placement_index = SIZE_MAX;
+		self->fiber_cache = buf_new<Fiber>();
+		for (auto& blocks: self->small_blocks)
+			blocks = buf_new<void*>();
 		self->atomic_state = IWorker::STATE_RUNNING;
 		self->atomic_disable_block_timing = true;
 		self->thread = thread_new(_worker_main, self, self->name.ptr);
@@ -203,7 +1260,7 @@ namespace mn
 		str_free(self->name);
 		mutex_free(self->mtx);
 		cond_var_free(self->cv);
-		destruct(self->job_q);
+		_worker_queue_free(self->job_q);
 
 		free(self);
 	}
@@ -217,7 +1274,7 @@ namespace mn
 		{
 			auto current_job_flags = worker->atomic_current_job_kind.load();
 			auto block_start_time = worker->atomic_block_start_time_in_ms.load();
-			if(block_start_time != 0 && current_job_flags == Fabric_Task::KIND_ONESHOT)
+			if(block_start_time != 0 && current_job_flags != Fabric_Task::KIND_COMPUTE)
 			{
 				auto block_time = time_in_millis() - block_start_time;
 				if(block_time > self->settings.coop_blocking_threshold_in_ms)
@@ -239,15 +1296,18 @@ namespace mn
 		// move the blocking workers out
 		for (auto blocking_worker: blocking_workers)
 		{
-			Ring<Fabric_Task> job_q{};
+			Worker_Queue job_q{};
 			{
 				mutex_lock(blocking_worker->mtx);
 				mn_defer{mutex_unlock(blocking_worker->mtx);};
 
 				job_q = blocking_worker->job_q;
-				blocking_worker->job_q = ring_new<Fabric_Task>();
+				blocking_worker->job_q = _worker_queue_new();
 			}
 
+			if (_tracer_fabric())
+				_tracer_sysmon_decision(self->sysmon_name.ptr, "replace blocking worker", blocking_worker->fabric_index, job_q.count);
+
 			{
 				mutex_lock(self->mtx);
 				mn_defer{mutex_unlock(self->mtx);};
@@ -260,7 +1320,7 @@ namespace mn
 
 					new_worker->fabric_index = blocking_worker->fabric_index;
 					self->workers[blocking_worker->fabric_index] = new_worker;
-					ring_free(new_worker->job_q);
+					_worker_queue_free(new_worker->job_q);
 					new_worker->job_q = job_q;
 
 					_worker_resume(new_worker);
@@ -296,7 +1356,7 @@ namespace mn
 		{
 			auto current_job_flags = worker->atomic_current_job_kind.load();
 			auto job_start_time = worker->atomic_job_start_time_in_ms.load();
-			if (job_start_time != 0 && current_job_flags == Fabric_Task::KIND_ONESHOT)
+			if (job_start_time != 0 && current_job_flags != Fabric_Task::KIND_COMPUTE)
 			{
 				auto job_run_time = time_in_millis() - job_start_time;
 				if(job_run_time > self->settings.external_blocking_threshold_in_ms)
@@ -313,15 +1373,18 @@ namespace mn
 		// move the blocking workers out
 		for (auto blocking_worker: blocking_workers)
 		{
-			Ring<Fabric_Task> job_q{};
+			Worker_Queue job_q{};
 			{
 				mutex_lock(blocking_worker->mtx);
 				mn_defer{mutex_unlock(blocking_worker->mtx);};
 
 				job_q = blocking_worker->job_q;
-				blocking_worker->job_q = ring_new<Fabric_Task>();
+				blocking_worker->job_q = _worker_queue_new();
 			}
 
+			if (_tracer_fabric())
+				_tracer_sysmon_decision(self->sysmon_name.ptr, "replace long running worker", blocking_worker->fabric_index, job_q.count);
+
 			{
 				mutex_lock(self->mtx);
 				mn_defer{mutex_unlock(self->mtx);};
@@ -334,7 +1397,7 @@ namespace mn
 
 					new_worker->fabric_index = blocking_worker->fabric_index;
 					self->workers[blocking_worker->fabric_index] = new_worker;
-					ring_free(new_worker->job_q);
+					_worker_queue_free(new_worker->job_q);
 					new_worker->job_q = job_q;
 
 					_worker_resume(new_worker);
@@ -362,6 +1425,110 @@ namespace mn
 		buf_clear(blocking_workers);
 	}
 
+	// advances the fabric timers and dispatches the expired ones to the workers in a single batch
+	inline static void
+	_fabric_timers_dispatch(Fabric self, Buf<uint32_t>& expired, Buf<Fabric_Task>& tasks)
+	{
+		auto now = time_in_millis();
+		{
+			mutex_lock(self->timers_mtx);
+			mn_defer{mutex_unlock(self->timers_mtx);};
+
+			_timer_wheel_advance(self->timers, now, expired);
+			for (auto index: expired)
+			{
+				auto& node = self->timers.nodes[index];
+				if (node.period_in_ms == 0)
+				{
+					buf_push(tasks, node.task);
+					_timer_wheel_node_free(self->timers, index);
+					continue;
+				}
+
+				auto task = node.task;
+				auto call = Task<void()>::make(Fabric_Timer_Call{node.fn});
+				if (task.kind == Fabric_Task::KIND_FIBER)
+					task.as_fiber.task = call;
+				else
+					task.as_oneshot.task = call;
+				buf_push(tasks, task);
+
+				// periodic timers keep their phase, the calls which were missed while sysmon was late are skipped
+				auto missed = (now - node.expires_in_ms) / node.period_in_ms + 1;
+				node.expires_in_ms += missed * node.period_in_ms;
+				_timer_wheel_link(self->timers, index);
+			}
+			buf_clear(expired);
+		}
+
+		if (tasks.count > 0)
+			fabric_task_batch_do(self, tasks.ptr, tasks.count);
+		buf_clear(tasks);
+	}
+
+	// computes the next time sysmon should check on the workers and publishes it so that workers which need an
+	// earlier check wake it up, returns UINT64_MAX if nothing needs checking
+	inline static uint64_t
+	_sysmon_next_deadline(Fabric self, Buf<uint64_t>& block_counts, uint32_t timeslice, bool poll)
+	{
+		// the published deadline is reset before reading the workers state, this way a worker which arms a deadline
+		// either has its state read here or sees the reset deadline and wakes sysmon up
+		self->atomic_sysmon_deadline_in_ms.store(UINT64_MAX);
+
+		auto now = time_in_millis();
+		uint64_t res = UINT64_MAX;
+		if (poll)
+			res = now + timeslice;
+
+		for (size_t i = 0; i < self->workers.count; ++i)
+		{
+			auto worker = self->workers[i];
+			auto deadline = UINT64_MAX;
+			if (worker->atomic_current_job_kind.load() != Fabric_Task::KIND_COMPUTE)
+			{
+				auto block_start_time = worker->atomic_block_start_time_in_ms.load();
+				if (block_start_time != 0)
+					deadline = block_start_time + self->settings.coop_blocking_threshold_in_ms;
+
+				auto job_start_time = worker->atomic_job_start_time_in_ms.load();
+				if (job_start_time != 0 && job_start_time + self->settings.external_blocking_threshold_in_ms < deadline)
+					deadline = job_start_time + self->settings.external_blocking_threshold_in_ms;
+			}
+
+			// a worker which blocked since the last pass might block again soon, so we keep checking on it instead
+			// of letting every short block wake sysmon up
+			auto block_count = worker->atomic_block_count.load();
+			if (block_count != block_counts[i])
+			{
+				block_counts[i] = block_count;
+				if (now + self->settings.coop_blocking_threshold_in_ms < deadline)
+					deadline = now + self->settings.coop_blocking_threshold_in_ms;
+			}
+
+			// overdue deadlines which sysmon didn't act upon (e.g. too few workers are blocking) are checked again
+			// after a timeslice
+			if (deadline <= now)
+				deadline = now + timeslice;
+
+			if (deadline < res)
+				res = deadline;
+		}
+
+		// timers which are added after the published deadline is reset are either seen here or arm their own deadline
+		{
+			mutex_lock(self->timers_mtx);
+			auto timers_deadline = _timer_wheel_next_deadline(self->timers);
+			mutex_unlock(self->timers_mtx);
+			if (timers_deadline < res)
+				res = timers_deadline;
+		}
+
+		auto armed = UINT64_MAX;
+		while (res < armed && self->atomic_sysmon_deadline_in_ms.compare_exchange_weak(armed, res) == false)
+		{}
+		return res < armed ? res : armed;
+	}
+
 	static void
 	_sysmon_main(void* fabric)
 	{
@@ -380,8 +1547,23 @@ namespace mn
 		auto dead_workers = buf_with_capacity<Worker>(self->workers.count);
 		mn_defer{destruct(dead_workers);};
 
-		auto tmp_jobs = buf_new<Fabric_Task>();
-		mn_defer{destruct(tmp_jobs);};
+		auto tmp_jobs = buf_new<Worker_Job>();
+		mn_defer{buf_free(tmp_jobs);};
+
+		auto jobs_counts = buf_with_capacity<size_t>(self->workers.count);
+		mn_defer{buf_free(jobs_counts);};
+
+		// expired timers and their tasks which are dispatched to the workers
+		auto timers_expired = buf_new<uint32_t>();
+		mn_defer{buf_free(timers_expired);};
+		auto timers_tasks = buf_new<Fabric_Task>();
+		mn_defer{buf_free(timers_tasks);};
+
+		// block counts of the workers as of the last sysmon pass
+		auto block_counts = buf_with_count<uint64_t>(self->workers.count);
+		mn_defer{buf_free(block_counts);};
+		for (auto& count: block_counts)
+			count = 0;
 
 		auto timeslice = self->settings.coop_blocking_threshold_in_ms;
 		if (timeslice > self->settings.external_blocking_threshold_in_ms)
@@ -405,53 +1587,89 @@ namespace mn
 				return true;
 			});
 
-			bool slept_on_cond_var = false;
+			// sysmon only needs to poll (in timeslice steps) while there are side workers to recycle
+			auto deadline = _sysmon_next_deadline(
+				self,
+				block_counts,
+				timeslice,
+				dead_workers.count > 0 || self->sleepy_side_workers.count > 0
+			);
 
 			{
-				mutex_lock(self->mtx);
-				mn_defer{mutex_unlock(self->mtx);};
+				mutex_lock(self->sysmon_mtx);
+				mn_defer{mutex_unlock(self->sysmon_mtx);};
 
-				if (self->atomic_available_jobs.load() == 0 &&
-					self->sleepy_side_workers.count == 0)
+				auto wakeup = [&]{
+					return self->is_running == false ||
+						self->atomic_sysmon_signal.load() ||
+						self->atomic_sysmon_deadline_in_ms.load() < deadline;
+				};
+
+				if (deadline == UINT64_MAX)
 				{
-					slept_on_cond_var = true;
-					cond_var_wait(self->cv, self->mtx, [&]{
-						return self->atomic_available_jobs.load() > 0 ||
-							self->is_running == false ||
-							self->sleepy_side_workers.count > 0;
-					});
+					cond_var_wait(self->sysmon_cv, self->sysmon_mtx, wakeup);
+				}
+				else
+				{
+					auto now = time_in_millis();
+					while (wakeup() == false && now < deadline)
+					{
+						cond_var_wait_timeout(self->sysmon_cv, self->sysmon_mtx, uint32_t(deadline - now));
+						now = time_in_millis();
+					}
 				}
 
 				if (self->is_running == false)
 					return;
 			}
+			self->atomic_sysmon_signal.store(false);
 
-			// SYSMON rest station, sysmon needs to sleep for some time, he does a lot of work, he deserves it
-			if (slept_on_cond_var == false)
-				thread_sleep(timeslice);
+			_fabric_timers_dispatch(self, timers_expired, timers_tasks);
 
-			// get the max/min jobs
-			size_t busiest_worker = 0;
-			size_t max_jobs = 0;
+			// get the min jobs worker and the max jobs worker from the published queue depths, preferring the
+			// busiest worker which shares the same numa node with the idle worker so the stolen jobs stay close to
+			// their data
 			size_t idle_worker = SIZE_MAX;
 			size_t min_jobs = SIZE_MAX;
+			buf_resize(jobs_counts, self->workers.count);
 			for (size_t i = 0; i < self->workers.count; ++i)
 			{
-				auto worker = self->workers[i];
-
-				mutex_lock(worker->mtx);
-				mn_defer{mutex_unlock(worker->mtx);};
+				jobs_counts[i] = self->queue_depths[i].load();
+				if (self->workers[i]->atomic_job_start_time_in_ms.load() == 0 && jobs_counts[i] < min_jobs)
+				{
+					idle_worker = i;
+					min_jobs = jobs_counts[i];
+				}
+			}
 
-				if (worker->job_q.count > max_jobs)
+			size_t busiest_worker = 0;
+			size_t max_jobs = 0;
+			for (size_t i = 0; i < jobs_counts.count; ++i)
+			{
+				if (jobs_counts[i] > max_jobs)
 				{
 					busiest_worker = i;
-					max_jobs = worker->job_q.count;
+					max_jobs = jobs_counts[i];
 				}
+			}
 
-				if (worker->atomic_job_start_time_in_ms.load() == 0 && worker->job_q.count < min_jobs)
+			if (idle_worker < self->workers.count)
+			{
+				size_t local_busiest_worker = 0;
+				size_t local_max_jobs = 0;
+				for (size_t i = 0; i < jobs_counts.count; ++i)
 				{
-					idle_worker = i;
-					min_jobs = worker->job_q.count;
+					if (self->placements[i].node == self->placements[idle_worker].node && jobs_counts[i] > local_max_jobs)
+					{
+						local_busiest_worker = i;
+						local_max_jobs = jobs_counts[i];
+					}
+				}
+
+				if (local_max_jobs > min_jobs)
+				{
+					busiest_worker = local_busiest_worker;
+					max_jobs = local_max_jobs;
 				}
 			}
 
@@ -469,13 +1687,10 @@ namespace mn
 					if (job_steal_count > 1)
 						job_steal_count /= 2;
 
-					for (size_t i = 0; i < job_steal_count; ++i)
-					{
-						auto job = ring_back(max_worker->job_q);
-						ring_pop_back(max_worker->job_q);
-
+					Worker_Job job{};
+					for (size_t i = 0; i < job_steal_count && _worker_queue_pop_back(max_worker->job_q, job); ++i)
 						buf_push(tmp_jobs, job);
-					}
+					_worker_queue_depth_publish(max_worker);
 				}
 
 				{
@@ -484,9 +1699,12 @@ namespace mn
 					mutex_lock(min_worker->mtx);
 					mn_defer{mutex_unlock(min_worker->mtx);};
 
-					for (auto job: tmp_jobs)
-						ring_push_back(min_worker->job_q, job);
+					for (const auto& job: tmp_jobs)
+						_worker_queue_push_job(min_worker->job_q, job);
+					if (_tracer_fabric())
+						_tracer_sysmon_decision(self->sysmon_name.ptr, "steal jobs", idle_worker, tmp_jobs.count);
 					buf_clear(tmp_jobs);
+					_worker_queue_depth_publish(min_worker);
 
 					cond_var_notify(min_worker->cv);
 				}
@@ -499,10 +1717,14 @@ namespace mn
 				{
 					if (self->ready_side_workers.count < self->settings.put_aside_worker_count)
 					{
+						if (_tracer_fabric())
+							_tracer_sysmon_decision(self->sysmon_name.ptr, "put aside side worker", worker->fabric_index, 0);
 						buf_push(self->ready_side_workers, worker);
 					}
 					else
 					{
+						if (_tracer_fabric())
+							_tracer_sysmon_decision(self->sysmon_name.ptr, "stop side worker", worker->fabric_index, 0);
 						_worker_stop(worker);
 						buf_push(dead_workers, worker);
 					}
@@ -517,6 +1739,61 @@ namespace mn
 	}
 
 
+	// computes the cpus and numa node of each worker index according to the placement settings
+	inline static Buf<Fabric_Worker_Placement>
+	_fabric_placements(const Fabric_Settings& settings)
+	{
+		auto res = buf_with_count<Fabric_Worker_Placement>(settings.workers_count);
+		for (auto& placement: res)
+			placement = Fabric_Worker_Placement{};
+
+		bool has_affinity = cpu_set_count(settings.affinity) > 0;
+		if (settings.placement == FABRIC_PLACEMENT_NONE)
+		{
+			for (auto& placement: res)
+			{
+				placement.pinned = has_affinity;
+				placement.cpus = settings.affinity;
+			}
+			return res;
+		}
+
+		// restrict the nodes to the allowed cpus and remove the nodes which end up empty
+		auto nodes = numa_nodes(memory::tmp());
+		if (has_affinity)
+		{
+			for (auto& node: nodes)
+				for (size_t i = 0; i < CPU_SET_CAPACITY / 64; ++i)
+					node.cpus.bits[i] &= settings.affinity.bits[i];
+			buf_remove_if(nodes, [](const Numa_Node& node) { return cpu_set_count(node.cpus) == 0; });
+		}
+		if (nodes.count == 0)
+			return res;
+
+		// assign contiguous worker ranges to each node so that neighbouring compute tiles (which are given to
+		// neighbouring workers) share the same node
+		for (size_t i = 0; i < res.count; ++i)
+		{
+			auto node_index = i * nodes.count / res.count;
+			const auto& node = nodes[node_index];
+			auto& placement = res[i];
+			placement.pinned = true;
+			placement.node = node_index;
+			if (settings.placement == FABRIC_PLACEMENT_CORE)
+			{
+				auto node_first_worker = (node_index * res.count + nodes.count - 1) / nodes.count;
+				auto cpu = cpu_set_nth(node.cpus, (i - node_first_worker) % cpu_set_count(node.cpus));
+				cpu_set_add(placement.cpus, cpu);
+			}
+			else
+			{
+				placement.cpus = node.cpus;
+			}
+		}
+		return res;
+	}
+
+
 	// API
 	Worker
 	worker_new(const char* name)
@@ -534,22 +1811,29 @@ namespace mn
 	void
 	worker_task_do(Worker self, const Fabric_Task& task)
 	{
+		auto now = _fabric_time_in_us();
+		auto settings = self->fabric ? &self->fabric->settings : nullptr;
+
 		mutex_lock(self->mtx);
 		mn_defer{mutex_unlock(self->mtx);};
 
-		ring_push_back(self->job_q, task);
+		_worker_queue_push(self->job_q, task, now, settings);
+		_worker_queue_depth_publish(self);
 		cond_var_notify(self->cv);
 	}
 
 	void
 	worker_task_batch_do(Worker self, const Fabric_Task* ptr, size_t count)
 	{
+		auto now = _fabric_time_in_us();
+		auto settings = self->fabric ? &self->fabric->settings : nullptr;
+
 		mutex_lock(self->mtx);
 		mn_defer{mutex_unlock(self->mtx);};
 
-		ring_reserve(self->job_q, count);
 		for (size_t i = 0; i < count; ++i)
-			ring_push_back(self->job_q, ptr[i]);
+			_worker_queue_push(self->job_q, ptr[i], now, settings);
+		_worker_queue_depth_publish(self);
 		cond_var_notify(self->cv);
 	}
 
@@ -568,183 +1852,723 @@ namespace mn
 		if (LOCAL_WORKER->atomic_disable_block_timing.load() == true)
 			return;
 
-		LOCAL_WORKER->atomic_block_start_time_in_ms.store(time_in_millis());
+		_epoch_worker_suspend();
+
+		// arm a deadline for sysmon to check whether this worker is still blocked after the coop blocking threshold
+		auto now = time_in_millis();
+		LOCAL_WORKER->atomic_block_start_time_in_ms.store(now);
+		LOCAL_WORKER->atomic_block_count.store(LOCAL_WORKER->atomic_block_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (auto fabric = LOCAL_WORKER->fabric)
+			_fabric_sysmon_arm(fabric, now + fabric->settings.coop_blocking_threshold_in_ms);
+	}
+
+	void
+	worker_block_clear()
+	{
+		if (LOCAL_WORKER == nullptr)
+			return;
+
+		if (LOCAL_WORKER->atomic_disable_block_timing.load() == true)
+			return;
+
+		LOCAL_WORKER->atomic_block_start_time_in_ms.store(0);
+		_epoch_worker_resume();
+	}
+
+	int
+	local_worker_index()
+	{
+		if (LOCAL_WORKER == nullptr)
+			return -1;
+
+		return (int)LOCAL_WORKER->fabric_index;
+	}
+
+
+	// fabric
+	Fabric
+	fabric_new(Fabric_Settings settings)
+	{
+		if (settings.name == nullptr)
+			settings.name = "fabric";
+
+		if (settings.workers_count == 0)
+		{
+			settings.workers_count = cpu_set_count(settings.affinity);
+			if (settings.workers_count == 0)
+				settings.workers_count = std::thread::hardware_concurrency();
+		}
+		if (settings.coop_blocking_threshold_in_ms == 0)
+			settings.coop_blocking_threshold_in_ms = DEFAULT_COOP_BLOCKING_THRESHOLD;
+		if (settings.external_blocking_threshold_in_ms == 0)
+			settings.external_blocking_threshold_in_ms = DEFAULT_EXTR_BLOCKING_THRESHOLD;
+		if (settings.put_aside_worker_count == 0)
+			settings.put_aside_worker_count = settings.workers_count / 2;
+		if (settings.blocking_workers_threshold == 0.0f)
+			settings.blocking_workers_threshold = 0.5f;
+		if (settings.tmp_retain_size == 0)
+			settings.tmp_retain_size = DEFAULT_TMP_RETAIN_SIZE;
+		if (settings.tmp_decay_in_ms == 0)
+			settings.tmp_decay_in_ms = DEFAULT_TMP_DECAY;
+		if (settings.fiber_stack_size == 0)
+			settings.fiber_stack_size = DEFAULT_FIBER_STACK_SIZE;
+		if (settings.normal_latency_budget_in_ms == 0)
+			settings.normal_latency_budget_in_ms = DEFAULT_NORMAL_LATENCY_BUDGET;
+		if (settings.background_latency_budget_in_ms == 0)
+			settings.background_latency_budget_in_ms = DEFAULT_BACKGROUND_LATENCY_BUDGET;
+
+
+		auto self = alloc_zerod<IFabric>();
+		self->settings = settings;
+		self->name = strf("{}", settings.name);
+		self->sysmon_name = strf("{} sysmon thread", settings.name);
+		self->workers = buf_with_count<Worker>(self->settings.workers_count);
+		self->sleepy_side_workers = buf_new<Worker>();
+		self->ready_side_workers = buf_new<Worker>();
+		self->placements = _fabric_placements(self->settings);
+		self->mtx = mn_mutex_new_with_srcloc(self->name.ptr);
+		self->next_worker = 0;
+		self->worker_id_generator = 0;
+		self->atomic_tmp_release_count = 0;
+		self->atomic_tmp_release_mem = 0;
+		self->atomic_tmp_retained_mem = 0;
+		self->queue_depths = (Padded_Atomic<size_t>*)alloc(
+			sizeof(Padded_Atomic<size_t>) * self->settings.workers_count,
+			alignof(Padded_Atomic<size_t>)
+		).ptr;
+		for (size_t i = 0; i < self->settings.workers_count; ++i)
+			self->queue_depths[i] = 0;
+		self->sysmon_mtx = mn_mutex_new_with_srcloc(self->sysmon_name.ptr);
+		self->sysmon_cv = cond_var_new();
+		self->is_running = true;
+		self->atomic_sysmon_deadline_in_ms = UINT64_MAX;
+		self->atomic_sysmon_signal = false;
+		self->timers_mtx = mn_mutex_new_with_srcloc("Fabric Timers Mutex");
+		self->timers = _timer_wheel_new(time_in_millis());
+
+		for (size_t i = 0; i < self->workers.count; ++i)
+		{
+			self->workers[i] = _worker_new(
+				strf("{} worker #{}", self->name, self->worker_id_generator++),
+				self,
+				i
+			);
+		}
+
+		self->sysmon = thread_new(_sysmon_main, self, self->sysmon_name.ptr);
+
+		return self;
+	}
+
+	void
+	fabric_free(Fabric self)
+	{
+		{
+			mutex_lock(self->sysmon_mtx);
+			mn_defer{mutex_unlock(self->sysmon_mtx);};
+
+			self->is_running = false;
+			cond_var_notify(self->sysmon_cv);
+		}
+
+		thread_join(self->sysmon);
+		thread_free(self->sysmon);
+
+		for (auto worker : self->workers)
+			_worker_stop(worker);
+
+		for (auto worker : self->sleepy_side_workers)
+			_worker_stop(worker);
+
+		for (auto worker : self->ready_side_workers)
+			_worker_stop(worker);
+
+		for (auto worker : self->workers)
+			_worker_free(worker);
+		buf_free(self->workers);
+
+		for (auto worker : self->sleepy_side_workers)
+			_worker_free(worker);
+		buf_free(self->sleepy_side_workers);
+
+		for (auto worker : self->ready_side_workers)
+			_worker_free(worker);
+		buf_free(self->ready_side_workers);
+		buf_free(self->placements);
+
+		_timer_wheel_free(self->timers);
+		mutex_free(self->timers_mtx);
+		cond_var_free(self->sysmon_cv);
+		mutex_free(self->sysmon_mtx);
+		free(Block{self->queue_depths, sizeof(Padded_Atomic<size_t>) * self->settings.workers_count});
+		mutex_free(self->mtx);
+		str_free(self->name);
+		str_free(self->sysmon_name);
+		task_free(self->settings.after_each_job);
+		task_free(self->settings.on_worker_start);
+		free(self);
+	}
+
+	void
+	fabric_task_do(Fabric self, const Fabric_Task& task)
+	{
+		mutex_lock(self->mtx);
+		mn_defer{mutex_unlock(self->mtx);};
+
+		auto next_worker = self->next_worker++;
+		next_worker %= self->workers.count;
+
+		auto worker = self->workers[next_worker];
+		worker_task_do(worker, task);
+	}
+
+	void
+	fabric_task_batch_do(Fabric self, const Fabric_Task* ptr, size_t count)
+	{
+		mutex_lock(self->mtx);
+		mn_defer{mutex_unlock(self->mtx);};
+
+		size_t increment = count / self->workers.count;
+		if (increment == 0)
+			increment = count;
+		size_t added = 0;
+		while (added < count)
+		{
+			auto to_add = increment;
+			if (added + to_add >= count)
+				to_add = count - added;
+
+			auto next_worker = self->next_worker++;
+			next_worker %= self->workers.count;
+
+			auto worker = self->workers[next_worker];
+			worker_task_batch_do(worker, ptr + added, to_add);
+
+			added += to_add;
+		}
+
+	}
+
+	Fabric
+	fabric_local()
+	{
+		Fabric res = nullptr;
+		if (auto w = worker_local())
+			res = w->fabric;
+		return res;
+	}
+
+	size_t
+	fabric_workers_count(Fabric self)
+	{
+		return self->workers.count;
+	}
+
+	Fabric_Tmp_Stats
+	fabric_tmp_stats(Fabric self)
+	{
+		Fabric_Tmp_Stats res{};
+		res.release_count = self->atomic_tmp_release_count.load();
+		res.release_mem = self->atomic_tmp_release_mem.load();
+		res.retained_mem = self->atomic_tmp_retained_mem.load();
+		return res;
+	}
+
+	Fabric_Timer
+	fabric_timer_task_do(Fabric self, uint32_t delay_in_ms, uint32_t period_in_ms, const Fabric_Task& task)
+	{
+		mn_assert_msg(
+			task.kind == Fabric_Task::KIND_ONESHOT || task.kind == Fabric_Task::KIND_FIBER,
+			"only oneshot and fiber tasks can be scheduled using timers"
+		);
+
+		if (delay_in_ms == 0)
+			delay_in_ms = 1;
+
+		uint64_t slack = 1;
+		while ((slack << 1) <= (delay_in_ms >> TIMER_SLACK_SHIFT))
+			slack <<= 1;
+		auto expires = (time_in_millis() + delay_in_ms + slack - 1) & ~(slack - 1);
+
+		auto node_task = task;
+		Fabric_Timer_Fn* fn = nullptr;
+		if (period_in_ms > 0)
+		{
+			fn = alloc<Fabric_Timer_Fn>();
+			fn->atomic_arc = 1;
+			if (task.kind == Fabric_Task::KIND_FIBER)
+			{
+				fn->task = task.as_fiber.task;
+				node_task.as_fiber.task = Task<void()>{};
+			}
+			else
+			{
+				fn->task = task.as_oneshot.task;
+				node_task.as_oneshot.task = Task<void()>{};
+			}
+		}
+
+		Handle_Table_Index handle{};
+		{
+			mutex_lock(self->timers_mtx);
+			mn_defer{mutex_unlock(self->timers_mtx);};
+
+			auto& timers = self->timers;
+			uint32_t index = timers.free_head;
+			if (index != TIMER_NULL)
+			{
+				timers.free_head = timers.nodes[index].next;
+			}
+			else
+			{
+				index = uint32_t(timers.nodes.count);
+				buf_push(timers.nodes, Fabric_Timer_Node{});
+				timers.nodes[index].generation = 1;
+			}
+
+			auto& node = timers.nodes[index];
+			node.expires_in_ms = expires;
+			node.period_in_ms = period_in_ms;
+			node.task = node_task;
+			node.fn = fn;
+			_timer_wheel_link(timers, index);
+			++timers.count;
+
+			handle.index = index;
+			handle.generation = node.generation;
+		}
+
+		_fabric_sysmon_arm(self, expires);
+		return Fabric_Timer{handle_table_index_to_uint64(handle)};
+	}
+
+	bool
+	fabric_timer_cancel(Fabric self, Fabric_Timer timer)
+	{
+		auto handle = handle_table_index_from_uint64(timer.handle);
+		Fabric_Task task{};
+		Fabric_Timer_Fn* fn = nullptr;
+		{
+			mutex_lock(self->timers_mtx);
+			mn_defer{mutex_unlock(self->timers_mtx);};
+
+			auto& timers = self->timers;
+			if (handle.index >= timers.nodes.count)
+				return false;
+
+			auto& node = timers.nodes[handle.index];
+			if (node.generation != handle.generation || node.slot == TIMER_NULL)
+				return false;
+
+			_timer_wheel_unlink(timers, handle.index);
+			task = node.task;
+			fn = node.fn;
+			_timer_wheel_node_free(timers, handle.index);
+		}
+
+		// the tasks are freed outside the lock because they might run arbitrary destructors
+		fabric_task_free(task);
+		if (fn)
+			_fabric_timer_fn_unref(fn);
+		return true;
+	}
+
+	Fabric_Queue_Stats
+	fabric_queue_stats(Fabric self)
+	{
+		Fabric_Queue_Stats res{};
+		for (size_t i = 0; i < FABRIC_PRIORITY_COUNT; ++i)
+		{
+			const auto& stats = self->queue_stats[i];
+			auto& it = res.priorities[i];
+			it.tasks_count = stats.tasks_count.load();
+			it.total_latency_in_us = stats.total_latency_in_us.load();
+			it.max_latency_in_us = stats.max_latency_in_us.load();
+			it.missed_deadlines_count = stats.missed_deadlines_count.load();
+			for (size_t j = 0; j < FABRIC_LATENCY_BUCKETS_COUNT; ++j)
+				it.latency_histogram[j] = stats.latency_histogram[j].load();
+		}
+		return res;
+	}
+
+	Fabric_Resume_Point
+	fabric_resume_point_local()
+	{
+		Fabric_Resume_Point res{};
+		if (auto worker = worker_local())
+		{
+			res.fabric = worker->fabric;
+			res.fabric_index = worker->fabric_index;
+			res.worker = worker;
+		}
+		return res;
+	}
+
+	void
+	fabric_resume_point_task_do(Fabric_Resume_Point self, const Fabric_Task& task)
+	{
+		if (auto fabric = self.fabric)
+		{
+			// the fabric mutex keeps sysmon from replacing the worker while we schedule the task
+			mutex_lock(fabric->mtx);
+			mn_defer{mutex_unlock(fabric->mtx);};
+			worker_task_do(fabric->workers[self.fabric_index], task);
+		}
+		else if (self.worker)
+		{
+			worker_task_do(self.worker, task);
+		}
+		else
+		{
+			auto job = task;
+			fabric_task_run(job);
+			fabric_task_free(job);
+		}
+	}
+
+	void
+	_chan_select_sync(Mutex& mtx, Cond_Var& cv)
+	{
+		auto& self = CHAN_SELECT_LOCAL;
+		if (self.mtx == nullptr)
+		{
+			self.mtx = mutex_new("chan_select");
+			self.cv = cond_var_new();
+		}
+		mtx = self.mtx;
+		cv = self.cv;
+	}
+
+	void*
+	_fabric_block_alloc(size_t size)
+	{
+		auto size_class = _small_block_class(size);
+		if (size_class >= SMALL_BLOCK_CLASS_COUNT)
+			return memory::clib()->alloc(size, alignof(std::max_align_t)).ptr;
+
+		if (auto worker = worker_local())
+		{
+			auto& blocks = worker->small_blocks[size_class];
+			if (blocks.count > 0)
+			{
+				auto res = buf_top(blocks);
+				buf_pop(blocks);
+				return res;
+			}
+		}
+		return memory::clib()->alloc(SMALL_BLOCK_MIN_SIZE << size_class, alignof(std::max_align_t)).ptr;
+	}
+
+	void
+	_fabric_block_free(void* ptr, size_t size)
+	{
+		auto size_class = _small_block_class(size);
+		if (size_class >= SMALL_BLOCK_CLASS_COUNT)
+		{
+			memory::clib()->free(Block{ptr, size});
+			return;
+		}
+
+		if (auto worker = worker_local())
+		{
+			auto& blocks = worker->small_blocks[size_class];
+			if (blocks.count < SMALL_BLOCK_CACHE_LIMIT)
+			{
+				buf_push(blocks, ptr);
+				return;
+			}
+		}
+		memory::clib()->free(Block{ptr, SMALL_BLOCK_MIN_SIZE << size_class});
+	}
+
+	_Future_Continuation*
+	_future_continuation_new(Fabric fabric, const Task<void()>& task)
+	{
+		auto self = (_Future_Continuation*)_fabric_block_alloc(sizeof(_Future_Continuation));
+		self->task = task;
+		self->fabric = fabric;
+		self->next = nullptr;
+		return self;
+	}
+
+	void
+	_future_continuation_free(_Future_Continuation* self)
+	{
+		task_free(self->task);
+		_fabric_block_free(self, sizeof(_Future_Continuation));
+	}
+
+	bool
+	_future_continuation_push(_IFuture_Base* self, _Future_Continuation* continuation)
+	{
+		auto head = self->_continuations.load(std::memory_order_acquire);
+		do
+		{
+			if (head == _future_done_mark())
+				return false;
+			continuation->next = head;
+		} while (self->_continuations.compare_exchange_weak(
+			head,
+			continuation,
+			std::memory_order_release,
+			std::memory_order_acquire
+		) == false);
+		return true;
+	}
+
+	void
+	_future_continuation_run(_Future_Continuation* self)
+	{
+		auto task = self->task;
+		auto fabric = self->fabric;
+		_fabric_block_free(self, sizeof(_Future_Continuation));
+
+		if (fabric == nullptr)
+		{
+			task();
+			task_free(task);
+			return;
+		}
+
+		// continuations are kept on the completing worker if it belongs to their fabric because they read the
+		// result it has just written
+		Fabric_Task job{};
+		job.as_oneshot.task = task;
+		auto local = fabric_resume_point_local();
+		if (local.fabric == fabric)
+			fabric_resume_point_task_do(local, job);
+		else
+			fabric_task_do(fabric, job);
+	}
+
+	void
+	_future_complete(_IFuture_Base* self)
+	{
+		auto head = self->_continuations.exchange(_future_done_mark(), std::memory_order_acq_rel);
+		mn_assert_msg(head != _future_done_mark(), "future is completed twice");
+
+		// the continuations are pushed in reverse order
+		_Future_Continuation* continuations = nullptr;
+		while (head)
+		{
+			auto next = head->next;
+			head->next = continuations;
+			continuations = head;
+			head = next;
+		}
+
+		while (continuations)
+		{
+			auto next = continuations->next;
+			_future_continuation_run(continuations);
+			continuations = next;
+		}
 	}
 
 	void
-	worker_block_clear()
+	_future_wait(_IFuture_Base* self)
 	{
-		if (LOCAL_WORKER == nullptr)
+		if (self->_continuations.load(std::memory_order_acquire) == _future_done_mark())
 			return;
 
-		if (LOCAL_WORKER->atomic_disable_block_timing.load() == true)
-			return;
-
-		LOCAL_WORKER->atomic_block_start_time_in_ms.store(0);
+		auto wg = waitgroup_new();
+		mn_defer{waitgroup_free(wg);};
+		waitgroup_add(wg, 1);
+		_future_continuation_add(self, nullptr, Task<void()>::make([wg]{ waitgroup_done(wg); }));
+		waitgroup_wait(wg);
 	}
 
-	int
-	local_worker_index()
+	// fiber
+	MN_FIBER_NOINLINE Fiber
+	fiber_local()
 	{
-		if (LOCAL_WORKER == nullptr)
-			return -1;
-
-		return (int)LOCAL_WORKER->fabric_index;
+		return LOCAL_FIBER;
 	}
 
-
-	// fabric
-	Fabric
-	fabric_new(Fabric_Settings settings)
+	void
+	fiber_park()
 	{
-		if (settings.name == nullptr)
-			settings.name = "fabric";
-
-		if (settings.workers_count == 0)
-			settings.workers_count = std::thread::hardware_concurrency();
-		if (settings.coop_blocking_threshold_in_ms == 0)
-			settings.coop_blocking_threshold_in_ms = DEFAULT_COOP_BLOCKING_THRESHOLD;
-		if (settings.external_blocking_threshold_in_ms == 0)
-			settings.external_blocking_threshold_in_ms = DEFAULT_EXTR_BLOCKING_THRESHOLD;
-		if (settings.put_aside_worker_count == 0)
-			settings.put_aside_worker_count = settings.workers_count / 2;
-		if (settings.blocking_workers_threshold == 0.0f)
-			settings.blocking_workers_threshold = 0.5f;
-
-
-		auto self = alloc_zerod<IFabric>();
-		self->settings = settings;
-		self->name = strf("{}", settings.name);
-		self->sysmon_name = strf("{} sysmon thread", settings.name);
-		self->workers = buf_with_count<Worker>(self->settings.workers_count);
-		self->sleepy_side_workers = buf_new<Worker>();
-		self->ready_side_workers = buf_new<Worker>();
-		self->mtx = mn_mutex_new_with_srcloc(self->name.ptr);
-		self->cv = cond_var_new();
-		self->is_running = true;
-		self->atomic_available_jobs = 0;
-		self->next_worker = 0;
-		self->worker_id_generator = 0;
+		auto self = fiber_local();
+		mn_assert(self != nullptr);
+		_fiber_context_switch(self->exec_context, self->worker->fiber_scheduler);
+	}
 
-		for (size_t i = 0; i < self->workers.count; ++i)
+	void
+	fiber_ready(Fiber self)
+	{
+		auto state = self->atomic_state.load();
+		while (true)
 		{
-			self->workers[i] = _worker_new(
-				strf("{} worker #{}", self->name, self->worker_id_generator++),
-				self,
-				i
-			);
+			if (state == IFiber::STATE_PARKED)
+			{
+				if (self->atomic_state.compare_exchange_weak(state, IFiber::STATE_RUNNING))
+				{
+					_fiber_schedule(self);
+					return;
+				}
+			}
+			else if (state == IFiber::STATE_RUNNING)
+			{
+				// the fiber didn't switch out yet, its worker will resume it once it does
+				if (self->atomic_state.compare_exchange_weak(state, IFiber::STATE_WAKE_PENDING))
+					return;
+			}
+			else
+			{
+				return;
+			}
 		}
-
-		self->sysmon = thread_new(_sysmon_main, self, self->sysmon_name.ptr);
-
-		return self;
 	}
 
 	void
-	fabric_free(Fabric self)
+	fiber_yield()
 	{
+		auto self = fiber_local();
+		if (self == nullptr)
 		{
-			mutex_lock(self->mtx);
-			mn_defer{mutex_unlock(self->mtx);};
-
-			self->is_running = false;
-			cond_var_notify(self->cv);
+			std::this_thread::yield();
+			return;
 		}
 
-		thread_join(self->sysmon);
-		thread_free(self->sysmon);
-
-		for (auto worker : self->workers)
-			_worker_stop(worker);
-
-		for (auto worker : self->sleepy_side_workers)
-			_worker_stop(worker);
+		self->yield = true;
+		_fiber_context_switch(self->exec_context, self->worker->fiber_scheduler);
+	}
 
-		for (auto worker : self->ready_side_workers)
-			_worker_stop(worker);
+	struct Fiber_Fd_Wait
+	{
+		Poll_Wait wait;
+		Fiber fiber;
+		bool ready;
+	};
 
-		for (auto worker : self->workers)
-			_worker_free(worker);
-		buf_free(self->workers);
+	int
+	fiber_wait_fd(int64_t fd, bool write, Timeout timeout)
+	{
+		auto fiber = fiber_local();
+		if (fiber == nullptr)
+			return -1;
 
-		for (auto worker : self->sleepy_side_workers)
-			_worker_free(worker);
-		buf_free(self->sleepy_side_workers);
+		Fiber_Fd_Wait self{};
+		self.fiber = fiber;
+		self.wait.fd = fd;
+		self.wait.write = write;
+		self.wait.deadline_in_ms = UINT64_MAX;
+		if (timeout != INFINITE_TIMEOUT)
+			self.wait.deadline_in_ms = time_in_millis() + timeout.milliseconds;
+		self.wait.user_data = &self;
+		self.wait.on_done = [](Poll_Wait* wait, bool ready) {
+			auto self = (Fiber_Fd_Wait*)wait->user_data;
+			// the wait lives on the fiber stack so we shouldn't touch it after the fiber is ready
+			auto fiber = self->fiber;
+			self->ready = ready;
+			fiber_ready(fiber);
+		};
 
-		for (auto worker : self->ready_side_workers)
-			_worker_free(worker);
-		buf_free(self->ready_side_workers);
+		if (_poll_wait_start(&self.wait) == false)
+			return -1;
 
-		cond_var_free(self->cv);
-		mutex_free(self->mtx);
-		str_free(self->name);
-		str_free(self->sysmon_name);
-		task_free(self->settings.after_each_job);
-		task_free(self->settings.on_worker_start);
-		free(self);
+		fiber_park();
+		return self.ready ? 1 : 0;
 	}
 
 	void
-	fabric_task_do(Fabric self, const Fabric_Task& task)
+	_fiber_wait_list_push(Fiber_Wait_List& self, Fiber fiber)
 	{
-		mutex_lock(self->mtx);
-		mn_defer{mutex_unlock(self->mtx);};
-
-		auto next_worker = self->next_worker++;
-		next_worker %= self->workers.count;
-
-		auto worker = self->workers[next_worker];
-		worker_task_do(worker, task);
-
-		self->atomic_available_jobs.fetch_add(1);
-		cond_var_notify(self->cv);
+		_fiber_wait_list_lock(self);
+		mn_defer{_fiber_wait_list_unlock(self);};
+
+		fiber->next_waiter = nullptr;
+		if (self.tail)
+			self.tail->next_waiter = fiber;
+		else
+			self.head = fiber;
+		self.tail = fiber;
+		self.count.fetch_add(1);
 	}
 
-	void
-	fabric_task_batch_do(Fabric self, const Fabric_Task* ptr, size_t count)
+	bool
+	_fiber_wait_list_remove(Fiber_Wait_List& self, Fiber fiber)
 	{
-		mutex_lock(self->mtx);
-		mn_defer{mutex_unlock(self->mtx);};
+		_fiber_wait_list_lock(self);
+		mn_defer{_fiber_wait_list_unlock(self);};
 
-		size_t increment = count / self->workers.count;
-		if (increment == 0)
-			increment = count;
-		size_t added = 0;
-		while (added < count)
+		Fiber prev = nullptr;
+		for (auto it = self.head; it; it = it->next_waiter)
 		{
-			auto to_add = increment;
-			if (added + to_add >= count)
-				to_add = count - added;
+			if (it == fiber)
+			{
+				if (prev)
+					prev->next_waiter = it->next_waiter;
+				else
+					self.head = it->next_waiter;
+				if (self.tail == it)
+					self.tail = prev;
+				it->next_waiter = nullptr;
+				self.count.fetch_sub(1);
+				return true;
+			}
+			prev = it;
+		}
+		return false;
+	}
 
-			auto next_worker = self->next_worker++;
-			next_worker %= self->workers.count;
+	Fiber
+	_fiber_wait_list_pop(Fiber_Wait_List& self)
+	{
+		if (self.count.load() == 0)
+			return nullptr;
 
-			auto worker = self->workers[next_worker];
-			worker_task_batch_do(worker, ptr + added, to_add);
+		_fiber_wait_list_lock(self);
+		mn_defer{_fiber_wait_list_unlock(self);};
 
-			added += to_add;
+		auto res = self.head;
+		if (res)
+		{
+			self.head = res->next_waiter;
+			if (self.head == nullptr)
+				self.tail = nullptr;
+			res->next_waiter = nullptr;
+			self.count.fetch_sub(1);
 		}
-
-		self->atomic_available_jobs.fetch_add(count);
-		cond_var_notify(self->cv);
+		return res;
 	}
 
-	Fabric
-	fabric_local()
+	Fiber
+	_fiber_wait_list_pop_all(Fiber_Wait_List& self)
 	{
-		Fabric res = nullptr;
-		if (auto w = worker_local())
-			res = w->fabric;
+		if (self.count.load() == 0)
+			return nullptr;
+
+		_fiber_wait_list_lock(self);
+		mn_defer{_fiber_wait_list_unlock(self);};
+
+		auto res = self.head;
+		self.head = nullptr;
+		self.tail = nullptr;
+		self.count.store(0);
 		return res;
 	}
 
-	size_t
-	fabric_workers_count(Fabric self)
+	void
+	_fiber_ready_all(Fiber fibers)
 	{
-		return self->workers.count;
+		while (fibers)
+		{
+			// the fiber might wait in another list once it's ready so we read the next one first
+			auto next = fibers->next_waiter;
+			fibers->next_waiter = nullptr;
+			fiber_ready(fibers);
+			fibers = next;
+		}
 	}
 
 	// channel stream
+	inline static bool
+	_chan_stream_buffered(Chan_Stream self)
+	{
+		return self->ring_sizes.count > 0;
+	}
+
 	void
 	IChan_Stream::dispose()
 	{
@@ -755,6 +2579,9 @@ namespace mn
 			mutex_free(this->mtx);
 			cond_var_free(this->read_cv);
 			cond_var_free(this->write_cv);
+			if (this->ring_memory.ptr)
+				free_from(memory::clib(), this->ring_memory);
+			buf_free(this->ring_sizes);
 			free(this);
 		}
 	}
@@ -765,36 +2592,13 @@ namespace mn
 		chan_stream_ref(this);
 		mn_defer{chan_stream_unref(this);};
 
-		mutex_lock(this->mtx);
-		if (this->data_blob.size == 0)
-		{
-			if (chan_stream_closed(this))
-			{
-				mutex_unlock(this->mtx);
-				return 0;
-			}
-
-			cond_var_wait(this->read_cv, this->mtx, [this]{
-				return this->data_blob.size > 0 || chan_stream_closed(this);
-			});
-		}
-
+		auto data = chan_stream_read_acquire(this);
 		auto read_size = data_out.size;
-		if (this->data_blob.size < read_size)
-			read_size = this->data_blob.size;
-
-		::memcpy(data_out.ptr, this->data_blob.ptr, read_size);
-		auto ptr = (char*)this->data_blob.ptr;
-		ptr += read_size;
-		this->data_blob.ptr = ptr;
-		this->data_blob.size -= read_size;
-		bool ready_to_write = this->data_blob.size == 0;
-
-		mutex_unlock(this->mtx);
-
-		if (ready_to_write)
-			cond_var_notify(this->write_cv);
+		if (data.size < read_size)
+			read_size = data.size;
 
+		::memcpy(data_out.ptr, data.ptr, read_size);
+		chan_stream_read_release(this, read_size);
 		return read_size;
 	}
 
@@ -804,6 +2608,29 @@ namespace mn
 		chan_stream_ref(this);
 		mn_defer{chan_stream_unref(this);};
 
+		if (_chan_stream_buffered(this))
+		{
+			if (chan_stream_closed(this))
+				panic("cannot write in a closed Chan_Stream");
+
+			// copy the data into the ring buffers and return without waiting for the reader
+			size_t res = 0;
+			while (res < data_in.size)
+			{
+				auto buffer = chan_stream_write_acquire(this);
+				if (buffer.size == 0)
+					break;
+
+				auto write_size = data_in.size - res;
+				if (buffer.size < write_size)
+					write_size = buffer.size;
+				::memcpy(buffer.ptr, (char*)data_in.ptr + res, write_size);
+				chan_stream_write_commit(this, write_size);
+				res += write_size;
+			}
+			return res;
+		}
+
 		// wait until there's available space
 		mutex_lock(this->mtx);
 		if (this->data_blob.size > 0)
@@ -819,10 +2646,10 @@ namespace mn
 		// get the data
 		this->data_blob = data_in;
 
-		// notify the read
+		// notify the read, and wait until the reader is done with our memory
 		cond_var_notify(this->read_cv);
 		cond_var_wait(this->write_cv, this->mtx, [this] {
-			return this->data_blob.size == 0 || chan_stream_closed(this);
+			return (this->data_blob.size == 0 || chan_stream_closed(this)) && this->reader_busy == false;
 		});
 		auto res = data_in.size - this->data_blob.size;
 		mutex_unlock(this->mtx);
@@ -834,6 +2661,7 @@ namespace mn
 	chan_stream_new()
 	{
 		auto self = alloc_construct<IChan_Stream>();
+		self->ring_sizes = buf_new<size_t>();
 		self->mtx = mn_mutex_new_with_srcloc("chan stream mutex");
 		self->read_cv = cond_var_new();
 		self->write_cv = cond_var_new();
@@ -841,6 +2669,18 @@ namespace mn
 		return self;
 	}
 
+	Chan_Stream
+	chan_stream_buffered_new(size_t buffers_count, size_t buffer_size)
+	{
+		mn_assert_msg(buffers_count > 0 && buffer_size > 0, "buffered Chan_Stream should have at least one buffer");
+
+		auto self = chan_stream_new();
+		self->ring_memory = alloc_from(memory::clib(), buffers_count * buffer_size, alignof(std::max_align_t));
+		buf_resize_fill(self->ring_sizes, buffers_count, 0);
+		self->ring_buffer_size = buffer_size;
+		return self;
+	}
+
 	void
 	chan_stream_free(Chan_Stream self)
 	{
@@ -874,11 +2714,13 @@ namespace mn
 		if (self == nullptr)
 			return;
 
+		// the condition variables are notified while the mutex is locked because a woken up thread might free the
+		// stream as soon as it sees it closed
 		mutex_lock(self->mtx);
 		self->atomic_closed.store(true);
-		mutex_unlock(self->mtx);
 		cond_var_notify_all(self->read_cv);
 		cond_var_notify_all(self->write_cv);
+		mutex_unlock(self->mtx);
 	}
 
 	bool
@@ -889,4 +2731,132 @@ namespace mn
 
 		return self->atomic_closed.load();
 	}
+
+	Block
+	chan_stream_write_acquire(Chan_Stream self)
+	{
+		mn_assert_msg(_chan_stream_buffered(self), "only buffered Chan_Stream supports acquiring write buffers");
+
+		mutex_lock(self->mtx);
+		cond_var_wait(self->write_cv, self->mtx, [self]{
+			return (self->ring_count < self->ring_sizes.count && self->writer_busy == false) || chan_stream_closed(self);
+		});
+
+		if (chan_stream_closed(self))
+		{
+			mutex_unlock(self->mtx);
+			return Block{};
+		}
+
+		self->writer_busy = true;
+		auto index = (self->ring_head + self->ring_count) % self->ring_sizes.count;
+		mutex_unlock(self->mtx);
+
+		return Block{(char*)self->ring_memory.ptr + index * self->ring_buffer_size, self->ring_buffer_size};
+	}
+
+	void
+	chan_stream_write_commit(Chan_Stream self, size_t size)
+	{
+		mn_assert_msg(size <= self->ring_buffer_size, "committed size is larger than the Chan_Stream buffer");
+
+		mutex_lock(self->mtx);
+		mn_assert_msg(self->writer_busy, "there's no acquired Chan_Stream write buffer to commit");
+		self->writer_busy = false;
+		if (size > 0)
+		{
+			auto index = (self->ring_head + self->ring_count) % self->ring_sizes.count;
+			self->ring_sizes[index] = size;
+			++self->ring_count;
+			cond_var_notify(self->read_cv);
+		}
+		// wakes up another writer which might be waiting for this buffer to be committed
+		cond_var_notify(self->write_cv);
+		mutex_unlock(self->mtx);
+	}
+
+	Block
+	chan_stream_read_acquire(Chan_Stream self)
+	{
+		mutex_lock(self->mtx);
+
+		if (_chan_stream_buffered(self) == false)
+		{
+			cond_var_wait(self->read_cv, self->mtx, [self]{
+				return (self->data_blob.size > 0 && self->reader_busy == false) || chan_stream_closed(self);
+			});
+
+			if (self->data_blob.size == 0 || self->reader_busy)
+			{
+				mutex_unlock(self->mtx);
+				return Block{};
+			}
+
+			self->reader_busy = true;
+			auto res = self->data_blob;
+			mutex_unlock(self->mtx);
+			return res;
+		}
+
+		cond_var_wait(self->read_cv, self->mtx, [self]{
+			return (self->ring_count > 0 && self->reader_busy == false) || (chan_stream_closed(self) && self->ring_count == 0);
+		});
+
+		if (self->ring_count == 0)
+		{
+			mutex_unlock(self->mtx);
+			return Block{};
+		}
+
+		self->reader_busy = true;
+		auto index = self->ring_head;
+		auto offset = self->ring_read_offset;
+		auto size = self->ring_sizes[index] - offset;
+		mutex_unlock(self->mtx);
+
+		return Block{(char*)self->ring_memory.ptr + index * self->ring_buffer_size + offset, size};
+	}
+
+	void
+	chan_stream_read_release(Chan_Stream self, size_t size)
+	{
+		mutex_lock(self->mtx);
+		if (self->reader_busy == false)
+		{
+			// an empty block was acquired, so there's nothing to release
+			mn_assert_msg(size == 0, "there's no acquired Chan_Stream read buffer to release");
+			mutex_unlock(self->mtx);
+			return;
+		}
+		self->reader_busy = false;
+
+		bool ready_to_write = false;
+		if (_chan_stream_buffered(self) == false)
+		{
+			mn_assert_msg(size <= self->data_blob.size, "released size is larger than the acquired Chan_Stream block");
+			self->data_blob.ptr = (char*)self->data_blob.ptr + size;
+			self->data_blob.size -= size;
+			ready_to_write = self->data_blob.size == 0 || chan_stream_closed(self);
+		}
+		else
+		{
+			auto index = self->ring_head;
+			mn_assert_msg(self->ring_read_offset + size <= self->ring_sizes[index], "released size is larger than the acquired Chan_Stream block");
+			self->ring_read_offset += size;
+			if (self->ring_read_offset == self->ring_sizes[index])
+			{
+				self->ring_sizes[index] = 0;
+				self->ring_read_offset = 0;
+				self->ring_head = (self->ring_head + 1) % self->ring_sizes.count;
+				--self->ring_count;
+				ready_to_write = true;
+			}
+		}
+
+		if (ready_to_write)
+			cond_var_notify(self->write_cv);
+		// wakes up another reader which might be waiting for this buffer to be released
+		cond_var_notify(self->read_cv);
+		mutex_unlock(self->mtx);
+	}
 }
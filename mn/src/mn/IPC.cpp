@@ -0,0 +1,561 @@
+#include "mn/IPC.h"
+#include "mn/Memory.h"
+#include "mn/Fabric.h"
+#include "mn/Defer.h"
+#include "mn/Assert.h"
+
+#include <string.h>
+
+#include <thread>
+
+namespace mn::ipc
+{
+	static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared memory primitives require lock free 32-bit atomics");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory primitives require lock free 64-bit atomics");
+
+	constexpr static uint32_t SHARED_STATE_UNINITIALIZED = 0;
+	constexpr static uint32_t SHARED_STATE_INITIALIZING = 1;
+	constexpr static uint32_t SHARED_STATE_READY = 0x4D4E4950; // "MNIP"
+
+	// allocations are rounded up to this size, it's also the minimum alignment of the allocated blocks so that each
+	// freed block can hold a Shared_Free_Block
+	constexpr static uint64_t SHARED_ALLOCATOR_GRANULARITY = 16;
+
+	struct IShared_Allocator_Header
+	{
+		std::atomic<uint32_t> state;
+		// 0 means unlocked, 1 means locked, 2 means locked and other processes might be waiting on it
+		std::atomic<uint32_t> lock;
+		uint64_t size;
+		// end of the bump region, the memory after it has never been allocated
+		std::atomic<uint64_t> alloc_head;
+		// offset of the first free block, free blocks are sorted by offset and coalesced, 0 means there are none
+		uint64_t free_head;
+		std::atomic<uint64_t> used;
+	};
+
+	// a freed block, it's stored inside the freed memory itself
+	struct Shared_Free_Block
+	{
+		uint64_t size;
+		uint64_t next;
+	};
+
+	struct IShared_Queue_Header
+	{
+		std::atomic<uint32_t> state;
+		SHARED_QUEUE_MODE mode;
+		uint64_t capacity;
+		std::atomic<uint32_t> closed;
+
+		// producers side
+		alignas(64) std::atomic<uint64_t> reserve_head;
+		// bytes up to commit_head are ready to be read
+		alignas(64) std::atomic<uint64_t> commit_head;
+		// incremented each time bytes are committed, the consumer waits on it
+		std::atomic<uint32_t> commit_seq;
+		std::atomic<uint32_t> read_waiters;
+
+		// consumer side
+		alignas(64) std::atomic<uint64_t> read_head;
+		// incremented each time bytes are consumed, producers wait on it
+		std::atomic<uint32_t> read_seq;
+		std::atomic<uint32_t> write_waiters;
+	};
+
+	inline static uint64_t
+	_align_up(uint64_t offset, uint64_t alignment)
+	{
+		if (alignment == 0)
+			return offset;
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	inline static uint64_t
+	_next_power_of_2(uint64_t v)
+	{
+		--v;
+		v |= v >> 1;
+		v |= v >> 2;
+		v |= v >> 4;
+		v |= v >> 8;
+		v |= v >> 16;
+		v |= v >> 32;
+		++v;
+		return v;
+	}
+
+	// converts the given timeout to a deadline in milliseconds, 0 means no deadline
+	inline static uint64_t
+	_deadline_from_timeout(Timeout timeout)
+	{
+		if (timeout == INFINITE_TIMEOUT || timeout == NO_TIMEOUT)
+			return 0;
+		return time_in_millis() + timeout.milliseconds;
+	}
+
+	// returns the remaining timeout until the given deadline
+	inline static Timeout
+	_timeout_until(Timeout timeout, uint64_t deadline)
+	{
+		if (timeout == INFINITE_TIMEOUT || timeout == NO_TIMEOUT)
+			return timeout;
+
+		auto now = time_in_millis();
+		if (now >= deadline)
+			return NO_TIMEOUT;
+		return Timeout{deadline - now};
+	}
+
+	// waits on the given sequence word while the condition is false, returns whether the condition is met
+	// the waiters counter is used by the waking side to avoid the wake syscall when no one is waiting
+	template<typename TFunc>
+	inline static bool
+	_shared_wait(std::atomic<uint32_t>* seq, std::atomic<uint32_t>* waiters, Timeout timeout, TFunc&& cond)
+	{
+		if (cond())
+			return true;
+
+		if (timeout == NO_TIMEOUT)
+			return false;
+
+		auto deadline = _deadline_from_timeout(timeout);
+		while (true)
+		{
+			auto expected = seq->load();
+			waiters->fetch_add(1);
+			// re-check the condition after announcing ourselves as a waiter, so that the other side either sees
+			// our announcement or we see its update
+			if (cond())
+			{
+				waiters->fetch_sub(1);
+				return true;
+			}
+			auto remaining = _timeout_until(timeout, deadline);
+			bool timed_out = remaining == NO_TIMEOUT || futex_wait(seq, expected, remaining) == false;
+			waiters->fetch_sub(1);
+
+			if (cond())
+				return true;
+			if (timed_out)
+				return false;
+		}
+	}
+
+	inline static void
+	_shared_notify(std::atomic<uint32_t>* seq, std::atomic<uint32_t>* waiters)
+	{
+		seq->fetch_add(1);
+		if (waiters->load() > 0)
+			futex_wake_all(seq);
+	}
+
+	inline static void
+	_ring_copy_in(Shared_Queue self, uint64_t offset, Block data)
+	{
+		auto capacity = self->header->capacity;
+		auto index = offset & (capacity - 1);
+		auto first = data.size;
+		if (first > capacity - index)
+			first = capacity - index;
+		::memcpy(self->ring + index, data.ptr, first);
+		if (first < data.size)
+			::memcpy(self->ring, (char*)data.ptr + first, data.size - first);
+	}
+
+	inline static void
+	_ring_copy_out(Shared_Queue self, uint64_t offset, Block data)
+	{
+		auto capacity = self->header->capacity;
+		auto index = offset & (capacity - 1);
+		auto first = data.size;
+		if (first > capacity - index)
+			first = capacity - index;
+		::memcpy(data.ptr, self->ring + index, first);
+		if (first < data.size)
+			::memcpy((char*)data.ptr + first, self->ring, data.size - first);
+	}
+
+	// the lock lives in the segment so it works across processes, it's the classic 3 state futex mutex
+	inline static void
+	_shared_lock(std::atomic<uint32_t>* lock)
+	{
+		uint32_t state = 0;
+		if (lock->compare_exchange_strong(state, 1))
+			return;
+
+		if (state != 2)
+			state = lock->exchange(2);
+		while (state != 0)
+		{
+			futex_wait(lock, 2);
+			state = lock->exchange(2);
+		}
+	}
+
+	inline static void
+	_shared_unlock(std::atomic<uint32_t>* lock)
+	{
+		if (lock->exchange(0) == 2)
+			futex_wake_one(lock);
+	}
+
+	inline static Shared_Free_Block*
+	_shared_free_block(Shared_Allocator* self, uint64_t offset)
+	{
+		return (Shared_Free_Block*)((char*)self->segment->data.ptr + offset);
+	}
+
+	// inserts the given range into the free list and merges it with its neighbours, ranges which end at the bump
+	// region are given back to it, it should be called while holding the lock
+	inline static void
+	_shared_allocator_insert(Shared_Allocator* self, uint64_t offset, uint64_t size)
+	{
+		auto header = self->header;
+
+		uint64_t prev = 0;
+		uint64_t* prev_link = nullptr;
+		uint64_t* link = &header->free_head;
+		while (*link != 0 && *link < offset)
+		{
+			prev = *link;
+			prev_link = link;
+			link = &_shared_free_block(self, prev)->next;
+		}
+		mn_assert_msg(*link != offset, "shared allocator double free");
+
+		auto next = *link;
+		if (next != 0 && offset + size == next)
+		{
+			auto next_block = _shared_free_block(self, next);
+			size += next_block->size;
+			next = next_block->next;
+		}
+
+		if (prev != 0 && prev + _shared_free_block(self, prev)->size == offset)
+		{
+			size += _shared_free_block(self, prev)->size;
+			offset = prev;
+			link = prev_link;
+		}
+
+		if (offset + size == header->alloc_head.load())
+		{
+			mn_assert(next == 0);
+			*link = 0;
+			header->alloc_head.store(offset);
+			return;
+		}
+
+		auto block = _shared_free_block(self, offset);
+		block->size = size;
+		block->next = next;
+		*link = offset;
+	}
+
+	inline static Shared_Queue
+	_shared_queue_from_segment(Shared_Memory segment)
+	{
+		auto self = alloc_construct<IShared_Queue>();
+		self->segment = segment;
+		self->header = (IShared_Queue_Header*)segment->data.ptr;
+		self->ring = (uint8_t*)segment->data.ptr + _align_up(sizeof(IShared_Queue_Header), 64);
+		return self;
+	}
+
+	// API
+	Shared_Allocator::Shared_Allocator(Shared_Memory segment_)
+		: Interface("shared")
+	{
+		mn_assert(segment_->data.size > sizeof(IShared_Allocator_Header));
+		segment = segment_;
+		header = (IShared_Allocator_Header*)segment->data.ptr;
+
+		// the first process to attach initializes the header, the others wait for it to finish
+		auto state = SHARED_STATE_UNINITIALIZED;
+		if (header->state.compare_exchange_strong(state, SHARED_STATE_INITIALIZING))
+		{
+			header->size = segment->data.size;
+			header->alloc_head = _align_up(sizeof(IShared_Allocator_Header), SHARED_ALLOCATOR_GRANULARITY);
+			header->free_head = 0;
+			header->used = 0;
+			header->state.store(SHARED_STATE_READY);
+		}
+		else
+		{
+			worker_block_on([&]{ return header->state.load() == SHARED_STATE_READY; });
+		}
+	}
+
+	Block
+	Shared_Allocator::alloc(size_t size, uint8_t alignment)
+	{
+		auto rounded_size = _align_up(size > 0 ? size : 1, SHARED_ALLOCATOR_GRANULARITY);
+		uint64_t align = alignment < SHARED_ALLOCATOR_GRANULARITY ? SHARED_ALLOCATOR_GRANULARITY : alignment;
+
+		_shared_lock(&header->lock);
+		mn_defer{_shared_unlock(&header->lock);};
+
+		// first fit from the free list, the parts of the free block around the allocation go back to the list
+		uint64_t offset = 0;
+		for (auto link = &header->free_head; *link != 0; link = &_shared_free_block(this, *link)->next)
+		{
+			auto free_offset = *link;
+			auto free_block = _shared_free_block(this, free_offset);
+			auto free_end = free_offset + free_block->size;
+			auto aligned = _align_up(free_offset, align);
+			if (aligned + rounded_size > free_end)
+				continue;
+
+			*link = free_block->next;
+			if (aligned > free_offset)
+				_shared_allocator_insert(this, free_offset, aligned - free_offset);
+			if (aligned + rounded_size < free_end)
+				_shared_allocator_insert(this, aligned + rounded_size, free_end - aligned - rounded_size);
+			offset = aligned;
+			break;
+		}
+
+		if (offset == 0)
+		{
+			auto head = header->alloc_head.load();
+			offset = _align_up(head, align);
+			if (offset + rounded_size > header->size)
+				return {};
+
+			header->alloc_head.store(offset + rounded_size);
+			if (offset > head)
+				_shared_allocator_insert(this, head, offset - head);
+		}
+		header->used.fetch_add(rounded_size);
+
+		Block res{(char*)segment->data.ptr + offset, size};
+		_memory_profile_alloc(res.ptr, res.size);
+		_telemetry_alloc(telemetry, res.size);
+		return res;
+	}
+
+	void
+	Shared_Allocator::free(Block block)
+	{
+		if (block_is_empty(block))
+			return;
+
+		_memory_profile_free(block.ptr, block.size);
+		_telemetry_free(telemetry, block.size);
+		auto offset = shared_memory_offset(segment, block.ptr);
+		mn_assert_msg(offset % SHARED_ALLOCATOR_GRANULARITY == 0, "block wasn't allocated by the shared allocator");
+		auto rounded_size = _align_up(block.size, SHARED_ALLOCATOR_GRANULARITY);
+
+		_shared_lock(&header->lock);
+		mn_defer{_shared_unlock(&header->lock);};
+
+		_shared_allocator_insert(this, offset, rounded_size);
+		header->used.fetch_sub(rounded_size);
+	}
+
+	size_t
+	Shared_Allocator::used_mem() const
+	{
+		return header->used.load();
+	}
+
+	void
+	IShared_Queue::dispose()
+	{
+		shared_queue_free(this);
+	}
+
+	size_t
+	IShared_Queue::read(Block data)
+	{
+		return shared_queue_read(this, data, INFINITE_TIMEOUT);
+	}
+
+	size_t
+	IShared_Queue::write(Block data)
+	{
+		return shared_queue_write(this, data, INFINITE_TIMEOUT);
+	}
+
+	int64_t
+	IShared_Queue::size()
+	{
+		return shared_queue_count(this);
+	}
+
+	Shared_Queue
+	shared_queue_new(const Str& name, size_t capacity, SHARED_QUEUE_MODE mode)
+	{
+		mn_assert(capacity > 0);
+		capacity = _next_power_of_2(capacity);
+
+		auto segment = shared_memory_new(name, _align_up(sizeof(IShared_Queue_Header), 64) + capacity);
+		if (segment == nullptr)
+			return nullptr;
+
+		auto self = _shared_queue_from_segment(segment);
+		auto header = self->header;
+		header->mode = mode;
+		header->capacity = capacity;
+		header->closed = 0;
+		header->reserve_head = 0;
+		header->commit_head = 0;
+		header->commit_seq = 0;
+		header->read_waiters = 0;
+		header->read_head = 0;
+		header->read_seq = 0;
+		header->write_waiters = 0;
+		header->state.store(SHARED_STATE_READY);
+		return self;
+	}
+
+	Shared_Queue
+	shared_queue_open(const Str& name)
+	{
+		auto segment = shared_memory_open(name);
+		if (segment == nullptr)
+			return nullptr;
+
+		if (segment->data.size < sizeof(IShared_Queue_Header) ||
+			((IShared_Queue_Header*)segment->data.ptr)->state.load() != SHARED_STATE_READY)
+		{
+			shared_memory_free(segment);
+			return nullptr;
+		}
+
+		return _shared_queue_from_segment(segment);
+	}
+
+	void
+	shared_queue_free(Shared_Queue self)
+	{
+		shared_memory_free(self->segment);
+		free_destruct(self);
+	}
+
+	size_t
+	shared_queue_write(Shared_Queue self, Block data, Timeout timeout)
+	{
+		if (block_is_empty(data))
+			return 0;
+
+		auto header = self->header;
+		auto capacity = header->capacity;
+
+		size_t chunk = data.size;
+		if (chunk > capacity)
+			chunk = capacity;
+
+		uint64_t offset = 0;
+		if (header->mode == SHARED_QUEUE_MODE_SPSC)
+		{
+			// single producer, we own reserve_head so we can write as much as fits
+			offset = header->reserve_head.load(std::memory_order_relaxed);
+			auto has_space = [&]{
+				return header->closed.load() != 0 || capacity - (offset - header->read_head.load()) > 0;
+			};
+			if (_shared_wait(&header->read_seq, &header->write_waiters, timeout, has_space) == false)
+				return 0;
+			if (header->closed.load() != 0)
+				return 0;
+
+			auto available = capacity - (offset - header->read_head.load());
+			if (chunk > available)
+				chunk = available;
+			header->reserve_head.store(offset + chunk, std::memory_order_relaxed);
+
+			_ring_copy_in(self, offset, Block{data.ptr, chunk});
+			header->commit_head.store(offset + chunk);
+		}
+		else
+		{
+			// multiple producers, wait for the entire chunk to fit then reserve it, once we reserve a region we
+			// must commit it even if the queue is closed in the meantime otherwise the following producers will
+			// wait on our commit forever
+			bool closed = false;
+			auto reserved = [&]{
+				if (header->closed.load() != 0)
+				{
+					closed = true;
+					return true;
+				}
+				offset = header->reserve_head.load();
+				while (capacity - (offset - header->read_head.load()) >= chunk)
+				{
+					if (header->reserve_head.compare_exchange_weak(offset, offset + chunk))
+						return true;
+				}
+				return false;
+			};
+			if (_shared_wait(&header->read_seq, &header->write_waiters, timeout, reserved) == false)
+				return 0;
+			if (closed)
+				return 0;
+
+			_ring_copy_in(self, offset, Block{data.ptr, chunk});
+
+			// commits are published in reservation order, we only wait for producers which reserved before us
+			// and are still copying their bytes which is a short window
+			while (header->commit_head.load() != offset)
+				std::this_thread::yield();
+			header->commit_head.store(offset + chunk);
+		}
+
+		_shared_notify(&header->commit_seq, &header->read_waiters);
+		return chunk;
+	}
+
+	size_t
+	shared_queue_read(Shared_Queue self, Block data, Timeout timeout)
+	{
+		if (block_is_empty(data))
+			return 0;
+
+		auto header = self->header;
+		auto offset = header->read_head.load(std::memory_order_relaxed);
+
+		auto has_data = [&]{
+			return header->commit_head.load() != offset || header->closed.load() != 0;
+		};
+		if (_shared_wait(&header->commit_seq, &header->read_waiters, timeout, has_data) == false)
+			return 0;
+
+		size_t available = header->commit_head.load() - offset;
+		if (available == 0)
+			return 0;
+
+		auto read_size = data.size;
+		if (read_size > available)
+			read_size = available;
+
+		_ring_copy_out(self, offset, Block{data.ptr, read_size});
+		header->read_head.store(offset + read_size);
+
+		_shared_notify(&header->read_seq, &header->write_waiters);
+		return read_size;
+	}
+
+	void
+	shared_queue_close(Shared_Queue self)
+	{
+		auto header = self->header;
+		header->closed.store(1);
+		header->commit_seq.fetch_add(1);
+		header->read_seq.fetch_add(1);
+		futex_wake_all(&header->commit_seq);
+		futex_wake_all(&header->read_seq);
+	}
+
+	bool
+	shared_queue_closed(Shared_Queue self)
+	{
+		return self->header->closed.load() != 0;
+	}
+
+	size_t
+	shared_queue_count(Shared_Queue self)
+	{
+		return self->header->commit_head.load() - self->header->read_head.load();
+	}
+}
@@ -0,0 +1,122 @@
+#include "mn/Memory_Telemetry.h"
+
+#include <thread>
+
+namespace mn
+{
+	// the registry is a spin locked intrusive list of allocators telemetry, it's constant initialized so allocators
+	// can register themselves during static initialization and unregister during static destruction
+	static std::atomic<bool> TELEMETRY_REGISTRY_LOCKED = false;
+	static memory::Telemetry* TELEMETRY_REGISTRY_HEAD = nullptr;
+
+	inline static void
+	_telemetry_registry_lock()
+	{
+		while (TELEMETRY_REGISTRY_LOCKED.exchange(true, std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+
+	inline static void
+	_telemetry_registry_unlock()
+	{
+		TELEMETRY_REGISTRY_LOCKED.store(false, std::memory_order_release);
+	}
+
+	inline static Allocator_Telemetry
+	_telemetry_read(const memory::Telemetry& self)
+	{
+		Allocator_Telemetry res{};
+		res.name = self.name;
+		res.allocator = self.allocator;
+		res.allocations_count = self.allocations_count.load(std::memory_order_relaxed);
+		res.frees_count = self.frees_count.load(std::memory_order_relaxed);
+		res.allocated_bytes = self.allocated_bytes.load(std::memory_order_relaxed);
+		res.live_bytes = self.live_bytes.load(std::memory_order_relaxed);
+		res.highwater_bytes = self.highwater_bytes.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < memory::TELEMETRY_SIZE_CLASSES_COUNT; ++i)
+			res.size_classes[i] = self.size_classes[i].load(std::memory_order_relaxed);
+		return res;
+	}
+
+	namespace memory
+	{
+		Interface::Interface(const char* name)
+		{
+			telemetry.name = name;
+			telemetry.single_owner = false;
+			telemetry.allocations_count = 0;
+			telemetry.frees_count = 0;
+			telemetry.allocated_bytes = 0;
+			telemetry.live_bytes = 0;
+			telemetry.highwater_bytes = 0;
+			for (auto& size_class: telemetry.size_classes)
+				size_class = 0;
+			telemetry.allocator = this;
+			telemetry.prev = nullptr;
+
+			_telemetry_registry_lock();
+			telemetry.next = TELEMETRY_REGISTRY_HEAD;
+			if (TELEMETRY_REGISTRY_HEAD)
+				TELEMETRY_REGISTRY_HEAD->prev = &telemetry;
+			TELEMETRY_REGISTRY_HEAD = &telemetry;
+			_telemetry_registry_unlock();
+		}
+
+		Interface::~Interface()
+		{
+			_telemetry_registry_lock();
+			if (telemetry.prev)
+				telemetry.prev->next = telemetry.next;
+			else
+				TELEMETRY_REGISTRY_HEAD = telemetry.next;
+			if (telemetry.next)
+				telemetry.next->prev = telemetry.prev;
+			_telemetry_registry_unlock();
+		}
+	}
+
+	// API
+	Buf<Allocator_Telemetry>
+	memory_telemetry_snapshot(Allocator allocator)
+	{
+		auto res = buf_with_allocator<Allocator_Telemetry>(allocator);
+
+		// we don't allocate while holding the registry lock because the allocation might create a new allocator
+		// (first use of a thread's tmp arena for example), so we reserve then fill and retry if allocators were
+		// added in the meantime
+		while (true)
+		{
+			size_t count = 0;
+			_telemetry_registry_lock();
+			for (auto it = TELEMETRY_REGISTRY_HEAD; it != nullptr; it = it->next)
+				++count;
+			_telemetry_registry_unlock();
+
+			buf_reserve(res, count);
+
+			bool fits = true;
+			_telemetry_registry_lock();
+			for (auto it = TELEMETRY_REGISTRY_HEAD; it != nullptr; it = it->next)
+			{
+				if (res.count == res.cap)
+				{
+					fits = false;
+					break;
+				}
+				res.ptr[res.count++] = _telemetry_read(*it);
+			}
+			_telemetry_registry_unlock();
+
+			if (fits)
+				break;
+			buf_clear(res);
+		}
+		return res;
+	}
+
+	Allocator_Telemetry
+	memory_telemetry_of(Allocator self)
+	{
+		return _telemetry_read(self->telemetry);
+	}
+}
@@ -0,0 +1,268 @@
+#include "mn/Path.h"
+#include "mn/Memory.h"
+#include "mn/Fabric.h"
+#include "mn/Defer.h"
+
+#include <string.h>
+
+namespace mn
+{
+	// matches a character class, p points right after the "[" and is moved past the closing "]"
+	// returns false in matched if the class is not terminated
+	inline static bool
+	_glob_match_class(const char*& p, char c, bool& matched)
+	{
+		auto it = p;
+		bool negate = false;
+		if (*it == '!' || *it == '^')
+		{
+			negate = true;
+			++it;
+		}
+
+		matched = false;
+		bool first = true;
+		while (*it != '\0' && (first || *it != ']'))
+		{
+			first = false;
+			char lo = *it;
+			char hi = lo;
+			if (it[1] == '-' && it[2] != '\0' && it[2] != ']')
+			{
+				hi = it[2];
+				it += 3;
+			}
+			else
+			{
+				++it;
+			}
+
+			if (lo <= c && c <= hi)
+				matched = true;
+		}
+
+		if (*it != ']')
+			return false;
+
+		matched = matched != negate;
+		p = it + 1;
+		return true;
+	}
+
+	static bool
+	_glob_match(const char* p, const char* s)
+	{
+		while (*p != '\0')
+		{
+			if (*p == '*')
+			{
+				bool deep = p[1] == '*';
+				p += deep ? 2 : 1;
+
+				// "**/" also matches zero folders
+				if (deep && *p == '/' && _glob_match(p + 1, s))
+					return true;
+
+				while (true)
+				{
+					if (_glob_match(p, s))
+						return true;
+					if (*s == '\0' || (deep == false && *s == '/'))
+						return false;
+					++s;
+				}
+			}
+
+			if (*s == '\0')
+				return false;
+
+			if (*p == '?')
+			{
+				if (*s == '/')
+					return false;
+				++p;
+				++s;
+				continue;
+			}
+
+			if (*p == '[' && *s != '/')
+			{
+				auto it = p + 1;
+				bool matched = false;
+				if (_glob_match_class(it, *s, matched))
+				{
+					if (matched == false)
+						return false;
+					p = it;
+					++s;
+					continue;
+				}
+				// unterminated classes are matched literally
+			}
+
+			if (*p == '\\' && p[1] != '\0')
+				++p;
+
+			if (*p != *s)
+				return false;
+			++p;
+			++s;
+		}
+		return *s == '\0';
+	}
+
+	struct Path_Walker
+	{
+		const Path_Walk_Settings& settings;
+		Task<void(const Path_Walk_Entry&)>& on_entry;
+		size_t relative_offset;
+		Waitgroup wg;
+	};
+
+	// linux limits symlink resolution to the same number of nested links
+	constexpr static size_t PATH_WALK_MAX_SYMLINKS = 40;
+
+	inline static bool
+	_path_walker_matches_any(const Buf<Str>& patterns, const Str& path)
+	{
+		for (const auto& pattern: patterns)
+			if (path_glob_match(pattern, path))
+				return true;
+		return false;
+	}
+
+	static void
+	_path_walker_folder(Path_Walker& self, Str& path, size_t depth, size_t symlinks, memory::Arena* arena);
+
+	static void
+	_path_walker_folder_go(Path_Walker& self, const Str& path, size_t depth, size_t symlinks)
+	{
+		waitgroup_add(self.wg, 1);
+		go(self.settings.fabric, [&self, path = clone(path), depth, symlinks]() mutable {
+			// the fabric worker clears its tmp arena after each job, so it's safe to use it here
+			_path_walker_folder(self, path, depth, symlinks, memory::tmp());
+			str_free(path);
+			waitgroup_done(self.wg);
+		});
+	}
+
+	// visits the children of the folder at path, path is used as a scratch buffer for the children paths
+	// and is restored back to its original content on return
+	static void
+	_path_walker_folder(Path_Walker& self, Str& path, size_t depth, size_t symlinks, memory::Arena* arena)
+	{
+		auto checkpoint = arena->checkpoint();
+		mn_defer{arena->restore(checkpoint);};
+
+		auto entries = path_entries(path, arena);
+
+		auto count = path.count;
+		mn_defer{str_resize(path, count);};
+
+		auto child_depth = depth + 1;
+		auto max_depth = self.settings.max_depth;
+		for (const auto& entry: entries)
+		{
+			if (entry.name == "." || entry.name == "..")
+				continue;
+
+			str_resize(path, count);
+			if (count > 0 && path[count - 1] != '/')
+				buf_push(path, '/');
+			str_push(path, entry.name);
+
+			Path_Walk_Entry walk_entry{};
+			walk_entry.kind = entry.kind;
+			walk_entry.path = path;
+			walk_entry.relative_path.ptr = path.ptr + self.relative_offset;
+			walk_entry.relative_path.count = path.count - self.relative_offset;
+			walk_entry.relative_path.cap = walk_entry.relative_path.count + 1;
+			walk_entry.depth = child_depth;
+
+			if (_path_walker_matches_any(self.settings.exclude, walk_entry.relative_path))
+				continue;
+
+			auto child_symlinks = symlinks;
+			if (walk_entry.kind == Path_Entry::KIND_SYMLINK &&
+				self.settings.follow_symlinks &&
+				symlinks < PATH_WALK_MAX_SYMLINKS &&
+				path_is_folder(path))
+			{
+				walk_entry.kind = Path_Entry::KIND_FOLDER;
+				++child_symlinks;
+			}
+
+			if (walk_entry.kind != Path_Entry::KIND_FOLDER)
+			{
+				if (self.settings.include.count == 0 || _path_walker_matches_any(self.settings.include, walk_entry.relative_path))
+					self.on_entry(walk_entry);
+				continue;
+			}
+
+			self.on_entry(walk_entry);
+
+			if (max_depth != 0 && child_depth >= max_depth)
+				continue;
+
+			if (self.settings.fabric)
+				_path_walker_folder_go(self, path, child_depth, child_symlinks);
+			else
+				_path_walker_folder(self, path, child_depth, child_symlinks, arena);
+		}
+	}
+
+
+	// API
+	bool
+	path_glob_match(const char* pattern, const char* path)
+	{
+		if (::strchr(pattern, '/') == nullptr)
+		{
+			if (auto name = ::strrchr(path, '/'))
+				path = name + 1;
+		}
+		return _glob_match(pattern, path);
+	}
+
+	bool
+	path_walk(const char* root, const Path_Walk_Settings& settings, Task<void(const Path_Walk_Entry&)>& on_entry)
+	{
+		if (path_is_folder(root) == false)
+			return false;
+
+		auto path = path_sanitize(str_from_c(root));
+		mn_defer{str_free(path);};
+		if (path.count > 1 && path[path.count - 1] == '/')
+			str_resize(path, path.count - 1);
+
+		Path_Walker self{settings, on_entry, path.count, nullptr};
+		if (path.count > 0 && path[path.count - 1] != '/')
+			++self.relative_offset;
+
+		if (settings.fabric)
+		{
+			self.wg = waitgroup_new();
+			mn_defer{waitgroup_free(self.wg);};
+
+			_path_walker_folder_go(self, path, 0, 0);
+			waitgroup_wait(self.wg);
+		}
+		else
+		{
+			memory::Arena arena{64ULL * 1024ULL, memory::clib()};
+			_path_walker_folder(self, path, 0, 0, &arena);
+		}
+		return true;
+	}
+
+	bool
+	path_walk(const char* root, const Path_Walk_Settings& settings, Chan<Path_Walk_Entry> chan)
+	{
+		return path_walk(root, settings, [chan](const Path_Walk_Entry& entry) {
+			auto res = entry;
+			res.path = clone(entry.path);
+			res.relative_path.ptr = res.path.ptr + (entry.relative_path.ptr - entry.path.ptr);
+			chan_send(chan, res);
+		});
+	}
+}
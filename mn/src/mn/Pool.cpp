@@ -1,5 +1,6 @@
 #include "mn/Pool.h"
 #include "mn/Memory.h"
+#include "mn/Memory_Telemetry.h"
 #include "mn/OS.h"
 
 namespace mn
@@ -22,6 +23,7 @@ namespace mn
 
 		self->meta_allocator = meta_allocator;
 		self->arena = allocator_arena_new(element_size * bucket_size, meta_allocator);
+		allocator_name_set(self->arena, "pool");
 		self->head = nullptr;
 		self->element_size = element_size;
 		return self;
@@ -43,6 +45,8 @@ namespace mn
 		{
 			void* result = self->head;
 			self->head = (void*)(*(uintptr_t*)self->head);
+			// recycled elements don't go through the arena so we report them to its telemetry ourselves
+			memory::_telemetry_alloc(self->arena->telemetry, self->element_size);
 			return result;
 		}
 
@@ -73,5 +77,6 @@ namespace mn
 		uintptr_t* sptr = (uintptr_t*)ptr;
 		*sptr = (uintptr_t)self->head;
 		self->head = ptr;
+		memory::_telemetry_free(self->arena->telemetry, self->element_size);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "mn/Task_Graph.h"
+#include "mn/Buf.h"
+#include "mn/Fmt.h"
+#include "mn/Thread.h"
+#include "mn/Assert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace mn
+{
+	struct Task_Graph_Node_Info
+	{
+		Str name;
+		Task<void()> task;
+		// the cost given when the node was added, 0 if it's measured
+		uint64_t cost;
+		Buf<Task_Graph_Node> successors;
+		size_t predecessors_count;
+		// the cost of the longest path from this node to the end of the graph including the node itself
+		uint64_t critical_path;
+		// measurements of the last run, times are relative to the start of the run
+		uint64_t start_time_in_us;
+		uint64_t end_time_in_us;
+		int worker_index;
+	};
+
+	struct ITask_Graph
+	{
+		Str name;
+		Buf<Task_Graph_Node_Info> nodes;
+		// nodes without predecessors sorted by their critical path
+		Buf<Task_Graph_Node> roots;
+		// unfinished predecessors of each node in the current run
+		std::atomic<size_t>* pending;
+		size_t pending_capacity;
+		// unfinished nodes in the current run, it's 0 when the graph isn't running
+		std::atomic<size_t> remaining;
+		Fabric fabric;
+		Waitgroup wg;
+		// start time of the last run, and its duration once it finishes
+		uint64_t run_start_time_in_us;
+		uint64_t run_duration_in_us;
+		bool has_run;
+	};
+
+	inline static uint64_t
+	_task_graph_time_in_us()
+	{
+		auto now = std::chrono::steady_clock::now().time_since_epoch();
+		return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+	}
+
+	inline static uint64_t
+	_task_graph_node_cost(const ITask_Graph* self, const Task_Graph_Node_Info& node)
+	{
+		if (node.cost != 0)
+			return node.cost;
+		if (self->has_run && node.end_time_in_us > node.start_time_in_us)
+			return node.end_time_in_us - node.start_time_in_us;
+		return 1;
+	}
+
+	// computes the critical paths and sorts the successors and roots by them, it panics if the graph has a cycle
+	inline static void
+	_task_graph_prepare(Task_Graph self)
+	{
+		// topological order using the predecessor counts
+		auto pending = buf_with_count<size_t>(self->nodes.count);
+		mn_defer{buf_free(pending);};
+		auto order = buf_with_capacity<Task_Graph_Node>(self->nodes.count);
+		mn_defer{buf_free(order);};
+
+		for (size_t i = 0; i < self->nodes.count; ++i)
+		{
+			pending[i] = self->nodes[i].predecessors_count;
+			if (pending[i] == 0)
+				buf_push(order, i);
+		}
+
+		for (size_t i = 0; i < order.count; ++i)
+			for (auto successor: self->nodes[order[i]].successors)
+				if (--pending[successor] == 0)
+					buf_push(order, successor);
+
+		if (order.count != self->nodes.count)
+			panic("task graph '{}' has a cycle", self->name);
+
+		for (size_t i = order.count; i > 0; --i)
+		{
+			auto& node = self->nodes[order[i - 1]];
+			uint64_t successors_path = 0;
+			for (auto successor: node.successors)
+				if (self->nodes[successor].critical_path > successors_path)
+					successors_path = self->nodes[successor].critical_path;
+			node.critical_path = _task_graph_node_cost(self, node) + successors_path;
+		}
+
+		auto more_critical = [self](Task_Graph_Node a, Task_Graph_Node b) {
+			return self->nodes[a].critical_path > self->nodes[b].critical_path;
+		};
+		for (auto& node: self->nodes)
+			std::sort(begin(node.successors), end(node.successors), more_critical);
+
+		buf_clear(self->roots);
+		for (size_t i = 0; i < self->nodes.count; ++i)
+			if (self->nodes[i].predecessors_count == 0)
+				buf_push(self->roots, i);
+		std::sort(begin(self->roots), end(self->roots), more_critical);
+
+		if (self->pending_capacity < self->nodes.count)
+		{
+			if (self->pending)
+				free(Block{self->pending, sizeof(std::atomic<size_t>) * self->pending_capacity});
+			self->pending_capacity = self->nodes.count;
+			self->pending = (std::atomic<size_t>*)alloc(
+				sizeof(std::atomic<size_t>) * self->pending_capacity,
+				alignof(std::atomic<size_t>)
+			).ptr;
+		}
+		for (size_t i = 0; i < self->nodes.count; ++i)
+			self->pending[i] = self->nodes[i].predecessors_count;
+	}
+
+	static void
+	_task_graph_node_run(Task_Graph self, Task_Graph_Node index);
+
+	// schedules the given node into the calling worker if it belongs to the graph fabric so it runs close to its
+	// predecessor, otherwise it's scheduled into the fabric
+	inline static void
+	_task_graph_node_schedule(Task_Graph self, Task_Graph_Node index)
+	{
+		Fabric_Task task{};
+		task.as_oneshot.task = Task<void()>::make([self, index]{ _task_graph_node_run(self, index); });
+
+		// the resume point is used instead of the worker itself because sysmon might have replaced it while the
+		// node was running, in which case the node goes to the worker which replaced it
+		auto resume_point = fabric_resume_point_local();
+		if (resume_point.fabric == self->fabric)
+			fabric_resume_point_task_do(resume_point, task);
+		else
+			fabric_task_do(self->fabric, task);
+	}
+
+	static void
+	_task_graph_node_run(Task_Graph self, Task_Graph_Node index)
+	{
+		while (true)
+		{
+			auto& node = self->nodes[index];
+			node.worker_index = local_worker_index();
+			node.start_time_in_us = _task_graph_time_in_us() - self->run_start_time_in_us;
+			node.task();
+			node.end_time_in_us = _task_graph_time_in_us() - self->run_start_time_in_us;
+
+			// the successors are sorted by their critical path, so the first one which becomes ready is the most
+			// critical one and it runs next on this worker without going through the queue
+			auto next = SIZE_MAX;
+			for (auto successor: node.successors)
+			{
+				if (self->pending[successor].fetch_sub(1) == 1)
+				{
+					if (next == SIZE_MAX)
+						next = successor;
+					else
+						_task_graph_node_schedule(self, successor);
+				}
+			}
+
+			// the graph might be freed or run again once it's done, so it shouldn't be touched afterwards
+			if (self->remaining.fetch_sub(1) == 1)
+			{
+				self->run_duration_in_us = _task_graph_time_in_us() - self->run_start_time_in_us;
+				waitgroup_done(self->wg);
+				return;
+			}
+
+			if (next == SIZE_MAX)
+				return;
+			index = next;
+		}
+	}
+
+	inline static void
+	_task_graph_json_str_push(Str& out, const Str& str)
+	{
+		str_push(out, "\"");
+		for (auto c: str)
+		{
+			if (c == '"' || c == '\\')
+				out = strf(out, "\\{}", c);
+			else if ((unsigned char)c < 0x20)
+				out = strf(out, "\\u{:04x}", int(c));
+			else
+				out = strf(out, "{}", c);
+		}
+		str_push(out, "\"");
+	}
+
+	// API
+	Task_Graph
+	task_graph_new(const char* name)
+	{
+		auto self = alloc_zerod<ITask_Graph>();
+		self->name = str_from_c(name);
+		self->nodes = buf_new<Task_Graph_Node_Info>();
+		self->roots = buf_new<Task_Graph_Node>();
+		self->remaining = 0;
+		self->wg = waitgroup_new();
+		return self;
+	}
+
+	void
+	task_graph_free(Task_Graph self)
+	{
+		mn_assert_msg(self->remaining.load() == 0, "task graph is freed while it's running");
+
+		for (auto& node: self->nodes)
+		{
+			str_free(node.name);
+			task_free(node.task);
+			buf_free(node.successors);
+		}
+		buf_free(self->nodes);
+		buf_free(self->roots);
+		if (self->pending)
+			free(Block{self->pending, sizeof(std::atomic<size_t>) * self->pending_capacity});
+		waitgroup_free(self->wg);
+		str_free(self->name);
+		free(self);
+	}
+
+	Task_Graph_Node
+	task_graph_node_add(Task_Graph self, const char* name, const Task<void()>& task, uint64_t cost)
+	{
+		mn_assert_msg(self->remaining.load() == 0, "task graph is changed while it's running");
+
+		Task_Graph_Node_Info node{};
+		node.name = str_from_c(name);
+		node.task = task;
+		node.cost = cost;
+		node.successors = buf_new<Task_Graph_Node>();
+		node.worker_index = -1;
+		buf_push(self->nodes, node);
+		return self->nodes.count - 1;
+	}
+
+	void
+	task_graph_edge(Task_Graph self, Task_Graph_Node before, Task_Graph_Node after)
+	{
+		mn_assert_msg(self->remaining.load() == 0, "task graph is changed while it's running");
+		mn_assert(before < self->nodes.count && after < self->nodes.count);
+
+		buf_push(self->nodes[before].successors, after);
+		++self->nodes[after].predecessors_count;
+	}
+
+	void
+	task_graph_run(Task_Graph self, Fabric fabric)
+	{
+		mn_assert_msg(self->remaining.load() == 0, "task graph is run while it's running");
+		if (self->nodes.count == 0)
+			return;
+
+		_task_graph_prepare(self);
+		self->fabric = fabric;
+		self->run_start_time_in_us = _task_graph_time_in_us();
+		self->run_duration_in_us = 0;
+		self->has_run = true;
+		self->remaining = self->nodes.count;
+		waitgroup_add(self->wg, 1);
+
+		// the roots are scheduled in the order of their critical paths so the most critical ones start first
+		for (auto root: self->roots)
+		{
+			Fabric_Task task{};
+			task.as_oneshot.task = Task<void()>::make([self, root]{ _task_graph_node_run(self, root); });
+			fabric_task_do(fabric, task);
+		}
+	}
+
+	void
+	task_graph_wait(Task_Graph self)
+	{
+		waitgroup_wait(self->wg);
+	}
+
+	Str
+	task_graph_trace(Task_Graph self, Allocator allocator)
+	{
+		mn_assert_msg(self->remaining.load() == 0, "task graph trace is requested while it's running");
+
+		auto res = str_with_allocator(allocator);
+		str_push(res, "{\"traceEvents\":[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":");
+		_task_graph_json_str_push(res, self->name);
+		str_push(res, "}}");
+		if (self->has_run)
+		{
+			for (const auto& node: self->nodes)
+			{
+				str_push(res, ",{\"name\":");
+				_task_graph_json_str_push(res, node.name);
+				res = strf(
+					res,
+					",\"cat\":\"task_graph\",\"ph\":\"X\",\"ts\":{},\"dur\":{},\"pid\":0,\"tid\":{},\"args\":{{\"critical_path_in_us\":{}}}}}",
+					node.start_time_in_us,
+					node.end_time_in_us - node.start_time_in_us,
+					node.worker_index,
+					node.critical_path
+				);
+			}
+		}
+		res = strf(res, "],\"displayTimeUnit\":\"ms\",\"otherData\":{{\"duration_in_us\":{}}}}}", self->run_duration_in_us);
+		return res;
+	}
+}
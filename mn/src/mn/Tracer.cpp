@@ -0,0 +1,865 @@
+#include "mn/Tracer.h"
+#include "mn/Context.h"
+#include "mn/Thread.h"
+#include "mn/Memory.h"
+#include "mn/Fmt.h"
+#include "mn/Assert.h"
+#include "mn/Defer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+#include <string.h>
+
+namespace mn
+{
+	constexpr static size_t TRACER_CHUNK_EVENTS_COUNT = 4096;
+	constexpr static size_t TRACER_DEFAULT_EVENTS_PER_THREAD_LIMIT = 1024 * 1024;
+	constexpr static uint64_t TRACER_DEFAULT_CONTENTION_THRESHOLD = 1000;
+	// each thread aggregates its lock stats in an open addressing table with this many locations, locks of the
+	// locations which don't fit aren't counted
+	constexpr static size_t TRACER_LOCK_LOCATIONS_COUNT = 128;
+	// maximum number of locks a thread can hold at the same time while being traced
+	constexpr static size_t TRACER_LOCK_STACK_CAPACITY = 32;
+
+	enum TRACER_EVENT: uint8_t
+	{
+		TRACER_EVENT_THREAD_NEW,
+		TRACER_EVENT_JOB,
+		TRACER_EVENT_MUTEX_WAIT,
+		TRACER_EVENT_ALLOC,
+		TRACER_EVENT_FREE,
+		TRACER_EVENT_SYSMON,
+	};
+
+	struct Tracer_Event
+	{
+		// times are relative to the start of the recording
+		uint64_t time_in_ns;
+		uint64_t duration_in_ns;
+		// the mutex handle, or the allocated/freed memory
+		const void* ptr;
+		// the lock location of mutex events, or the decision of sysmon events
+		const void* data;
+		// the memory size of memory events, the worker index of sysmon events
+		uint64_t value;
+		// the moved jobs count of sysmon events
+		uint32_t count;
+		TRACER_EVENT kind;
+	};
+
+	// events are appended to fixed size chunks, the count of each chunk is published using a release store after
+	// the event is written so that the exporter only reads complete events
+	struct Tracer_Chunk
+	{
+		Tracer_Event events[TRACER_CHUNK_EVENTS_COUNT];
+		std::atomic<size_t> count;
+		std::atomic<Tracer_Chunk*> next;
+	};
+
+	// lock stats of all the mutexes with the same key (source location or name) which were locked by a thread
+	struct Tracer_Lock_Location
+	{
+		// the source location if the mutex has one, its name otherwise, it's published after srcloc and name
+		std::atomic<const void*> key;
+		const Source_Location* srcloc;
+		const char* name;
+		std::atomic<uint64_t> locks_count;
+		std::atomic<uint64_t> contended_count;
+		std::atomic<uint64_t> total_wait_in_ns;
+		std::atomic<uint64_t> max_wait_in_ns;
+		std::atomic<uint64_t> total_hold_in_ns;
+	};
+
+	// a lock which the thread is waiting on or holding
+	struct Tracer_Lock
+	{
+		const void* handle;
+		uint64_t start_time_in_ns;
+		// 0 while the thread is still waiting for the lock
+		uint64_t acquire_time_in_ns;
+		Tracer_Lock_Location* location;
+		// whether the previous hooks asked for the after lock call
+		bool forward_after_lock;
+	};
+
+	// the buffer of a recorded thread, buffers are never freed, they're reused by new threads once their thread
+	// exits and their events belong to an older recording
+	struct Tracer_Thread
+	{
+		Tracer_Thread* next;
+		std::atomic<bool> in_use;
+		// the recording the events belong to, the owner thread discards its events once it sees a newer recording
+		std::atomic<uint64_t> session;
+		uint64_t id;
+		// the name is published by has_name
+		char name[64];
+		std::atomic<bool> has_name;
+
+		std::atomic<Tracer_Chunk*> head;
+		std::atomic<size_t> events_count;
+		std::atomic<uint64_t> dropped_events_count;
+
+		std::atomic<uint64_t> jobs_count;
+		std::atomic<uint64_t> busy_time_in_ns;
+		std::atomic<uint64_t> lock_wait_in_ns;
+		std::atomic<uint64_t> allocations_count;
+		std::atomic<uint64_t> allocated_bytes;
+		std::atomic<uint64_t> frees_count;
+		std::atomic<uint64_t> freed_bytes;
+		Tracer_Lock_Location locations[TRACER_LOCK_LOCATIONS_COUNT];
+
+		// the rest is only accessed by the owner thread
+		// the chunk the next event is appended to, null if it's the head chunk
+		Tracer_Chunk* tail;
+		Tracer_Lock locks[TRACER_LOCK_STACK_CAPACITY];
+		size_t locks_count;
+		uint64_t job_start_time_in_ns;
+		bool in_job;
+	};
+
+	static std::atomic<Tracer_Thread*> TRACER_THREADS = nullptr;
+	static std::atomic<uint64_t> TRACER_THREADS_COUNT = 0;
+	// the current recording, 0 before the first recording
+	static std::atomic<uint64_t> TRACER_SESSION = 0;
+	static std::atomic<bool> TRACER_RECORDING = false;
+	static std::atomic<uint64_t> TRACER_START_TIME = 0;
+	static std::atomic<uint64_t> TRACER_STOP_TIME = 0;
+	static Tracer_Settings TRACER_SETTINGS;
+	static Thread_Profile_Interface TRACER_PREV_THREAD;
+	static Memory_Profile_Interface TRACER_PREV_MEMORY;
+	std::atomic<bool> _TRACER_FABRIC = false;
+
+	struct Tracer_Local
+	{
+		Tracer_Thread* thread;
+		// set while the tracer itself runs on this thread (e.g. allocating a chunk), so that the hooks it triggers
+		// aren't recorded
+		bool busy;
+
+		~Tracer_Local();
+	};
+
+	thread_local Tracer_Local TRACER_LOCAL;
+	// hooks might be called by other thread local destructors after the tracer local is destroyed
+	thread_local bool TRACER_LOCAL_EXITED = false;
+
+	Tracer_Local::~Tracer_Local()
+	{
+		TRACER_LOCAL_EXITED = true;
+		if (thread)
+			thread->in_use.store(false);
+		thread = nullptr;
+	}
+
+	inline static uint64_t
+	_tracer_time_in_ns()
+	{
+		auto now = std::chrono::steady_clock::now().time_since_epoch();
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+	}
+
+	inline static uint64_t
+	_tracer_now()
+	{
+		return _tracer_time_in_ns() - TRACER_START_TIME.load(std::memory_order_relaxed);
+	}
+
+	inline static void
+	_tracer_name_set(Tracer_Thread* self, const char* name)
+	{
+		::strncpy(self->name, name, sizeof(self->name) - 1);
+		self->name[sizeof(self->name) - 1] = '\0';
+		self->has_name.store(true, std::memory_order_release);
+	}
+
+	inline static Tracer_Thread*
+	_tracer_thread_register()
+	{
+		auto session = TRACER_SESSION.load();
+		for (auto it = TRACER_THREADS.load(); it; it = it->next)
+		{
+			auto in_use = false;
+			if (it->in_use.load() == false && it->session.load() != session &&
+				it->in_use.compare_exchange_strong(in_use, true))
+			{
+				return it;
+			}
+		}
+
+		auto self = ::new (memory::clib()->alloc(sizeof(Tracer_Thread), alignof(Tracer_Thread)).ptr) Tracer_Thread{};
+		self->in_use.store(true);
+		self->id = TRACER_THREADS_COUNT.fetch_add(1);
+		auto head = TRACER_THREADS.load();
+		do
+		{
+			self->next = head;
+		} while (TRACER_THREADS.compare_exchange_weak(head, self) == false);
+		return self;
+	}
+
+	// discards the events of the previous recording, the chunks are kept for the new events
+	inline static void
+	_tracer_thread_reset(Tracer_Thread* self, uint64_t session)
+	{
+		for (auto chunk = self->head.load(); chunk; chunk = chunk->next.load())
+			chunk->count.store(0);
+		self->tail = nullptr;
+		self->has_name.store(false);
+		self->events_count.store(0);
+		self->dropped_events_count.store(0);
+		self->jobs_count.store(0);
+		self->busy_time_in_ns.store(0);
+		self->lock_wait_in_ns.store(0);
+		self->allocations_count.store(0);
+		self->allocated_bytes.store(0);
+		self->frees_count.store(0);
+		self->freed_bytes.store(0);
+		for (auto& location: self->locations)
+		{
+			location.key.store(nullptr);
+			location.locks_count.store(0);
+			location.contended_count.store(0);
+			location.total_wait_in_ns.store(0);
+			location.max_wait_in_ns.store(0);
+			location.total_hold_in_ns.store(0);
+		}
+		self->locks_count = 0;
+		self->in_job = false;
+		self->session.store(session, std::memory_order_release);
+	}
+
+	// returns the buffer of the calling thread, or null if the event shouldn't be recorded
+	inline static Tracer_Thread*
+	_tracer_thread()
+	{
+		if (TRACER_RECORDING.load(std::memory_order_relaxed) == false || TRACER_LOCAL_EXITED)
+			return nullptr;
+
+		auto& local = TRACER_LOCAL;
+		if (local.busy)
+			return nullptr;
+
+		if (local.thread == nullptr)
+		{
+			local.busy = true;
+			local.thread = _tracer_thread_register();
+			local.busy = false;
+		}
+
+		auto self = local.thread;
+		auto session = TRACER_SESSION.load(std::memory_order_acquire);
+		if (self->session.load(std::memory_order_relaxed) != session)
+			_tracer_thread_reset(self, session);
+		return self;
+	}
+
+	inline static void
+	_tracer_event_push(Tracer_Thread* self, const Tracer_Event& event)
+	{
+		if (self->events_count.load(std::memory_order_relaxed) >= TRACER_SETTINGS.events_per_thread_limit)
+		{
+			self->dropped_events_count.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		auto chunk = self->tail;
+		if (chunk == nullptr || chunk->count.load(std::memory_order_relaxed) == TRACER_CHUNK_EVENTS_COUNT)
+		{
+			auto next = chunk ? chunk->next.load() : self->head.load();
+			if (next == nullptr)
+			{
+				TRACER_LOCAL.busy = true;
+				next = ::new (memory::clib()->alloc(sizeof(Tracer_Chunk), alignof(Tracer_Chunk)).ptr) Tracer_Chunk{};
+				TRACER_LOCAL.busy = false;
+
+				if (chunk)
+					chunk->next.store(next, std::memory_order_release);
+				else
+					self->head.store(next, std::memory_order_release);
+			}
+			self->tail = chunk = next;
+		}
+
+		auto count = chunk->count.load(std::memory_order_relaxed);
+		chunk->events[count] = event;
+		chunk->count.store(count + 1, std::memory_order_release);
+		self->events_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline static Tracer_Lock_Location*
+	_tracer_lock_location(Tracer_Thread* self, const Source_Location* srcloc, const char* name)
+	{
+		const void* key = srcloc ? (const void*)srcloc : (const void*)name;
+		auto hash = size_t(uintptr_t(key) * 0x9E3779B97F4A7C15ULL >> 32);
+		for (size_t i = 0; i < TRACER_LOCK_LOCATIONS_COUNT; ++i)
+		{
+			auto& location = self->locations[(hash + i) % TRACER_LOCK_LOCATIONS_COUNT];
+			auto location_key = location.key.load(std::memory_order_relaxed);
+			if (location_key == key)
+				return &location;
+
+			if (location_key == nullptr)
+			{
+				location.srcloc = srcloc;
+				location.name = srcloc ? srcloc->name : name;
+				location.key.store(key, std::memory_order_release);
+				return &location;
+			}
+		}
+		return nullptr;
+	}
+
+	// records the start of a lock wait, returns whether the after lock hook should be called
+	inline static bool
+	_tracer_lock_before(const void* handle, const Source_Location* srcloc, const char* name, bool forward)
+	{
+		auto self = _tracer_thread();
+		if (self == nullptr || self->locks_count == TRACER_LOCK_STACK_CAPACITY)
+			return forward;
+
+		auto& lock = self->locks[self->locks_count++];
+		lock.handle = handle;
+		lock.start_time_in_ns = _tracer_now();
+		lock.acquire_time_in_ns = 0;
+		lock.location = _tracer_lock_location(self, srcloc, name);
+		lock.forward_after_lock = forward;
+		return true;
+	}
+
+	// records the end of a lock wait, returns whether the after lock hook should be forwarded
+	inline static bool
+	_tracer_lock_after(const void* handle)
+	{
+		auto self = _tracer_thread();
+		if (self == nullptr)
+			return true;
+
+		for (size_t i = self->locks_count; i > 0; --i)
+		{
+			auto& lock = self->locks[i - 1];
+			if (lock.handle != handle || lock.acquire_time_in_ns != 0)
+				continue;
+
+			lock.acquire_time_in_ns = _tracer_now();
+			auto wait = lock.acquire_time_in_ns - lock.start_time_in_ns;
+			self->lock_wait_in_ns.fetch_add(wait, std::memory_order_relaxed);
+			auto contended = wait >= TRACER_SETTINGS.contention_threshold_in_ns;
+			if (auto location = lock.location)
+			{
+				location->locks_count.fetch_add(1, std::memory_order_relaxed);
+				location->total_wait_in_ns.fetch_add(wait, std::memory_order_relaxed);
+				if (wait > location->max_wait_in_ns.load(std::memory_order_relaxed))
+					location->max_wait_in_ns.store(wait, std::memory_order_relaxed);
+				if (contended)
+					location->contended_count.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			if (contended)
+			{
+				Tracer_Event event{};
+				event.kind = TRACER_EVENT_MUTEX_WAIT;
+				event.time_in_ns = lock.start_time_in_ns;
+				event.duration_in_ns = wait;
+				event.ptr = handle;
+				event.data = lock.location;
+				_tracer_event_push(self, event);
+			}
+			return lock.forward_after_lock;
+		}
+		return true;
+	}
+
+	inline static void
+	_tracer_unlock(const void* handle)
+	{
+		auto self = _tracer_thread();
+		if (self == nullptr)
+			return;
+
+		// locks are usually released in reverse order, but not always
+		for (size_t i = self->locks_count; i > 0; --i)
+		{
+			auto& lock = self->locks[i - 1];
+			if (lock.handle != handle || lock.acquire_time_in_ns == 0)
+				continue;
+
+			if (lock.location)
+				lock.location->total_hold_in_ns.fetch_add(_tracer_now() - lock.acquire_time_in_ns, std::memory_order_relaxed);
+			for (size_t j = i; j < self->locks_count; ++j)
+				self->locks[j - 1] = self->locks[j];
+			--self->locks_count;
+			return;
+		}
+	}
+
+	// hooks
+	static void
+	_tracer_thread_new(Thread handle, const char* name)
+	{
+		if (auto self = _tracer_thread())
+		{
+			_tracer_name_set(self, name);
+			Tracer_Event event{};
+			event.kind = TRACER_EVENT_THREAD_NEW;
+			event.time_in_ns = _tracer_now();
+			_tracer_event_push(self, event);
+		}
+
+		if (TRACER_PREV_THREAD.thread_new)
+			TRACER_PREV_THREAD.thread_new(handle, name);
+	}
+
+	static bool
+	_tracer_mutex_before_lock(Mutex handle, void* user_data)
+	{
+		bool forward = false;
+		if (TRACER_PREV_THREAD.mutex_before_lock)
+			forward = TRACER_PREV_THREAD.mutex_before_lock(handle, user_data);
+		return _tracer_lock_before(handle, mutex_source_location(handle), mutex_name(handle), forward);
+	}
+
+	static void
+	_tracer_mutex_after_lock(Mutex handle, void* user_data)
+	{
+		if (_tracer_lock_after(handle) && TRACER_PREV_THREAD.mutex_after_lock)
+			TRACER_PREV_THREAD.mutex_after_lock(handle, user_data);
+	}
+
+	static void
+	_tracer_mutex_after_unlock(Mutex handle, void* user_data)
+	{
+		_tracer_unlock(handle);
+		if (TRACER_PREV_THREAD.mutex_after_unlock)
+			TRACER_PREV_THREAD.mutex_after_unlock(handle, user_data);
+	}
+
+	static bool
+	_tracer_mutex_before_read_lock(Mutex_RW handle, void* user_data)
+	{
+		bool forward = false;
+		if (TRACER_PREV_THREAD.mutex_before_read_lock)
+			forward = TRACER_PREV_THREAD.mutex_before_read_lock(handle, user_data);
+		return _tracer_lock_before(handle, mutex_rw_source_location(handle), mutex_rw_name(handle), forward);
+	}
+
+	static void
+	_tracer_mutex_after_read_lock(Mutex_RW handle, void* user_data)
+	{
+		if (_tracer_lock_after(handle) && TRACER_PREV_THREAD.mutex_after_read_lock)
+			TRACER_PREV_THREAD.mutex_after_read_lock(handle, user_data);
+	}
+
+	static void
+	_tracer_mutex_after_read_unlock(Mutex_RW handle, void* user_data)
+	{
+		_tracer_unlock(handle);
+		if (TRACER_PREV_THREAD.mutex_after_read_unlock)
+			TRACER_PREV_THREAD.mutex_after_read_unlock(handle, user_data);
+	}
+
+	static bool
+	_tracer_mutex_before_write_lock(Mutex_RW handle, void* user_data)
+	{
+		bool forward = false;
+		if (TRACER_PREV_THREAD.mutex_before_write_lock)
+			forward = TRACER_PREV_THREAD.mutex_before_write_lock(handle, user_data);
+		return _tracer_lock_before(handle, mutex_rw_source_location(handle), mutex_rw_name(handle), forward);
+	}
+
+	static void
+	_tracer_mutex_after_write_lock(Mutex_RW handle, void* user_data)
+	{
+		if (_tracer_lock_after(handle) && TRACER_PREV_THREAD.mutex_after_write_lock)
+			TRACER_PREV_THREAD.mutex_after_write_lock(handle, user_data);
+	}
+
+	static void
+	_tracer_mutex_after_write_unlock(Mutex_RW handle, void* user_data)
+	{
+		_tracer_unlock(handle);
+		if (TRACER_PREV_THREAD.mutex_after_write_unlock)
+			TRACER_PREV_THREAD.mutex_after_write_unlock(handle, user_data);
+	}
+
+	static void
+	_tracer_profile_alloc(void*, void* ptr, size_t size)
+	{
+		if (auto self = _tracer_thread())
+		{
+			self->allocations_count.fetch_add(1, std::memory_order_relaxed);
+			self->allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+			Tracer_Event event{};
+			event.kind = TRACER_EVENT_ALLOC;
+			event.time_in_ns = _tracer_now();
+			event.ptr = ptr;
+			event.value = size;
+			_tracer_event_push(self, event);
+		}
+
+		if (TRACER_PREV_MEMORY.profile_alloc)
+			TRACER_PREV_MEMORY.profile_alloc(TRACER_PREV_MEMORY.self, ptr, size);
+	}
+
+	static void
+	_tracer_profile_free(void*, void* ptr, size_t size)
+	{
+		if (auto self = _tracer_thread())
+		{
+			self->frees_count.fetch_add(1, std::memory_order_relaxed);
+			self->freed_bytes.fetch_add(size, std::memory_order_relaxed);
+			Tracer_Event event{};
+			event.kind = TRACER_EVENT_FREE;
+			event.time_in_ns = _tracer_now();
+			event.ptr = ptr;
+			event.value = size;
+			_tracer_event_push(self, event);
+		}
+
+		if (TRACER_PREV_MEMORY.profile_free)
+			TRACER_PREV_MEMORY.profile_free(TRACER_PREV_MEMORY.self, ptr, size);
+	}
+
+	// calls the given function with each thread buffer of the current recording
+	template<typename TFunc>
+	inline static void
+	_tracer_threads_for_each(TFunc&& fn)
+	{
+		auto session = TRACER_SESSION.load();
+		for (auto it = TRACER_THREADS.load(); it; it = it->next)
+			if (it->session.load(std::memory_order_acquire) == session)
+				fn(it);
+	}
+
+	inline static uint64_t
+	_tracer_duration_in_ns()
+	{
+		auto stop_time = TRACER_STOP_TIME.load();
+		if (stop_time == 0)
+			stop_time = _tracer_time_in_ns();
+		return stop_time - TRACER_START_TIME.load();
+	}
+
+	inline static void
+	_tracer_json_str_push(Str& out, const char* str)
+	{
+		str_push(out, "\"");
+		for (auto it = str; *it; ++it)
+		{
+			auto c = *it;
+			if (c == '"' || c == '\\')
+				out = strf(out, "\\{}", c);
+			else if ((unsigned char)c < 0x20)
+				out = strf(out, "\\u{:04x}", int(c));
+			else
+				buf_push(out, c);
+		}
+		str_null_terminate(out);
+		str_push(out, "\"");
+	}
+
+	inline static void
+	_tracer_json_event_push(Str& out, const Tracer_Thread* thread, const Tracer_Event& event)
+	{
+		auto ts = double(event.time_in_ns) / 1000.0;
+		switch (event.kind)
+		{
+		case TRACER_EVENT_THREAD_NEW:
+			out = strf(
+				out,
+				",{{\"name\":\"thread_new\",\"cat\":\"thread\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3f},\"pid\":0,\"tid\":{}}}",
+				ts,
+				thread->id
+			);
+			break;
+		case TRACER_EVENT_JOB:
+			out = strf(
+				out,
+				",{{\"name\":\"job\",\"cat\":\"fabric\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":0,\"tid\":{}}}",
+				ts,
+				double(event.duration_in_ns) / 1000.0,
+				thread->id
+			);
+			break;
+		case TRACER_EVENT_MUTEX_WAIT:
+		{
+			auto location = (const Tracer_Lock_Location*)event.data;
+			str_push(out, ",{\"name\":");
+			_tracer_json_str_push(out, location ? location->name : "mutex");
+			out = strf(
+				out,
+				",\"cat\":\"mutex\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":0,\"tid\":{},\"args\":{{\"mutex\":\"{}\"",
+				ts,
+				double(event.duration_in_ns) / 1000.0,
+				thread->id,
+				event.ptr
+			);
+			if (location && location->srcloc)
+			{
+				str_push(out, ",\"location\":");
+				_tracer_json_str_push(out, str_tmpf("{}:{} ({})", location->srcloc->file, location->srcloc->line, location->srcloc->function).ptr);
+			}
+			str_push(out, "}}");
+			break;
+		}
+		case TRACER_EVENT_ALLOC:
+		case TRACER_EVENT_FREE:
+			out = strf(
+				out,
+				",{{\"name\":\"{}\",\"cat\":\"memory\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3f},\"pid\":0,\"tid\":{},\"args\":{{\"ptr\":\"{}\",\"size\":{}}}}}",
+				event.kind == TRACER_EVENT_ALLOC ? "alloc" : "free",
+				ts,
+				thread->id,
+				event.ptr,
+				event.value
+			);
+			break;
+		case TRACER_EVENT_SYSMON:
+			str_push(out, ",{\"name\":");
+			_tracer_json_str_push(out, (const char*)event.data);
+			out = strf(
+				out,
+				",\"cat\":\"sysmon\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3f},\"pid\":0,\"tid\":{},\"args\":{{\"worker\":{},\"jobs\":{}}}}}",
+				ts,
+				thread->id,
+				event.value,
+				event.count
+			);
+			break;
+		default:
+			mn_unreachable();
+			break;
+		}
+	}
+
+	// API
+	void
+	tracer_start(const Tracer_Settings& settings)
+	{
+		if (tracer_is_recording())
+			tracer_stop();
+
+		TRACER_SETTINGS = settings;
+		if (TRACER_SETTINGS.events_per_thread_limit == 0)
+			TRACER_SETTINGS.events_per_thread_limit = TRACER_DEFAULT_EVENTS_PER_THREAD_LIMIT;
+		if (TRACER_SETTINGS.contention_threshold_in_ns == 0)
+			TRACER_SETTINGS.contention_threshold_in_ns = TRACER_DEFAULT_CONTENTION_THRESHOLD;
+
+		TRACER_START_TIME.store(_tracer_time_in_ns());
+		TRACER_STOP_TIME.store(0);
+		TRACER_SESSION.fetch_add(1);
+
+		// the mutex creation hooks are left to the previous hooks because they own the mutexes user data
+		auto prev_thread = thread_profile_interface_set({});
+		Thread_Profile_Interface thread_hooks = prev_thread;
+		thread_hooks.thread_new = _tracer_thread_new;
+		if (settings.ignore_mutexes == false)
+		{
+			thread_hooks.mutex_before_lock = _tracer_mutex_before_lock;
+			thread_hooks.mutex_after_lock = _tracer_mutex_after_lock;
+			thread_hooks.mutex_after_unlock = _tracer_mutex_after_unlock;
+			thread_hooks.mutex_before_read_lock = _tracer_mutex_before_read_lock;
+			thread_hooks.mutex_after_read_lock = _tracer_mutex_after_read_lock;
+			thread_hooks.mutex_after_read_unlock = _tracer_mutex_after_read_unlock;
+			thread_hooks.mutex_before_write_lock = _tracer_mutex_before_write_lock;
+			thread_hooks.mutex_after_write_lock = _tracer_mutex_after_write_lock;
+			thread_hooks.mutex_after_write_unlock = _tracer_mutex_after_write_unlock;
+		}
+		TRACER_PREV_THREAD = prev_thread;
+		thread_profile_interface_set(thread_hooks);
+
+		if (settings.ignore_memory == false)
+		{
+			Memory_Profile_Interface memory_hooks{};
+			memory_hooks.profile_alloc = _tracer_profile_alloc;
+			memory_hooks.profile_free = _tracer_profile_free;
+			TRACER_PREV_MEMORY = memory_profile_interface_set(memory_hooks);
+		}
+
+		TRACER_RECORDING.store(true);
+		_TRACER_FABRIC.store(settings.ignore_fabric == false);
+	}
+
+	void
+	tracer_stop()
+	{
+		if (tracer_is_recording() == false)
+			return;
+
+		_TRACER_FABRIC.store(false);
+		TRACER_RECORDING.store(false);
+		TRACER_STOP_TIME.store(_tracer_time_in_ns());
+
+		thread_profile_interface_set(TRACER_PREV_THREAD);
+		if (TRACER_SETTINGS.ignore_memory == false)
+			memory_profile_interface_set(TRACER_PREV_MEMORY);
+		TRACER_PREV_THREAD = Thread_Profile_Interface{};
+		TRACER_PREV_MEMORY = Memory_Profile_Interface{};
+	}
+
+	bool
+	tracer_is_recording()
+	{
+		return TRACER_RECORDING.load();
+	}
+
+	Str
+	tracer_chrome_trace(Allocator allocator)
+	{
+		// the exporter's own allocations aren't recorded
+		auto busy = TRACER_LOCAL.busy;
+		TRACER_LOCAL.busy = true;
+		mn_defer{TRACER_LOCAL.busy = busy;};
+
+		auto res = str_with_allocator(allocator);
+		str_push(res, "{\"traceEvents\":[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"mn\"}}");
+		_tracer_threads_for_each([&](Tracer_Thread* thread) {
+			res = strf(res, ",{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":", thread->id);
+			if (thread->has_name.load(std::memory_order_acquire))
+				_tracer_json_str_push(res, thread->name);
+			else
+				_tracer_json_str_push(res, str_tmpf("thread #{}", thread->id).ptr);
+			str_push(res, "}}");
+
+			for (auto chunk = thread->head.load(std::memory_order_acquire); chunk; chunk = chunk->next.load(std::memory_order_acquire))
+			{
+				auto count = chunk->count.load(std::memory_order_acquire);
+				for (size_t i = 0; i < count; ++i)
+					_tracer_json_event_push(res, thread, chunk->events[i]);
+			}
+		});
+		res = strf(res, "],\"displayTimeUnit\":\"ns\",\"otherData\":{{\"duration_in_ns\":{}}}}}", _tracer_duration_in_ns());
+		return res;
+	}
+
+	Buf<Tracer_Lock_Stats>
+	tracer_lock_stats(Allocator allocator)
+	{
+		auto busy = TRACER_LOCAL.busy;
+		TRACER_LOCAL.busy = true;
+		mn_defer{TRACER_LOCAL.busy = busy;};
+
+		auto res = buf_with_allocator<Tracer_Lock_Stats>(allocator);
+		_tracer_threads_for_each([&](Tracer_Thread* thread) {
+			for (const auto& location: thread->locations)
+			{
+				auto key = location.key.load(std::memory_order_acquire);
+				if (key == nullptr)
+					continue;
+
+				Tracer_Lock_Stats* stats = nullptr;
+				for (auto& it: res)
+				{
+					if ((it.srcloc ? (const void*)it.srcloc : (const void*)it.name) == key)
+					{
+						stats = &it;
+						break;
+					}
+				}
+				if (stats == nullptr)
+				{
+					Tracer_Lock_Stats new_stats{};
+					new_stats.srcloc = location.srcloc;
+					new_stats.name = location.name;
+					buf_push(res, new_stats);
+					stats = &buf_top(res);
+				}
+
+				stats->locks_count += location.locks_count.load(std::memory_order_relaxed);
+				stats->contended_count += location.contended_count.load(std::memory_order_relaxed);
+				stats->total_wait_in_ns += location.total_wait_in_ns.load(std::memory_order_relaxed);
+				stats->total_hold_in_ns += location.total_hold_in_ns.load(std::memory_order_relaxed);
+				auto max_wait = location.max_wait_in_ns.load(std::memory_order_relaxed);
+				if (max_wait > stats->max_wait_in_ns)
+					stats->max_wait_in_ns = max_wait;
+			}
+		});
+
+		std::sort(begin(res), end(res), [](const Tracer_Lock_Stats& a, const Tracer_Lock_Stats& b) {
+			return a.total_wait_in_ns > b.total_wait_in_ns;
+		});
+		return res;
+	}
+
+	Buf<Tracer_Thread_Stats>
+	tracer_thread_stats(Allocator allocator)
+	{
+		auto busy = TRACER_LOCAL.busy;
+		TRACER_LOCAL.busy = true;
+		mn_defer{TRACER_LOCAL.busy = busy;};
+
+		auto duration = _tracer_duration_in_ns();
+		auto res = buf_with_allocator<Tracer_Thread_Stats>(allocator);
+		_tracer_threads_for_each([&](Tracer_Thread* thread) {
+			Tracer_Thread_Stats stats{};
+			if (thread->has_name.load(std::memory_order_acquire))
+				::memcpy(stats.name, thread->name, sizeof(stats.name));
+			else
+				::snprintf(stats.name, sizeof(stats.name), "thread #%llu", (unsigned long long)thread->id);
+			stats.id = thread->id;
+			stats.jobs_count = thread->jobs_count.load(std::memory_order_relaxed);
+			stats.busy_time_in_ns = thread->busy_time_in_ns.load(std::memory_order_relaxed);
+			stats.utilization = duration > 0 ? double(stats.busy_time_in_ns) / double(duration) : 0;
+			stats.lock_wait_in_ns = thread->lock_wait_in_ns.load(std::memory_order_relaxed);
+			stats.allocations_count = thread->allocations_count.load(std::memory_order_relaxed);
+			stats.allocated_bytes = thread->allocated_bytes.load(std::memory_order_relaxed);
+			stats.frees_count = thread->frees_count.load(std::memory_order_relaxed);
+			stats.freed_bytes = thread->freed_bytes.load(std::memory_order_relaxed);
+			stats.dropped_events_count = thread->dropped_events_count.load(std::memory_order_relaxed);
+			buf_push(res, stats);
+		});
+		return res;
+	}
+
+	void
+	_tracer_job_begin(const char* worker_name)
+	{
+		auto self = _tracer_thread();
+		if (self == nullptr)
+			return;
+
+		if (self->has_name.load(std::memory_order_relaxed) == false)
+			_tracer_name_set(self, worker_name);
+		self->job_start_time_in_ns = _tracer_now();
+		self->in_job = true;
+	}
+
+	void
+	_tracer_job_end()
+	{
+		auto self = _tracer_thread();
+		if (self == nullptr || self->in_job == false)
+			return;
+
+		self->in_job = false;
+		auto duration = _tracer_now() - self->job_start_time_in_ns;
+		self->jobs_count.fetch_add(1, std::memory_order_relaxed);
+		self->busy_time_in_ns.fetch_add(duration, std::memory_order_relaxed);
+
+		Tracer_Event event{};
+		event.kind = TRACER_EVENT_JOB;
+		event.time_in_ns = self->job_start_time_in_ns;
+		event.duration_in_ns = duration;
+		_tracer_event_push(self, event);
+	}
+
+	void
+	_tracer_sysmon_decision(const char* sysmon_name, const char* decision, size_t worker_index, size_t count)
+	{
+		auto self = _tracer_thread();
+		if (self == nullptr)
+			return;
+
+		if (self->has_name.load(std::memory_order_relaxed) == false)
+			_tracer_name_set(self, sysmon_name);
+
+		Tracer_Event event{};
+		event.kind = TRACER_EVENT_SYSMON;
+		event.time_in_ns = _tracer_now();
+		event.data = decision;
+		event.value = worker_index;
+		event.count = uint32_t(count);
+		_tracer_event_push(self, event);
+	}
+}
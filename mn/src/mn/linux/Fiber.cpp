@@ -0,0 +1,416 @@
+#include "mn/Fiber.h"
+#include "mn/Thread.h"
+#include "mn/Virtual_Memory.h"
+#include "mn/Memory.h"
+#include "mn/Context.h"
+#include "mn/Defer.h"
+#include "mn/Assert.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <limits.h>
+
+#if !defined(__x86_64__) && !defined(__aarch64__)
+#include <ucontext.h>
+#endif
+
+// the context switch saves the callee saved registers on the suspended stack and switches the stack pointer, so
+// a switch costs about as much as a function call, a fresh fiber stack is laid out as if it was suspended in the
+// switch function and its return address points to the trampoline which calls the entry function
+#if defined(__x86_64__)
+asm(R"(
+	.pushsection .text
+	.globl mn_fiber_switch
+	.hidden mn_fiber_switch
+	.type mn_fiber_switch,@function
+	.p2align 4
+mn_fiber_switch:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size mn_fiber_switch,.-mn_fiber_switch
+
+	.globl mn_fiber_trampoline
+	.hidden mn_fiber_trampoline
+	.type mn_fiber_trampoline,@function
+	.p2align 4
+mn_fiber_trampoline:
+	movq %r12, %rdi
+	callq *%r13
+	ud2
+	.size mn_fiber_trampoline,.-mn_fiber_trampoline
+	.popsection
+)");
+#elif defined(__aarch64__)
+asm(R"(
+	.pushsection .text
+	.globl mn_fiber_switch
+	.hidden mn_fiber_switch
+	.type mn_fiber_switch,%function
+	.p2align 4
+mn_fiber_switch:
+	sub sp, sp, #160
+	stp x19, x20, [sp, #0]
+	stp x21, x22, [sp, #16]
+	stp x23, x24, [sp, #32]
+	stp x25, x26, [sp, #48]
+	stp x27, x28, [sp, #64]
+	stp x29, x30, [sp, #80]
+	stp d8, d9, [sp, #96]
+	stp d10, d11, [sp, #112]
+	stp d12, d13, [sp, #128]
+	stp d14, d15, [sp, #144]
+	mov x9, sp
+	str x9, [x0]
+	mov sp, x1
+	ldp x19, x20, [sp, #0]
+	ldp x21, x22, [sp, #16]
+	ldp x23, x24, [sp, #32]
+	ldp x25, x26, [sp, #48]
+	ldp x27, x28, [sp, #64]
+	ldp x29, x30, [sp, #80]
+	ldp d8, d9, [sp, #96]
+	ldp d10, d11, [sp, #112]
+	ldp d12, d13, [sp, #128]
+	ldp d14, d15, [sp, #144]
+	add sp, sp, #160
+	ret
+	.size mn_fiber_switch,.-mn_fiber_switch
+
+	.globl mn_fiber_trampoline
+	.hidden mn_fiber_trampoline
+	.type mn_fiber_trampoline,%function
+	.p2align 4
+mn_fiber_trampoline:
+	mov x0, x19
+	blr x20
+	brk #0
+	.size mn_fiber_trampoline,.-mn_fiber_trampoline
+	.popsection
+)");
+#endif
+
+#if defined(__x86_64__) || defined(__aarch64__)
+extern "C" void mn_fiber_switch(void** from_sp, void* to_sp);
+extern "C" void mn_fiber_trampoline();
+#endif
+
+namespace mn
+{
+	inline static size_t
+	_fiber_page_size()
+	{
+		static size_t page_size = size_t(::sysconf(_SC_PAGESIZE));
+		return page_size;
+	}
+
+	#if !defined(__x86_64__) && !defined(__aarch64__)
+	// makecontext can only pass int arguments, so the fiber being started is passed in this variable instead
+	thread_local Fiber_Context* FIBER_STARTING = nullptr;
+
+	static void
+	_fiber_ucontext_main()
+	{
+		auto self = FIBER_STARTING;
+		self->entry(self->arg);
+		mn_unreachable();
+	}
+	#endif
+
+	// API
+	bool
+	_fiber_context_thread_init([[maybe_unused]] Fiber_Context& self)
+	{
+		#if !defined(__x86_64__) && !defined(__aarch64__)
+		self.handle = alloc_zerod<ucontext_t>();
+		#endif
+		return true;
+	}
+
+	void
+	_fiber_context_thread_free([[maybe_unused]] Fiber_Context& self)
+	{
+		#if !defined(__x86_64__) && !defined(__aarch64__)
+		free((ucontext_t*)self.handle);
+		self.handle = nullptr;
+		#endif
+	}
+
+	bool
+	_fiber_context_init(Fiber_Context& self, size_t stack_size, void (*entry)(void*), void* arg)
+	{
+		// the stack grows down so the guard page is placed below it, this way stack overflows fault instead of
+		// silently corrupting the memory before it
+		auto page_size = _fiber_page_size();
+		stack_size = (stack_size + page_size - 1) & ~(page_size - 1);
+		auto mapping = virtual_reserve(nullptr, stack_size + page_size);
+		if (mapping.ptr == nullptr)
+			return false;
+
+		if (virtual_commit(Block{(char*)mapping.ptr + page_size, stack_size}) == false)
+		{
+			virtual_free(mapping);
+			return false;
+		}
+
+		self = Fiber_Context{};
+		self.stack = mapping;
+		self.entry = entry;
+		self.arg = arg;
+
+		auto top = ((uintptr_t)mapping.ptr + mapping.size) & ~uintptr_t(15);
+		#if defined(__x86_64__)
+			// mxcsr/x87 control word, r15, r14, r13, r12, rbx, rbp, return address, the stack is aligned such that
+			// the trampoline calls the entry function with a 16 byte aligned stack
+			auto sp = (uint64_t*)(top - 80);
+			sp[0] = 0x1F80 | (uint64_t(0x037F) << 32);
+			sp[1] = 0;
+			sp[2] = 0;
+			sp[3] = (uint64_t)entry;
+			sp[4] = (uint64_t)arg;
+			sp[5] = 0;
+			sp[6] = 0;
+			sp[7] = (uint64_t)mn_fiber_trampoline;
+			self.sp = sp;
+		#elif defined(__aarch64__)
+			// x19-x28, x29 (frame pointer), x30 (link register), and d8-d15
+			auto sp = (uint64_t*)(top - 160);
+			for (size_t i = 0; i < 20; ++i)
+				sp[i] = 0;
+			sp[0] = (uint64_t)arg;
+			sp[1] = (uint64_t)entry;
+			sp[11] = (uint64_t)mn_fiber_trampoline;
+			self.sp = sp;
+		#else
+			auto context = alloc_zerod<ucontext_t>();
+			::getcontext(context);
+			context->uc_stack.ss_sp = (char*)mapping.ptr + page_size;
+			context->uc_stack.ss_size = stack_size;
+			context->uc_link = nullptr;
+			::makecontext(context, _fiber_ucontext_main, 0);
+			self.handle = context;
+		#endif
+		return true;
+	}
+
+	void
+	_fiber_context_free(Fiber_Context& self)
+	{
+		#if !defined(__x86_64__) && !defined(__aarch64__)
+		free((ucontext_t*)self.handle);
+		#endif
+		if (self.stack.ptr)
+			virtual_free(self.stack);
+		self = Fiber_Context{};
+	}
+
+	void
+	_fiber_context_switch(Fiber_Context& from, Fiber_Context& to)
+	{
+		#if defined(__x86_64__) || defined(__aarch64__)
+			mn_fiber_switch(&from.sp, to.sp);
+		#else
+			FIBER_STARTING = &to;
+			::swapcontext((ucontext_t*)from.handle, (ucontext_t*)to.handle);
+		#endif
+	}
+
+
+	// the poller is a process wide thread which waits on an epoll instance, waits are registered as oneshot events
+	// so each one fires at most once, and the waits with deadlines are kept in a list which the poller expires
+	struct Linux_Fiber_Poller
+	{
+		int epoll_fd;
+		int wake_fd;
+		bool running;
+		// protects the timed waits list and the wake deadline
+		pthread_mutex_t mtx;
+		Poll_Wait* timed_waits;
+		// the deadline the poller is currently sleeping until
+		uint64_t wake_deadline_in_ms;
+	};
+
+	inline static void
+	_linux_poller_unlink(Linux_Fiber_Poller* self, Poll_Wait* wait)
+	{
+		if (wait->prev)
+			wait->prev->next = wait->next;
+		else
+			self->timed_waits = wait->next;
+		if (wait->next)
+			wait->next->prev = wait->prev;
+		wait->prev = nullptr;
+		wait->next = nullptr;
+	}
+
+	static void*
+	_linux_poller_main(void* poller)
+	{
+		auto self = (Linux_Fiber_Poller*)poller;
+		_disable_profiling_for_this_thread();
+
+		epoll_event events[64];
+		while (true)
+		{
+			int timeout = -1;
+			{
+				pthread_mutex_lock(&self->mtx);
+				uint64_t deadline = UINT64_MAX;
+				for (auto it = self->timed_waits; it; it = it->next)
+					if (it->deadline_in_ms < deadline)
+						deadline = it->deadline_in_ms;
+				self->wake_deadline_in_ms = deadline;
+				pthread_mutex_unlock(&self->mtx);
+
+				if (deadline != UINT64_MAX)
+				{
+					auto now = time_in_millis();
+					timeout = 0;
+					if (deadline > now)
+						timeout = deadline - now < INT_MAX ? int(deadline - now) : INT_MAX;
+				}
+			}
+
+			auto count = ::epoll_wait(self->epoll_fd, events, 64, timeout);
+			for (int i = 0; i < count; ++i)
+			{
+				auto wait = (Poll_Wait*)events[i].data.ptr;
+				if (wait == nullptr)
+				{
+					uint64_t value = 0;
+					[[maybe_unused]] auto res = ::read(self->wake_fd, &value, sizeof(value));
+					continue;
+				}
+
+				if (wait->deadline_in_ms != UINT64_MAX)
+				{
+					pthread_mutex_lock(&self->mtx);
+					_linux_poller_unlink(self, wait);
+					pthread_mutex_unlock(&self->mtx);
+				}
+				::epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, int(wait->fd), nullptr);
+				wait->on_done(wait, true);
+			}
+
+			// expire the timed out waits, they're moved to a separate list first so that the callbacks are called
+			// without holding the mutex
+			Poll_Wait* expired = nullptr;
+			{
+				auto now = time_in_millis();
+				pthread_mutex_lock(&self->mtx);
+				auto it = self->timed_waits;
+				while (it)
+				{
+					auto next = it->next;
+					if (it->deadline_in_ms <= now)
+					{
+						_linux_poller_unlink(self, it);
+						it->next = expired;
+						expired = it;
+					}
+					it = next;
+				}
+				pthread_mutex_unlock(&self->mtx);
+			}
+
+			while (expired)
+			{
+				auto wait = expired;
+				expired = expired->next;
+				::epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, int(wait->fd), nullptr);
+				wait->on_done(wait, false);
+			}
+		}
+		return nullptr;
+	}
+
+	inline static Linux_Fiber_Poller*
+	_linux_poller()
+	{
+		static Linux_Fiber_Poller* poller = []{
+			// the poller lives as long as the process, so it's never freed
+			static Linux_Fiber_Poller self{};
+			::pthread_mutex_init(&self.mtx, nullptr);
+			self.wake_deadline_in_ms = UINT64_MAX;
+			self.epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+			self.wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (self.epoll_fd == -1 || self.wake_fd == -1)
+				return &self;
+
+			epoll_event event{};
+			event.events = EPOLLIN;
+			event.data.ptr = nullptr;
+			if (::epoll_ctl(self.epoll_fd, EPOLL_CTL_ADD, self.wake_fd, &event) == -1)
+				return &self;
+
+			pthread_t thread;
+			if (::pthread_create(&thread, nullptr, _linux_poller_main, &self) != 0)
+				return &self;
+			::pthread_detach(thread);
+			self.running = true;
+			return &self;
+		}();
+		return poller;
+	}
+
+	bool
+	_poll_wait_start(Poll_Wait* wait)
+	{
+		auto self = _linux_poller();
+		if (self->running == false)
+			return false;
+
+		wait->prev = nullptr;
+		wait->next = nullptr;
+
+		epoll_event event{};
+		event.events = (wait->write ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+		event.data.ptr = wait;
+
+		// the wait is registered and linked under the mutex so that the poller can't complete it before it's linked
+		bool wake = false;
+		{
+			pthread_mutex_lock(&self->mtx);
+			mn_defer{pthread_mutex_unlock(&self->mtx);};
+
+			if (::epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, int(wait->fd), &event) == -1)
+				return false;
+
+			if (wait->deadline_in_ms != UINT64_MAX)
+			{
+				wait->next = self->timed_waits;
+				if (self->timed_waits)
+					self->timed_waits->prev = wait;
+				self->timed_waits = wait;
+				wake = wait->deadline_in_ms < self->wake_deadline_in_ms;
+			}
+		}
+
+		if (wake)
+		{
+			uint64_t value = 1;
+			[[maybe_unused]] auto res = ::write(self->wake_fd, &value, sizeof(value));
+		}
+		return true;
+	}
+}
@@ -2,6 +2,7 @@
 #include "mn/OS.h"
 #include "mn/Fabric.h"
 #include "mn/Assert.h"
+#include "mn/Defer.h"
 
 #define _LARGEFILE64_SOURCE 1
 #include <sys/sysinfo.h>
@@ -14,6 +15,7 @@
 #include <errno.h>
 #include <dirent.h>
 #include <linux/limits.h>
+#include <sys/uio.h>
 
 namespace mn
 {
@@ -341,6 +343,176 @@ namespace mn
 		return fcntl(self->linux_handle, F_SETLK, &fl) != -1;
 	}
 
+	size_t
+	file_read_at(File self, int64_t offset, Block data)
+	{
+		mn_assert(offset >= 0);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		size_t total = 0;
+		while (total < data.size)
+		{
+			auto res = ::pread64(self->linux_handle, (char*)data.ptr + total, data.size - total, offset + total);
+			if (res < 0 && errno == EINTR)
+				continue;
+			if (res <= 0)
+				break;
+			total += res;
+		}
+		return total;
+	}
+
+	size_t
+	file_write_at(File self, int64_t offset, Block data)
+	{
+		mn_assert(offset >= 0);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		size_t total = 0;
+		while (total < data.size)
+		{
+			auto res = ::pwrite64(self->linux_handle, (char*)data.ptr + total, data.size - total, offset + total);
+			if (res < 0 && errno == EINTR)
+				continue;
+			if (res <= 0)
+				break;
+			total += res;
+		}
+		return total;
+	}
+
+	// number of iovecs we pass to a single preadv/pwritev call
+	constexpr static size_t FILE_IOV_BATCH = 64;
+
+	template<typename TFunc>
+	inline static size_t
+	_file_vectored_at(int64_t offset, const Block* blocks, size_t blocks_count, TFunc&& io)
+	{
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		size_t total = 0;
+		size_t index = 0;
+		// bytes already transferred of blocks[index] after a partial transfer
+		size_t partial = 0;
+		while (index < blocks_count)
+		{
+			iovec iov[FILE_IOV_BATCH];
+			int iov_count = 0;
+			size_t requested = 0;
+			for (size_t i = index; i < blocks_count && iov_count < int(FILE_IOV_BATCH); ++i)
+			{
+				auto skip = i == index ? partial : 0;
+				iov[iov_count].iov_base = (char*)blocks[i].ptr + skip;
+				iov[iov_count].iov_len = blocks[i].size - skip;
+				requested += iov[iov_count].iov_len;
+				++iov_count;
+			}
+
+			auto res = io(iov, iov_count, offset + total);
+			if (res < 0 && errno == EINTR)
+				continue;
+			if (res <= 0)
+				break;
+			total += res;
+
+			// advance over the fully transferred blocks
+			size_t transferred = size_t(res) + partial;
+			while (index < blocks_count && transferred >= blocks[index].size)
+			{
+				transferred -= blocks[index].size;
+				++index;
+			}
+			partial = transferred;
+
+			// a short transfer means we hit the end of the file (or the disk is full)
+			if (size_t(res) < requested)
+				break;
+		}
+		return total;
+	}
+
+	size_t
+	file_readv_at(File self, int64_t offset, const Block* blocks, size_t blocks_count)
+	{
+		mn_assert(offset >= 0);
+		return _file_vectored_at(offset, blocks, blocks_count, [self](const iovec* iov, int count, int64_t at) {
+			return ::preadv64(self->linux_handle, iov, count, at);
+		});
+	}
+
+	size_t
+	file_writev_at(File self, int64_t offset, const Block* blocks, size_t blocks_count)
+	{
+		mn_assert(offset >= 0);
+		return _file_vectored_at(offset, blocks, blocks_count, [self](const iovec* iov, int count, int64_t at) {
+			return ::pwritev64(self->linux_handle, iov, count, at);
+		});
+	}
+
+	bool
+	file_preallocate(File self, int64_t offset, int64_t size)
+	{
+		mn_assert(offset >= 0 && size >= 0);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		int res = 0;
+		do
+		{
+			res = ::fallocate64(self->linux_handle, 0, offset, size);
+		} while (res != 0 && errno == EINTR);
+
+		// filesystems without fallocate support (like older nfs) go through the slow glibc emulation
+		if (res != 0 && errno == EOPNOTSUPP)
+			return ::posix_fallocate64(self->linux_handle, offset, size) == 0;
+		return res == 0;
+	}
+
+	bool
+	file_access_hint(File self, int64_t offset, int64_t size, FILE_ACCESS_HINT hint)
+	{
+		mn_assert(offset >= 0 && size >= 0);
+
+		int advice = POSIX_FADV_NORMAL;
+		switch (hint)
+		{
+		case FILE_ACCESS_HINT_NORMAL:
+			advice = POSIX_FADV_NORMAL;
+			break;
+		case FILE_ACCESS_HINT_SEQUENTIAL:
+			advice = POSIX_FADV_SEQUENTIAL;
+			break;
+		case FILE_ACCESS_HINT_RANDOM:
+			advice = POSIX_FADV_RANDOM;
+			break;
+		case FILE_ACCESS_HINT_WILL_NEED:
+		{
+			// readahead starts the io right away instead of leaving it to the page cache heuristics
+			// it needs an explicit size though
+			auto len = size;
+			if (len == 0)
+				len = file_size(self) - offset;
+			if (len > 0 && ::readahead(self->linux_handle, offset, len) == 0)
+				return true;
+			advice = POSIX_FADV_WILLNEED;
+			break;
+		}
+		case FILE_ACCESS_HINT_DONT_NEED:
+			advice = POSIX_FADV_DONTNEED;
+			break;
+		default:
+			mn_unreachable();
+			break;
+		}
+		return ::posix_fadvise64(self->linux_handle, offset, size, advice) == 0;
+	}
+
 	struct IMapped_File
 	{
 		Mapped_File file_view;
@@ -349,7 +521,7 @@ namespace mn
 	};
 
 	Mapped_File*
-	file_mmap(File file, int64_t offset, int64_t size, IO_MODE io_mode)
+	file_mmap(File file, int64_t offset, int64_t size, IO_MODE io_mode, const Virtual_Map_Options& options)
 	{
 		int prot = PROT_READ;
 		int flags = MAP_PRIVATE;
@@ -384,6 +556,9 @@ namespace mn
 				return nullptr;
 		}
 
+		if (options.populate)
+			flags |= MAP_POPULATE;
+
 		auto ptr = ::mmap(
 			NULL,
 			size,
@@ -393,9 +568,15 @@ namespace mn
 			offset
 		);
 
-		if (ptr == nullptr)
+		if (ptr == MAP_FAILED)
 			return nullptr;
 
+		if (virtual_advise(Block{ptr, size_t(size)}, options) == false)
+		{
+			::munmap(ptr, size);
+			return nullptr;
+		}
+
 		auto self = alloc_zerod<IMapped_File>();
 		self->file_view.data.ptr = ptr;
 		self->file_view.data.size = size;
@@ -404,14 +585,14 @@ namespace mn
 	}
 
 	Mapped_File*
-	file_mmap(const Str& filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode)
+	file_mmap(const Str& filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode, const Virtual_Map_Options& options)
 	{
 		auto file = file_open(filename, io_mode, open_mode, share_mode);
 		if (file == nullptr)
 			return nullptr;
 		mn_defer{if (file) file_close(file);};
 
-		auto res = file_mmap(file, offset, size, io_mode);
+		auto res = file_mmap(file, offset, size, io_mode, options);
 		if (res == nullptr)
 			return nullptr;
 
@@ -11,6 +11,10 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <poll.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
 
 namespace mn::ipc
 {
@@ -315,4 +319,134 @@ namespace mn::ipc
 		mn_assert(remaining == 0);
 		return res;
 	}
+
+	bool
+	futex_wait(std::atomic<uint32_t>* word, uint32_t expected, Timeout timeout)
+	{
+		if (timeout == NO_TIMEOUT)
+			return word->load() != expected;
+
+		timespec ts{};
+		timespec* pts = nullptr;
+		if (timeout != INFINITE_TIMEOUT)
+		{
+			ts.tv_sec = timeout.milliseconds / 1000;
+			ts.tv_nsec = (timeout.milliseconds % 1000) * 1000000;
+			pts = &ts;
+		}
+
+		worker_block_ahead();
+		auto res = ::syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, expected, pts, nullptr, 0);
+		worker_block_clear();
+		return res == 0 || errno != ETIMEDOUT;
+	}
+
+	void
+	futex_wake_one(std::atomic<uint32_t>* word)
+	{
+		::syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+	}
+
+	void
+	futex_wake_all(std::atomic<uint32_t>* word)
+	{
+		::syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	inline static Str
+	_shared_memory_name(const Str& name)
+	{
+		// posix shared memory names should start with a slash
+		if (str_prefix(name, "/"))
+			return str_clone(name);
+		return strf("/{}", name);
+	}
+
+	Shared_Memory
+	shared_memory_new(const Str& name, size_t size)
+	{
+		mn_assert(size > 0);
+		auto os_name = _shared_memory_name(name);
+
+		// the segment might be in use by another process, so an existing segment is an error rather than being replaced
+		int handle = ::shm_open(os_name.ptr, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+		if (handle == -1)
+		{
+			str_free(os_name);
+			return nullptr;
+		}
+
+		if (::ftruncate(handle, size) != 0)
+		{
+			::close(handle);
+			::shm_unlink(os_name.ptr);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+		if (ptr == MAP_FAILED)
+		{
+			::close(handle);
+			::shm_unlink(os_name.ptr);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto self = alloc_zerod<IShared_Memory>();
+		self->linux_handle = handle;
+		self->name = os_name;
+		self->data = Block{ptr, size};
+		self->owner = true;
+		return self;
+	}
+
+	Shared_Memory
+	shared_memory_open(const Str& name)
+	{
+		auto os_name = _shared_memory_name(name);
+
+		int handle = ::shm_open(os_name.ptr, O_RDWR, S_IRUSR | S_IWUSR);
+		if (handle == -1)
+		{
+			str_free(os_name);
+			return nullptr;
+		}
+
+		// the creator might still be resizing the segment
+		struct stat sb{};
+		if (::fstat(handle, &sb) != 0 || sb.st_size == 0)
+		{
+			::close(handle);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto size = size_t(sb.st_size);
+		auto ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+		if (ptr == MAP_FAILED)
+		{
+			::close(handle);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto self = alloc_zerod<IShared_Memory>();
+		self->linux_handle = handle;
+		self->name = os_name;
+		self->data = Block{ptr, size};
+		self->owner = false;
+		return self;
+	}
+
+	void
+	shared_memory_free(Shared_Memory self)
+	{
+		::munmap(self->data.ptr, self->data.size);
+		::close(self->linux_handle);
+		if (self->owner)
+			::shm_unlink(self->name.ptr);
+		str_free(self->name);
+		free(self);
+	}
 }
@@ -0,0 +1,94 @@
+#include "mn/Numa.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <thread>
+
+namespace mn
+{
+	// reads a small sysfs file into the given buffer as a null terminated string, returns false on failure
+	inline static bool
+	_numa_read_sysfs(const char* path, char* buffer, size_t buffer_size)
+	{
+		auto fd = ::open(path, O_RDONLY);
+		if (fd == -1)
+			return false;
+
+		auto read_size = ::read(fd, buffer, buffer_size - 1);
+		::close(fd);
+		if (read_size <= 0)
+			return false;
+
+		buffer[read_size] = '\0';
+		return true;
+	}
+
+	// parses a sysfs list (e.g. "0-3,8-11") and calls the given function with each item in it
+	template<typename TFunc>
+	inline static void
+	_numa_parse_list(const char* it, TFunc&& fn)
+	{
+		while (*it != '\0' && *it != '\n')
+		{
+			char* end = nullptr;
+			auto first = ::strtoul(it, &end, 10);
+			if (end == it)
+				break;
+			auto last = first;
+			it = end;
+			if (*it == '-')
+			{
+				++it;
+				last = ::strtoul(it, &end, 10);
+				if (end == it)
+					break;
+				it = end;
+			}
+
+			for (auto i = first; i <= last; ++i)
+				fn(size_t(i));
+
+			if (*it == ',')
+				++it;
+		}
+	}
+
+	Buf<Numa_Node>
+	numa_nodes(Allocator allocator)
+	{
+		auto res = buf_with_allocator<Numa_Node>(allocator);
+
+		char online[1024];
+		if (_numa_read_sysfs("/sys/devices/system/node/online", online, sizeof(online)))
+		{
+			_numa_parse_list(online, [&](size_t id) {
+				char path[128];
+				::snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist", id);
+
+				char cpulist[4096];
+				if (_numa_read_sysfs(path, cpulist, sizeof(cpulist)) == false)
+					return;
+
+				Numa_Node node{};
+				node.id = id;
+				_numa_parse_list(cpulist, [&](size_t cpu) { cpu_set_add(node.cpus, cpu); });
+				// memory only nodes don't have cpus so there's nothing to schedule on them
+				if (cpu_set_count(node.cpus) > 0)
+					buf_push(res, node);
+			});
+		}
+
+		if (res.count == 0)
+		{
+			Numa_Node node{};
+			for (size_t cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+				cpu_set_add(node.cpus, cpu);
+			buf_push(res, node);
+		}
+
+		return res;
+	}
+}
@@ -3,6 +3,7 @@
 #include "mn/IO.h"
 #include "mn/Defer.h"
 #include "mn/Assert.h"
+#include "mn/Fabric.h"
 
 #define _LARGEFILE64_SOURCE 1
 #include <sys/sysinfo.h>
@@ -15,6 +16,8 @@
 #include <dirent.h>
 #include <linux/limits.h>
 #include <libgen.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
 
 #include <chrono>
 
@@ -174,35 +177,86 @@ namespace mn
 		return result;
 	}
 
+	// the kernel's linux_dirent64 layout, d_name is actually a flexible array member
+	struct Linux_Dirent64
+	{
+		uint64_t d_ino;
+		int64_t d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[1];
+	};
+
+	constexpr static size_t GETDENTS_BUFFER_SIZE = 32ULL * 1024ULL;
+
+	inline static Path_Entry::KIND
+	_path_entry_kind_from_mode(mode_t mode)
+	{
+		if (S_ISDIR(mode))
+			return Path_Entry::KIND_FOLDER;
+		else if (S_ISREG(mode))
+			return Path_Entry::KIND_FILE;
+		else if (S_ISLNK(mode))
+			return Path_Entry::KIND_SYMLINK;
+		else
+			return Path_Entry::KIND_OTHER;
+	}
+
 	Buf<Path_Entry>
 	path_entries(const char* path, Allocator allocator)
 	{
 		Buf<Path_Entry> res = buf_with_allocator<Path_Entry>(allocator);
 
-		DIR *d;
-		struct dirent *dir = nullptr;
-		d = ::opendir(path);
-		if(d)
+		int fd = ::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0)
+			return res;
+		mn_defer{::close(fd);};
+
+		// read the entries in big batches instead of the small buffer readdir uses
+		auto buffer = alloc_from(memory::clib(), GETDENTS_BUFFER_SIZE, alignof(Linux_Dirent64));
+		mn_defer{free_from(memory::clib(), buffer);};
+
+		while (true)
 		{
-			while((dir = ::readdir(d)) != NULL)
+			auto nread = ::syscall(SYS_getdents64, fd, buffer.ptr, buffer.size);
+			if (nread < 0 && errno == EINTR)
+				continue;
+			if (nread <= 0)
+				break;
+
+			for (long offset = 0; offset < nread;)
 			{
+				auto dirent = (Linux_Dirent64*)((char*)buffer.ptr + offset);
+				offset += dirent->d_reclen;
+
 				Path_Entry entry{};
-				if(dir->d_type == DT_DIR)
+				switch (dirent->d_type)
 				{
+				case DT_DIR:
 					entry.kind = Path_Entry::KIND_FOLDER;
-				}
-				else if(dir->d_type == DT_REG)
-				{
+					break;
+				case DT_REG:
 					entry.kind = Path_Entry::KIND_FILE;
-				}
-				else
+					break;
+				case DT_LNK:
+					entry.kind = Path_Entry::KIND_SYMLINK;
+					break;
+				case DT_UNKNOWN:
 				{
-					mn_unreachable();
+					// some filesystems (xfs without ftype, some network filesystems) don't fill d_type
+					struct stat sb{};
+					if (::fstatat(fd, dirent->d_name, &sb, AT_SYMLINK_NOFOLLOW) != 0)
+						continue;
+					entry.kind = _path_entry_kind_from_mode(sb.st_mode);
+					break;
 				}
-				entry.name = str_from_c(dir->d_name, allocator);
+				default:
+					entry.kind = Path_Entry::KIND_OTHER;
+					break;
+				}
+				entry.name = str_from_c(dirent->d_name, allocator);
 				buf_push(res, entry);
 			}
-			::closedir(d);
 		}
 		return res;
 	}
@@ -234,21 +288,137 @@ namespace mn
 		return int64_t(sb.st_mtime);
 	}
 
-	bool
-	file_copy(const char* src, const char* dst)
+	enum COPY_STRATEGY
 	{
-		char buf[4096];
-		ssize_t nread = -1;
-		int fd_src = ::open(src, O_RDONLY);
-		if(fd_src < 0)
-			return false;
+		COPY_STRATEGY_COPY_FILE_RANGE,
+		COPY_STRATEGY_SENDFILE,
+		COPY_STRATEGY_BUFFER,
+	};
 
-		int fd_dst = ::open(dst, O_WRONLY | O_CREAT | O_EXCL, 0666);
-		if(fd_dst < 0)
-			goto FAILURE;
+	constexpr static size_t COPY_BUFFER_SIZE = 1ULL * 1024ULL * 1024ULL;
+
+	inline static bool
+	_copy_errno_unsupported(int err)
+	{
+		return err == ENOSYS || err == EXDEV || err == EINVAL || err == EOPNOTSUPP || err == EPERM;
+	}
+
+	// copies the [offset, offset + length) range from fd_src to the same offset in fd_dst, it starts with
+	// the in-kernel copy_file_range (which can reflink or do server side copies), falls back to sendfile
+	// and then to a plain pread/pwrite loop over a large buffer, the chosen strategy sticks for the rest of the file
+	static bool
+	_file_copy_range(int fd_src, int fd_dst, off_t offset, off_t length, COPY_STRATEGY& strategy, Block& buffer)
+	{
+		off_t end = offset + length;
+		while (offset < end)
+		{
+			size_t count = size_t(end - offset);
+			if (strategy == COPY_STRATEGY_COPY_FILE_RANGE)
+			{
+				loff_t in_off = offset;
+				loff_t out_off = offset;
+				auto res = ::copy_file_range(fd_src, &in_off, fd_dst, &out_off, count, 0);
+				if (res > 0)
+				{
+					offset += res;
+					continue;
+				}
+				else if (res == 0)
+				{
+					// the source file got truncated under us
+					return true;
+				}
+				else if (errno == EINTR)
+				{
+					continue;
+				}
+				else if (_copy_errno_unsupported(errno))
+				{
+					strategy = COPY_STRATEGY_SENDFILE;
+					continue;
+				}
+				return false;
+			}
+			else if (strategy == COPY_STRATEGY_SENDFILE)
+			{
+				if (::lseek(fd_dst, offset, SEEK_SET) != offset)
+					return false;
+
+				off_t in_off = offset;
+				auto res = ::sendfile(fd_dst, fd_src, &in_off, count);
+				if (res > 0)
+				{
+					offset += res;
+					continue;
+				}
+				else if (res == 0)
+				{
+					return true;
+				}
+				else if (errno == EINTR)
+				{
+					continue;
+				}
+				else if (_copy_errno_unsupported(errno))
+				{
+					strategy = COPY_STRATEGY_BUFFER;
+					continue;
+				}
+				return false;
+			}
+			else
+			{
+				if (buffer.ptr == nullptr)
+					buffer = alloc(COPY_BUFFER_SIZE, alignof(max_align_t));
+
+				if (count > buffer.size)
+					count = buffer.size;
+
+				auto nread = ::pread(fd_src, buffer.ptr, count, offset);
+				if (nread == 0)
+					return true;
+				else if (nread < 0 && errno == EINTR)
+					continue;
+				else if (nread < 0)
+					return false;
 
-		while(nread = ::read(fd_src, buf, sizeof(buf)), nread > 0)
+				auto out_ptr = (char*)buffer.ptr;
+				auto out_offset = offset;
+				while (nread > 0)
+				{
+					auto nwritten = ::pwrite(fd_dst, out_ptr, nread, out_offset);
+					if (nwritten >= 0)
+					{
+						nread -= nwritten;
+						out_ptr += nwritten;
+						out_offset += nwritten;
+					}
+					else if (errno != EINTR)
+					{
+						return false;
+					}
+				}
+				offset = out_offset;
+			}
+		}
+		return true;
+	}
+
+	// copies a file which doesn't report a meaningful size (like procfs/sysfs files) by reading it until EOF
+	static bool
+	_file_copy_stream(int fd_src, int fd_dst)
+	{
+		char buf[4096];
+		ssize_t nread = -1;
+		while(nread = ::read(fd_src, buf, sizeof(buf)), nread != 0)
 		{
+			if (nread < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+
 			char *out_ptr = buf;
 			ssize_t nwritten = 0;
 			do
@@ -261,16 +431,68 @@ namespace mn
 				}
 				else if(errno != EINTR)
 				{
-					goto FAILURE;
+					return false;
 				}
 			} while(nread > 0);
 		}
+		return true;
+	}
+
+	bool
+	file_copy(const char* src, const char* dst)
+	{
+		int fd_src = ::open(src, O_RDONLY | O_CLOEXEC);
+		if(fd_src < 0)
+			return false;
+		mn_defer{::close(fd_src);};
+
+		struct stat sb{};
+		if (::fstat(fd_src, &sb) != 0)
+			return false;
+
+		int fd_dst = ::open(dst, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+		if(fd_dst < 0)
+			return false;
+		mn_defer{::close(fd_dst);};
+
+		if (S_ISREG(sb.st_mode) == false || sb.st_size == 0)
+			return _file_copy_stream(fd_src, fd_dst);
+
+		::posix_fadvise(fd_src, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		auto strategy = COPY_STRATEGY_COPY_FILE_RANGE;
+		Block buffer{};
+		mn_defer{if (buffer.ptr) free(buffer);};
+
+		// walk the data regions of the source file and skip the holes, so sparse files stay sparse
+		off_t size = sb.st_size;
+		off_t data = 0;
+		while (data < size)
+		{
+			off_t next_data = ::lseek(fd_src, data, SEEK_DATA);
+			off_t hole = size;
+			if (next_data < 0)
+			{
+				// no more data, the rest of the file is a hole
+				if (errno == ENXIO)
+					break;
+				// the filesystem doesn't support SEEK_DATA so treat the rest of the file as data
+			}
+			else
+			{
+				data = next_data;
+				hole = ::lseek(fd_src, data, SEEK_HOLE);
+				if (hole < 0 || hole > size)
+					hole = size;
+			}
+
+			if (_file_copy_range(fd_src, fd_dst, data, hole - data, strategy, buffer) == false)
+				return false;
+			data = hole;
+		}
 
-	FAILURE:
-		::close(fd_src);
-		if(fd_dst >= 0)
-			::close(fd_dst);
-		return nread == 0;
+		// extends the file over the trailing hole without allocating it
+		return ::ftruncate(fd_dst, size) == 0;
 	}
 
 	bool
@@ -357,78 +579,161 @@ namespace mn
 				continue;
 
 			str_clear(tmp_path);
-			if(files[i].kind == Path_Entry::KIND_FILE)
-			{
-				tmp_path = path_join(tmp_path, path, files[i].name);
-				if(file_remove(tmp_path) == false)
-					return false;
-			}
-			else if(files[i].kind == Path_Entry::KIND_FOLDER)
+			tmp_path = path_join(tmp_path, path, files[i].name);
+			if(files[i].kind == Path_Entry::KIND_FOLDER)
 			{
-				tmp_path = path_join(tmp_path, path, files[i].name);
 				if(folder_remove(tmp_path) == false)
 					return false;
 			}
 			else
 			{
-				mn_unreachable();
-				return false;
+				// files, symlinks (which are not followed) and special files are all unlinked
+				if(file_remove(tmp_path) == false)
+					return false;
 			}
 		}
 
 		return ::rmdir(path) == 0;
 	}
 
-	bool
-	folder_copy(const char* src, const char* dst)
+	// recreates the symlink at src as a symlink at dst, the same way cp -R does it
+	static bool
+	_folder_copy_symlink(const char* src, const char* dst)
 	{
-		Buf<Path_Entry> files = path_entries(src);
-		mn_defer{destruct(files);};
+		char target[PATH_MAX + 1];
+		auto len = ::readlink(src, target, PATH_MAX);
+		if (len < 0)
+			return false;
+		target[len] = '\0';
+		return ::symlink(target, dst) == 0;
+	}
 
+	// walks the src folder tree once, reusing the same src/dst path buffers all the way down, it creates
+	// the folders in dst and calls on_file(src, dst) for each regular file
+	template<typename TFunc>
+	static bool
+	_folder_copy_walk(Str& src, Str& dst, TFunc& on_file)
+	{
 		//create the folder no matter what
 		if(folder_make(dst) == false)
 			return false;
 
-		//if the source folder is empty then exit with success
-		if(files.count <= 2)
-			return true;
-
-		size_t i = 0;
-		auto tmp_src = str_new();
-		mn_defer{str_free(tmp_src);};
+		DIR* d = ::opendir(src.ptr);
+		if (d == nullptr)
+			return false;
+		mn_defer{::closedir(d);};
 
-		auto tmp_dst = str_new();
-		mn_defer{str_free(tmp_dst);};
+		auto src_count = src.count;
+		auto dst_count = dst.count;
+		mn_defer
+		{
+			str_resize(src, src_count);
+			str_resize(dst, dst_count);
+		};
 
-		for(i = 0; i < files.count; ++i)
+		while (auto entry = ::readdir(d))
 		{
-			if(files[i].name != "." && files[i].name != "..")
+			if (::strcmp(entry->d_name, ".") == 0 || ::strcmp(entry->d_name, "..") == 0)
+				continue;
+
+			str_resize(src, src_count);
+			str_resize(dst, dst_count);
+			src = path_join(src, entry->d_name);
+			dst = path_join(dst, entry->d_name);
+
+			auto type = entry->d_type;
+			if (type == DT_UNKNOWN)
 			{
-				str_clear(tmp_src);
-				str_clear(tmp_dst);
-				if(files[i].kind == Path_Entry::KIND_FILE)
-				{
-					tmp_src = path_join(tmp_src, src, files[i].name);
-					tmp_dst = path_join(tmp_dst, dst, files[i].name);
-					if(file_copy(tmp_src, tmp_dst) == false)
-						break;
-				}
-				else if(files[i].kind == Path_Entry::KIND_FOLDER)
-				{
-					tmp_src = path_join(tmp_src, src, files[i].name);
-					tmp_dst = path_join(tmp_dst, dst, files[i].name);
-					if(folder_copy(tmp_src, tmp_dst) == false)
-						break;
-				}
-				else
-				{
-					mn_unreachable();
-					break;
-				}
+				struct stat sb{};
+				if (::lstat(src.ptr, &sb) != 0)
+					return false;
+				if (S_ISDIR(sb.st_mode))
+					type = DT_DIR;
+				else if (S_ISREG(sb.st_mode))
+					type = DT_REG;
+				else if (S_ISLNK(sb.st_mode))
+					type = DT_LNK;
 			}
+
+			bool ok = true;
+			switch (type)
+			{
+			case DT_DIR:
+				ok = _folder_copy_walk(src, dst, on_file);
+				break;
+			case DT_REG:
+				ok = on_file(src, dst);
+				break;
+			case DT_LNK:
+				ok = _folder_copy_symlink(src.ptr, dst.ptr);
+				break;
+			default:
+				// devices, fifos and sockets are not copied
+				break;
+			}
+
+			if (ok == false)
+				return false;
 		}
+		return true;
+	}
+
+	bool
+	folder_copy(const char* src, const char* dst)
+	{
+		auto tmp_src = str_from_c(src);
+		mn_defer{str_free(tmp_src);};
+
+		auto tmp_dst = str_from_c(dst);
+		mn_defer{str_free(tmp_dst);};
+
+		auto on_file = [](const Str& file_src, const Str& file_dst) {
+			return file_copy(file_src, file_dst);
+		};
+		return _folder_copy_walk(tmp_src, tmp_dst, on_file);
+	}
+
+	bool
+	folder_copy(const char* src, const char* dst, Fabric fabric, size_t max_in_flight)
+	{
+		if (max_in_flight == 0)
+			max_in_flight = 2 * fabric_workers_count(fabric);
+
+		// the channel is used as a counting semaphore, each in flight copy holds one slot
+		auto in_flight = chan_new<bool>(int32_t(max_in_flight));
+		mn_defer{chan_free(in_flight);};
+
+		auto wg = waitgroup_new();
+		mn_defer{waitgroup_free(wg);};
+
+		std::atomic<bool> failed = false;
+
+		auto tmp_src = str_from_c(src);
+		mn_defer{str_free(tmp_src);};
+
+		auto tmp_dst = str_from_c(dst);
+		mn_defer{str_free(tmp_dst);};
+
+		auto on_file = [&](const Str& file_src, const Str& file_dst) {
+			if (failed.load(std::memory_order_relaxed))
+				return false;
+
+			chan_send(in_flight, true);
+			waitgroup_add(wg, 1);
+			go(fabric, [in_flight, wg, &failed, file_src = clone(file_src), file_dst = clone(file_dst)]() mutable {
+				if (file_copy(file_src, file_dst) == false)
+					failed = true;
+				str_free(file_src);
+				str_free(file_dst);
+				chan_recv_try(in_flight);
+				waitgroup_done(wg);
+			});
+			return true;
+		};
+		bool walked = _folder_copy_walk(tmp_src, tmp_dst, on_file);
 
-		return i == files.count;
+		waitgroup_wait(wg);
+		return walked && failed == false;
 	}
 
 	Str
@@ -10,9 +10,14 @@
 
 #include <pthread.h>
 #include <unistd.h>
+#include <sched.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include <chrono>
+#include <climits>
+#include <errno.h>
 
 // sometimes, distros like debian use old glibc versions
 // gettid() was only defined in glibc v2.30+ (see https://man7.org/linux/man-pages/man2/gettid.2.html#VERSIONS)
@@ -24,14 +29,182 @@
 
 namespace mn
 {
+	// mutex state bits, the bits above MUTEX_FIBERS_SHIFT count the fibers waiting in the fiber_waiters list
+	constexpr uint32_t MUTEX_LOCKED = 1;
+	// threads might be sleeping on the state futex so the unlock should wake one of them
+	constexpr uint32_t MUTEX_CONTENDED = 2;
+	constexpr uint32_t MUTEX_FIBERS_SHIFT = 2;
+	constexpr uint32_t MUTEX_FIBER = 1 << MUTEX_FIBERS_SHIFT;
+	// upper bound of the adaptive spinning before a thread sleeps on the mutex futex
+	constexpr int32_t MUTEX_SPIN_LIMIT = 100;
+
 	struct IMutex
 	{
-		pthread_mutex_t handle;
+		std::atomic<uint32_t> state;
+		// running average of the spins it took to acquire the mutex, it's used to bound the next spins
+		std::atomic<int32_t> spin_estimate;
 		const char* name;
 		const Source_Location* srcloc;
 		void* profile_user_data;
+		// fibers parked until the mutex is unlocked
+		Fiber_Wait_List fiber_waiters;
 	};
 
+	inline static long
+	_thread_futex_wait(std::atomic<uint32_t>* word, uint32_t expected, const timespec* timeout)
+	{
+		return ::syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+	}
+
+	inline static void
+	_thread_futex_wake(std::atomic<uint32_t>* word, int count)
+	{
+		::syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+	}
+
+	inline static void
+	_thread_cpu_relax()
+	{
+		#if ARCH_X86
+			__builtin_ia32_pause();
+		#elif ARCH_ARM
+			__asm__ __volatile__("yield");
+		#endif
+	}
+
+	// spinning only helps if the owner of the mutex is running on another cpu
+	inline static bool
+	_thread_should_spin()
+	{
+		static bool res = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+		return res;
+	}
+
+	inline static void
+	_mutex_init(IMutex* self)
+	{
+		self->state.store(0);
+		self->spin_estimate.store(0);
+		_fiber_wait_list_init(self->fiber_waiters);
+	}
+
+	inline static bool
+	_mutex_try_lock(IMutex* self)
+	{
+		auto state = self->state.load(std::memory_order_relaxed);
+		while ((state & MUTEX_LOCKED) == 0)
+		{
+			if (self->state.compare_exchange_weak(state, state | MUTEX_LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+
+	// spins on the mutex for a bounded number of iterations which adapts to how long it took to acquire it recently
+	inline static bool
+	_mutex_spin_lock(IMutex* self)
+	{
+		if (_thread_should_spin() == false)
+			return false;
+
+		auto estimate = self->spin_estimate.load(std::memory_order_relaxed);
+		auto limit = estimate * 2 + 10;
+		if (limit > MUTEX_SPIN_LIMIT)
+			limit = MUTEX_SPIN_LIMIT;
+
+		for (int32_t i = 0; i < limit; ++i)
+		{
+			_thread_cpu_relax();
+			if (self->state.load(std::memory_order_relaxed) & MUTEX_LOCKED)
+				continue;
+
+			if (_mutex_try_lock(self))
+			{
+				self->spin_estimate.store(estimate + (i - estimate) / 8, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		self->spin_estimate.store(estimate + (limit - estimate) / 8, std::memory_order_relaxed);
+		return false;
+	}
+
+	// sleeps on the state futex until the mutex is acquired, the contended bit stays set so that the unlock wakes the
+	// next sleeping thread
+	inline static void
+	_mutex_futex_lock(IMutex* self)
+	{
+		while (true)
+		{
+			auto state = self->state.fetch_or(MUTEX_LOCKED | MUTEX_CONTENDED, std::memory_order_acquire);
+			if ((state & MUTEX_LOCKED) == 0)
+				return;
+			_thread_futex_wait(&self->state, state | MUTEX_LOCKED | MUTEX_CONTENDED, nullptr);
+		}
+	}
+
+	// parks the fiber until an unlock wakes it up, the fiber is counted in the mutex state after it's pushed into the
+	// wait list so that an unlock which happens after our failed try lock finds it there
+	inline static void
+	_mutex_fiber_lock(IMutex* self, Fiber fiber)
+	{
+		while (true)
+		{
+			_fiber_wait_list_push(self->fiber_waiters, fiber);
+			self->state.fetch_add(MUTEX_FIBER);
+			auto locked = _mutex_try_lock(self);
+			if (locked && _fiber_wait_list_remove(self->fiber_waiters, fiber))
+			{
+				self->state.fetch_sub(MUTEX_FIBER);
+				return;
+			}
+
+			// if an unlock took us off the list it's going to wake us up, so we park to consume this wake
+			fiber_park();
+			self->state.fetch_sub(MUTEX_FIBER);
+			if (locked || _mutex_try_lock(self))
+				return;
+		}
+	}
+
+	// unlocks the mutex, a parked fiber is taken off the wait list while the mutex is still locked and it's woken up
+	// after the mutex is unlocked, so the mutex isn't touched after it's unlocked (other than the address of the futex
+	// wake) and another thread is free to free it as soon as it acquires it
+	inline static void
+	_mutex_os_unlock(IMutex* self)
+	{
+		// we start by guessing the uncontended state which saves a load in the common case, the exchange corrects it
+		Fiber fiber = nullptr;
+		uint32_t state = MUTEX_LOCKED;
+		while (true)
+		{
+			if (fiber == nullptr && (state >> MUTEX_FIBERS_SHIFT) != 0)
+				fiber = _fiber_wait_list_pop(self->fiber_waiters);
+
+			// the exchange fails if a fiber registers itself in the meantime
+			if (self->state.compare_exchange_weak(state, state & ~(MUTEX_LOCKED | MUTEX_CONTENDED), std::memory_order_release, std::memory_order_relaxed))
+				break;
+		}
+
+		if (state & MUTEX_CONTENDED)
+			_thread_futex_wake(&self->state, 1);
+		if (fiber)
+			fiber_ready(fiber);
+	}
+
+	// locks the mutex without the profiling hooks, it's used to reacquire the mutex after waiting on a condition
+	// variable
+	inline static void
+	_mutex_os_lock(IMutex* self)
+	{
+		if (_mutex_try_lock(self) || _mutex_spin_lock(self))
+			return;
+
+		if (auto fiber = fiber_local())
+			_mutex_fiber_lock(self, fiber);
+		else
+			_mutex_futex_lock(self);
+	}
+
 	struct Leak_Allocator_Mutex
 	{
 		Source_Location srcloc;
@@ -46,8 +219,7 @@ namespace mn
 			srcloc.color = 0;
 			self.name = srcloc.name;
 			self.srcloc = &srcloc;
-			[[maybe_unused]] int result = pthread_mutex_init(&self.handle, NULL);
-			mn_assert(result == 0);
+			_mutex_init(&self);
 			self.profile_user_data = _mutex_new(&self, self.name);
 		}
 
@@ -391,6 +563,30 @@ namespace mn
 		#endif
 	}
 
+	inline static void
+	_mutex_lock(Mutex self)
+	{
+		if (_mutex_try_lock(self) || _mutex_spin_lock(self))
+		{
+			_deadlock_detector_mutex_set_exclusive_owner(self);
+			return;
+		}
+
+		// fibers are parked instead of blocking their worker
+		if (auto fiber = fiber_local())
+		{
+			_mutex_fiber_lock(self, fiber);
+			_deadlock_detector_mutex_set_exclusive_owner(self);
+			return;
+		}
+
+		worker_block_ahead();
+		_deadlock_detector_mutex_block(self);
+		_mutex_futex_lock(self);
+		_deadlock_detector_mutex_set_exclusive_owner(self);
+		worker_block_clear();
+	}
+
 	// API
 	Mutex
 	mutex_new_with_srcloc(const Source_Location* srcloc)
@@ -398,8 +594,7 @@ namespace mn
 		auto self = alloc<IMutex>();
 		self->srcloc = srcloc;
 		self->name = srcloc->name;
-		[[maybe_unused]] int result = pthread_mutex_init(&self->handle, NULL);
-		mn_assert(result == 0);
+		_mutex_init(self);
 
 		self->profile_user_data = _mutex_new(self, self->name);
 
@@ -412,8 +607,7 @@ namespace mn
 		auto self = alloc<IMutex>();
 		self->srcloc = nullptr;
 		self->name = name;
-		[[maybe_unused]] int result = pthread_mutex_init(&self->handle, NULL);
-		mn_assert(result == 0);
+		_mutex_init(self);
 
 		self->profile_user_data = _mutex_new(self, self->name);
 
@@ -423,40 +617,42 @@ namespace mn
 	void
 	mutex_lock(Mutex self)
 	{
-		auto call_after_lock = _mutex_before_lock(self, self->profile_user_data);
-		mn_defer{
-			if (call_after_lock)
-				_mutex_after_lock(self, self->profile_user_data);
-		};
-
-		if (pthread_mutex_trylock(&self->handle) == 0)
+		if (_thread_profile_mutex_hooks())
 		{
-			_deadlock_detector_mutex_set_exclusive_owner(self);
-			return;
+			auto call_after_lock = _mutex_before_lock(self, self->profile_user_data);
+			mn_defer{
+				if (call_after_lock)
+					_mutex_after_lock(self, self->profile_user_data);
+			};
+			_mutex_lock(self);
+		}
+		else
+		{
+			_mutex_lock(self);
 		}
-
-		worker_block_ahead();
-		_deadlock_detector_mutex_block(self);
-		[[maybe_unused]] int result = pthread_mutex_lock(&self->handle);
-		mn_assert(result == 0);
-		_deadlock_detector_mutex_set_exclusive_owner(self);
-		worker_block_clear();
 	}
 
 	void
 	mutex_unlock(Mutex self)
 	{
 		_deadlock_detector_mutex_unset_owner(self);
-		[[maybe_unused]] int result = pthread_mutex_unlock(&self->handle);
-		mn_assert(result == 0);
-		_mutex_after_unlock(self, self->profile_user_data);
+		if (_thread_profile_mutex_hooks())
+		{
+			// the mutex might be freed once it's unlocked so we read the profiler data first
+			auto profile_user_data = self->profile_user_data;
+			_mutex_os_unlock(self);
+			_mutex_after_unlock(self, profile_user_data);
+		}
+		else
+		{
+			_mutex_os_unlock(self);
+		}
 	}
 
 	void
 	mutex_free(Mutex self)
 	{
 		_mutex_free(self, self->profile_user_data);
-		[[maybe_unused]] int result = pthread_mutex_destroy(&self->handle);
 		free(self);
 	}
 
@@ -466,20 +662,123 @@ namespace mn
 		return self->srcloc;
 	}
 
+	const char*
+	mutex_name(Mutex self)
+	{
+		return self->name;
+	}
+
 
 	//Mutex_RW API
+	// reader biased mutexes count their readers in per cpu slots, each slot is on its own cache line so readers on
+	// different cpus don't share any written cache line
+	constexpr size_t MUTEX_RW_SLOT_SIZE = 64;
+	constexpr size_t MUTEX_RW_MAX_SLOTS = 256;
+
+	struct alignas(MUTEX_RW_SLOT_SIZE) Mutex_RW_Slot
+	{
+		// a reader might unlock from a different cpu than the one it locked on so the count of a single slot can be
+		// negative, only the sum of all the slots is meaningful
+		std::atomic<int32_t> readers;
+	};
+
 	struct IMutex_RW
 	{
 		pthread_rwlock_t lock;
 		const char* name;
 		const Source_Location* srcloc;
 		void* profile_user_data;
+
+		// reader biased state, slots is empty for the pthread based mutexes
+		Block slots_memory;
+		Mutex_RW_Slot* slots;
+		size_t slots_count;
+		// serializes the writers
+		IMutex writers;
+		// set while a writer holds or waits for the mutex, readers back off and sleep on it
+		std::atomic<uint32_t> writer;
+		// number of readers sleeping on writer, the write unlock skips the futex wake if there are none
+		std::atomic<uint32_t> read_waiters;
 	};
 
+	inline static bool
+	_mutex_rw_reader_biased(Mutex_RW self)
+	{
+		return self->slots_count > 0;
+	}
+
+	inline static Mutex_RW_Slot*
+	_mutex_rw_slot(Mutex_RW self)
+	{
+		auto cpu = sched_getcpu();
+		if (cpu < 0)
+			cpu = 0;
+		return self->slots + (size_t(cpu) % self->slots_count);
+	}
+
+	inline static bool
+	_mutex_rw_biased_try_read_lock(Mutex_RW self)
+	{
+		// the slot is incremented before the writer flag is checked and the writer sets its flag before it sums the
+		// slots, so either we see the writer or the writer sees us
+		auto slot = _mutex_rw_slot(self);
+		slot->readers.fetch_add(1);
+		if (self->writer.load() == 0)
+			return true;
+		slot->readers.fetch_sub(1);
+		return false;
+	}
+
+	inline static void
+	_mutex_rw_biased_read_lock(Mutex_RW self)
+	{
+		while (_mutex_rw_biased_try_read_lock(self) == false)
+		{
+			self->read_waiters.fetch_add(1);
+			if (self->writer.load() != 0)
+				_thread_futex_wait(&self->writer, 1, nullptr);
+			self->read_waiters.fetch_sub(1);
+		}
+	}
+
+	inline static int64_t
+	_mutex_rw_biased_readers(Mutex_RW self)
+	{
+		int64_t res = 0;
+		for (size_t i = 0; i < self->slots_count; ++i)
+			res += self->slots[i].readers.load();
+		return res;
+	}
+
+	// writers pay for the reader bias, they stop new readers then wait for the slots to drain
+	inline static void
+	_mutex_rw_biased_write_lock(Mutex_RW self)
+	{
+		_mutex_os_lock(&self->writers);
+		self->writer.store(1);
+
+		for (size_t i = 0; _mutex_rw_biased_readers(self) != 0; ++i)
+		{
+			if (i < MUTEX_SPIN_LIMIT && _thread_should_spin())
+				_thread_cpu_relax();
+			else
+				sched_yield();
+		}
+	}
+
+	inline static void
+	_mutex_rw_biased_write_unlock(Mutex_RW self)
+	{
+		self->writer.store(0);
+		if (self->read_waiters.load() > 0)
+			_thread_futex_wake(&self->writer, INT_MAX);
+		_mutex_os_unlock(&self->writers);
+	}
+
 	Mutex_RW
 	mutex_rw_new_with_srcloc(const Source_Location* srcloc)
 	{
-		Mutex_RW self = alloc<IMutex_RW>();
+		Mutex_RW self = alloc_zerod<IMutex_RW>();
 		pthread_rwlock_init(&self->lock, NULL);
 		self->name = srcloc->name;
 		self->srcloc = srcloc;
@@ -490,7 +789,7 @@ namespace mn
 	Mutex_RW
 	mutex_rw_new(const char* name)
 	{
-		Mutex_RW self = alloc<IMutex_RW>();
+		Mutex_RW self = alloc_zerod<IMutex_RW>();
 		pthread_rwlock_init(&self->lock, NULL);
 		self->name = name;
 		self->srcloc = nullptr;
@@ -498,11 +797,38 @@ namespace mn
 		return self;
 	}
 
+	Mutex_RW
+	mutex_rw_reader_biased_new(const char* name)
+	{
+		auto self = mutex_rw_new(name);
+
+		static size_t cpus_count = size_t(sysconf(_SC_NPROCESSORS_CONF));
+		self->slots_count = cpus_count;
+		if (self->slots_count == 0)
+			self->slots_count = 1;
+		if (self->slots_count > MUTEX_RW_MAX_SLOTS)
+			self->slots_count = MUTEX_RW_MAX_SLOTS;
+
+		// allocators don't guarantee cache line alignment so we over allocate and align the slots ourselves
+		self->slots_memory = alloc((self->slots_count + 1) * MUTEX_RW_SLOT_SIZE, alignof(Mutex_RW_Slot));
+		auto ptr = (uintptr_t(self->slots_memory.ptr) + MUTEX_RW_SLOT_SIZE - 1) & ~uintptr_t(MUTEX_RW_SLOT_SIZE - 1);
+		self->slots = (Mutex_RW_Slot*)ptr;
+		for (size_t i = 0; i < self->slots_count; ++i)
+			self->slots[i].readers.store(0);
+
+		_mutex_init(&self->writers);
+		self->writer.store(0);
+		self->read_waiters.store(0);
+		return self;
+	}
+
 	void
 	mutex_rw_free(Mutex_RW self)
 	{
 		_mutex_rw_free(self, self->profile_user_data);
 		pthread_rwlock_destroy(&self->lock);
+		if (_mutex_rw_reader_biased(self))
+			free(self->slots_memory);
 		free(self);
 	}
 
@@ -515,6 +841,22 @@ namespace mn
 				_mutex_after_read_lock(self, self->profile_user_data);
 		};
 
+		if (_mutex_rw_reader_biased(self))
+		{
+			if (_mutex_rw_biased_try_read_lock(self))
+			{
+				_deadlock_detector_mutex_set_shared_owner(self);
+				return;
+			}
+
+			worker_block_ahead();
+			_deadlock_detector_mutex_block(self);
+			_mutex_rw_biased_read_lock(self);
+			_deadlock_detector_mutex_set_shared_owner(self);
+			worker_block_clear();
+			return;
+		}
+
 		if (pthread_rwlock_tryrdlock(&self->lock) == 0)
 		{
 			_deadlock_detector_mutex_set_shared_owner(self);
@@ -532,7 +874,10 @@ namespace mn
 	mutex_read_unlock(Mutex_RW self)
 	{
 		_deadlock_detector_mutex_unset_owner(self);
-		pthread_rwlock_unlock(&self->lock);
+		if (_mutex_rw_reader_biased(self))
+			_mutex_rw_slot(self)->readers.fetch_sub(1);
+		else
+			pthread_rwlock_unlock(&self->lock);
 		_mutex_after_read_unlock(self, self->profile_user_data);
 	}
 
@@ -545,6 +890,16 @@ namespace mn
 				_mutex_after_write_lock(self, self->profile_user_data);
 		};
 
+		if (_mutex_rw_reader_biased(self))
+		{
+			worker_block_ahead();
+			_deadlock_detector_mutex_block(self);
+			_mutex_rw_biased_write_lock(self);
+			_deadlock_detector_mutex_set_exclusive_owner(self);
+			worker_block_clear();
+			return;
+		}
+
 		if (pthread_rwlock_trywrlock(&self->lock) == 0)
 		{
 			_deadlock_detector_mutex_set_exclusive_owner(self);
@@ -562,7 +917,10 @@ namespace mn
 	mutex_write_unlock(Mutex_RW self)
 	{
 		_deadlock_detector_mutex_unset_owner(self);
-		pthread_rwlock_unlock(&self->lock);
+		if (_mutex_rw_reader_biased(self))
+			_mutex_rw_biased_write_unlock(self);
+		else
+			pthread_rwlock_unlock(&self->lock);
 		_mutex_after_write_unlock(self, self->profile_user_data);
 	}
 
@@ -572,6 +930,12 @@ namespace mn
 		return self->srcloc;
 	}
 
+	const char*
+	mutex_rw_name(Mutex_RW self)
+	{
+		return self->name;
+	}
+
 
 	//Thread
 	struct IThread
@@ -633,6 +997,19 @@ namespace mn
 		return (void*)(uintptr_t)gettid();
 	}
 
+	bool
+	thread_affinity_set(const Cpu_Set& cpus)
+	{
+		static_assert(CPU_SET_CAPACITY <= CPU_SETSIZE, "cpu set capacity is bigger than the os cpu set size");
+
+		cpu_set_t os_cpus;
+		CPU_ZERO(&os_cpus);
+		for (size_t cpu = 0; cpu < CPU_SET_CAPACITY; ++cpu)
+			if (cpu_set_has(cpus, cpu))
+				CPU_SET(cpu, &os_cpus);
+		return pthread_setaffinity_np(pthread_self(), sizeof(os_cpus), &os_cpus) == 0;
+	}
+
 
 	uint64_t
 	time_in_millis()
@@ -645,49 +1022,79 @@ namespace mn
 	// Condition Variables
 	struct ICond_Var
 	{
-		pthread_cond_t cv;
+		// bumped by each notification, threads sleep on it using futex
+		std::atomic<uint32_t> seq;
+		// number of threads sleeping on seq, notifications skip the futex wake if there are none
+		std::atomic<uint32_t> waiters;
+		// fibers parked on the condition variable
+		Fiber_Wait_List fiber_waiters;
 	};
 
+	// unlocks the mutex and sleeps on the condition variable, then locks the mutex again, returns the futex wait result
+	inline static long
+	_cond_var_futex_wait(Cond_Var self, Mutex mtx, const timespec* timeout)
+	{
+		worker_block_ahead();
+		_deadlock_detector_mutex_unset_owner(mtx);
+
+		// the waiter is counted and the sequence is read before the mutex is unlocked so it can't miss a notification
+		self->waiters.fetch_add(1);
+		auto seq = self->seq.load();
+		_mutex_os_unlock(mtx);
+		auto res = _thread_futex_wait(&self->seq, seq, timeout);
+		auto err = errno;
+		self->waiters.fetch_sub(1);
+		_mutex_os_lock(mtx);
+
+		_deadlock_detector_mutex_set_exclusive_owner(mtx);
+		worker_block_clear();
+		return res == 0 ? 0 : err;
+	}
+
 	Cond_Var
 	cond_var_new()
 	{
 		auto self = alloc<ICond_Var>();
-		[[maybe_unused]] auto res = pthread_cond_init(&self->cv, NULL);
-		mn_assert(res == 0);
+		self->seq.store(0);
+		self->waiters.store(0);
+		_fiber_wait_list_init(self->fiber_waiters);
 		return self;
 	}
 
 	void
 	cond_var_free(Cond_Var self)
 	{
-		[[maybe_unused]] auto res = pthread_cond_destroy(&self->cv);
-		mn_assert(res == 0);
 		free(self);
 	}
 
 	void
 	cond_var_wait(Cond_Var self, Mutex mtx)
 	{
-		worker_block_ahead();
-		_deadlock_detector_mutex_unset_owner(mtx);
-		pthread_cond_wait(&self->cv, &mtx->handle);
-		_deadlock_detector_mutex_set_exclusive_owner(mtx);
-		worker_block_clear();
+		// fibers are parked instead of blocking their worker, the fiber is added to the wait list before it
+		// unlocks the mutex so that it can't miss a notification
+		if (auto fiber = fiber_local())
+		{
+			_fiber_wait_list_push(self->fiber_waiters, fiber);
+			mutex_unlock(mtx);
+			fiber_park();
+			mutex_lock(mtx);
+			return;
+		}
+
+		_cond_var_futex_wait(self, mtx, nullptr);
 	}
 
 	Cond_Var_Wake_State
 	cond_var_wait_timeout(Cond_Var self, Mutex mtx, uint32_t millis)
 	{
+		// futex timeouts are relative
 		timespec ts{};
 		ms2ts(&ts, millis);
 
-		worker_block_ahead();
-		_deadlock_detector_mutex_unset_owner(mtx);
-		auto res = pthread_cond_timedwait(&self->cv, &mtx->handle, &ts);
-		_deadlock_detector_mutex_set_exclusive_owner(mtx);
-		worker_block_clear();
+		auto res = _cond_var_futex_wait(self, mtx, &ts);
 
-		if (res == 0)
+		// EAGAIN means that a notification happened before we slept
+		if (res == 0 || res == EAGAIN)
 			return Cond_Var_Wake_State::SIGNALED;
 
 		if (res == ETIMEDOUT)
@@ -699,90 +1106,203 @@ namespace mn
 	void
 	cond_var_notify(Cond_Var self)
 	{
-		pthread_cond_signal(&self->cv);
+		if (auto fiber = _fiber_wait_list_pop(self->fiber_waiters))
+		{
+			fiber_ready(fiber);
+			return;
+		}
+
+		// like pthread condition variables we don't write to the condition variable when there are no waiters, so
+		// it's fine to notify it after unlocking the mutex even if a woken up thread frees it right away
+		if (self->waiters.load() == 0)
+			return;
+
+		self->seq.fetch_add(1);
+		_thread_futex_wake(&self->seq, 1);
 	}
 
 	void
 	cond_var_notify_all(Cond_Var self)
 	{
-		pthread_cond_broadcast(&self->cv);
+		_fiber_ready_all(_fiber_wait_list_pop_all(self->fiber_waiters));
+
+		if (self->waiters.load() == 0)
+			return;
+
+		self->seq.fetch_add(1);
+		_thread_futex_wake(&self->seq, INT_MAX);
 	}
 
 	// Waitgroup
+	// the low 32 bits of the waitgroup state are the count, and the high 32 bits are the number of waitgroup_done calls
+	// which are still using the waitgroup, waitgroup_free waits for them to finish because a waiter might return (and
+	// free the waitgroup) as soon as the count reaches 0
+	constexpr uint64_t WAITGROUP_COUNT_MASK = 0xFFFFFFFF;
+	constexpr uint64_t WAITGROUP_DONE_CALL = 1ULL << 32;
+
 	struct IWaitgroup
 	{
-		int count;
-		pthread_mutex_t mtx;
-		pthread_cond_t cv;
+		std::atomic<uint64_t> state;
+		// bumped each time the count reaches 0, threads sleep on it using futex
+		std::atomic<uint32_t> generation;
+		// number of threads sleeping on generation, waitgroup_done skips the futex wake if there are none
+		std::atomic<uint32_t> sleepers;
+		// protects the fiber and async waiter lists, it's only taken by the waiters and by the waitgroup_done which
+		// brings the count to 0
+		std::atomic<bool> waiters_lock;
+		// fibers parked until the count reaches 0
+		Fiber_Wait_List fiber_waiters;
+		// asynchronous waiters notified when the count reaches 0
+		Async_Waiter* async_waiters;
 	};
 
+	inline static int
+	_waitgroup_count(Waitgroup self)
+	{
+		return int(self->state.load() & WAITGROUP_COUNT_MASK);
+	}
+
+	inline static void
+	_waitgroup_waiters_lock(Waitgroup self)
+	{
+		while (self->waiters_lock.exchange(true, std::memory_order_acquire))
+		{
+			while (self->waiters_lock.load(std::memory_order_relaxed))
+				_thread_cpu_relax();
+		}
+	}
+
+	inline static void
+	_waitgroup_waiters_unlock(Waitgroup self)
+	{
+		self->waiters_lock.store(false, std::memory_order_release);
+	}
+
 	Waitgroup
 	waitgroup_new()
 	{
 		auto self = alloc<IWaitgroup>();
-		self->count = 0;
-		[[maybe_unused]] auto res = pthread_mutex_init(&self->mtx, NULL);
-		mn_assert(res == 0);
-		res = pthread_cond_init(&self->cv, NULL);
-		mn_assert(res == 0);
+		self->state.store(0);
+		self->generation.store(0);
+		self->sleepers.store(0);
+		self->waiters_lock.store(false);
+		_fiber_wait_list_init(self->fiber_waiters);
+		self->async_waiters = nullptr;
 		return self;
 	}
 
 	void
 	waitgroup_free(Waitgroup self)
 	{
-		[[maybe_unused]] auto res = pthread_mutex_destroy(&self->mtx);
-		mn_assert(res == 0);
-		res = pthread_cond_destroy(&self->cv);
-		mn_assert(res == 0);
+		while (self->state.load() >= WAITGROUP_DONE_CALL)
+			_thread_cpu_relax();
 		free(self);
 	}
 
 	void
 	waitgroup_wait(Waitgroup self)
 	{
+		// fibers are parked instead of blocking their worker
+		if (auto fiber = fiber_local())
+		{
+			while (true)
+			{
+				_waitgroup_waiters_lock(self);
+				if (_waitgroup_count(self) == 0)
+				{
+					_waitgroup_waiters_unlock(self);
+					return;
+				}
+				_fiber_wait_list_push(self->fiber_waiters, fiber);
+				_waitgroup_waiters_unlock(self);
+				fiber_park();
+			}
+		}
+
+		if (_waitgroup_count(self) == 0)
+			return;
+
 		worker_block_ahead();
 		mn_defer{worker_block_clear();};
 
-		pthread_mutex_lock(&self->mtx);
-		mn_defer{pthread_mutex_unlock(&self->mtx);};
+		while (true)
+		{
+			auto generation = self->generation.load();
+			if (_waitgroup_count(self) == 0)
+				break;
+
+			// the count is checked again after the sleeper is counted so that waitgroup_done either sees the sleeper
+			// or we see the count reaching 0
+			self->sleepers.fetch_add(1);
+			if (_waitgroup_count(self) == 0)
+			{
+				self->sleepers.fetch_sub(1);
+				break;
+			}
+			_thread_futex_wait(&self->generation, generation, nullptr);
+			self->sleepers.fetch_sub(1);
+		}
+	}
+
+	bool
+	waitgroup_wait_async(Waitgroup self, Async_Waiter* waiter)
+	{
+		_waitgroup_waiters_lock(self);
+		mn_defer{_waitgroup_waiters_unlock(self);};
 
-		while(self->count > 0)
-			pthread_cond_wait(&self->cv, &self->mtx);
+		if (_waitgroup_count(self) == 0)
+			return false;
 
-		mn_assert(self->count == 0);
+		waiter->next = self->async_waiters;
+		self->async_waiters = waiter;
+		return true;
 	}
 
 	void
 	waitgroup_add(Waitgroup self, int c)
 	{
 		mn_assert(c > 0);
-
-		pthread_mutex_lock(&self->mtx);
-		mn_defer{pthread_mutex_unlock(&self->mtx);};
-
-		self->count += c;
+		self->state.fetch_add(uint64_t(c));
 	}
 
 	void
 	waitgroup_done(Waitgroup self)
 	{
-		pthread_mutex_lock(&self->mtx);
-		mn_defer{pthread_mutex_unlock(&self->mtx);};
+		// decrements the count and registers this call as a user of the waitgroup in a single step
+		auto state = self->state.fetch_add(WAITGROUP_DONE_CALL - 1);
+		mn_assert((state & WAITGROUP_COUNT_MASK) > 0);
 
-		--self->count;
-		mn_assert(self->count >= 0);
+		if ((state & WAITGROUP_COUNT_MASK) != 1)
+		{
+			self->state.fetch_sub(WAITGROUP_DONE_CALL);
+			return;
+		}
 
-		if (self->count == 0)
-			pthread_cond_broadcast(&self->cv);
+		// the parked fibers and async waiters are taken off their lists while the waitgroup is still alive, and
+		// they're notified after it's released
+		_waitgroup_waiters_lock(self);
+		auto fibers = _fiber_wait_list_pop_all(self->fiber_waiters);
+		auto async_waiters = self->async_waiters;
+		self->async_waiters = nullptr;
+		_waitgroup_waiters_unlock(self);
+
+		self->generation.fetch_add(1);
+		if (self->sleepers.load() > 0)
+			_thread_futex_wake(&self->generation, INT_MAX);
+		self->state.fetch_sub(WAITGROUP_DONE_CALL);
+
+		_fiber_ready_all(fibers);
+		while (async_waiters)
+		{
+			auto waiter = async_waiters;
+			async_waiters = async_waiters->next;
+			waiter->notify(waiter);
+		}
 	}
 
 	int
 	waitgroup_count(Waitgroup self)
 	{
-		pthread_mutex_lock(&self->mtx);
-		mn_defer{pthread_mutex_unlock(&self->mtx);};
-
-		return self->count;
+		return _waitgroup_count(self);
 	}
 }
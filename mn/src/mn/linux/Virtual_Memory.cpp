@@ -1,16 +1,86 @@
 #include "mn/Virtual_Memory.h"
 
 #include <sys/mman.h>
+#include <unistd.h>
 
 namespace mn
 {
+	constexpr static size_t VIRTUAL_HUGE_PAGE_SIZE = 2ULL * 1024ULL * 1024ULL;
+
+	inline static size_t
+	_virtual_align_up(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	inline static size_t
+	_virtual_page_size()
+	{
+		static size_t page_size = size_t(::sysconf(_SC_PAGESIZE));
+		return page_size;
+	}
+
+	// populates anonymous memory, we write to each page because reading would just map the shared zero page
+	inline static void
+	_virtual_populate_write(Block block)
+	{
+	#ifdef MADV_POPULATE_WRITE
+		if (::madvise(block.ptr, block.size, MADV_POPULATE_WRITE) == 0)
+			return;
+	#endif
+		auto page_size = _virtual_page_size();
+		for (size_t i = 0; i < block.size; i += page_size)
+			((volatile char*)block.ptr)[i] = 0;
+	}
+
+	// API
 	Block
-	virtual_alloc(void* address_hint, size_t size)
+	virtual_alloc(void* address_hint, size_t size, const Virtual_Map_Options& options)
 	{
-		Block result{};
-		result.ptr = mmap(address_hint, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-		if(result.ptr)
-			result.size = size;
+		int flags = MAP_PRIVATE|MAP_ANONYMOUS;
+		if (options.huge_pages)
+		{
+			flags |= MAP_HUGETLB;
+			size = _virtual_align_up(size, VIRTUAL_HUGE_PAGE_SIZE);
+		}
+
+		// transparent huge pages are only used for 2MB aligned ranges so we overallocate then trim the mapping
+		bool align_huge = options.transparent_huge_pages &&
+			options.huge_pages == false &&
+			address_hint == nullptr &&
+			size >= VIRTUAL_HUGE_PAGE_SIZE;
+
+		// the madvise(MADV_HUGEPAGE) should happen before the pages are faulted in, so we populate after it
+		bool populate_after_advise = options.populate && options.transparent_huge_pages && options.huge_pages == false;
+		if (options.populate && populate_after_advise == false)
+			flags |= MAP_POPULATE;
+
+		auto map_size = align_huge ? size + VIRTUAL_HUGE_PAGE_SIZE : size;
+		auto ptr = ::mmap(address_hint, map_size, PROT_READ|PROT_WRITE, flags, -1, 0);
+		if (ptr == MAP_FAILED)
+			return Block{};
+
+		if (align_huge)
+		{
+			auto aligned = (char*)_virtual_align_up(size_t(ptr), VIRTUAL_HUGE_PAGE_SIZE);
+			auto head = size_t(aligned - (char*)ptr);
+			auto tail_begin = _virtual_align_up(head + size, _virtual_page_size());
+			if (head > 0)
+				::munmap(ptr, head);
+			if (tail_begin < map_size)
+				::munmap((char*)ptr + tail_begin, map_size - tail_begin);
+			ptr = aligned;
+		}
+
+		Block result{ptr, size};
+		if (virtual_advise(result, options) == false)
+		{
+			virtual_free(result);
+			return Block{};
+		}
+
+		if (populate_after_advise)
+			_virtual_populate_write(result);
 		return result;
 	}
 
@@ -19,4 +89,69 @@ namespace mn
 	{
 		munmap(block.ptr, block.size);
 	}
+
+	Block
+	virtual_realloc(Block block, size_t new_size, bool can_move)
+	{
+		if (block_is_empty(block))
+			return can_move ? virtual_alloc(nullptr, new_size) : Block{};
+
+		// mremap moves the page table entries instead of copying the content
+		auto ptr = ::mremap(block.ptr, block.size, new_size, can_move ? MREMAP_MAYMOVE : 0);
+		if (ptr == MAP_FAILED)
+			return Block{};
+		return Block{ptr, new_size};
+	}
+
+	Block
+	virtual_reserve(void* address_hint, size_t size)
+	{
+		auto ptr = ::mmap(address_hint, size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		if (ptr == MAP_FAILED)
+			return Block{};
+		return Block{ptr, size};
+	}
+
+	bool
+	virtual_commit(Block block)
+	{
+		return ::mprotect(block.ptr, block.size, PROT_READ|PROT_WRITE) == 0;
+	}
+
+	void
+	virtual_decommit(Block block)
+	{
+		// mapping a fresh inaccessible range over the old one drops its pages immediately
+		::mmap(block.ptr, block.size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE|MAP_FIXED, -1, 0);
+	}
+
+	bool
+	virtual_advise(Block block, const Virtual_Map_Options& options)
+	{
+		// madvise works on whole pages
+		auto page_size = _virtual_page_size();
+		auto begin = size_t(block.ptr) & ~(page_size - 1);
+		auto size = size_t(block.ptr) + block.size - begin;
+
+		// transparent huge pages might be disabled or unsupported, which is fine since it's only a hint
+		if (options.transparent_huge_pages)
+			::madvise((void*)begin, size, MADV_HUGEPAGE);
+
+		int advice = MADV_NORMAL;
+		switch (options.access)
+		{
+		case VIRTUAL_ACCESS_RANDOM: advice = MADV_RANDOM; break;
+		case VIRTUAL_ACCESS_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+		case VIRTUAL_ACCESS_WILL_NEED: advice = MADV_WILLNEED; break;
+		case VIRTUAL_ACCESS_NORMAL:
+		default: advice = MADV_NORMAL; break;
+		}
+		// new mappings already have the normal advice, so it's skipped to save the syscall
+		if (advice != MADV_NORMAL)
+			::madvise((void*)begin, size, advice);
+
+		if (options.lock && ::mlock(block.ptr, block.size) != 0)
+			return false;
+		return true;
+	}
 }
@@ -0,0 +1,363 @@
+#include "mn/Fiber.h"
+#include "mn/Thread.h"
+#include "mn/Virtual_Memory.h"
+#include "mn/Memory.h"
+#include "mn/Context.h"
+#include "mn/Defer.h"
+#include "mn/Assert.h"
+
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <sys/unistd.h>
+#include <pthread.h>
+
+// the context switch saves the callee saved registers on the suspended stack and switches the stack pointer, so
+// a switch costs about as much as a function call, a fresh fiber stack is laid out as if it was suspended in the
+// switch function and its return address points to the trampoline which calls the entry function
+#if defined(__x86_64__)
+asm(R"(
+	.text
+	.globl _mn_fiber_switch
+	.private_extern _mn_fiber_switch
+	.p2align 4
+_mn_fiber_switch:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+
+	.globl _mn_fiber_trampoline
+	.private_extern _mn_fiber_trampoline
+	.p2align 4
+_mn_fiber_trampoline:
+	movq %r12, %rdi
+	callq *%r13
+	ud2
+)");
+#elif defined(__aarch64__) || defined(__arm64__)
+asm(R"(
+	.text
+	.globl _mn_fiber_switch
+	.private_extern _mn_fiber_switch
+	.p2align 4
+_mn_fiber_switch:
+	sub sp, sp, #160
+	stp x19, x20, [sp, #0]
+	stp x21, x22, [sp, #16]
+	stp x23, x24, [sp, #32]
+	stp x25, x26, [sp, #48]
+	stp x27, x28, [sp, #64]
+	stp x29, x30, [sp, #80]
+	stp d8, d9, [sp, #96]
+	stp d10, d11, [sp, #112]
+	stp d12, d13, [sp, #128]
+	stp d14, d15, [sp, #144]
+	mov x9, sp
+	str x9, [x0]
+	mov sp, x1
+	ldp x19, x20, [sp, #0]
+	ldp x21, x22, [sp, #16]
+	ldp x23, x24, [sp, #32]
+	ldp x25, x26, [sp, #48]
+	ldp x27, x28, [sp, #64]
+	ldp x29, x30, [sp, #80]
+	ldp d8, d9, [sp, #96]
+	ldp d10, d11, [sp, #112]
+	ldp d12, d13, [sp, #128]
+	ldp d14, d15, [sp, #144]
+	add sp, sp, #160
+	ret
+
+	.globl _mn_fiber_trampoline
+	.private_extern _mn_fiber_trampoline
+	.p2align 4
+_mn_fiber_trampoline:
+	mov x0, x19
+	blr x20
+	brk #0
+)");
+#else
+	#error "unsupported architecture for fibers"
+#endif
+
+extern "C" void mn_fiber_switch(void** from_sp, void* to_sp);
+extern "C" void mn_fiber_trampoline();
+
+namespace mn
+{
+	inline static size_t
+	_fiber_page_size()
+	{
+		static size_t page_size = size_t(::sysconf(_SC_PAGESIZE));
+		return page_size;
+	}
+
+	// API
+	bool
+	_fiber_context_thread_init(Fiber_Context&)
+	{
+		return true;
+	}
+
+	void
+	_fiber_context_thread_free(Fiber_Context&)
+	{}
+
+	bool
+	_fiber_context_init(Fiber_Context& self, size_t stack_size, void (*entry)(void*), void* arg)
+	{
+		// the stack grows down so the guard page is placed below it, this way stack overflows fault instead of
+		// silently corrupting the memory before it
+		auto page_size = _fiber_page_size();
+		stack_size = (stack_size + page_size - 1) & ~(page_size - 1);
+		auto mapping = virtual_reserve(nullptr, stack_size + page_size);
+		if (mapping.ptr == nullptr)
+			return false;
+
+		if (virtual_commit(Block{(char*)mapping.ptr + page_size, stack_size}) == false)
+		{
+			virtual_free(mapping);
+			return false;
+		}
+
+		self = Fiber_Context{};
+		self.stack = mapping;
+		self.entry = entry;
+		self.arg = arg;
+
+		auto top = ((uintptr_t)mapping.ptr + mapping.size) & ~uintptr_t(15);
+		#if defined(__x86_64__)
+			// mxcsr/x87 control word, r15, r14, r13, r12, rbx, rbp, return address, the stack is aligned such that
+			// the trampoline calls the entry function with a 16 byte aligned stack
+			auto sp = (uint64_t*)(top - 80);
+			sp[0] = 0x1F80 | (uint64_t(0x037F) << 32);
+			sp[1] = 0;
+			sp[2] = 0;
+			sp[3] = (uint64_t)entry;
+			sp[4] = (uint64_t)arg;
+			sp[5] = 0;
+			sp[6] = 0;
+			sp[7] = (uint64_t)mn_fiber_trampoline;
+		#else
+			// x19-x28, x29 (frame pointer), x30 (link register), and d8-d15
+			auto sp = (uint64_t*)(top - 160);
+			for (size_t i = 0; i < 20; ++i)
+				sp[i] = 0;
+			sp[0] = (uint64_t)arg;
+			sp[1] = (uint64_t)entry;
+			sp[11] = (uint64_t)mn_fiber_trampoline;
+		#endif
+		self.sp = sp;
+		return true;
+	}
+
+	void
+	_fiber_context_free(Fiber_Context& self)
+	{
+		if (self.stack.ptr)
+			virtual_free(self.stack);
+		self = Fiber_Context{};
+	}
+
+	void
+	_fiber_context_switch(Fiber_Context& from, Fiber_Context& to)
+	{
+		mn_fiber_switch(&from.sp, to.sp);
+	}
+
+
+	// the poller is a process wide thread which waits on a kqueue, waits are registered as oneshot events so each
+	// one fires at most once, and the waits with deadlines are kept in a list which the poller expires
+	// note: kqueue merges registrations of the same fd and filter, so only a single wait per fd and direction is
+	// supported
+	struct Mac_Fiber_Poller
+	{
+		int kq;
+		bool running;
+		// protects the timed waits list and the wake deadline
+		pthread_mutex_t mtx;
+		Poll_Wait* timed_waits;
+		// the deadline the poller is currently sleeping until
+		uint64_t wake_deadline_in_ms;
+	};
+
+	inline static void
+	_mac_poller_unlink(Mac_Fiber_Poller* self, Poll_Wait* wait)
+	{
+		if (wait->prev)
+			wait->prev->next = wait->next;
+		else
+			self->timed_waits = wait->next;
+		if (wait->next)
+			wait->next->prev = wait->prev;
+		wait->prev = nullptr;
+		wait->next = nullptr;
+	}
+
+	static void*
+	_mac_poller_main(void* poller)
+	{
+		auto self = (Mac_Fiber_Poller*)poller;
+		_disable_profiling_for_this_thread();
+
+		struct kevent events[64];
+		while (true)
+		{
+			timespec timeout{};
+			timespec* timeout_ptr = nullptr;
+			{
+				pthread_mutex_lock(&self->mtx);
+				uint64_t deadline = UINT64_MAX;
+				for (auto it = self->timed_waits; it; it = it->next)
+					if (it->deadline_in_ms < deadline)
+						deadline = it->deadline_in_ms;
+				self->wake_deadline_in_ms = deadline;
+				pthread_mutex_unlock(&self->mtx);
+
+				if (deadline != UINT64_MAX)
+				{
+					auto now = time_in_millis();
+					auto millis = deadline > now ? deadline - now : 0;
+					timeout.tv_sec = millis / 1000;
+					timeout.tv_nsec = (millis % 1000) * 1000000;
+					timeout_ptr = &timeout;
+				}
+			}
+
+			auto count = ::kevent(self->kq, nullptr, 0, events, 64, timeout_ptr);
+			for (int i = 0; i < count; ++i)
+			{
+				if (events[i].filter == EVFILT_USER)
+					continue;
+
+				auto wait = (Poll_Wait*)events[i].udata;
+				if (wait->deadline_in_ms != UINT64_MAX)
+				{
+					pthread_mutex_lock(&self->mtx);
+					_mac_poller_unlink(self, wait);
+					pthread_mutex_unlock(&self->mtx);
+				}
+				wait->on_done(wait, true);
+			}
+
+			// expire the timed out waits, they're moved to a separate list first so that the callbacks are called
+			// without holding the mutex
+			Poll_Wait* expired = nullptr;
+			{
+				auto now = time_in_millis();
+				pthread_mutex_lock(&self->mtx);
+				auto it = self->timed_waits;
+				while (it)
+				{
+					auto next = it->next;
+					if (it->deadline_in_ms <= now)
+					{
+						_mac_poller_unlink(self, it);
+						it->next = expired;
+						expired = it;
+					}
+					it = next;
+				}
+				pthread_mutex_unlock(&self->mtx);
+			}
+
+			while (expired)
+			{
+				auto wait = expired;
+				expired = expired->next;
+
+				struct kevent change{};
+				EV_SET(&change, uintptr_t(wait->fd), wait->write ? EVFILT_WRITE : EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+				::kevent(self->kq, &change, 1, nullptr, 0, nullptr);
+				wait->on_done(wait, false);
+			}
+		}
+		return nullptr;
+	}
+
+	inline static Mac_Fiber_Poller*
+	_mac_poller()
+	{
+		static Mac_Fiber_Poller* poller = []{
+			// the poller lives as long as the process, so it's never freed
+			static Mac_Fiber_Poller self{};
+			::pthread_mutex_init(&self.mtx, nullptr);
+			self.wake_deadline_in_ms = UINT64_MAX;
+			self.kq = ::kqueue();
+			if (self.kq == -1)
+				return &self;
+
+			struct kevent change{};
+			EV_SET(&change, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+			if (::kevent(self.kq, &change, 1, nullptr, 0, nullptr) == -1)
+				return &self;
+
+			pthread_t thread;
+			if (::pthread_create(&thread, nullptr, _mac_poller_main, &self) != 0)
+				return &self;
+			::pthread_detach(thread);
+			self.running = true;
+			return &self;
+		}();
+		return poller;
+	}
+
+	bool
+	_poll_wait_start(Poll_Wait* wait)
+	{
+		auto self = _mac_poller();
+		if (self->running == false)
+			return false;
+
+		wait->prev = nullptr;
+		wait->next = nullptr;
+
+		struct kevent change{};
+		EV_SET(&change, uintptr_t(wait->fd), wait->write ? EVFILT_WRITE : EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, wait);
+
+		// the wait is registered and linked under the mutex so that the poller can't complete it before it's linked
+		bool wake = false;
+		{
+			pthread_mutex_lock(&self->mtx);
+			mn_defer{pthread_mutex_unlock(&self->mtx);};
+
+			if (::kevent(self->kq, &change, 1, nullptr, 0, nullptr) == -1)
+				return false;
+
+			if (wait->deadline_in_ms != UINT64_MAX)
+			{
+				wait->next = self->timed_waits;
+				if (self->timed_waits)
+					self->timed_waits->prev = wait;
+				self->timed_waits = wait;
+				wake = wait->deadline_in_ms < self->wake_deadline_in_ms;
+			}
+		}
+
+		if (wake)
+		{
+			struct kevent trigger{};
+			EV_SET(&trigger, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+			::kevent(self->kq, &trigger, 1, nullptr, 0, nullptr);
+		}
+		return true;
+	}
+}
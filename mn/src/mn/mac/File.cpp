@@ -2,6 +2,7 @@
 #include "mn/OS.h"
 #include "mn/Fabric.h"
 #include "mn/Assert.h"
+#include "mn/Defer.h"
 
 #define _LARGEFILE64_SOURCE 1
 #include <sys/stat.h>
@@ -340,6 +341,138 @@ namespace mn
 		return fcntl(self->macos_handle, F_SETLK, &fl) != -1;
 	}
 
+	size_t
+	file_read_at(File self, int64_t offset, Block data)
+	{
+		mn_assert(offset >= 0);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		size_t total = 0;
+		while (total < data.size)
+		{
+			auto res = ::pread(self->macos_handle, (char*)data.ptr + total, data.size - total, offset + total);
+			if (res < 0 && errno == EINTR)
+				continue;
+			if (res <= 0)
+				break;
+			total += res;
+		}
+		return total;
+	}
+
+	size_t
+	file_write_at(File self, int64_t offset, Block data)
+	{
+		mn_assert(offset >= 0);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		size_t total = 0;
+		while (total < data.size)
+		{
+			auto res = ::pwrite(self->macos_handle, (char*)data.ptr + total, data.size - total, offset + total);
+			if (res < 0 && errno == EINTR)
+				continue;
+			if (res <= 0)
+				break;
+			total += res;
+		}
+		return total;
+	}
+
+	// preadv/pwritev are only available starting from macOS 11 so we issue a positional call per block
+	size_t
+	file_readv_at(File self, int64_t offset, const Block* blocks, size_t blocks_count)
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < blocks_count; ++i)
+		{
+			auto res = file_read_at(self, offset + total, blocks[i]);
+			total += res;
+			if (res < blocks[i].size)
+				break;
+		}
+		return total;
+	}
+
+	size_t
+	file_writev_at(File self, int64_t offset, const Block* blocks, size_t blocks_count)
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < blocks_count; ++i)
+		{
+			auto res = file_write_at(self, offset + total, blocks[i]);
+			total += res;
+			if (res < blocks[i].size)
+				break;
+		}
+		return total;
+	}
+
+	bool
+	file_preallocate(File self, int64_t offset, int64_t size)
+	{
+		mn_assert(offset >= 0 && size >= 0);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		// try to get a contiguous allocation first then fallback to a fragmented one
+		fstore_t store{};
+		store.fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL;
+		store.fst_posmode = F_PEOFPOSMODE;
+		store.fst_offset = 0;
+		store.fst_length = offset + size;
+		if (::fcntl(self->macos_handle, F_PREALLOCATE, &store) == -1)
+		{
+			store.fst_flags = F_ALLOCATEALL;
+			if (::fcntl(self->macos_handle, F_PREALLOCATE, &store) == -1)
+				return false;
+		}
+
+		// F_PREALLOCATE doesn't change the file size
+		if (file_size(self) < offset + size)
+			return ::ftruncate(self->macos_handle, offset + size) == 0;
+		return true;
+	}
+
+	bool
+	file_access_hint(File self, int64_t offset, int64_t size, FILE_ACCESS_HINT hint)
+	{
+		mn_assert(offset >= 0 && size >= 0);
+
+		// macOS only has file level read ahead control and explicit read advisories
+		switch (hint)
+		{
+		case FILE_ACCESS_HINT_NORMAL:
+		case FILE_ACCESS_HINT_SEQUENTIAL:
+			return ::fcntl(self->macos_handle, F_RDAHEAD, 1) != -1;
+		case FILE_ACCESS_HINT_RANDOM:
+			return ::fcntl(self->macos_handle, F_RDAHEAD, 0) != -1;
+		case FILE_ACCESS_HINT_WILL_NEED:
+		{
+			auto len = size;
+			if (len == 0)
+				len = file_size(self) - offset;
+			if (len <= 0)
+				return true;
+
+			radvisory advisory{};
+			advisory.ra_offset = offset;
+			advisory.ra_count = len > INT_MAX ? INT_MAX : int(len);
+			return ::fcntl(self->macos_handle, F_RDADVISE, &advisory) != -1;
+		}
+		case FILE_ACCESS_HINT_DONT_NEED:
+			return true;
+		default:
+			mn_unreachable();
+			return false;
+		}
+	}
+
 	struct IMapped_File
 	{
 		Mapped_File file_view;
@@ -348,7 +481,7 @@ namespace mn
 	};
 
 	Mapped_File*
-	file_mmap(File file, int64_t offset, int64_t size, IO_MODE io_mode)
+	file_mmap(File file, int64_t offset, int64_t size, IO_MODE io_mode, const Virtual_Map_Options& options)
 	{
 		int prot = PROT_READ;
 		int flags = MAP_PRIVATE;
@@ -392,9 +525,23 @@ namespace mn
 			offset
 		);
 
-		if (ptr == nullptr)
+		if (ptr == MAP_FAILED)
 			return nullptr;
 
+		if (virtual_advise(Block{ptr, size_t(size)}, options) == false)
+		{
+			::munmap(ptr, size);
+			return nullptr;
+		}
+
+		// there's no MAP_POPULATE on macOS so we fault the pages in ourselves
+		if (options.populate && (prot & PROT_READ))
+		{
+			auto page_size = size_t(::getpagesize());
+			for (size_t i = 0; i < size_t(size); i += page_size)
+				(void)((volatile char*)ptr)[i];
+		}
+
 		auto self = alloc_zerod<IMapped_File>();
 		self->file_view.data.ptr = ptr;
 		self->file_view.data.size = size;
@@ -403,14 +550,14 @@ namespace mn
 	}
 
 	Mapped_File*
-	file_mmap(const Str& filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode)
+	file_mmap(const Str& filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode, const Virtual_Map_Options& options)
 	{
 		auto file = file_open(filename, io_mode, open_mode, share_mode);
 		if (file == nullptr)
 			return nullptr;
 		mn_defer{if (file) file_close(file);};
 
-		auto res = file_mmap(file, offset, size, io_mode);
+		auto res = file_mmap(file, offset, size, io_mode, options);
 		if (res == nullptr)
 			return nullptr;
 
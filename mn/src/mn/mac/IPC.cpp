@@ -11,6 +11,7 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <poll.h>
+#include <sys/stat.h>
 
 namespace mn::ipc
 {
@@ -314,4 +315,125 @@ namespace mn::ipc
 		mn_assert(remaining == 0);
 		return res;
 	}
+
+	// macos doesn't expose a public cross-process futex so we poll the word instead
+	bool
+	futex_wait(std::atomic<uint32_t>* word, uint32_t expected, Timeout timeout)
+	{
+		bool changed = false;
+		worker_block_on_with_timeout(timeout, [&]{
+			changed = word->load() != expected;
+			return changed;
+		});
+		return changed || timeout == INFINITE_TIMEOUT;
+	}
+
+	void
+	futex_wake_one(std::atomic<uint32_t>*)
+	{
+		// do nothing, waiters poll the word
+	}
+
+	void
+	futex_wake_all(std::atomic<uint32_t>*)
+	{
+		// do nothing, waiters poll the word
+	}
+
+	inline static Str
+	_shared_memory_name(const Str& name)
+	{
+		// posix shared memory names should start with a slash
+		if (str_prefix(name, "/"))
+			return str_clone(name);
+		return strf("/{}", name);
+	}
+
+	Shared_Memory
+	shared_memory_new(const Str& name, size_t size)
+	{
+		mn_assert(size > 0);
+		auto os_name = _shared_memory_name(name);
+
+		// the segment might be in use by another process, so an existing segment is an error rather than being replaced
+		int handle = ::shm_open(os_name.ptr, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+		if (handle == -1)
+		{
+			str_free(os_name);
+			return nullptr;
+		}
+
+		if (::ftruncate(handle, size) != 0)
+		{
+			::close(handle);
+			::shm_unlink(os_name.ptr);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+		if (ptr == MAP_FAILED)
+		{
+			::close(handle);
+			::shm_unlink(os_name.ptr);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto self = alloc_zerod<IShared_Memory>();
+		self->macos_handle = handle;
+		self->name = os_name;
+		self->data = Block{ptr, size};
+		self->owner = true;
+		return self;
+	}
+
+	Shared_Memory
+	shared_memory_open(const Str& name)
+	{
+		auto os_name = _shared_memory_name(name);
+
+		int handle = ::shm_open(os_name.ptr, O_RDWR, S_IRUSR | S_IWUSR);
+		if (handle == -1)
+		{
+			str_free(os_name);
+			return nullptr;
+		}
+
+		// the creator might still be resizing the segment
+		struct stat sb{};
+		if (::fstat(handle, &sb) != 0 || sb.st_size == 0)
+		{
+			::close(handle);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto size = size_t(sb.st_size);
+		auto ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+		if (ptr == MAP_FAILED)
+		{
+			::close(handle);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto self = alloc_zerod<IShared_Memory>();
+		self->macos_handle = handle;
+		self->name = os_name;
+		self->data = Block{ptr, size};
+		self->owner = false;
+		return self;
+	}
+
+	void
+	shared_memory_free(Shared_Memory self)
+	{
+		::munmap(self->data.ptr, self->data.size);
+		::close(self->macos_handle);
+		if (self->owner)
+			::shm_unlink(self->name.ptr);
+		str_free(self->name);
+		free(self);
+	}
 }
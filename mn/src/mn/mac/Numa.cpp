@@ -0,0 +1,18 @@
+#include "mn/Numa.h"
+
+#include <thread>
+
+namespace mn
+{
+	Buf<Numa_Node>
+	numa_nodes(Allocator allocator)
+	{
+		// macOS machines are uniform memory access, so we report all the cpus in a single node
+		auto res = buf_with_allocator<Numa_Node>(allocator);
+		Numa_Node node{};
+		for (size_t cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+			cpu_set_add(node.cpus, cpu);
+		buf_push(res, node);
+		return res;
+	}
+}
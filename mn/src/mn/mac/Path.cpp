@@ -3,6 +3,7 @@
 #include "mn/IO.h"
 #include "mn/Defer.h"
 #include "mn/Assert.h"
+#include "mn/Fabric.h"
 
 #define _LARGEFILE64_SOURCE 1
 #include <sys/stat.h>
@@ -196,9 +197,27 @@ namespace mn
 				{
 					entry.kind = Path_Entry::KIND_FILE;
 				}
+				else if(dir->d_type == DT_LNK)
+				{
+					entry.kind = Path_Entry::KIND_SYMLINK;
+				}
+				else if(dir->d_type == DT_UNKNOWN)
+				{
+					struct stat sb{};
+					if(::fstatat(::dirfd(d), dir->d_name, &sb, AT_SYMLINK_NOFOLLOW) != 0)
+						continue;
+					if(S_ISDIR(sb.st_mode))
+						entry.kind = Path_Entry::KIND_FOLDER;
+					else if(S_ISREG(sb.st_mode))
+						entry.kind = Path_Entry::KIND_FILE;
+					else if(S_ISLNK(sb.st_mode))
+						entry.kind = Path_Entry::KIND_SYMLINK;
+					else
+						entry.kind = Path_Entry::KIND_OTHER;
+				}
 				else
 				{
-					mn_unreachable();
+					entry.kind = Path_Entry::KIND_OTHER;
 				}
 				entry.name = str_from_c(dir->d_name, allocator);
 				buf_push(res, entry);
@@ -359,28 +378,35 @@ namespace mn
 				continue;
 
 			str_clear(tmp_path);
-			if(files[i].kind == Path_Entry::KIND_FILE)
-			{
-				tmp_path = path_join(tmp_path, path, files[i].name);
-				if(file_remove(tmp_path) == false)
-					return false;
-			}
-			else if(files[i].kind == Path_Entry::KIND_FOLDER)
+			tmp_path = path_join(tmp_path, path, files[i].name);
+			if(files[i].kind == Path_Entry::KIND_FOLDER)
 			{
-				tmp_path = path_join(tmp_path, path, files[i].name);
 				if(folder_remove(tmp_path) == false)
 					return false;
 			}
 			else
 			{
-				mn_unreachable();
-				return false;
+				// files, symlinks (which are not followed) and special files are all unlinked
+				if(file_remove(tmp_path) == false)
+					return false;
 			}
 		}
 
 		return ::rmdir(path) == 0;
 	}
 
+	// recreates the symlink at src as a symlink at dst, the same way cp -R does it
+	static bool
+	_folder_copy_symlink(const char* src, const char* dst)
+	{
+		char target[PATH_MAX + 1];
+		auto len = ::readlink(src, target, PATH_MAX);
+		if (len < 0)
+			return false;
+		target[len] = '\0';
+		return ::symlink(target, dst) == 0;
+	}
+
 	bool
 	folder_copy(const char* src, const char* dst)
 	{
@@ -422,10 +448,12 @@ namespace mn
 					if(folder_copy(tmp_src, tmp_dst) == false)
 						break;
 				}
-				else
+				else if(files[i].kind == Path_Entry::KIND_SYMLINK)
 				{
-					mn_unreachable();
-					break;
+					tmp_src = path_join(tmp_src, src, files[i].name);
+					tmp_dst = path_join(tmp_dst, dst, files[i].name);
+					if(_folder_copy_symlink(tmp_src.ptr, tmp_dst.ptr) == false)
+						break;
 				}
 			}
 		}
@@ -433,6 +461,87 @@ namespace mn
 		return i == files.count;
 	}
 
+	// walks the src folder tree once, creates the folders in dst and calls on_file(src, dst) for each file
+	template<typename TFunc>
+	static bool
+	_folder_copy_walk(const Str& src, const Str& dst, TFunc& on_file)
+	{
+		auto files = path_entries(src);
+		mn_defer{destruct(files);};
+
+		//create the folder no matter what
+		if(folder_make(dst) == false)
+			return false;
+
+		auto tmp_src = str_new();
+		mn_defer{str_free(tmp_src);};
+
+		auto tmp_dst = str_new();
+		mn_defer{str_free(tmp_dst);};
+
+		for(const auto& entry: files)
+		{
+			if(entry.name == "." || entry.name == "..")
+				continue;
+
+			str_clear(tmp_src);
+			str_clear(tmp_dst);
+			tmp_src = path_join(tmp_src, src, entry.name);
+			tmp_dst = path_join(tmp_dst, dst, entry.name);
+
+			bool ok = false;
+			if(entry.kind == Path_Entry::KIND_FILE)
+				ok = on_file(tmp_src, tmp_dst);
+			else if(entry.kind == Path_Entry::KIND_FOLDER)
+				ok = _folder_copy_walk(tmp_src, tmp_dst, on_file);
+			else if(entry.kind == Path_Entry::KIND_SYMLINK)
+				ok = _folder_copy_symlink(tmp_src.ptr, tmp_dst.ptr);
+			else
+				ok = true;
+
+			if(ok == false)
+				return false;
+		}
+		return true;
+	}
+
+	bool
+	folder_copy(const char* src, const char* dst, Fabric fabric, size_t max_in_flight)
+	{
+		if(max_in_flight == 0)
+			max_in_flight = 2 * fabric_workers_count(fabric);
+
+		// the channel is used as a counting semaphore, each in flight copy holds one slot
+		auto in_flight = chan_new<bool>(int32_t(max_in_flight));
+		mn_defer{chan_free(in_flight);};
+
+		auto wg = waitgroup_new();
+		mn_defer{waitgroup_free(wg);};
+
+		std::atomic<bool> failed = false;
+
+		auto on_file = [&](const Str& file_src, const Str& file_dst) {
+			if(failed.load(std::memory_order_relaxed))
+				return false;
+
+			chan_send(in_flight, true);
+			waitgroup_add(wg, 1);
+			go(fabric, [in_flight, wg, &failed, file_src = clone(file_src), file_dst = clone(file_dst)]() mutable {
+				if(file_copy(file_src, file_dst) == false)
+					failed = true;
+				str_free(file_src);
+				str_free(file_dst);
+				chan_recv_try(in_flight);
+				waitgroup_done(wg);
+			});
+			return true;
+		};
+		bool walked = _folder_copy_walk(str_lit(src), str_lit(dst), on_file);
+
+		waitgroup_wait(wg);
+		return walked && failed == false;
+	}
+
 	Str
 	folder_tmp(Allocator allocator)
 	{
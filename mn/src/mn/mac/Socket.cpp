@@ -66,6 +66,36 @@ namespace mn
 	}
 
 
+	// waits for the socket to be readable and returns the same result as poll, a fiber is parked until the socket
+	// is ready instead of blocking its worker
+	inline static int
+	_socket_poll_read(Socket self, Timeout timeout)
+	{
+		if(timeout != NO_TIMEOUT)
+		{
+			int res = fiber_wait_fd(self->handle, false, timeout);
+			if(res != -1)
+				return res;
+		}
+
+		pollfd pfd_read{};
+		pfd_read.fd = self->handle;
+		pfd_read.events = POLLIN;
+
+		int milliseconds = 0;
+		if(timeout == INFINITE_TIMEOUT)
+			milliseconds = -1;
+		else if(timeout == NO_TIMEOUT)
+			milliseconds = 0;
+		else
+			milliseconds = int(timeout.milliseconds);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+		return ::poll(&pfd_read, 1, milliseconds);
+	}
+
+
 	// API
 	void
 	ISocket::dispose()
@@ -180,26 +210,9 @@ namespace mn
 	Socket
 	socket_accept(Socket self, Timeout timeout)
 	{
-		pollfd pfd_read{};
-		pfd_read.fd = self->handle;
-		pfd_read.events = POLLIN;
-
-		int milliseconds = 0;
-		if(timeout == INFINITE_TIMEOUT)
-			milliseconds = -1;
-		else if(timeout == NO_TIMEOUT)
-			milliseconds = 0;
-		else
-			milliseconds = int(timeout.milliseconds);
-
-		{
-			worker_block_ahead();
-			mn_defer{worker_block_clear();};
+		if (_socket_poll_read(self, timeout) <= 0)
+			return nullptr;
 
-			int ready = poll(&pfd_read, 1, milliseconds);
-			if(ready == 0)
-				return nullptr;
-		}
 		auto handle = ::accept(self->handle, nullptr, nullptr);
 		if(handle == -1)
 			return nullptr;
@@ -220,22 +233,8 @@ namespace mn
 	Result<size_t, MN_SOCKET_ERROR>
 	socket_read(Socket self, Block data, Timeout timeout)
 	{
-		pollfd pfd_read{};
-		pfd_read.fd = self->handle;
-		pfd_read.events = POLLIN;
-
-		int milliseconds = 0;
-		if (timeout == INFINITE_TIMEOUT)
-			milliseconds = -1;
-		else if (timeout == NO_TIMEOUT)
-			milliseconds = 0;
-		else
-			milliseconds = int(timeout.milliseconds);
-
 		ssize_t res = 0;
-		worker_block_ahead();
-		mn_defer{worker_block_clear();};
-		int ready = ::poll(&pfd_read, 1, milliseconds);
+		int ready = _socket_poll_read(self, timeout);
 		if(ready > 0)
 		{
 			res = ::recv(self->handle, data.ptr, data.size, 0);
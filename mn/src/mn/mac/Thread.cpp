@@ -22,6 +22,8 @@ namespace mn
 		const char* name;
 		const Source_Location* srcloc;
 		void* profile_user_data;
+		// fibers parked until the mutex is unlocked
+		Fiber_Wait_List fiber_waiters;
 	};
 
 	struct Leak_Allocator_Mutex
@@ -40,6 +42,7 @@ namespace mn
 			self.srcloc = &srcloc;
 			[[maybe_unused]] int result = pthread_mutex_init(&self.handle, NULL);
 			mn_assert(result == 0);
+			_fiber_wait_list_init(self.fiber_waiters);
 			self.profile_user_data = _mutex_new(&self, self.name);
 		}
 
@@ -393,6 +396,7 @@ namespace mn
 		self->name = srcloc->name;
 		[[maybe_unused]] int result = pthread_mutex_init(&self->handle, NULL);
 		mn_assert(result == 0);
+		_fiber_wait_list_init(self->fiber_waiters);
 
 		self->profile_user_data = _mutex_new(self, self->name);
 
@@ -407,6 +411,7 @@ namespace mn
 		self->name = name;
 		[[maybe_unused]] int result = pthread_mutex_init(&self->handle, NULL);
 		mn_assert(result == 0);
+		_fiber_wait_list_init(self->fiber_waiters);
 
 		self->profile_user_data = _mutex_new(self, self->name);
 
@@ -428,6 +433,16 @@ namespace mn
 			return;
 		}
 
+		// fibers are parked instead of blocking their worker
+		if (auto fiber = fiber_local())
+		{
+			_fiber_mutex_lock(self->fiber_waiters, fiber, [self]{
+				return pthread_mutex_trylock(&self->handle) == 0;
+			});
+			_deadlock_detector_mutex_set_exclusive_owner(self);
+			return;
+		}
+
 		worker_block_ahead();
 		_deadlock_detector_mutex_block(self);
 		[[maybe_unused]] int result = pthread_mutex_lock(&self->handle);
@@ -442,6 +457,7 @@ namespace mn
 		_deadlock_detector_mutex_unset_owner(self);
 		[[maybe_unused]] int result = pthread_mutex_unlock(&self->handle);
 		mn_assert(result == 0);
+		_fiber_mutex_unlock(self->fiber_waiters);
 		_mutex_after_unlock(self, self->profile_user_data);
 	}
 
@@ -460,6 +476,12 @@ namespace mn
 		return self->srcloc;
 	}
 
+	const char*
+	mutex_name(Mutex self)
+	{
+		return self->name;
+	}
+
 
 	//Mutex_RW API
 	struct IMutex_RW
@@ -492,6 +514,13 @@ namespace mn
 		return self;
 	}
 
+	Mutex_RW
+	mutex_rw_reader_biased_new(const char* name)
+	{
+		// the per cpu reader counts are only implemented on linux
+		return mutex_rw_new(name);
+	}
+
 	void
 	mutex_rw_free(Mutex_RW self)
 	{
@@ -566,6 +595,12 @@ namespace mn
 		return self->srcloc;
 	}
 
+	const char*
+	mutex_rw_name(Mutex_RW self)
+	{
+		return self->name;
+	}
+
 
 	//Thread
 	struct IThread
@@ -627,6 +662,13 @@ namespace mn
 		return (void*)pthread_self();
 	}
 
+	bool
+	thread_affinity_set(const Cpu_Set&)
+	{
+		// macOS doesn't support binding threads to cpus, it only accepts affinity tags as scheduling hints
+		return false;
+	}
+
 
 	uint64_t
 	time_in_millis()
@@ -640,6 +682,8 @@ namespace mn
 	struct ICond_Var
 	{
 		pthread_cond_t cv;
+		// fibers parked on the condition variable
+		Fiber_Wait_List fiber_waiters;
 	};
 
 	Cond_Var
@@ -648,6 +692,7 @@ namespace mn
 		auto self = alloc<ICond_Var>();
 		[[maybe_unused]] auto res = pthread_cond_init(&self->cv, NULL);
 		mn_assert(res == 0);
+		_fiber_wait_list_init(self->fiber_waiters);
 		return self;
 	}
 
@@ -662,6 +707,17 @@ namespace mn
 	void
 	cond_var_wait(Cond_Var self, Mutex mtx)
 	{
+		// fibers are parked instead of blocking their worker, the fiber is added to the wait list before it
+		// unlocks the mutex so that it can't miss a notification
+		if (auto fiber = fiber_local())
+		{
+			_fiber_wait_list_push(self->fiber_waiters, fiber);
+			mutex_unlock(mtx);
+			fiber_park();
+			mutex_lock(mtx);
+			return;
+		}
+
 		worker_block_ahead();
 		_deadlock_detector_mutex_unset_owner(mtx);
 		pthread_cond_wait(&self->cv, &mtx->handle);
@@ -693,12 +749,18 @@ namespace mn
 	void
 	cond_var_notify(Cond_Var self)
 	{
+		if (auto fiber = _fiber_wait_list_pop(self->fiber_waiters))
+		{
+			fiber_ready(fiber);
+			return;
+		}
 		pthread_cond_signal(&self->cv);
 	}
 
 	void
 	cond_var_notify_all(Cond_Var self)
 	{
+		_fiber_ready_all(_fiber_wait_list_pop_all(self->fiber_waiters));
 		pthread_cond_broadcast(&self->cv);
 	}
 
@@ -708,6 +770,10 @@ namespace mn
 		int count;
 		pthread_mutex_t mtx;
 		pthread_cond_t cv;
+		// fibers parked until the count reaches 0
+		Fiber_Wait_List fiber_waiters;
+		// asynchronous waiters notified when the count reaches 0
+		Async_Waiter* async_waiters;
 	};
 
 	Waitgroup
@@ -719,6 +785,8 @@ namespace mn
 		mn_assert(res == 0);
 		res = pthread_cond_init(&self->cv, NULL);
 		mn_assert(res == 0);
+		_fiber_wait_list_init(self->fiber_waiters);
+		self->async_waiters = nullptr;
 		return self;
 	}
 
@@ -735,6 +803,21 @@ namespace mn
 	void
 	waitgroup_wait(Waitgroup self)
 	{
+		// fibers are parked instead of blocking their worker
+		if (auto fiber = fiber_local())
+		{
+			pthread_mutex_lock(&self->mtx);
+			while (self->count > 0)
+			{
+				_fiber_wait_list_push(self->fiber_waiters, fiber);
+				pthread_mutex_unlock(&self->mtx);
+				fiber_park();
+				pthread_mutex_lock(&self->mtx);
+			}
+			pthread_mutex_unlock(&self->mtx);
+			return;
+		}
+
 		worker_block_ahead();
 		mn_defer{worker_block_clear();};
 
@@ -747,6 +830,20 @@ namespace mn
 		mn_assert(self->count == 0);
 	}
 
+	bool
+	waitgroup_wait_async(Waitgroup self, Async_Waiter* waiter)
+	{
+		pthread_mutex_lock(&self->mtx);
+		mn_defer{pthread_mutex_unlock(&self->mtx);};
+
+		if (self->count == 0)
+			return false;
+
+		waiter->next = self->async_waiters;
+		self->async_waiters = waiter;
+		return true;
+	}
+
 	void
 	waitgroup_add(Waitgroup self, int c)
 	{
@@ -761,14 +858,33 @@ namespace mn
 	void
 	waitgroup_done(Waitgroup self)
 	{
-		pthread_mutex_lock(&self->mtx);
-		mn_defer{pthread_mutex_unlock(&self->mtx);};
+		// the parked fibers and async waiters are taken off their lists under the mutex, because the waitgroup might
+		// be freed once it's unlocked, and they're notified after the mutex is unlocked
+		Fiber fibers = nullptr;
+		Async_Waiter* async_waiters = nullptr;
+		{
+			pthread_mutex_lock(&self->mtx);
+			mn_defer{pthread_mutex_unlock(&self->mtx);};
 
-		--self->count;
-		mn_assert(self->count >= 0);
+			--self->count;
+			mn_assert(self->count >= 0);
 
-		if (self->count == 0)
-			pthread_cond_broadcast(&self->cv);
+			if (self->count == 0)
+			{
+				pthread_cond_broadcast(&self->cv);
+				fibers = _fiber_wait_list_pop_all(self->fiber_waiters);
+				async_waiters = self->async_waiters;
+				self->async_waiters = nullptr;
+			}
+		}
+		_fiber_ready_all(fibers);
+
+		while (async_waiters)
+		{
+			auto waiter = async_waiters;
+			async_waiters = async_waiters->next;
+			waiter->notify(waiter);
+		}
 	}
 
 	int
@@ -1,16 +1,47 @@
 #include "mn/Virtual_Memory.h"
 
 #include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
 
 namespace mn
 {
+	inline static size_t
+	_virtual_page_size()
+	{
+		static size_t page_size = size_t(::getpagesize());
+		return page_size;
+	}
+
+	inline static size_t
+	_virtual_align_up(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// API
+	// macOS has neither MAP_POPULATE nor transparent huge pages, and its superpages are x86 only,
+	// so huge pages options are ignored and we populate by touching the pages
 	Block
-	virtual_alloc(void* address_hint, size_t size)
+	virtual_alloc(void* address_hint, size_t size, const Virtual_Map_Options& options)
 	{
-		Block result{};
-		result.ptr = mmap(address_hint, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-		if(result.ptr)
-			result.size = size;
+		auto ptr = ::mmap(address_hint, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			return Block{};
+
+		Block result{ptr, size};
+		if (virtual_advise(result, options) == false)
+		{
+			virtual_free(result);
+			return Block{};
+		}
+
+		if (options.populate)
+		{
+			auto page_size = _virtual_page_size();
+			for (size_t i = 0; i < size; i += page_size)
+				((volatile char*)ptr)[i] = 0;
+		}
 		return result;
 	}
 
@@ -19,4 +50,87 @@ namespace mn
 	{
 		munmap(block.ptr, block.size);
 	}
+
+	Block
+	virtual_realloc(Block block, size_t new_size, bool can_move)
+	{
+		if (block_is_empty(block))
+			return can_move ? virtual_alloc(nullptr, new_size) : Block{};
+
+		auto page_size = _virtual_page_size();
+		auto begin = size_t(block.ptr);
+		auto old_end = _virtual_align_up(begin + block.size, page_size);
+		auto new_end = _virtual_align_up(begin + new_size, page_size);
+
+		if (new_end <= old_end)
+		{
+			if (new_end < old_end)
+				::munmap((void*)new_end, old_end - new_end);
+			return Block{block.ptr, new_size};
+		}
+
+		// macOS doesn't have mremap, so we try to map the pages right after the block using an address hint
+		auto tail = ::mmap((void*)old_end, new_end - old_end, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (tail == (void*)old_end)
+			return Block{block.ptr, new_size};
+		if (tail != MAP_FAILED)
+			::munmap(tail, new_end - old_end);
+
+		if (can_move == false)
+			return Block{};
+
+		auto res = virtual_alloc(nullptr, new_size);
+		if (block_is_empty(res))
+			return Block{};
+		::memcpy(res.ptr, block.ptr, block.size);
+		virtual_free(block);
+		return res;
+	}
+
+	Block
+	virtual_reserve(void* address_hint, size_t size)
+	{
+		auto ptr = ::mmap(address_hint, size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		if (ptr == MAP_FAILED)
+			return Block{};
+		return Block{ptr, size};
+	}
+
+	bool
+	virtual_commit(Block block)
+	{
+		return ::mprotect(block.ptr, block.size, PROT_READ|PROT_WRITE) == 0;
+	}
+
+	void
+	virtual_decommit(Block block)
+	{
+		// mapping a fresh inaccessible range over the old one drops its pages immediately
+		::mmap(block.ptr, block.size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE|MAP_FIXED, -1, 0);
+	}
+
+	bool
+	virtual_advise(Block block, const Virtual_Map_Options& options)
+	{
+		auto page_size = _virtual_page_size();
+		auto begin = size_t(block.ptr) & ~(page_size - 1);
+		auto size = size_t(block.ptr) + block.size - begin;
+
+		int advice = MADV_NORMAL;
+		switch (options.access)
+		{
+		case VIRTUAL_ACCESS_RANDOM: advice = MADV_RANDOM; break;
+		case VIRTUAL_ACCESS_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+		case VIRTUAL_ACCESS_WILL_NEED: advice = MADV_WILLNEED; break;
+		case VIRTUAL_ACCESS_NORMAL:
+		default: advice = MADV_NORMAL; break;
+		}
+		// new mappings already have the normal advice, so it's skipped to save the syscall
+		if (advice != MADV_NORMAL)
+			::madvise((void*)begin, size, advice);
+
+		if (options.lock && ::mlock(block.ptr, block.size) != 0)
+			return false;
+		return true;
+	}
 }
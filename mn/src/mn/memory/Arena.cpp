@@ -1,12 +1,86 @@
 #include "mn/memory/Arena.h"
+#include "mn/Virtual_Memory.h"
 #include "mn/IO.h"
+#include "mn/OS.h"
 #include "mn/Assert.h"
 
 namespace mn::memory
 {
+	// reserved mode commits memory in multiples of this granularity, which is a multiple of the page size on all
+	// supported platforms
+	constexpr static size_t ARENA_COMMIT_GRANULARITY = 64ULL * 1024ULL;
+
+	inline static size_t
+	_arena_align_up(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// commits enough memory in the reserved range to hold the given size after the allocation head
+	// returns false if the reserved range is exhausted
+	inline static bool
+	_arena_reserved_commit(Arena* self, size_t size)
+	{
+		auto base = (uint8_t*)self->reserved.ptr;
+		auto end = base + self->reserved.size;
+		if (size_t(end - self->reserved_alloc_head) < size)
+			return false;
+
+		auto needed = self->reserved_alloc_head + size;
+		if (needed <= self->reserved_commit_head)
+			return true;
+
+		auto new_commit_head = base + _arena_align_up(needed - base, self->block_size);
+		if (new_commit_head > end)
+			new_commit_head = end;
+
+		auto commit_size = size_t(new_commit_head - self->reserved_commit_head);
+		if (virtual_commit(Block{self->reserved_commit_head, commit_size}) == false)
+			mn::panic("arena failed to commit memory");
+
+		self->reserved_commit_head = new_commit_head;
+		self->total_mem += commit_size;
+		return true;
+	}
+
+	// decommits the reserved pages above the given head
+	inline static void
+	_arena_reserved_decommit(Arena* self, uint8_t* keep_head)
+	{
+		if (self->reserved_commit_head <= keep_head)
+			return;
+
+		auto size = size_t(self->reserved_commit_head - keep_head);
+		virtual_decommit(Block{keep_head, size});
+		self->total_mem -= size;
+		self->reserved_commit_head = keep_head;
+		self->release_count++;
+		self->release_mem += size;
+	}
+
+	// frees the nodes on top of the given node to the meta allocator
+	inline static void
+	_arena_free_nodes_until(Arena* self, Arena::Node* node)
+	{
+		if (self->head == node || self->head == nullptr)
+			return;
+
+		while (self->head != node && self->head != nullptr)
+		{
+			Arena::Node* next = self->head->next;
+			self->release_mem += self->head->mem.size;
+			self->meta->free(Block{ self->head, self->head->mem.size + sizeof(Arena::Node) });
+			self->head = next;
+		}
+		self->release_count++;
+	}
+
 	Arena::Arena(size_t block_size, Interface* meta)
+		: Interface("arena")
 	{
 		mn_assert(block_size != 0);
+		// arenas aren't thread safe so only one thread touches the telemetry at a time
+		this->telemetry.single_owner = true;
 		this->meta = meta;
 		this->head = nullptr;
 		this->block_size = block_size;
@@ -16,11 +90,29 @@ namespace mn::memory
 		this->clear_all_readjust_threshold = 4ULL * 1024ULL * 1024ULL;
 		this->clear_all_current_highwater = 0;
 		this->clear_all_previous_highwater = 0;
+		this->reserved = Block{};
+		this->reserved_alloc_head = nullptr;
+		this->reserved_commit_head = nullptr;
+		this->release_count = 0;
+		this->release_mem = 0;
+	}
+
+	Arena::Arena(Reserve reserve, size_t block_size)
+		: Arena(block_size, clib())
+	{
+		// if the os can't reserve the address range (it might be too big for 32-bit address spaces) we fallback
+		// to the chained nodes mode
+		this->block_size = _arena_align_up(block_size, ARENA_COMMIT_GRANULARITY);
+		this->reserved = virtual_reserve(nullptr, _arena_align_up(reserve.size, this->block_size));
+		this->reserved_alloc_head = (uint8_t*)this->reserved.ptr;
+		this->reserved_commit_head = (uint8_t*)this->reserved.ptr;
 	}
 
 	Arena::~Arena()
 	{
 		free_all();
+		if (this->reserved.ptr)
+			virtual_free(this->reserved);
 	}
 
 	Block
@@ -28,9 +120,19 @@ namespace mn::memory
 	{
 		grow(size);
 
-		uint8_t* ptr = this->head->alloc_head;
-		this->head->alloc_head += size;
+		uint8_t* ptr = nullptr;
+		if (this->reserved.ptr)
+		{
+			ptr = this->reserved_alloc_head;
+			this->reserved_alloc_head += size;
+		}
+		else
+		{
+			ptr = this->head->alloc_head;
+			this->head->alloc_head += size;
+		}
 		this->used_mem += size;
+		_telemetry_alloc(this->telemetry, size);
 		this->highwater_mem = this->highwater_mem > this->used_mem ? this->highwater_mem : this->used_mem;
 		this->clear_all_current_highwater = this->clear_all_current_highwater > this->used_mem ? this->clear_all_current_highwater : this->used_mem;
 
@@ -42,9 +144,50 @@ namespace mn::memory
 	{
 	}
 
+	bool
+	Arena::try_grow(Block& block, size_t new_size)
+	{
+		if (block_is_empty(block) || new_size < block.size)
+			return false;
+
+		// only the most recent allocation can grow since it's adjacent to the free part of the arena
+		auto block_end = (uint8_t*)block.ptr + block.size;
+		auto added_size = new_size - block.size;
+		if (this->reserved.ptr)
+		{
+			if (block_end != this->reserved_alloc_head || _arena_reserved_commit(this, added_size) == false)
+				return false;
+			this->reserved_alloc_head += added_size;
+		}
+		else
+		{
+			if (this->head == nullptr || block_end != this->head->alloc_head)
+				return false;
+
+			auto node_end = (uint8_t*)this->head->mem.ptr + this->head->mem.size;
+			if (size_t(node_end - block_end) < added_size)
+				return false;
+			this->head->alloc_head += added_size;
+		}
+		_telemetry_resize(this->telemetry, block.size, new_size);
+		this->used_mem += added_size;
+		this->highwater_mem = this->highwater_mem > this->used_mem ? this->highwater_mem : this->used_mem;
+		this->clear_all_current_highwater = this->clear_all_current_highwater > this->used_mem ? this->clear_all_current_highwater : this->used_mem;
+
+		block.size = new_size;
+		return true;
+	}
+
 	void
 	Arena::grow(size_t size)
 	{
+		if (this->reserved.ptr)
+		{
+			if (_arena_reserved_commit(this, size) == false)
+				mn::panic("arena reserved memory exhausted");
+			return;
+		}
+
 		if (this->head != nullptr)
 		{
 			size_t node_used_mem = this->head->alloc_head - (uint8_t*)this->head->mem.ptr;
@@ -69,20 +212,42 @@ namespace mn::memory
 	void
 	Arena::free_all()
 	{
-		while (this->head)
+		if (this->reserved.ptr)
 		{
-			Node* next = this->head->next;
-			meta->free(Block{ this->head, this->head->mem.size + sizeof(Node) });
-			this->head = next;
+			auto base = (uint8_t*)this->reserved.ptr;
+			_arena_reserved_decommit(this, base);
+			this->reserved_alloc_head = base;
 		}
-		this->head = nullptr;
+
+		_arena_free_nodes_until(this, nullptr);
 		this->total_mem = 0;
 		this->used_mem = 0;
+		_telemetry_live(this->telemetry, this->used_mem);
 	}
 
 	void
 	Arena::clear_all()
 	{
+		if (this->reserved.ptr)
+		{
+			// keep the pages up to the highwater mark committed and only decommit the rest if it's big enough to
+			// be worth the cost of committing it again
+			auto base = (uint8_t*)this->reserved.ptr;
+			auto keep_head = base + _arena_align_up(this->clear_all_current_highwater, this->block_size);
+			if (this->reserved_commit_head > keep_head &&
+				size_t(this->reserved_commit_head - keep_head) >= this->clear_all_readjust_threshold)
+			{
+				_arena_reserved_decommit(this, keep_head);
+			}
+
+			this->reserved_alloc_head = base;
+			this->used_mem = 0;
+			_telemetry_live(this->telemetry, this->used_mem);
+			this->clear_all_previous_highwater = this->clear_all_current_highwater;
+			this->clear_all_current_highwater = 0;
+			return;
+		}
+
 		size_t delta = 0;
 		if (this->clear_all_current_highwater > this->clear_all_previous_highwater)
 			delta = this->clear_all_current_highwater - this->clear_all_previous_highwater;
@@ -102,13 +267,37 @@ namespace mn::memory
 		{
 			this->head->alloc_head = (uint8_t*)this->head->mem.ptr;
 			this->used_mem = 0;
+			_telemetry_live(this->telemetry, this->used_mem);
 			this->clear_all_current_highwater = 0;
 		}
 	}
 
+	void
+	Arena::trim(size_t retain_size)
+	{
+		if (this->reserved.ptr)
+		{
+			auto base = (uint8_t*)this->reserved.ptr;
+			auto keep_size = this->used_mem > retain_size ? this->used_mem : retain_size;
+			auto keep_head = base + _arena_align_up(keep_size, this->block_size);
+			_arena_reserved_decommit(this, keep_head);
+			return;
+		}
+
+		// the nodes are filled in order, so only an empty arena has whole nodes which can be freed
+		if (this->used_mem == 0 && this->total_mem > retain_size)
+		{
+			_arena_free_nodes_until(this, nullptr);
+			this->total_mem = 0;
+		}
+	}
+
 	bool
 	Arena::owns(void* ptr) const
 	{
+		if (this->reserved.ptr)
+			return ptr >= this->reserved.ptr && ptr < (void*)this->reserved_commit_head;
+
 		for (auto it = this->head; it != nullptr; it = it->next)
 		{
 			auto begin_ptr = (char*)it->mem.ptr;
@@ -124,7 +313,10 @@ namespace mn::memory
 	{
 		State s{};
 		s.head = this->head;
-		s.alloc_head = this->head->alloc_head;
+		if (this->reserved.ptr)
+			s.alloc_head = this->reserved_alloc_head;
+		else
+			s.alloc_head = this->head ? this->head->alloc_head : nullptr;
 		s.total_mem = this->total_mem;
 		s.used_mem = this->used_mem;
 		s.highwater_mem = this->highwater_mem;
@@ -134,16 +326,35 @@ namespace mn::memory
 	void
 	Arena::restore(State s)
 	{
-		while (this->head != s.head)
+		// in reserved mode the committed pages stay committed, so we only move the allocation head back
+		// if the arena was freed after the checkpoint was taken we need to commit the pages under the checkpoint again
+		if (this->reserved.ptr)
 		{
-			Node* next = this->head->next;
-			meta->free(Block{ this->head, this->head->mem.size + sizeof(Node) });
-			this->head = next;
+			if (s.alloc_head > this->reserved_commit_head)
+			{
+				this->reserved_alloc_head = (uint8_t*)this->reserved.ptr;
+				_arena_reserved_commit(this, size_t(s.alloc_head - this->reserved_alloc_head));
+			}
+			this->reserved_alloc_head = s.alloc_head;
+			this->used_mem = s.used_mem;
+			_telemetry_live(this->telemetry, this->used_mem);
+			return;
+		}
+
+		_arena_free_nodes_until(this, s.head);
+		// the arena was freed after the checkpoint was taken so the checkpoint nodes no longer exist
+		if (this->head != s.head)
+		{
+			this->total_mem = 0;
+			this->used_mem = 0;
+			_telemetry_live(this->telemetry, this->used_mem);
+			return;
 		}
-		mn_assert(this->head == s.head);
 		this->head = s.head;
-		this->head->alloc_head = s.alloc_head;
+		if (this->head)
+			this->head->alloc_head = s.alloc_head;
 		this->total_mem = s.total_mem;
 		this->used_mem = s.used_mem;
+		_telemetry_live(this->telemetry, this->used_mem);
 	}
 }
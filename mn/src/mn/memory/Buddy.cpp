@@ -1,199 +1,252 @@
 #include "mn/memory/Buddy.h"
+#include "mn/Assert.h"
 
-#include <math.h>
 #include <string.h>
+#include <new>
+#include <thread>
+
+#if MN_COMPILER_MSVC
+#include <intrin.h>
+#endif
 
 namespace mn::memory
 {
-	constexpr size_t BUDDY_HEADER_SIZE = 8;
 	constexpr size_t BUDDY_MIN_ALLOC_LOG2 = 4;
 	constexpr size_t BUDDY_MIN_ALLOC = 16;
+	// the heap base is aligned to the maximum alignment we can be asked for (alignment is an uint8_t)
+	constexpr size_t BUDDY_BASE_ALIGNMENT = 128;
+	// stripes are cache line aligned so that their locks don't share cache lines
+	constexpr size_t BUDDY_STRIPE_ALIGNMENT = 64;
+	constexpr size_t BUDDY_SPIN_COUNT = 64;
 
-	inline static void
-	node_init(Buddy::Node* n)
+	inline static size_t
+	_buddy_find_first_set(uint64_t v)
 	{
-		n->prev = n;
-		n->next = n;
+	#if MN_COMPILER_MSVC
+		unsigned long index = 0;
+		_BitScanForward64(&index, v);
+		return index;
+	#else
+		return (size_t)__builtin_ctzll(v);
+	#endif
 	}
 
-	inline static void
-	node_push(Buddy::Node* list, Buddy::Node* entry)
+	inline static size_t
+	_buddy_find_last_set(uint64_t v)
 	{
-		auto prev = list->prev;
-		entry->prev = prev;
-		entry->next = list;
-		prev->next = entry;
-		list->prev = entry;
+	#if MN_COMPILER_MSVC
+		unsigned long index = 0;
+		_BitScanReverse64(&index, v);
+		return index;
+	#else
+		return 63 - (size_t)__builtin_clzll(v);
+	#endif
 	}
 
-	inline static void
-	node_remove(Buddy::Node* entry)
+	inline static size_t
+	_buddy_ceil_log2(size_t v)
 	{
-		auto prev = entry->prev;
-		auto next = entry->next;
-		prev->next = next;
-		next->prev = prev;
+		return v <= 1 ? 0 : _buddy_find_last_set(v - 1) + 1;
 	}
 
-	inline static Buddy::Node*
-	node_pop(Buddy::Node* list)
+	inline static size_t
+	_buddy_align_up(size_t value, size_t alignment)
 	{
-		auto back = list->prev;
-		if (back == list)
-			return nullptr;
-		node_remove(back);
-		return back;
+		return (value + alignment - 1) & ~(alignment - 1);
 	}
 
 	inline static size_t
-	next_power_of_2(size_t v)
+	_buddy_level_words(size_t level)
 	{
-		--v;
-		v |= v >> 1;
-		v |= v >> 2;
-		v |= v >> 4;
-		v |= v >> 8;
-		v |= v >> 16;
-		if constexpr(sizeof(size_t) == 8)
-		{
-			v |= v >> 32;
-		}
-		++v;
-		return v;
+		return ((size_t(1) << level) + 63) / 64;
 	}
 
 	inline static size_t
-	bucket_for_request(Buddy* self, size_t request)
+	_buddy_level_for_size(Buddy* self, size_t size)
 	{
-		size_t bucket = self->bucket_max - 1;
-		size_t size = BUDDY_MIN_ALLOC;
-		while(size < request) {
-			--bucket;
-			size *= 2;
-		}
-		return bucket;
+		auto size_log2 = _buddy_ceil_log2(size < BUDDY_MIN_ALLOC ? BUDDY_MIN_ALLOC : size);
+		return self->max_alloc_log2 - size_log2;
 	}
 
-	inline static uint8_t*
-	ptr_for_node(Buddy* self, size_t index, size_t bucket)
+	inline static uint64_t*
+	_buddy_word(Buddy* self, Buddy::Stripe* stripe, size_t level, size_t index)
 	{
-		return self->base_ptr + ((index - ((size_t)1 << bucket) + (size_t)1) << (self->max_alloc_log2 - bucket));
+		return stripe->free_bits + self->level_word_offset[level] + index / 64;
 	}
 
-	inline static size_t
-	node_for_ptr(Buddy* self, uint8_t* ptr, size_t bucket)
+	inline static Buddy::Stripe*
+	_buddy_stripe(Buddy* self, size_t index)
 	{
-		return ((ptr - self->base_ptr) >> (self->max_alloc_log2 - bucket)) + ((size_t)1 << bucket) - (size_t)1;
+		return (Buddy::Stripe*)((uint8_t*)self->stripes + index * _buddy_align_up(sizeof(Buddy::Stripe), BUDDY_STRIPE_ALIGNMENT));
 	}
 
 	inline static bool
-	parent_is_split(Buddy* self, size_t index)
+	_buddy_is_free(Buddy* self, Buddy::Stripe* stripe, size_t level, size_t index)
 	{
-		index = (index - 1) / 2;
-		return (bool) ((self->node_is_split[index/8] >> (index % 8)) & 1);
+		return (*_buddy_word(self, stripe, level, index) >> (index % 64)) & 1;
 	}
 
 	inline static void
-	flip_parent_is_split(Buddy* self, size_t index)
+	_buddy_mark_free(Buddy* self, Buddy::Stripe* stripe, size_t level, size_t index)
 	{
-		index = (index - 1) / 2;
-		self->node_is_split[index/8] ^= 1 << (index % 8);
+		*_buddy_word(self, stripe, level, index) |= uint64_t(1) << (index % 64);
+		++stripe->free_count[level];
+		stripe->free_levels_mask |= uint64_t(1) << level;
+		if (index / 64 < stripe->search_hint[level])
+			stripe->search_hint[level] = index / 64;
 	}
 
 	inline static void
-	update_max_ptr(Buddy* self, uint8_t* new_ptr)
+	_buddy_mark_used(Buddy* self, Buddy::Stripe* stripe, size_t level, size_t index)
 	{
-		if (new_ptr > self->max_ptr)
-			self->max_ptr = new_ptr;
+		*_buddy_word(self, stripe, level, index) &= ~(uint64_t(1) << (index % 64));
+		if (--stripe->free_count[level] == 0)
+			stripe->free_levels_mask &= ~(uint64_t(1) << level);
 	}
 
+	// returns whether the given block is part of a bigger free block, which means it's not allocated at this level
 	inline static bool
-	lower_bucket_count(Buddy* self, size_t bucket)
+	_buddy_is_inside_free_block(Buddy* self, Buddy::Stripe* stripe, size_t level, size_t index)
 	{
-		while (bucket < self->bucket_count)
+		while (level > 0)
 		{
-			auto root = node_for_ptr(self, self->base_ptr, self->bucket_count);
-
-			/*
-			* If the parent isn't SPLIT, that means the node at the current bucket
-			* limit is UNUSED and our address space is entirely free. In that case,
-			* clear the root free list, increase the bucket limit, and add a single
-			* block with the newly-expanded address space to the new root free
-			* list.
-			*/
-			if (parent_is_split(self, root) == false)
+			--level;
+			index /= 2;
+			if (_buddy_is_free(self, stripe, level, index))
+				return true;
+		}
+		return false;
+	}
+
+	// finds a free block in a level which has at least one, the words before the search hint are all zeros
+	inline static size_t
+	_buddy_find_free(Buddy* self, Buddy::Stripe* stripe, size_t level)
+	{
+		auto words = stripe->free_bits + self->level_word_offset[level];
+		auto words_count = _buddy_level_words(level);
+		for (size_t i = stripe->search_hint[level]; i < words_count; ++i)
+		{
+			if (words[i] != 0)
 			{
-				node_remove((Buddy::Node*)self->base_ptr);
-				node_init(&self->buckets[--self->bucket_count]);
-				node_push(&self->buckets[self->bucket_count], (Buddy::Node*)self->base_ptr);
-				continue;
+				stripe->search_hint[level] = i;
+				return i * 64 + _buddy_find_first_set(words[i]);
 			}
+		}
+		mn_unreachable();
+		return 0;
+	}
+
+	inline static void
+	_buddy_lock(Buddy* self, Buddy::Stripe* stripe)
+	{
+		if (self->stripes_count == 1)
+			return;
 
-			/*
-			* Otherwise, the tree is currently in use. Create a parent node for the
-			* current root node in the SPLIT state with a right child on the free
-			* list. Make sure to reserve the memory for the free list entry before
-			* writing to it. Note that we do not need to flip the "is split" flag
-			* for our current parent because it's already on (we know because we
-			* just checked it above).
-			*/
-			auto right_child = ptr_for_node(self, root + 1, self->bucket_count);
-			update_max_ptr(self, right_child + sizeof(Buddy::Node));
-			node_push(&self->buckets[self->bucket_count], (Buddy::Node*)right_child);
-			node_init(&self->buckets[--self->bucket_count]);
-
-			/*
-			* Set the grandparent's SPLIT flag so if we need to lower the bucket
-			* limit again, we'll know that the new root node we just added is in
-			* use.
-			*/
-			root = (root - 1) / 2;
-			if (root != 0)
-				flip_parent_is_split(self, root);
+		size_t spins = 0;
+		while (stripe->locked.exchange(true, std::memory_order_acquire))
+		{
+			while (stripe->locked.load(std::memory_order_relaxed))
+			{
+				if (++spins >= BUDDY_SPIN_COUNT)
+				{
+					std::this_thread::yield();
+					spins = 0;
+				}
+			}
 		}
-		return true;
 	}
 
-	Buddy::Buddy(size_t heap_size, Interface* meta_)
+	inline static void
+	_buddy_unlock(Buddy* self, Buddy::Stripe* stripe)
 	{
-		meta = meta_;
+		if (self->stripes_count == 1)
+			return;
+		stripe->locked.store(false, std::memory_order_release);
+	}
 
-		heap_size = next_power_of_2(heap_size);
-		max_alloc = heap_size;
-		max_alloc_log2 = (size_t)log2((double)heap_size);
+	// allocates a block at the given level by splitting the smallest free block at or above the search level, the
+	// search level is above the block level for over aligned allocations, since the left most block of a split
+	// keeps the alignment of the split block
+	inline static Block
+	_buddy_stripe_alloc(Buddy* self, Buddy::Stripe* stripe, size_t level, size_t search_level, size_t size)
+	{
+		// the levels up to the search one have blocks big enough for this request, we pick the smallest of them
+		auto candidates = stripe->free_levels_mask;
+		if (search_level + 1 < 64)
+			candidates &= (uint64_t(1) << (search_level + 1)) - 1;
+		if (candidates == 0)
+			return {};
 
-		bucket_max = max_alloc_log2 - BUDDY_MIN_ALLOC_LOG2 + 1;
-		buckets = nullptr;
+		auto l = _buddy_find_last_set(candidates);
+		auto index = _buddy_find_free(self, stripe, l);
+		_buddy_mark_used(self, stripe, l, index);
 
-		bucket_count = bucket_max - 1;
+		// split the block down to the requested level, we keep the left half and free the right one
+		while (l < level)
+		{
+			++l;
+			index *= 2;
+			_buddy_mark_free(self, stripe, l, index + 1);
+		}
 
-		node_is_split = nullptr;
+		auto block_size = self->max_alloc >> level;
+		stripe->used_mem += block_size;
+		stripe->requested_mem += size;
+		++stripe->allocations_count;
+		_telemetry_alloc(self->telemetry, size);
+		return Block{stripe->base + index * block_size, size};
+	}
 
-		base_ptr = nullptr;
-		max_ptr = nullptr;
+	// thread index used to pick the thread's home stripe
+	static std::atomic<size_t> BUDDY_THREADS_COUNT = 0;
 
-		// increase size for buckets
-		size_t buckets_size = sizeof(Node) * bucket_max;
-		// increase size for node_is_split lookup
-		size_t node_is_split_size = (1 << (bucket_max - 1)) / 8;
-		size_t total_size = heap_size + buckets_size + node_is_split_size;
+	inline static size_t
+	_buddy_thread_index()
+	{
+		thread_local size_t index = BUDDY_THREADS_COUNT.fetch_add(1, std::memory_order_relaxed);
+		return index;
+	}
 
-		memory = meta->alloc(total_size, alignof(int));
+	Buddy::Buddy(size_t heap_size_, Interface* meta_, size_t stripes_count_)
+		: Interface("buddy")
+	{
+		meta = meta_;
 
-		base_ptr = (uint8_t*)memory.ptr;
-		max_ptr = (uint8_t*)memory.ptr;
+		stripes_count = size_t(1) << _buddy_ceil_log2(stripes_count_ == 0 ? 1 : stripes_count_);
+		heap_size = size_t(1) << _buddy_ceil_log2(heap_size_);
+		if (heap_size < BUDDY_MIN_ALLOC * stripes_count)
+			heap_size = BUDDY_MIN_ALLOC * stripes_count;
 
-		buckets = (Node*)((uint8_t*)memory.ptr + heap_size);
-		::memset(buckets, 0, buckets_size);
+		max_alloc = heap_size / stripes_count;
+		max_alloc_log2 = _buddy_ceil_log2(max_alloc);
+		levels_count = max_alloc_log2 - BUDDY_MIN_ALLOC_LOG2 + 1;
+
+		size_t words_count = 0;
+		for (size_t i = 0; i < MAX_LEVELS; ++i)
+		{
+			level_word_offset[i] = words_count;
+			if (i < levels_count)
+				words_count += _buddy_level_words(i);
+		}
 
-		node_is_split = (uint8_t*)memory.ptr + heap_size + buckets_size;
-		::memset(node_is_split, 0, node_is_split_size);
+		auto stripes_offset = _buddy_align_up(heap_size, BUDDY_STRIPE_ALIGNMENT);
+		auto stripes_size = _buddy_align_up(sizeof(Stripe), BUDDY_STRIPE_ALIGNMENT) * stripes_count;
+		auto bits_offset = stripes_offset + stripes_size;
+		auto bits_size = words_count * sizeof(uint64_t) * stripes_count;
 
-		// init the buckets list with the entire allocation
-		node_init(&buckets[bucket_max - 1]);
-		node_push(&buckets[bucket_max - 1], (Buddy::Node*)base_ptr);
+		memory = meta->alloc(bits_offset + bits_size + BUDDY_BASE_ALIGNMENT, alignof(int));
+		auto base = (uint8_t*)_buddy_align_up(size_t(memory.ptr), BUDDY_BASE_ALIGNMENT);
+		::memset(base + bits_offset, 0, bits_size);
 
-		update_max_ptr(this, base_ptr + sizeof(Buddy::Node));
+		stripes = (Stripe*)(base + stripes_offset);
+		for (size_t i = 0; i < stripes_count; ++i)
+		{
+			auto stripe = ::new ((uint8_t*)stripes + i * _buddy_align_up(sizeof(Stripe), BUDDY_STRIPE_ALIGNMENT)) Stripe{};
+			stripe->base = base + i * max_alloc;
+			stripe->free_bits = (uint64_t*)(base + bits_offset) + i * words_count;
+			// the entire stripe starts as a single free block at level 0
+			_buddy_mark_free(this, stripe, 0, 0);
+		}
 	}
 
 	Buddy::~Buddy()
@@ -202,85 +255,34 @@ namespace mn::memory
 	}
 
 	Block
-	Buddy::alloc(size_t request, uint8_t)
+	Buddy::alloc(size_t size, uint8_t alignment)
 	{
-		if (request == 0 || request + BUDDY_HEADER_SIZE > max_alloc)
+		if (size == 0)
 			return {};
 
-		// find the smallest bucket that will fit this request
-		size_t bucket = bucket_for_request(this, request + BUDDY_HEADER_SIZE);
-		size_t original_bucket = bucket;
-
-		// search for a bucket with a non empty free list that's as large or larger
-		// if there isn't an exact match, we'll need to split a larger one
-		while (bucket + 1 != 0)
-		{
-			// We may need to grow the tree to be able to fit an allocation of this
-			// size. Try to grow the tree and stop here if we can't.
-			if (lower_bucket_count(this, bucket) == false)
-				return {};
-
-			// Try to pop a block off the free list for this bucket. If the free
-			// list is empty, we're going to have to split a larger block instead.
-			uint8_t* ptr = (uint8_t*)node_pop(&buckets[bucket]);
-			if (ptr == nullptr)
-			{
-				// If we're not at the root of the tree or it's impossible to grow
-				// the tree any more, continue on to the next bucket.
-				if (bucket != bucket_count || bucket == 0)
-				{
-					--bucket;
-					continue;
-				}
+		if (size > max_alloc || alignment > max_alloc)
+			return {};
 
-				// Otherwise, grow the tree one more level and then pop a block off
-				// the free list again. Since we know the root of the tree is used
-				// (because the free list was empty), this will add a parent above
-				// this node in the SPLIT state and then add the new right child
-				// node to the free list for this bucket. Popping the free list will
-				// give us this right child.
-				if (lower_bucket_count(this, bucket - 1) == false)
-					return {};
-				ptr = (uint8_t*)node_pop(&buckets[bucket]);
-			}
+		// blocks are aligned to their power of two size, so an alignment bigger than the size is satisfied by
+		// splitting a block which is at least as big as the alignment, the block itself keeps the level of its
+		// size so that it's freed with the size it was allocated with
+		auto level = _buddy_level_for_size(this, size);
+		auto search_level = level;
+		if (alignment > size)
+			search_level = _buddy_level_for_size(this, alignment);
 
-			// Try to expand the address space first before going any further. If we
-			// have run out of space, put this block back on the free list and fail.
-			size_t size = (size_t) 1 << (max_alloc_log2 - bucket);
-			size_t bytes_needed = bucket < original_bucket ? size / 2 + sizeof(Buddy::Node) : size;
-			update_max_ptr(this, ptr + bytes_needed);
-
-			// If we got a node off the free list, change the node from UNUSED to
-			// USED. This involves flipping our parent's "is split" bit because that
-			// bit is the exclusive-or of the UNUSED flags of both children, and our
-			// UNUSED flag (which isn't ever stored explicitly) has just changed.
-			//
-			// Note that we shouldn't ever need to flip the "is split" bit of our
-			// grandparent because we know our buddy is USED so it's impossible for
-			// our grandparent to be UNUSED (if our buddy chunk was UNUSED, our
-			// parent wouldn't ever have been split in the first place).
-			size_t i = node_for_ptr(this, ptr, bucket);
-			if (i != 0)
-				flip_parent_is_split(this, i);
-
-			// If the node we got is larger than we need, split it down to the
-			// correct size and put the new unused child nodes on the free list in
-			// the corresponding bucket. This is done by repeatedly moving to the
-			// left child, splitting the parent, and then adding the right child to
-			// the free list.
-			while (bucket < original_bucket)
-			{
-				i = i * 2 + 1;
-				++bucket;
-				flip_parent_is_split(this, i);
-				node_push(&buckets[bucket], (Buddy::Node*)ptr_for_node(this, i + 1, bucket));
-			}
+		if (stripes_count == 1)
+			return _buddy_stripe_alloc(this, stripes, level, search_level, size);
 
-			// Now that we have a memory address, write the block header (just the
-			// size of the allocation) and return the address immediately after the
-			// header.
-			*(size_t*)ptr = request;
-			return Block{ptr + BUDDY_HEADER_SIZE, request};
+		auto home = _buddy_thread_index();
+		for (size_t i = 0; i < stripes_count; ++i)
+		{
+			auto stripe = _buddy_stripe(this, (home + i) & (stripes_count - 1));
+			_buddy_lock(this, stripe);
+			auto res = _buddy_stripe_alloc(this, stripe, level, search_level, size);
+			_buddy_unlock(this, stripe);
+			if (res.ptr)
+				return res;
 		}
 		return {};
 	}
@@ -292,47 +294,88 @@ namespace mn::memory
 		if (block_is_empty(block))
 			return;
 
-		// We were given the address returned by "malloc" so get back to the actual
-		// address of the node by subtracting off the size of the block header. Then
-		// look up the index of the node corresponding to this address.
-		uint8_t* ptr = (uint8_t *) block.ptr - BUDDY_HEADER_SIZE;
-		size_t bucket = bucket_for_request(this, *(size_t *) ptr + BUDDY_HEADER_SIZE);
-		size_t i = node_for_ptr(this, (uint8_t *) ptr, bucket);
+		auto offset = size_t((uint8_t*)block.ptr - stripes->base);
+		auto stripe_index = offset >> max_alloc_log2;
+		mn_assert_msg(stripe_index < stripes_count, "buddy does not own this block");
+		auto stripe = _buddy_stripe(this, stripe_index);
+
+		auto level = _buddy_level_for_size(this, block.size);
+		auto block_size = max_alloc >> level;
+		// a block which isn't aligned to its power of two size was freed with a different size than it was
+		// allocated with, or wasn't allocated by this buddy
+		mn_assert_msg((offset & (block_size - 1)) == 0, "buddy block is freed with the wrong size");
+		auto index = (offset & (max_alloc - 1)) >> (max_alloc_log2 - level);
+
+		_buddy_lock(this, stripe);
+		mn_assert_msg(_buddy_is_free(this, stripe, level, index) == false, "buddy double free");
+		mn_assert_msg(_buddy_is_inside_free_block(this, stripe, level, index) == false, "buddy block is freed with the wrong size");
+
+		stripe->used_mem -= block_size;
+		stripe->requested_mem -= block.size;
+		--stripe->allocations_count;
+		_telemetry_free(telemetry, block.size);
+
+		// merge with the buddy block as long as it's free
+		while (level > 0 && _buddy_is_free(this, stripe, level, index ^ 1))
+		{
+			_buddy_mark_used(this, stripe, level, index ^ 1);
+			index /= 2;
+			--level;
+		}
+		_buddy_mark_free(this, stripe, level, index);
+		_buddy_unlock(this, stripe);
+	}
+
+	bool
+	Buddy::try_grow(Block& block, size_t new_size)
+	{
+		if (block_is_empty(block) || new_size < block.size || new_size > max_alloc)
+			return false;
+
+		// the block can grow in place as long as it stays in the same level
+		if (_buddy_level_for_size(this, new_size) != _buddy_level_for_size(this, block.size))
+			return false;
+
+		auto stripe_index = size_t((uint8_t*)block.ptr - stripes->base) >> max_alloc_log2;
+		auto stripe = _buddy_stripe(this, stripe_index);
+		_buddy_lock(this, stripe);
+		stripe->requested_mem += new_size - block.size;
+		_buddy_unlock(this, stripe);
+		_telemetry_resize(telemetry, block.size, new_size);
+
+		block.size = new_size;
+		return true;
+	}
 
-		// Traverse up to the root node, flipping USED blocks to UNUSED and merging
-		// UNUSED buddies together into a single UNUSED parent.
-		while (i != 0)
+	Buddy::Stats
+	Buddy::stats()
+	{
+		Stats res{};
+		res.heap_size = heap_size;
+
+		for (size_t i = 0; i < stripes_count; ++i)
 		{
-			// Change this node from UNUSED to USED. This involves flipping our
-			// parent's "is split" bit because that bit is the exclusive-or of the
-			// UNUSED flags of both children, and our UNUSED flag (which isn't ever
-			// stored explicitly) has just changed.
-			flip_parent_is_split(this, i);
-
-			// If the parent is now SPLIT, that means our buddy is USED, so don't
-			// merge with it. Instead, stop the iteration here and add ourselves to
-			// the free list for our bucket.
-			//
-			// Also stop here if we're at the current root node, even if that root
-			// node is now UNUSED. Root nodes don't have a buddy so we can't merge
-			// with one.
-			if (parent_is_split(this, i) || bucket == bucket_count)
-				break;
-
-			// If we get here, we know our buddy is UNUSED. In this case we should
-			// merge with that buddy and continue traversing up to the root node. We
-			// need to remove the buddy from its free list here but we don't need to
-			// add the merged parent to its free list yet. That will be done once
-			// after this loop is finished.
-			node_remove((Buddy::Node*)ptr_for_node(this, ((i - 1) ^ 1) + 1, bucket));
-			i = (i - 1) / 2;
-			--bucket;
+			auto stripe = _buddy_stripe(this, i);
+			_buddy_lock(this, stripe);
+			res.used_mem += stripe->used_mem;
+			res.requested_mem += stripe->requested_mem;
+			res.allocations_count += stripe->allocations_count;
+			for (size_t level = 0; level < levels_count; ++level)
+				res.free_blocks_count += stripe->free_count[level];
+			if (stripe->free_levels_mask != 0)
+			{
+				auto largest = max_alloc >> _buddy_find_first_set(stripe->free_levels_mask);
+				if (largest > res.largest_free_block)
+					res.largest_free_block = largest;
+			}
+			_buddy_unlock(this, stripe);
 		}
 
-		// Add ourselves to the free list for our bucket. We add to the back of the
-		// list because "malloc" takes from the back of the list and we want a
-		// "free" followed by a "malloc" of the same size to ideally use the same
-		// address for better memory locality.
-		node_push(&buckets[bucket], (Buddy::Node*)ptr_for_node(this, i, bucket));
+		if (res.used_mem > 0)
+			res.internal_fragmentation = float(res.used_mem - res.requested_mem) / float(res.used_mem);
+		auto free_mem = res.heap_size - res.used_mem;
+		if (free_mem > 0)
+			res.external_fragmentation = 1.0f - float(res.largest_free_block) / float(free_mem);
+		return res;
 	}
 }
@@ -3,6 +3,9 @@
 #include "mn/OS.h"
 
 #include <stdlib.h>
+#if OS_LINUX
+#include <malloc.h>
+#endif
 
 namespace mn::memory
 {
@@ -15,16 +18,58 @@ namespace mn::memory
 			mn::panic("system out of memory");
 		res.size = size;
 		_memory_profile_alloc(res.ptr, res.size);
+		_telemetry_alloc(telemetry, res.size);
 		return res;
 	}
 
 	void
 	CLib::free(Block block)
 	{
+		if (block.ptr != nullptr)
+			_telemetry_free(telemetry, block.size);
 		_memory_profile_free(block.ptr, block.size);
 		::free(block.ptr);
 	}
 
+	bool
+	CLib::try_grow(Block& block, size_t new_size)
+	{
+		if (block_is_empty(block) || new_size < block.size)
+			return false;
+
+	#if OS_LINUX
+		if (::malloc_usable_size(block.ptr) < new_size)
+			return false;
+
+		_memory_profile_free(block.ptr, block.size);
+		_telemetry_resize(telemetry, block.size, new_size);
+		block.size = new_size;
+		_memory_profile_alloc(block.ptr, block.size);
+		return true;
+	#else
+		return false;
+	#endif
+	}
+
+	Block
+	CLib::realloc(Block block, size_t new_size, uint8_t)
+	{
+		if (block.ptr != nullptr)
+		{
+			_memory_profile_free(block.ptr, block.size);
+			_telemetry_free(telemetry, block.size);
+		}
+
+		Block res{};
+		res.ptr = ::realloc(block.ptr, new_size);
+		if (res.ptr == nullptr && new_size > 0)
+			mn::panic("system out of memory");
+		res.size = new_size;
+		_memory_profile_alloc(res.ptr, res.size);
+		_telemetry_alloc(telemetry, res.size);
+		return res;
+	}
+
 	CLib*
 	clib()
 	{
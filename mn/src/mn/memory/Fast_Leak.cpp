@@ -4,10 +4,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#if OS_LINUX
+#include <malloc.h>
+#endif
 
 namespace mn::memory
 {
 	Fast_Leak::Fast_Leak()
+		: Interface("fast leak")
 	{
 		this->atomic_size = 0;
 		this->atomic_count = 0;
@@ -36,6 +40,7 @@ namespace mn::memory
 		_memory_profile_alloc(res.ptr, res.size);
 		if (block_is_empty(res) == false)
 		{
+			_telemetry_alloc(telemetry, size);
 			atomic_count.fetch_add(1);
 			atomic_size.fetch_add(size);
 			return res;
@@ -50,11 +55,58 @@ namespace mn::memory
 		{
 			atomic_count.fetch_sub(1);
 			atomic_size.fetch_sub(block.size);
+			_telemetry_free(telemetry, block.size);
 		}
 		_memory_profile_free(block.ptr, block.size);
 		::free(block.ptr);
 	}
 
+	bool
+	Fast_Leak::try_grow(Block& block, size_t new_size)
+	{
+		if (block_is_empty(block) || new_size < block.size)
+			return false;
+
+	#if OS_LINUX
+		if (::malloc_usable_size(block.ptr) < new_size)
+			return false;
+
+		atomic_size.fetch_add(new_size - block.size);
+		_telemetry_resize(telemetry, block.size, new_size);
+		_memory_profile_free(block.ptr, block.size);
+		block.size = new_size;
+		_memory_profile_alloc(block.ptr, block.size);
+		return true;
+	#else
+		return false;
+	#endif
+	}
+
+	Block
+	Fast_Leak::realloc(Block block, size_t new_size, uint8_t alignment)
+	{
+		if (block_is_empty(block))
+			return alloc(new_size, alignment);
+
+		if (new_size == 0)
+		{
+			free(block);
+			return {};
+		}
+
+		_memory_profile_free(block.ptr, block.size);
+		Block res {::realloc(block.ptr, new_size), new_size};
+		if (res.ptr == nullptr)
+			mn::panic("system out of memory");
+
+		atomic_size.fetch_sub(block.size);
+		atomic_size.fetch_add(new_size);
+		_telemetry_free(telemetry, block.size);
+		_telemetry_alloc(telemetry, new_size);
+		_memory_profile_alloc(res.ptr, res.size);
+		return res;
+	}
+
 	Fast_Leak*
 	fast_leak()
 	{
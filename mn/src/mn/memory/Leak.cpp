@@ -11,6 +11,7 @@
 namespace mn::memory
 {
 	Leak::Leak()
+		: Interface("leak")
 	{
 		this->head = nullptr;
 		this->mtx = _leak_allocator_mutex();
@@ -43,6 +44,7 @@ namespace mn::memory
 		callstack_capture(ptr->callstack, Leak::CALLSTACK_MAX_FRAMES);
 		auto res = Block{ ptr + 1, size };
 		_memory_profile_alloc(res.ptr, res.size);
+		_telemetry_alloc(telemetry, size);
 		return res;
 	}
 
@@ -65,10 +67,50 @@ namespace mn::memory
 			mutex_unlock(this->mtx);
 
 			_memory_profile_free(block.ptr, block.size);
+			_telemetry_free(telemetry, block.size);
 			::free(ptr);
 		}
 	}
 
+	Block
+	Leak::realloc(Block block, size_t new_size, uint8_t alignment)
+	{
+		if (block_is_empty(block))
+			return alloc(new_size, alignment);
+
+		if (new_size == 0)
+		{
+			free(block);
+			return {};
+		}
+
+		_memory_profile_free(block.ptr, block.size);
+
+		// the node might move so we relink it while holding the lock
+		mutex_lock(this->mtx);
+			Node* ptr = (Node*)::realloc(((Node*)block.ptr) - 1, new_size + sizeof(Node));
+			if (ptr == nullptr)
+			{
+				mutex_unlock(this->mtx);
+				mn::panic("system out of memory");
+			}
+
+			ptr->size = new_size;
+			if (ptr->prev)
+				ptr->prev->next = ptr;
+			else
+				this->head = ptr;
+			if (ptr->next)
+				ptr->next->prev = ptr;
+		mutex_unlock(this->mtx);
+
+		auto res = Block{ ptr + 1, new_size };
+		_memory_profile_alloc(res.ptr, res.size);
+		_telemetry_free(telemetry, block.size);
+		_telemetry_alloc(telemetry, new_size);
+		return res;
+	}
+
 	void
 	Leak::report(bool report_on_destruct_)
 	{
@@ -5,8 +5,11 @@
 namespace mn::memory
 {
 	Stack::Stack(size_t stack_size, Interface* meta)
+		: Interface("stack")
 	{
 		mn_assert(stack_size != 0);
+		// stacks aren't thread safe so only one thread touches the telemetry at a time
+		this->telemetry.single_owner = true;
 		this->meta = meta;
 		this->memory = meta->alloc(stack_size, alignof(uint8_t));
 		this->alloc_head = (uint8_t*)this->memory.ptr;
@@ -29,22 +32,46 @@ namespace mn::memory
 		uint8_t* ptr = this->alloc_head;
 		this->alloc_head = ptr + size;
 		this->allocations_count++;
+		_telemetry_alloc(this->telemetry, size);
 		return Block{ ptr, size };
 	}
 
 	void
-	Stack::free(Block)
+	Stack::free(Block block)
 	{
 		mn_assert(this->allocations_count > 0);
+		_telemetry_free(this->telemetry, block.size);
 		--this->allocations_count;
 		if (this->allocations_count == 0)
 			this->alloc_head = (uint8_t*)this->memory.ptr;
 	}
 
+	bool
+	Stack::try_grow(Block& block, size_t new_size)
+	{
+		if (block_is_empty(block) || new_size < block.size)
+			return false;
+
+		auto block_end = (uint8_t*)block.ptr + block.size;
+		if (block_end != this->alloc_head)
+			return false;
+
+		auto memory_end = (uint8_t*)this->memory.ptr + this->memory.size;
+		auto added_size = new_size - block.size;
+		if (size_t(memory_end - block_end) < added_size)
+			return false;
+
+		this->alloc_head += added_size;
+		_telemetry_resize(this->telemetry, block.size, new_size);
+		block.size = new_size;
+		return true;
+	}
+
 	void
 	Stack::free_all()
 	{
 		this->allocations_count = 0;
 		this->alloc_head = (uint8_t*)this->memory.ptr;
+		_telemetry_live(this->telemetry, 0);
 	}
 }
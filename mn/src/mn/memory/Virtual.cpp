@@ -9,16 +9,60 @@ namespace mn::memory
 	{
 		Block res = virtual_alloc(nullptr, size);
 		_memory_profile_alloc(res.ptr, res.size);
+		if (res.ptr)
+			_telemetry_alloc(telemetry, res.size);
 		return res;
 	}
 
 	void
 	Virtual::free(Block block)
 	{
+		if (block.ptr)
+			_telemetry_free(telemetry, block.size);
 		_memory_profile_free(block.ptr, block.size);
 		virtual_free(block);
 	}
 
+	bool
+	Virtual::try_grow(Block& block, size_t new_size)
+	{
+		if (block_is_empty(block) || new_size < block.size)
+			return false;
+
+		auto res = virtual_realloc(block, new_size, false);
+		if (block_is_empty(res))
+			return false;
+
+		_memory_profile_free(block.ptr, block.size);
+		_memory_profile_alloc(res.ptr, res.size);
+		_telemetry_resize(telemetry, block.size, res.size);
+		block = res;
+		return true;
+	}
+
+	Block
+	Virtual::realloc(Block block, size_t new_size, uint8_t)
+	{
+		if (new_size == 0)
+		{
+			free(block);
+			return Block{};
+		}
+
+		auto res = virtual_realloc(block, new_size, true);
+		if (block_is_empty(res))
+			return res;
+
+		if (block_is_empty(block) == false)
+		{
+			_memory_profile_free(block.ptr, block.size);
+			_telemetry_free(telemetry, block.size);
+		}
+		_memory_profile_alloc(res.ptr, res.size);
+		_telemetry_alloc(telemetry, res.size);
+		return res;
+	}
+
 	Virtual*
 	virtual_mem()
 	{
@@ -0,0 +1,70 @@
+#include "mn/Fiber.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace mn
+{
+	static VOID WINAPI
+	_fiber_os_main(LPVOID arg)
+	{
+		auto self = (Fiber_Context*)arg;
+		self->entry(self->arg);
+	}
+
+	// API
+	bool
+	_fiber_context_thread_init(Fiber_Context& self)
+	{
+		// windows can only switch to fibers from a thread which is converted to a fiber itself
+		self = Fiber_Context{};
+		self.handle = ConvertThreadToFiberEx(nullptr, FIBER_FLAG_FLOAT_SWITCH);
+		if (self.handle == nullptr && GetLastError() == ERROR_ALREADY_FIBER)
+		{
+			self.handle = GetCurrentFiber();
+			// the thread was converted by someone else so we shouldn't convert it back
+			self.arg = &self;
+		}
+		return self.handle != nullptr;
+	}
+
+	void
+	_fiber_context_thread_free(Fiber_Context& self)
+	{
+		if (self.handle && self.arg == nullptr)
+			ConvertFiberToThread();
+		self = Fiber_Context{};
+	}
+
+	bool
+	_fiber_context_init(Fiber_Context& self, size_t stack_size, void (*entry)(void*), void* arg)
+	{
+		// windows fibers allocate their own stack with a guard page
+		self = Fiber_Context{};
+		self.entry = entry;
+		self.arg = arg;
+		self.handle = CreateFiberEx(0, stack_size, FIBER_FLAG_FLOAT_SWITCH, _fiber_os_main, &self);
+		return self.handle != nullptr;
+	}
+
+	void
+	_fiber_context_free(Fiber_Context& self)
+	{
+		if (self.handle)
+			DeleteFiber(self.handle);
+		self = Fiber_Context{};
+	}
+
+	void
+	_fiber_context_switch(Fiber_Context&, Fiber_Context& to)
+	{
+		SwitchToFiber(to.handle);
+	}
+
+	bool
+	_poll_wait_start(Poll_Wait*)
+	{
+		// windows doesn't have a poller yet, so fibers block their worker while waiting on sockets
+		return false;
+	}
+}
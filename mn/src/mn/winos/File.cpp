@@ -496,6 +496,117 @@ namespace mn
 		return UnlockFileEx(self->winos_handle, 0, size_low, size_high, &ov);
 	}
 
+	// windows doesn't have positional io which leaves the file cursor alone, ReadFile/WriteFile with an explicit
+	// offset in the OVERLAPPED struct is the closest thing and it's safe to use concurrently on the same handle
+	size_t
+	file_read_at(File self, int64_t offset, Block data)
+	{
+		mn_assert(offset >= 0);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		size_t total = 0;
+		while (total < data.size)
+		{
+			auto at = uint64_t(offset + total);
+			OVERLAPPED ov{};
+			ov.Offset = DWORD(at & 0xFFFFFFFF);
+			ov.OffsetHigh = DWORD(at >> 32);
+
+			auto remaining = data.size - total;
+			DWORD request = remaining > MAXDWORD ? MAXDWORD : DWORD(remaining);
+			DWORD bytes_read = 0;
+			if (ReadFile(self->winos_handle, (char*)data.ptr + total, request, &bytes_read, &ov) == FALSE || bytes_read == 0)
+				break;
+			total += bytes_read;
+		}
+		return total;
+	}
+
+	size_t
+	file_write_at(File self, int64_t offset, Block data)
+	{
+		mn_assert(offset >= 0);
+
+		worker_block_ahead();
+		mn_defer{worker_block_clear();};
+
+		size_t total = 0;
+		while (total < data.size)
+		{
+			auto at = uint64_t(offset + total);
+			OVERLAPPED ov{};
+			ov.Offset = DWORD(at & 0xFFFFFFFF);
+			ov.OffsetHigh = DWORD(at >> 32);
+
+			auto remaining = data.size - total;
+			DWORD request = remaining > MAXDWORD ? MAXDWORD : DWORD(remaining);
+			DWORD bytes_written = 0;
+			if (WriteFile(self->winos_handle, (char*)data.ptr + total, request, &bytes_written, &ov) == FALSE || bytes_written == 0)
+				break;
+			total += bytes_written;
+		}
+		return total;
+	}
+
+	// ReadFileScatter/WriteFileGather require unbuffered page aligned io so we issue a positional call per block
+	size_t
+	file_readv_at(File self, int64_t offset, const Block* blocks, size_t blocks_count)
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < blocks_count; ++i)
+		{
+			auto res = file_read_at(self, offset + total, blocks[i]);
+			total += res;
+			if (res < blocks[i].size)
+				break;
+		}
+		return total;
+	}
+
+	size_t
+	file_writev_at(File self, int64_t offset, const Block* blocks, size_t blocks_count)
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < blocks_count; ++i)
+		{
+			auto res = file_write_at(self, offset + total, blocks[i]);
+			total += res;
+			if (res < blocks[i].size)
+				break;
+		}
+		return total;
+	}
+
+	bool
+	file_preallocate(File self, int64_t offset, int64_t size)
+	{
+		mn_assert(offset >= 0 && size >= 0);
+
+		FILE_ALLOCATION_INFO allocation_info{};
+		allocation_info.AllocationSize.QuadPart = offset + size;
+		if (SetFileInformationByHandle(self->winos_handle, FileAllocationInfo, &allocation_info, sizeof(allocation_info)) == FALSE)
+			return false;
+
+		// the allocation size doesn't change the file size
+		if (file_size(self) < offset + size)
+		{
+			FILE_END_OF_FILE_INFO eof_info{};
+			eof_info.EndOfFile.QuadPart = offset + size;
+			return SetFileInformationByHandle(self->winos_handle, FileEndOfFileInfo, &eof_info, sizeof(eof_info));
+		}
+		return true;
+	}
+
+	bool
+	file_access_hint(File, [[maybe_unused]] int64_t offset, [[maybe_unused]] int64_t size, FILE_ACCESS_HINT)
+	{
+		// windows only accepts access hints at open time (FILE_FLAG_SEQUENTIAL_SCAN, FILE_FLAG_RANDOM_ACCESS)
+		mn_assert(offset >= 0 && size >= 0);
+		return true;
+	}
+
 	struct IMapped_File
 	{
 		Mapped_File file_view;
@@ -505,7 +616,7 @@ namespace mn
 	};
 
 	Mapped_File*
-	file_mmap(File file, int64_t offset, int64_t size, IO_MODE io_mode)
+	file_mmap(File file, int64_t offset, int64_t size, IO_MODE io_mode, const Virtual_Map_Options& options)
 	{
 		DWORD permission = PAGE_READONLY;
 		DWORD access = FILE_MAP_READ;
@@ -553,6 +664,21 @@ namespace mn
 		if (ptr == nullptr)
 			return nullptr;
 
+		if (virtual_advise(Block{ptr, size_t(size)}, options) == false)
+		{
+			UnmapViewOfFile(ptr);
+			return nullptr;
+		}
+
+		// fault the pages in ourselves since there's no populate flag for file mappings
+		if (options.populate)
+		{
+			SYSTEM_INFO info{};
+			GetSystemInfo(&info);
+			for (size_t i = 0; i < size_t(size); i += info.dwPageSize)
+				(void)((volatile char*)ptr)[i];
+		}
+
 		auto self = alloc_zerod<IMapped_File>();
 		self->file_map = file_map;
 		file_map = INVALID_HANDLE_VALUE;
@@ -563,14 +689,14 @@ namespace mn
 	}
 
 	Mapped_File*
-	file_mmap(const Str& filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode)
+	file_mmap(const Str& filename, int64_t offset, int64_t size, IO_MODE io_mode, OPEN_MODE open_mode, SHARE_MODE share_mode, const Virtual_Map_Options& options)
 	{
 		auto file = file_open(filename, io_mode, open_mode, share_mode);
 		if (file == nullptr)
 			return nullptr;
 		mn_defer{if (file) file_close(file);};
 
-		auto res = file_mmap(file, offset, size, io_mode);
+		auto res = file_mmap(file, offset, size, io_mode, options);
 		if (res == nullptr)
 			return nullptr;
 
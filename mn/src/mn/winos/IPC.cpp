@@ -323,4 +323,124 @@ namespace mn::ipc
 		mn_assert(remaining == 0);
 		return res;
 	}
+
+	// windows doesn't have a cross-process futex (WaitOnAddress only works within a single process)
+	// so we poll the word instead
+	bool
+	futex_wait(std::atomic<uint32_t>* word, uint32_t expected, Timeout timeout)
+	{
+		bool changed = false;
+		worker_block_on_with_timeout(timeout, [&]{
+			changed = word->load() != expected;
+			return changed;
+		});
+		return changed || timeout == INFINITE_TIMEOUT;
+	}
+
+	void
+	futex_wake_one(std::atomic<uint32_t>*)
+	{
+		// do nothing, waiters poll the word
+	}
+
+	void
+	futex_wake_all(std::atomic<uint32_t>*)
+	{
+		// do nothing, waiters poll the word
+	}
+
+	inline static Str
+	_shared_memory_name(const Str& name)
+	{
+		return strf("Local\\{}", name);
+	}
+
+	Shared_Memory
+	shared_memory_new(const Str& name, size_t size)
+	{
+		mn_assert(size > 0);
+		auto os_name = _shared_memory_name(name);
+		auto os_str = to_os_encoding(os_name, allocator_top());
+		mn_defer{mn::free(os_str);};
+
+		auto handle = CreateFileMapping(
+			INVALID_HANDLE_VALUE,
+			NULL,
+			PAGE_READWRITE,
+			DWORD(uint64_t(size) >> 32),
+			DWORD(uint64_t(size) & 0xFFFFFFFF),
+			(LPCWSTR)os_str.ptr
+		);
+		if (handle == NULL)
+		{
+			str_free(os_name);
+			return nullptr;
+		}
+
+		// the mapping might be in use by another process, so an existing mapping is an error rather than being reused
+		if (GetLastError() == ERROR_ALREADY_EXISTS)
+		{
+			CloseHandle(handle);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto ptr = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (ptr == NULL)
+		{
+			CloseHandle(handle);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto self = alloc_zerod<IShared_Memory>();
+		self->winos_handle = handle;
+		self->name = os_name;
+		self->data = Block{ptr, size};
+		self->owner = true;
+		return self;
+	}
+
+	Shared_Memory
+	shared_memory_open(const Str& name)
+	{
+		auto os_name = _shared_memory_name(name);
+		auto os_str = to_os_encoding(os_name, allocator_top());
+		mn_defer{mn::free(os_str);};
+
+		auto handle = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, (LPCWSTR)os_str.ptr);
+		if (handle == NULL)
+		{
+			str_free(os_name);
+			return nullptr;
+		}
+
+		auto ptr = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		if (ptr == NULL)
+		{
+			CloseHandle(handle);
+			str_free(os_name);
+			return nullptr;
+		}
+
+		MEMORY_BASIC_INFORMATION info{};
+		VirtualQuery(ptr, &info, sizeof(info));
+
+		auto self = alloc_zerod<IShared_Memory>();
+		self->winos_handle = handle;
+		self->name = os_name;
+		self->data = Block{ptr, info.RegionSize};
+		self->owner = false;
+		return self;
+	}
+
+	void
+	shared_memory_free(Shared_Memory self)
+	{
+		// windows removes the name when the last handle is closed
+		UnmapViewOfFile(self->data.ptr);
+		CloseHandle((HANDLE)self->winos_handle);
+		str_free(self->name);
+		mn::free(self);
+	}
 }
@@ -0,0 +1,44 @@
+#include "mn/Numa.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <thread>
+
+namespace mn
+{
+	Buf<Numa_Node>
+	numa_nodes(Allocator allocator)
+	{
+		auto res = buf_with_allocator<Numa_Node>(allocator);
+
+		// we only report the cpus of the first processor group which is the one thread_affinity_set supports
+		ULONG highest_node = 0;
+		if (GetNumaHighestNodeNumber(&highest_node))
+		{
+			for (ULONG id = 0; id <= highest_node; ++id)
+			{
+				ULONGLONG mask = 0;
+				if (GetNumaNodeProcessorMask((UCHAR)id, &mask) == FALSE || mask == 0)
+					continue;
+
+				Numa_Node node{};
+				node.id = id;
+				for (size_t cpu = 0; cpu < 64; ++cpu)
+					if (mask & (ULONGLONG(1) << cpu))
+						cpu_set_add(node.cpus, cpu);
+				buf_push(res, node);
+			}
+		}
+
+		if (res.count == 0)
+		{
+			Numa_Node node{};
+			for (size_t cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+				cpu_set_add(node.cpus, cpu);
+			buf_push(res, node);
+		}
+
+		return res;
+	}
+}
@@ -2,6 +2,7 @@
 #include "mn/File.h"
 #include "mn/OS.h"
 #include "mn/Assert.h"
+#include "mn/Fabric.h"
 
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
@@ -482,6 +483,83 @@ namespace mn
 		return i == files.count;
 	}
 
+	// walks the src folder tree once, creates the folders in dst and calls on_file(src, dst) for each file
+	template<typename TFunc>
+	static bool
+	_folder_copy_walk(const Str& src, const Str& dst, TFunc& on_file)
+	{
+		auto files = path_entries(src);
+		mn_defer{destruct(files);};
+
+		//create the folder no matter what
+		if (folder_make(dst) == false)
+			return false;
+
+		auto tmp_src = str_new();
+		mn_defer{str_free(tmp_src);};
+
+		auto tmp_dst = str_new();
+		mn_defer{str_free(tmp_dst);};
+
+		for (const auto& entry: files)
+		{
+			if (entry.name == "." || entry.name == "..")
+				continue;
+
+			str_clear(tmp_src);
+			str_clear(tmp_dst);
+			tmp_src = path_join(tmp_src, src, entry.name);
+			tmp_dst = path_join(tmp_dst, dst, entry.name);
+
+			bool ok = false;
+			if (entry.kind == Path_Entry::KIND_FILE)
+				ok = on_file(tmp_src, tmp_dst);
+			else if (entry.kind == Path_Entry::KIND_FOLDER)
+				ok = _folder_copy_walk(tmp_src, tmp_dst, on_file);
+
+			if (ok == false)
+				return false;
+		}
+		return true;
+	}
+
+	bool
+	folder_copy(const char* src, const char* dst, Fabric fabric, size_t max_in_flight)
+	{
+		if (max_in_flight == 0)
+			max_in_flight = 2 * fabric_workers_count(fabric);
+
+		// the channel is used as a counting semaphore, each in flight copy holds one slot
+		auto in_flight = chan_new<bool>(int32_t(max_in_flight));
+		mn_defer{chan_free(in_flight);};
+
+		auto wg = waitgroup_new();
+		mn_defer{waitgroup_free(wg);};
+
+		std::atomic<bool> failed = false;
+
+		auto on_file = [&](const Str& file_src, const Str& file_dst) {
+			if (failed.load(std::memory_order_relaxed))
+				return false;
+
+			chan_send(in_flight, true);
+			waitgroup_add(wg, 1);
+			go(fabric, [in_flight, wg, &failed, file_src = clone(file_src), file_dst = clone(file_dst)]() mutable {
+				if (file_copy(file_src, file_dst) == false)
+					failed = true;
+				str_free(file_src);
+				str_free(file_dst);
+				chan_recv_try(in_flight);
+				waitgroup_done(wg);
+			});
+			return true;
+		};
+		bool walked = _folder_copy_walk(str_lit(src), str_lit(dst), on_file);
+
+		waitgroup_wait(wg);
+		return walked && failed == false;
+	}
+
 	Str
 	folder_tmp(Allocator allocator)
 	{
@@ -445,6 +445,12 @@ namespace mn
 		return self->srcloc;
 	}
 
+	const char*
+	mutex_name(Mutex self)
+	{
+		return self->name;
+	}
+
 
 	//Mutex_RW API
 	struct IMutex_RW
@@ -477,6 +483,13 @@ namespace mn
 		return self;
 	}
 
+	Mutex_RW
+	mutex_rw_reader_biased_new(const char* name)
+	{
+		// the per cpu reader counts are only implemented on linux
+		return mutex_rw_new(name);
+	}
+
 	void
 	mutex_rw_free(Mutex_RW self)
 	{
@@ -550,6 +563,12 @@ namespace mn
 		return self->srcloc;
 	}
 
+	const char*
+	mutex_rw_name(Mutex_RW self)
+	{
+		return self->name;
+	}
+
 
 	//Thread API
 	struct IThread
@@ -659,6 +678,19 @@ namespace mn
 		return (void*)(uintptr_t)GetCurrentThreadId();
 	}
 
+	bool
+	thread_affinity_set(const Cpu_Set& cpus)
+	{
+		// we only support the first processor group which contains the first 64 cpus
+		DWORD_PTR mask = 0;
+		for (size_t cpu = 0; cpu < sizeof(mask) * 8; ++cpu)
+			if (cpu_set_has(cpus, cpu))
+				mask |= DWORD_PTR(1) << cpu;
+		if (mask == 0)
+			return false;
+		return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+	}
+
 
 	// time
 	uint64_t
@@ -741,6 +773,8 @@ namespace mn
 		int count;
 		CRITICAL_SECTION cs;
 		CONDITION_VARIABLE cv;
+		// asynchronous waiters notified when the count reaches 0
+		Async_Waiter* async_waiters;
 	};
 
 	Waitgroup
@@ -748,6 +782,7 @@ namespace mn
 	{
 		auto self = alloc<IWaitgroup>();
 		self->count = 0;
+		self->async_waiters = nullptr;
 		InitializeCriticalSectionAndSpinCount(&self->cs, 1<<14);
 		InitializeConditionVariable(&self->cv);
 		return self;
@@ -775,6 +810,20 @@ namespace mn
 		mn_assert(self->count == 0);
 	}
 
+	bool
+	waitgroup_wait_async(Waitgroup self, Async_Waiter* waiter)
+	{
+		EnterCriticalSection(&self->cs);
+		mn_defer{LeaveCriticalSection(&self->cs);};
+
+		if (self->count == 0)
+			return false;
+
+		waiter->next = self->async_waiters;
+		self->async_waiters = waiter;
+		return true;
+	}
+
 	void
 	waitgroup_add(Waitgroup self, int c)
 	{
@@ -789,14 +838,30 @@ namespace mn
 	void
 	waitgroup_done(Waitgroup self)
 	{
-		EnterCriticalSection(&self->cs);
-		mn_defer{LeaveCriticalSection(&self->cs);};
+		// the async waiters are taken off the list under the lock, because the waitgroup might be freed once it's
+		// unlocked, and they're notified after it's unlocked
+		Async_Waiter* async_waiters = nullptr;
+		{
+			EnterCriticalSection(&self->cs);
+			mn_defer{LeaveCriticalSection(&self->cs);};
 
-		--self->count;
-		mn_assert(self->count >= 0);
+			--self->count;
+			mn_assert(self->count >= 0);
 
-		if (self->count == 0)
-			WakeAllConditionVariable(&self->cv);
+			if (self->count == 0)
+			{
+				WakeAllConditionVariable(&self->cv);
+				async_waiters = self->async_waiters;
+				self->async_waiters = nullptr;
+			}
+		}
+
+		while (async_waiters)
+		{
+			auto waiter = async_waiters;
+			async_waiters = async_waiters->next;
+			waiter->notify(waiter);
+		}
 	}
 
 	int
@@ -8,13 +8,41 @@
 
 namespace mn
 {
+	// API
 	Block
-	virtual_alloc(void* address_hint, size_t size)
+	virtual_alloc(void* address_hint, size_t size, const Virtual_Map_Options& options)
 	{
+		DWORD allocation_type = MEM_RESERVE|MEM_COMMIT;
+		if (options.huge_pages)
+		{
+			// large pages require the SeLockMemoryPrivilege and a size multiple of the large page size
+			auto large_page_size = GetLargePageMinimum();
+			if (large_page_size == 0)
+				return Block{};
+			size = (size + large_page_size - 1) & ~(large_page_size - 1);
+			allocation_type |= MEM_LARGE_PAGES;
+		}
+
 		Block result{};
-		result.ptr = VirtualAlloc(address_hint, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
-		if(result.ptr)
-			result.size = size;
+		result.ptr = VirtualAlloc(address_hint, size, allocation_type, PAGE_READWRITE);
+		if(result.ptr == nullptr)
+			return Block{};
+		result.size = size;
+
+		if (virtual_advise(result, options) == false)
+		{
+			virtual_free(result);
+			return Block{};
+		}
+
+		// large pages are always resident, otherwise committed pages are still faulted in on first access
+		if (options.populate && options.huge_pages == false)
+		{
+			SYSTEM_INFO info{};
+			GetSystemInfo(&info);
+			for (size_t i = 0; i < size; i += info.dwPageSize)
+				((volatile char*)result.ptr)[i] = 0;
+		}
 		return result;
 	}
 
@@ -24,4 +52,64 @@ namespace mn
 		[[maybe_unused]] auto result = VirtualFree(block.ptr, 0, MEM_RELEASE);
 		mn_assert(result != NULL);
 	}
+
+	Block
+	virtual_realloc(Block block, size_t new_size, bool can_move)
+	{
+		if (block_is_empty(block))
+			return can_move ? virtual_alloc(nullptr, new_size) : Block{};
+
+		// the block can grow in place within its committed region, windows can't extend the region itself
+		// since the whole region should be released at once
+		MEMORY_BASIC_INFORMATION info{};
+		if (VirtualQuery(block.ptr, &info, sizeof(info)) != 0)
+		{
+			auto committed_end = (char*)info.BaseAddress + info.RegionSize;
+			if ((char*)block.ptr + new_size <= committed_end)
+				return Block{block.ptr, new_size};
+		}
+
+		if (can_move == false)
+			return Block{};
+
+		auto res = virtual_alloc(nullptr, new_size);
+		if (block_is_empty(res))
+			return Block{};
+		::memcpy(res.ptr, block.ptr, block.size < new_size ? block.size : new_size);
+		virtual_free(block);
+		return res;
+	}
+
+	Block
+	virtual_reserve(void* address_hint, size_t size)
+	{
+		Block result{};
+		result.ptr = VirtualAlloc(address_hint, size, MEM_RESERVE, PAGE_NOACCESS);
+		if (result.ptr == nullptr)
+			return Block{};
+		result.size = size;
+		return result;
+	}
+
+	bool
+	virtual_commit(Block block)
+	{
+		return VirtualAlloc(block.ptr, block.size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+	}
+
+	void
+	virtual_decommit(Block block)
+	{
+		[[maybe_unused]] auto result = VirtualFree(block.ptr, block.size, MEM_DECOMMIT);
+		mn_assert(result != FALSE);
+	}
+
+	bool
+	virtual_advise(Block block, const Virtual_Map_Options& options)
+	{
+		// windows doesn't have transparent huge pages or access pattern hints for mapped memory
+		if (options.lock && VirtualLock(block.ptr, block.size) == FALSE)
+			return false;
+		return true;
+	}
 }
@@ -0,0 +1,183 @@
+#include <doctest/doctest.h>
+#include <mn/Coroutine.h>
+#include <mn/Defer.h>
+#include <nanobench.h>
+
+static mn::Fabric_Coroutine<int>
+coroutine_square(int x)
+{
+	co_return x * x;
+}
+
+static mn::Fabric_Coroutine<int>
+coroutine_sum_squares(int count)
+{
+	int sum = 0;
+	for (int i = 1; i <= count; ++i)
+		sum += co_await coroutine_square(i);
+	co_return sum;
+}
+
+static mn::Fabric_Coroutine<void>
+coroutine_ping(mn::Chan<int> ping, mn::Chan<int> pong, int rounds, int* last)
+{
+	for (int i = 0; i < rounds; ++i)
+	{
+		co_await mn::co_chan_send(ping, i);
+		auto [value, more] = co_await mn::co_chan_recv(pong);
+		if (more == false)
+			co_return;
+		*last = value;
+	}
+	mn::chan_close(ping);
+}
+
+static mn::Fabric_Coroutine<void>
+coroutine_pong(mn::Chan<int> ping, mn::Chan<int> pong)
+{
+	while (true)
+	{
+		auto [value, more] = co_await mn::co_chan_recv(ping);
+		if (more == false)
+			break;
+		co_await mn::co_chan_send(pong, value + 1);
+	}
+}
+
+static mn::Fabric_Coroutine<int>
+coroutine_wait(mn::Waitgroup wg, mn::Future<int> future)
+{
+	co_await mn::co_waitgroup_wait(wg);
+	co_return co_await future;
+}
+
+static mn::Fabric_Coroutine<size_t>
+coroutine_read(mn::Socket server)
+{
+	auto client = mn::socket_accept(server, {1000});
+	if (client == nullptr)
+		co_return 0;
+	mn_defer{mn::socket_close(client);};
+
+	// read until the client closes the connection so that it's the one which waits for the connection to time out
+	size_t res = 0;
+	while (co_await mn::co_socket_ready(client, {1000}))
+	{
+		char buffer[16] = {};
+		auto [size, err] = mn::socket_read(client, mn::block_from(buffer), mn::NO_TIMEOUT);
+		if (err != mn::MN_SOCKET_ERROR_OK || size == 0)
+			break;
+		res += size;
+	}
+	co_return res;
+}
+
+TEST_CASE("fabric coroutines")
+{
+	// a single worker would deadlock if the coroutines blocked it instead of suspending
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	auto sum = mn::coroutine_go(fabric, coroutine_sum_squares(10));
+	mn_defer{mn::future_free(sum);};
+	mn::future_wait(sum);
+	CHECK(*sum == 385);
+
+	constexpr int ROUNDS = 1000;
+	auto ping = mn::chan_new<int>();
+	mn_defer{mn::chan_free(ping);};
+	auto pong = mn::chan_new<int>();
+	mn_defer{mn::chan_free(pong);};
+	int last = 0;
+	auto pinger = mn::coroutine_go(fabric, coroutine_ping(ping, pong, ROUNDS, &last));
+	mn_defer{mn::future_free(pinger);};
+	auto ponger = mn::coroutine_go(fabric, coroutine_pong(ping, pong));
+	mn_defer{mn::future_free(ponger);};
+	mn::future_wait(pinger);
+	mn::future_wait(ponger);
+	CHECK(last == ROUNDS);
+
+	// the coroutine waits for the waitgroup which is signaled from another thread, then for the future
+	auto wg = mn::waitgroup_new();
+	mn_defer{mn::waitgroup_free(wg);};
+	mn::waitgroup_add(wg, 1);
+	auto answer = mn::future_go(fabric, []{ return 42; });
+	mn_defer{mn::future_free(answer);};
+	auto waiter = mn::coroutine_go(fabric, coroutine_wait(wg, answer));
+	mn_defer{mn::future_free(waiter);};
+	mn::thread_sleep(10);
+	CHECK(mn::future_is_done(waiter) == false);
+	mn::waitgroup_done(wg);
+	mn::future_wait(waiter);
+	CHECK(*waiter == 42);
+
+	// the coroutine is suspended until the socket is readable
+	auto server = mn::socket_open(mn::SOCKET_FAMILY_IPV4, mn::SOCKET_TYPE_TCP);
+	mn_defer{mn::socket_close(server);};
+	CHECK(mn::socket_bind(server, "4752"));
+	CHECK(mn::socket_listen(server));
+	auto reader = mn::coroutine_go(fabric, coroutine_read(server));
+	mn_defer{mn::future_free(reader);};
+	auto client = mn::socket_open(mn::SOCKET_FAMILY_IPV4, mn::SOCKET_TYPE_TCP);
+	CHECK(mn::socket_connect(client, "localhost", "4752"));
+	mn::thread_sleep(10);
+	mn::socket_write(client, mn::block_lit("hello"));
+	mn::socket_close(client);
+	mn::future_wait(reader);
+	CHECK(*reader == 5);
+}
+
+TEST_CASE("coroutine ping pong benchmark")
+{
+	constexpr int ROUNDS = 10000;
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	ankerl::nanobench::Bench bench;
+	bench.title("channel ping pong").relative(true).minEpochIterations(5);
+
+	bench.run("blocking tasks", [&]{
+		auto ping = mn::chan_new<int>();
+		mn_defer{mn::chan_free(ping);};
+		auto pong = mn::chan_new<int>();
+		mn_defer{mn::chan_free(pong);};
+
+		mn::Auto_Waitgroup wg;
+		wg.add(2);
+		int last = 0;
+		mn::go(fabric, [&]{
+			for (int i = 0; i < ROUNDS; ++i)
+			{
+				mn::chan_send(ping, i);
+				last = mn::chan_recv(pong).res;
+			}
+			mn::chan_close(ping);
+			wg.done();
+		});
+		mn::go(fabric, [&]{
+			for (auto value: ping)
+				mn::chan_send(pong, value + 1);
+			wg.done();
+		});
+		wg.wait();
+		CHECK(last == ROUNDS);
+	});
+
+	bench.run("coroutines", [&]{
+		auto ping = mn::chan_new<int>();
+		mn_defer{mn::chan_free(ping);};
+		auto pong = mn::chan_new<int>();
+		mn_defer{mn::chan_free(pong);};
+
+		int last = 0;
+		auto pinger = mn::coroutine_go(fabric, coroutine_ping(ping, pong, ROUNDS, &last));
+		auto ponger = mn::coroutine_go(fabric, coroutine_pong(ping, pong));
+		mn::future_free(pinger);
+		mn::future_free(ponger);
+		CHECK(last == ROUNDS);
+	});
+}
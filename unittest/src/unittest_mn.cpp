@@ -26,10 +26,23 @@
 #include <mn/Json.h>
 #include <mn/Regex.h>
 #include <mn/Log.h>
-
+#include <mn/IPC.h>
+#include <mn/Memory_Telemetry.h>
+#include <mn/Numa.h>
+#include <mn/Socket.h>
+#include <mn/Epoch.h>
+#include <mn/Concurrent_Map.h>
+#include <mn/Task_Graph.h>
+#include <mn/Tracer.h>
+
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <thread>
+
+#include <string.h>
 
 #define ANKERL_NANOBENCH_IMPLEMENT 1
 #include <nanobench.h>
@@ -73,6 +86,167 @@ TEST_CASE("arena allocator")
 	mn::allocator_free(arena);
 }
 
+TEST_CASE("reserved arena allocator")
+{
+	mn::memory::Arena arena{mn::memory::Arena::Reserve{1ULL * 1024ULL * 1024ULL * 1024ULL}};
+	CHECK(arena.reserved.ptr != nullptr);
+	arena.clear_all_readjust_threshold = 1ULL * 1024ULL * 1024ULL;
+
+	auto a = arena.alloc(100, alignof(char));
+	CHECK(arena.owns(a.ptr));
+	CHECK(arena.total_mem == arena.block_size);
+
+	int stack_value = 0;
+	CHECK(arena.owns(&stack_value) == false);
+
+	auto checkpoint = arena.checkpoint();
+	auto big = arena.alloc(16ULL * 1024ULL * 1024ULL, alignof(char));
+	::memset(big.ptr, 1, big.size);
+	CHECK(arena.try_grow(big, 32ULL * 1024ULL * 1024ULL));
+	CHECK(arena.used_mem == 100 + 32ULL * 1024ULL * 1024ULL);
+	arena.restore(checkpoint);
+	CHECK(arena.used_mem == 100);
+	CHECK(arena.alloc(8, alignof(char)).ptr == big.ptr);
+
+	// the first clear keeps the pages up to the highwater mark, and the next one decommits them since they're unused
+	arena.clear_all();
+	CHECK(arena.total_mem >= 32ULL * 1024ULL * 1024ULL);
+	arena.alloc(100, alignof(char));
+	arena.clear_all();
+	CHECK(arena.total_mem == arena.block_size);
+	CHECK(arena.used_mem == 0);
+}
+
+TEST_CASE("allocator telemetry")
+{
+	mn::memory::Stack stack{4096};
+	mn::allocator_name_set(&stack, "test stack");
+
+	auto a = stack.alloc(8, alignof(char));
+	auto b = stack.alloc(100, alignof(char));
+	CHECK(stack.try_grow(b, 1000));
+	stack.free(b);
+
+	auto telemetry = mn::memory_telemetry_of(&stack);
+	CHECK(telemetry.allocations_count == 2);
+	CHECK(telemetry.frees_count == 1);
+	CHECK(telemetry.allocated_bytes == 1008);
+	CHECK(telemetry.live_bytes == 8);
+	CHECK(telemetry.highwater_bytes == 1008);
+	CHECK(telemetry.size_classes[0] == 1);
+	CHECK(telemetry.size_classes[3] == 1);
+	CHECK(mn::memory_telemetry_size_class_max(3) == 128);
+	stack.free(a);
+
+	// thread owned allocators skip the atomic read-modify-write counters, shared ones keep them
+	CHECK(stack.telemetry.single_owner);
+	CHECK(mn::memory::tmp()->telemetry.single_owner);
+	CHECK(mn::memory::clib()->telemetry.single_owner == false);
+
+	// the snapshot includes every thread's tmp arena
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto fabric = mn::fabric_new(settings);
+	mn::compute(fabric, {2, 1, 1}, {1, 1, 1}, [](mn::Compute_Args) { mn::memory::tmp()->alloc(64, alignof(char)); });
+	mn::memory::tmp()->alloc(32, alignof(char));
+
+	auto snapshot = mn::memory_telemetry_snapshot(mn::memory::clib());
+	mn_defer{mn::buf_free(snapshot);};
+	mn::fabric_free(fabric);
+
+	bool found_stack = false;
+	size_t tmp_count = 0;
+	for (const auto& entry: snapshot)
+	{
+		if (entry.allocator == &stack)
+		{
+			found_stack = true;
+			CHECK(::strcmp(entry.name, "test stack") == 0);
+			CHECK(entry.live_bytes == 0);
+		}
+		if (::strcmp(entry.name, "tmp") == 0)
+			++tmp_count;
+	}
+	CHECK(found_stack);
+	CHECK(tmp_count >= 2);
+	mn::memory::tmp()->clear_all();
+}
+
+TEST_CASE("allocator realloc")
+{
+	SUBCASE("arena grows the last allocation in place")
+	{
+		mn::memory::Arena arena{4096};
+		auto a = arena.alloc(64, alignof(char));
+		::memset(a.ptr, 'a', a.size);
+		CHECK(arena.try_grow(a, 128));
+		CHECK(a.size == 128);
+		CHECK(arena.used_mem == 128);
+
+		auto b = arena.alloc(16, alignof(char));
+		CHECK(arena.try_grow(a, 256) == false);
+		CHECK(arena.try_grow(b, 8192) == false);
+
+		auto c = arena.realloc(a, 256, alignof(char));
+		CHECK(c.ptr != a.ptr);
+		CHECK(((char*)c.ptr)[63] == 'a');
+	}
+
+	SUBCASE("stack grows the top allocation in place")
+	{
+		mn::memory::Stack stack{1024};
+		auto a = stack.alloc(64, alignof(char));
+		CHECK(stack.try_grow(a, 512));
+		auto b = stack.alloc(64, alignof(char));
+		CHECK(stack.try_grow(a, 600) == false);
+		CHECK(stack.try_grow(b, 1024) == false);
+		stack.free(b);
+		stack.free(a);
+	}
+
+	SUBCASE("buddy grows within its node")
+	{
+		mn::memory::Buddy buddy{1024 * 1024};
+		auto a = buddy.alloc(100, alignof(char));
+		CHECK(buddy.try_grow(a, 110));
+		CHECK(buddy.try_grow(a, 4096) == false);
+		auto b = buddy.realloc(a, 4096, alignof(char));
+		CHECK(b.size == 4096);
+		buddy.free(b);
+	}
+
+	SUBCASE("virtual and clib keep the content")
+	{
+		mn::Allocator allocators[] = {mn::memory::clib(), mn::memory::virtual_mem()};
+		for (auto allocator: allocators)
+		{
+			auto a = mn::alloc_from(allocator, 4096, alignof(int));
+			for (size_t i = 0; i < 1024; ++i)
+				((int*)a.ptr)[i] = int(i);
+			auto b = mn::realloc_from(allocator, a, 16 * 1024 * 1024, alignof(int));
+			CHECK(b.size == 16 * 1024 * 1024);
+			for (size_t i = 0; i < 1024; ++i)
+				CHECK(((int*)b.ptr)[i] == int(i));
+			mn::free_from(allocator, b);
+		}
+	}
+
+	SUBCASE("wrapped ring keeps its order")
+	{
+		auto r = mn::ring_new<int>();
+		for (int i = 0; i < 8; ++i)
+			mn::ring_push_back(r, i);
+		for (int i = 0; i < 5; ++i)
+			mn::ring_pop_front(r);
+		for (int i = 8; i < 100; ++i)
+			mn::ring_push_back(r, i);
+		CHECK(r.count == 95);
+		for (size_t i = 0; i < r.count; ++i)
+			CHECK(r[i] == int(i + 5));
+		mn::ring_free(r);
+	}
+}
+
 TEST_CASE("tmp allocator")
 {
 	{
@@ -102,6 +276,45 @@ TEST_CASE("buf push")
 	mn::buf_free(arr);
 }
 
+TEST_CASE("buf push benchmark")
+{
+	// forwards to clib without overriding realloc, so buf growth falls back to alloc, copy, and free
+	struct Copy_Allocator: mn::memory::Interface
+	{
+		mn::Block alloc(size_t size, uint8_t alignment) override { return mn::memory::clib()->alloc(size, alignment); }
+		void free(mn::Block block) override { mn::memory::clib()->free(block); }
+	};
+	Copy_Allocator copy_allocator;
+	mn::memory::Arena arena{64ULL * 1024ULL * 1024ULL, mn::memory::virtual_mem()};
+
+	struct Variant
+	{
+		const char* name;
+		mn::Allocator allocator;
+	};
+	Variant variants[] = {
+		{"alloc + copy", &copy_allocator},
+		{"clib realloc", mn::memory::clib()},
+		{"virtual mremap", mn::memory::virtual_mem()},
+		{"arena in place", &arena},
+	};
+
+	constexpr size_t COUNT = 4ULL * 1024ULL * 1024ULL;
+	ankerl::nanobench::Bench bench;
+	bench.title("buf_push 4M elements").relative(true).minEpochIterations(10);
+	for (const auto& variant: variants)
+	{
+		bench.run(variant.name, [&]{
+			auto arr = mn::buf_with_allocator<uint64_t>(variant.allocator);
+			for (size_t i = 0; i < COUNT; ++i)
+				mn::buf_push(arr, i);
+			ankerl::nanobench::doNotOptimizeAway(arr[COUNT - 1]);
+			mn::buf_free(arr);
+			arena.clear_all();
+		});
+	}
+}
+
 TEST_CASE("buf insert and remove ordered")
 {
 	auto v = mn::buf_lit({1, 2, 3, 5});
@@ -472,6 +685,135 @@ TEST_CASE("virtual memory allocation")
 	mn::virtual_free(block);
 }
 
+#if OS_LINUX || OS_MACOS
+#include <sys/resource.h>
+
+inline static size_t
+minor_faults()
+{
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return size_t(usage.ru_minflt);
+}
+#else
+inline static size_t
+minor_faults()
+{
+	return 0;
+}
+#endif
+
+TEST_CASE("virtual memory options")
+{
+	constexpr size_t PAGE = 4096;
+	size_t size = 64ULL * 1024ULL * 1024ULL;
+
+	mn::Virtual_Map_Options options{};
+	options.populate = true;
+	options.transparent_huge_pages = true;
+	options.access = mn::VIRTUAL_ACCESS_RANDOM;
+	auto block = mn::virtual_alloc(nullptr, size, options);
+	CHECK(block.ptr != nullptr);
+	CHECK(block.size == size);
+	for (size_t i = 0; i < block.size; i += PAGE)
+		((volatile char*)block.ptr)[i] = char(i);
+	size_t touched_mismatches = 0;
+	for (size_t i = 0; i < block.size; i += PAGE)
+		if (((volatile char*)block.ptr)[i] != char(i))
+			++touched_mismatches;
+	CHECK(touched_mismatches == 0);
+
+	// the hints can be changed on a live mapping, and a normal hint is a no-op
+	options = mn::Virtual_Map_Options{};
+	options.access = mn::VIRTUAL_ACCESS_SEQUENTIAL;
+	CHECK(mn::virtual_advise(block, options));
+	CHECK(mn::virtual_advise(block, mn::Virtual_Map_Options{}));
+	mn::virtual_free(block);
+
+	auto path = mn::file_tmp("", "bin");
+	mn_defer{
+		mn::file_remove(path);
+		mn::str_free(path);
+	};
+	auto f = mn::file_open(path, mn::IO_MODE_WRITE, mn::OPEN_MODE_CREATE_OVERWRITE);
+	CHECK(mn::file_preallocate(f, 0, 1024 * PAGE));
+	for (size_t i = 0; i < 1024; ++i)
+		mn::file_write_at(f, i * PAGE, mn::block_from(i));
+	mn::file_close(f);
+
+	options = mn::Virtual_Map_Options{};
+	options.populate = true;
+	options.access = mn::VIRTUAL_ACCESS_WILL_NEED;
+	auto mapped = mn::file_mmap(path, 0, 0, mn::IO_MODE_READ, mn::OPEN_MODE_OPEN_ONLY, mn::SHARE_MODE_ALL, options);
+	CHECK(mapped != nullptr);
+	CHECK(mapped->data.size == 1024 * PAGE);
+	size_t mismatches = 0;
+	for (size_t i = 0; i < 1024; ++i)
+		if (*(size_t*)((char*)mapped->data.ptr + i * PAGE) != i)
+			++mismatches;
+	CHECK(mismatches == 0);
+	mn::file_unmap(mapped);
+}
+
+TEST_CASE("virtual memory options benchmark")
+{
+	constexpr size_t PAGE = 4096;
+	size_t size = 256ULL * 1024ULL * 1024ULL;
+
+	struct Variant
+	{
+		const char* name;
+		mn::Virtual_Map_Options options;
+	};
+
+	Variant variants[6]{};
+	variants[0].name = "default";
+	variants[1].name = "populate";
+	variants[1].options.populate = true;
+	variants[2].name = "transparent huge pages";
+	variants[2].options.transparent_huge_pages = true;
+	variants[3].name = "transparent huge pages + populate";
+	variants[3].options.transparent_huge_pages = true;
+	variants[3].options.populate = true;
+	variants[4].name = "huge pages";
+	variants[4].options.huge_pages = true;
+	variants[5].name = "lock + random";
+	variants[5].options.lock = true;
+	variants[5].options.access = mn::VIRTUAL_ACCESS_RANDOM;
+
+	ankerl::nanobench::Bench bench;
+	bench.title("virtual memory random access").relative(true).minEpochIterations(1000000);
+	for (const auto& variant: variants)
+	{
+		auto faults = minor_faults();
+		auto block = mn::virtual_alloc(nullptr, size, variant.options);
+		// huge pages need a reserved pool and lock needs a big enough RLIMIT_MEMLOCK
+		if (block.ptr == nullptr)
+		{
+			mn::print("{}: not available\n", variant.name);
+			continue;
+		}
+
+		auto alloc_faults = minor_faults() - faults;
+		faults = minor_faults();
+		for (size_t i = 0; i < block.size; i += PAGE)
+			((volatile char*)block.ptr)[i] = char(i);
+		auto touch_faults = minor_faults() - faults;
+		mn::print("{}: {} minor faults in alloc, {} minor faults on first touch of {} pages\n", variant.name, alloc_faults, touch_faults, size / PAGE);
+
+		uint64_t state = 0x9E3779B97F4A7C15ULL;
+		auto ptr = (uint64_t*)block.ptr;
+		auto count = block.size / sizeof(uint64_t);
+		bench.run(variant.name, [&]{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			ankerl::nanobench::doNotOptimizeAway(ptr[state % count]);
+		});
+		mn::virtual_free(block);
+	}
+}
+
 TEST_CASE("reads")
 {
 	int a, b;
@@ -534,6 +876,266 @@ TEST_CASE("path windows os encoding")
 	mn::str_free(os_path);
 }
 
+#if OS_LINUX
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+TEST_CASE("folder copy")
+{
+	auto write_file = [](const mn::Str& path, size_t size, char seed) {
+		auto f = mn::file_open(path, mn::IO_MODE_WRITE, mn::OPEN_MODE_CREATE_OVERWRITE);
+		auto content = mn::str_new();
+		for (size_t i = 0; i < size; ++i)
+			mn::str_push(content, mn::Rune(seed + i % 26));
+		mn::file_write(f, mn::block_from(content));
+		mn::str_free(content);
+		mn::file_close(f);
+	};
+
+	auto root = mn::file_tmp("", "");
+	auto src = mn::path_join(mn::str_clone(root), "src");
+	auto dst = mn::path_join(mn::str_clone(root), "dst");
+	auto dst_parallel = mn::path_join(mn::str_clone(root), "dst_parallel");
+	mn_defer{
+		mn::folder_remove(root);
+		mn::str_free(root);
+		mn::str_free(src);
+		mn::str_free(dst);
+		mn::str_free(dst_parallel);
+	};
+
+	const char* files[] = {"a.txt", "sub/b.bin", "sub/deep/c.txt", "sub/deep/empty.txt"};
+	size_t sizes[] = {100, 3 * 1024 * 1024 + 17, 4096, 0};
+	CHECK(mn::folder_make(root));
+	CHECK(mn::folder_make(src));
+	CHECK(mn::folder_make(mn::str_tmpf("{}/sub", src)));
+	CHECK(mn::folder_make(mn::str_tmpf("{}/sub/deep", src)));
+	for (size_t i = 0; i < 4; ++i)
+		write_file(mn::str_tmpf("{}/{}", src, files[i]), sizes[i], char('a' + i));
+
+#if OS_LINUX
+	// a 64MB sparse file with 4KB of data at each end, and a relative symlink to a.txt
+	constexpr off_t SPARSE_SIZE = 64 * 1024 * 1024;
+	auto sparse_src = mn::str_tmpf("{}/sparse.bin", src);
+	{
+		auto f = mn::file_open(sparse_src, mn::IO_MODE_WRITE, mn::OPEN_MODE_CREATE_OVERWRITE);
+		char page[4096];
+		::memset(page, 's', sizeof(page));
+		CHECK(mn::file_write_at(f, 0, mn::block_from(page)) == sizeof(page));
+		CHECK(mn::file_write_at(f, SPARSE_SIZE - sizeof(page), mn::block_from(page)) == sizeof(page));
+		mn::file_close(f);
+	}
+	CHECK(::symlink("a.txt", mn::str_tmpf("{}/link.txt", src).ptr) == 0);
+#endif
+
+	CHECK(mn::folder_copy(src, dst));
+	CHECK(mn::file_copy(mn::str_tmpf("{}/a.txt", src), mn::str_tmpf("{}/a.txt", dst)) == false);
+
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	auto f = mn::fabric_new(settings);
+	CHECK(mn::folder_copy(src, dst_parallel, f, 2));
+	mn::fabric_free(f);
+
+	for (size_t i = 0; i < 4; ++i)
+	{
+		auto expected = mn::file_content_str(mn::str_tmpf("{}/{}", src, files[i]), mn::memory::tmp());
+		CHECK(expected.count == sizes[i]);
+		CHECK(mn::file_content_str(mn::str_tmpf("{}/{}", dst, files[i]), mn::memory::tmp()) == expected);
+		CHECK(mn::file_content_str(mn::str_tmpf("{}/{}", dst_parallel, files[i]), mn::memory::tmp()) == expected);
+	}
+
+#if OS_LINUX
+	// the copies of the sparse file keep its size without allocating its hole, it's only checked if the tmp
+	// filesystem keeps the source sparse in the first place
+	struct stat sparse_sb{};
+	CHECK(::stat(sparse_src.ptr, &sparse_sb) == 0);
+	bool src_is_sparse = sparse_sb.st_blocks * 512 < SPARSE_SIZE;
+	for (auto root_dst: {&dst, &dst_parallel})
+	{
+		struct stat sb{};
+		CHECK(::stat(mn::str_tmpf("{}/sparse.bin", *root_dst).ptr, &sb) == 0);
+		CHECK(sb.st_size == SPARSE_SIZE);
+		if (src_is_sparse)
+			CHECK(sb.st_blocks <= sparse_sb.st_blocks);
+		CHECK(mn::file_content_str(mn::str_tmpf("{}/sparse.bin", *root_dst), mn::memory::tmp()) ==
+			mn::file_content_str(sparse_src, mn::memory::tmp()));
+
+		// symlinks are recreated as symlinks with the same target instead of being followed
+		auto link = mn::str_tmpf("{}/link.txt", *root_dst);
+		CHECK(::lstat(link.ptr, &sb) == 0);
+		CHECK(S_ISLNK(sb.st_mode));
+		char target[64] = {};
+		CHECK(::readlink(link.ptr, target, sizeof(target) - 1) == 5);
+		CHECK(::strcmp(target, "a.txt") == 0);
+	}
+
+	// file_copy follows symlinks and copies the file they point to
+	auto followed = mn::str_tmpf("{}/followed.txt", root);
+	CHECK(mn::file_copy(mn::str_tmpf("{}/link.txt", src), followed));
+	struct stat followed_sb{};
+	CHECK(::lstat(followed.ptr, &followed_sb) == 0);
+	CHECK(S_ISREG(followed_sb.st_mode));
+	CHECK(mn::file_content_str(followed, mn::memory::tmp()) ==
+		mn::file_content_str(mn::str_tmpf("{}/a.txt", src), mn::memory::tmp()));
+#endif
+}
+
+TEST_CASE("path walk")
+{
+	CHECK(mn::path_glob_match("*.cpp", "src/mn/Path.cpp"));
+	CHECK(mn::path_glob_match("src/*/*.cpp", "src/mn/Path.cpp"));
+	CHECK(mn::path_glob_match("src/**/*.cpp", "src/Path.cpp"));
+	CHECK(mn::path_glob_match("src/**", "src/mn/linux/Path.cpp"));
+	CHECK(mn::path_glob_match("src/*.cpp", "src/mn/Path.cpp") == false);
+	CHECK(mn::path_glob_match("[a-c]?.h", "b1.h"));
+	CHECK(mn::path_glob_match("[!a-c]?.h", "b1.h") == false);
+
+	auto root = mn::file_tmp("", "");
+	mn_defer{
+		mn::folder_remove(root);
+		mn::str_free(root);
+	};
+
+	const char* files[] = {"a.txt", "b.cpp", "sub/c.txt", "sub/deep/d.txt", "skip/e.txt"};
+	CHECK(mn::folder_make_recursive(mn::str_tmpf("{}/sub/deep", root)));
+	CHECK(mn::folder_make_recursive(mn::str_tmpf("{}/skip", root)));
+	for (auto file: files)
+	{
+		auto f = mn::file_open(mn::str_tmpf("{}/{}", root, file), mn::IO_MODE_WRITE, mn::OPEN_MODE_CREATE_OVERWRITE);
+		mn::file_close(f);
+	}
+
+	SUBCASE("serial")
+	{
+		auto settings = mn::Path_Walk_Settings{};
+		settings.include = mn::buf_lit({mn::str_lit("*.txt")});
+		settings.exclude = mn::buf_lit({mn::str_lit("skip")});
+		mn_defer{
+			mn::buf_free(settings.include);
+			mn::buf_free(settings.exclude);
+		};
+
+		auto visited = mn::buf_new<mn::Str>();
+		mn_defer{destruct(visited);};
+		CHECK(mn::path_walk(root, settings, [&](const mn::Path_Walk_Entry& entry) {
+			buf_push(visited, mn::str_tmpf("{}:{}", entry.relative_path, entry.depth));
+		}));
+		std::sort(begin(visited), end(visited), [](const mn::Str& a, const mn::Str& b) { return ::strcmp(a.ptr, b.ptr) < 0; });
+		CHECK(visited.count == 5);
+		CHECK(visited[0] == "a.txt:1");
+		CHECK(visited[1] == "sub/c.txt:2");
+		CHECK(visited[2] == "sub/deep/d.txt:3");
+		CHECK(visited[3] == "sub/deep:2");
+		CHECK(visited[4] == "sub:1");
+
+		buf_clear(visited);
+		settings.max_depth = 1;
+		CHECK(mn::path_walk(root, settings, [&](const mn::Path_Walk_Entry& entry) {
+			buf_push(visited, entry.relative_path);
+		}));
+		CHECK(visited.count == 2);
+
+		CHECK(mn::path_walk(mn::str_tmpf("{}/not_there", root), settings, [](const mn::Path_Walk_Entry&) {}) == false);
+	}
+
+	SUBCASE("parallel")
+	{
+		mn::Fabric_Settings fabric_settings{};
+		fabric_settings.workers_count = 4;
+		auto f = mn::fabric_new(fabric_settings);
+		mn_defer{mn::fabric_free(f);};
+
+		auto settings = mn::Path_Walk_Settings{};
+		settings.fabric = f;
+
+		std::atomic<size_t> files_count = 0;
+		std::atomic<size_t> folders_count = 0;
+		CHECK(mn::path_walk(root, settings, [&](const mn::Path_Walk_Entry& entry) {
+			if (entry.kind == mn::Path_Entry::KIND_FOLDER)
+				++folders_count;
+			else
+				++files_count;
+		}));
+		CHECK(files_count == 5);
+		CHECK(folders_count == 3);
+
+		auto chan = mn::chan_new<mn::Path_Walk_Entry>(4);
+		mn_defer{mn::chan_free(chan);};
+		mn::go(f, [=] {
+			mn::path_walk(root, settings, chan);
+			mn::chan_close(chan);
+		});
+
+		size_t count = 0;
+		for (auto entry: chan)
+		{
+			CHECK(mn::str_prefix(entry.path, root));
+			mn::path_walk_entry_free(entry);
+			++count;
+		}
+		CHECK(count == 8);
+	}
+}
+
+TEST_CASE("file positional io")
+{
+	auto path = mn::file_tmp("", "bin");
+	mn_defer{
+		mn::file_remove(path);
+		mn::str_free(path);
+	};
+
+	auto f = mn::file_open(path, mn::IO_MODE_READ_WRITE, mn::OPEN_MODE_CREATE_OVERWRITE);
+	mn_defer{mn::file_close(f);};
+
+	constexpr size_t PAGE = 4096;
+	constexpr size_t PAGES = 64;
+	CHECK(mn::file_preallocate(f, 0, PAGE * PAGES));
+	CHECK(mn::file_size(f) == PAGE * PAGES);
+	CHECK(mn::file_access_hint(f, 0, 0, mn::FILE_ACCESS_HINT_RANDOM));
+
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	auto fabric = mn::fabric_new(settings);
+	mn::compute(fabric, {PAGES, 1, 1}, {1, 1, 1}, [&](mn::Compute_Args args) {
+		uint8_t page[PAGE];
+		::memset(page, int(args.global_invocation_id.x), PAGE);
+		mn::file_write_at(f, args.global_invocation_id.x * PAGE, mn::block_from(page));
+	});
+	std::atomic<size_t> mismatches = 0;
+	mn::compute(fabric, {PAGES, 1, 1}, {1, 1, 1}, [&](mn::Compute_Args args) {
+		uint8_t page[PAGE];
+		auto read_size = mn::file_read_at(f, args.global_invocation_id.x * PAGE, mn::block_from(page));
+		if (read_size != PAGE || page[0] != args.global_invocation_id.x || page[PAGE - 1] != args.global_invocation_id.x)
+			++mismatches;
+	});
+	mn::fabric_free(fabric);
+	CHECK(mismatches == 0);
+	CHECK(mn::file_cursor_pos(f) == 0);
+
+	uint32_t header = 0xDEADBEEF;
+	char name[5] = "mnio";
+	uint64_t footer = 42;
+	mn::Block out[] = {mn::block_from(header), mn::block_from(name), mn::block_from(footer)};
+	CHECK(mn::file_writev_at(f, PAGE * PAGES, out, 3) == sizeof(header) + sizeof(name) + sizeof(footer));
+
+	uint32_t header_in = 0;
+	char name_in[5] = {};
+	uint64_t footer_in = 0;
+	mn::Block in[] = {mn::block_from(header_in), mn::block_from(name_in), mn::block_from(footer_in)};
+	CHECK(mn::file_readv_at(f, PAGE * PAGES, in, 3) == sizeof(header) + sizeof(name) + sizeof(footer));
+	CHECK(header_in == header);
+	CHECK(::strcmp(name_in, name) == 0);
+	CHECK(footer_in == footer);
+
+	// reading past the end of the file returns the available bytes only
+	uint8_t tail[64];
+	CHECK(mn::file_read_at(f, PAGE * PAGES + 9, mn::block_from(tail)) == sizeof(footer));
+	CHECK(mn::file_read_at(f, PAGE * PAGES * 2, mn::block_from(tail)) == 0);
+}
+
 TEST_CASE("Str_Intern general case")
 {
 	auto intern = mn::str_intern_new();
@@ -1025,6 +1627,173 @@ TEST_CASE("future")
 	mn::fabric_free(f);
 }
 
+TEST_CASE("future continuations")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	SUBCASE("then")
+	{
+		auto answer = mn::future_go(fabric, []{ return 21; });
+		mn_defer{mn::future_free(answer);};
+		auto doubled = mn::future_then(answer, fabric, [](int& x) { return x * 2; });
+		mn_defer{mn::future_free(doubled);};
+		auto text = mn::future_then(doubled, nullptr, [](int& x) { return mn::strf("{}", x); });
+		mn_defer{mn::future_free(text);};
+		int void_calls = 0;
+		auto done = mn::future_then(text, fabric, [&](mn::Str& str) { CHECK(str == "42"); ++void_calls; });
+		mn_defer{mn::future_free(done);};
+		auto after_void = mn::future_then(done, fabric, [&]{ return void_calls; });
+		mn_defer{mn::future_free(after_void);};
+
+		mn::future_wait(after_void);
+		CHECK(mn::future_is_done(text));
+		CHECK(*text == "42");
+		CHECK(*after_void == 1);
+
+		// continuations attached to a finished future run right away
+		auto late = mn::future_then(answer, nullptr, [](int& x) { return x + 1; });
+		mn_defer{mn::future_free(late);};
+		CHECK(mn::future_is_done(late));
+		CHECK(*late == 22);
+	}
+
+	SUBCASE("when_all and when_any")
+	{
+		constexpr int LOOKUPS_COUNT = 1000;
+		auto lookups = mn::buf_new<mn::Future<int>>();
+		mn_defer{destruct(lookups);};
+		for (int i = 0; i < LOOKUPS_COUNT; ++i)
+			mn::buf_push(lookups, mn::future_go(fabric, [i]{ return i; }));
+
+		auto all = mn::future_when_all(lookups);
+		mn_defer{mn::future_free(all);};
+		auto sum = mn::future_then(all, fabric, [&]{
+			int res = 0;
+			for (auto lookup: lookups)
+			{
+				CHECK(mn::future_is_done(lookup));
+				res += *lookup;
+			}
+			return res;
+		});
+		mn_defer{mn::future_free(sum);};
+		mn::future_wait(sum);
+		CHECK(*sum == LOOKUPS_COUNT * (LOOKUPS_COUNT - 1) / 2);
+
+		auto empty = mn::future_when_all(lookups.ptr, 0);
+		mn_defer{mn::future_free(empty);};
+		CHECK(mn::future_is_done(empty));
+
+		// the slow future waits for the when_any to be done so it can't finish first
+		std::atomic<bool> release_slow = false;
+		auto slow = mn::future_go(fabric, [&]{
+			while (release_slow == false)
+				mn::thread_sleep(1);
+			return 1;
+		});
+		mn_defer{mn::future_free(slow);};
+		auto fast = mn::future_go(fabric, []{ return 2; });
+		mn_defer{mn::future_free(fast);};
+		auto first = mn::future_when_any(slow, fast);
+		mn_defer{mn::future_free(first);};
+		auto both = mn::future_when_all(slow, fast, first);
+		mn_defer{mn::future_free(both);};
+
+		mn::future_wait(first);
+		CHECK(*first == 1);
+		CHECK(mn::future_is_done(both) == false);
+		release_slow = true;
+		mn::future_wait(both);
+		CHECK(*slow == 1);
+	}
+
+	SUBCASE("chains don't block workers")
+	{
+		// each step of the chain schedules the next lookup from a continuation, so a single worker is enough
+		mn::Fabric_Settings single_settings{};
+		single_settings.workers_count = 1;
+		auto single = mn::fabric_new(single_settings);
+		mn_defer{mn::fabric_free(single);};
+
+		constexpr int STEPS_COUNT = 1000;
+		auto wg = mn::waitgroup_new();
+		mn_defer{mn::waitgroup_free(wg);};
+		mn::waitgroup_add(wg, 1);
+
+		std::atomic<int> last = 0;
+		struct Step
+		{
+			static void
+			run(mn::Fabric fabric, int value, mn::Waitgroup wg, std::atomic<int>* last)
+			{
+				auto lookup = mn::future_go(fabric, [value]{ return value + 1; });
+				auto next = mn::future_then(lookup, fabric, [fabric, wg, last](int& x) {
+					if (x == STEPS_COUNT)
+					{
+						*last = x;
+						mn::waitgroup_done(wg);
+					}
+					else
+					{
+						run(fabric, x, wg, last);
+					}
+				});
+				mn::future_detach(lookup);
+				mn::future_detach(next);
+			}
+		};
+		Step::run(single, 0, wg, &last);
+		mn::waitgroup_wait(wg);
+		CHECK(last == STEPS_COUNT);
+	}
+}
+
+TEST_CASE("future continuations benchmark")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	// fan out 100 lookups and join them, waiting on each one blocks the caller while when_all doesn't
+	ankerl::nanobench::Bench bench;
+	bench.title("future fan out and join").minEpochIterations(10);
+	bench.run("future_wait each", [&]{
+		mn::Future<int> lookups[100];
+		for (int i = 0; i < 100; ++i)
+			lookups[i] = mn::future_go(fabric, [i]{ return i; });
+		int sum = 0;
+		for (auto& lookup: lookups)
+		{
+			mn::future_wait(lookup);
+			sum += *lookup;
+			mn::future_free(lookup);
+		}
+		ankerl::nanobench::doNotOptimizeAway(sum);
+	});
+	bench.run("future_when_all", [&]{
+		mn::Future<int> lookups[100];
+		for (int i = 0; i < 100; ++i)
+			lookups[i] = mn::future_go(fabric, [i]{ return i; });
+		auto all = mn::future_when_all(lookups, 100);
+		auto sum = mn::future_then(all, nullptr, [&]{
+			int res = 0;
+			for (auto& lookup: lookups)
+				res += *lookup;
+			return res;
+		});
+		mn::future_detach(all);
+		mn::future_wait(sum);
+		ankerl::nanobench::doNotOptimizeAway(*sum);
+		mn::future_free(sum);
+		for (auto& lookup: lookups)
+			mn::future_free(lookup);
+	});
+}
+
 TEST_CASE("buddy")
 {
 	auto buddy = mn::allocator_buddy_new();
@@ -1036,9 +1805,127 @@ TEST_CASE("buddy")
 	for(int i = 0; i < 1000; ++i)
 		CHECK(nums[i] == i);
 	mn::buf_free(nums);
+
+	auto stats = buddy->stats();
+	CHECK(stats.allocations_count == 0);
+	CHECK(stats.used_mem == 0);
+	CHECK(stats.largest_free_block == 1024 * 1024);
+
+	// blocks don't have headers so the whole heap can be allocated, and a split heap has no single free block
+	auto whole = mn::alloc_from(buddy, 1024 * 1024, alignof(int));
+	CHECK(whole.ptr != nullptr);
+	mn::free_from(buddy, whole);
+
+	auto a = mn::alloc_from(buddy, 100, alignof(int));
+	auto b = mn::alloc_from(buddy, 512 * 1024, alignof(int));
+	stats = buddy->stats();
+	CHECK(stats.allocations_count == 2);
+	CHECK(stats.used_mem == 128 + 512 * 1024);
+	CHECK(stats.requested_mem == 100 + 512 * 1024);
+	CHECK(stats.largest_free_block == 256 * 1024);
+	CHECK(stats.external_fragmentation > 0.0f);
+	mn::free_from(buddy, a);
+	mn::free_from(buddy, b);
+	CHECK(buddy->stats().largest_free_block == 1024 * 1024);
+
+	// over aligned blocks keep the requested size and are freed with it
+	auto small = mn::alloc_from(buddy, 16, alignof(int));
+	auto aligned = mn::alloc_from(buddy, 8, 128);
+	CHECK(aligned.size == 8);
+	CHECK(size_t(aligned.ptr) % 128 == 0);
+	stats = buddy->stats();
+	CHECK(stats.used_mem == 32);
+	mn::free_from(buddy, aligned);
+	mn::free_from(buddy, small);
+	stats = buddy->stats();
+	CHECK(stats.allocations_count == 0);
+	CHECK(stats.used_mem == 0);
+	CHECK(stats.largest_free_block == 1024 * 1024);
+
 	mn::allocator_free(buddy);
 }
 
+TEST_CASE("concurrent buddy")
+{
+	constexpr size_t WORKERS = 4;
+	auto buddy = mn::allocator_buddy_new(16ULL * 1024ULL * 1024ULL, mn::memory::virtual_mem(), WORKERS);
+	CHECK(buddy->stripes_count == WORKERS);
+	CHECK(buddy->max_alloc == 4ULL * 1024ULL * 1024ULL);
+
+	mn::Fabric_Settings settings{};
+	settings.workers_count = WORKERS;
+	auto fabric = mn::fabric_new(settings);
+	std::atomic<size_t> corrupted = 0;
+	mn::compute(fabric, {64, 1, 1}, {1, 1, 1}, [&](mn::Compute_Args args) {
+		mn::Block blocks[64]{};
+		for (size_t i = 0; i < 64; ++i)
+		{
+			blocks[i] = mn::alloc_from(buddy, 16 + i * 32, alignof(int));
+			::memset(blocks[i].ptr, int(args.global_invocation_id.x), blocks[i].size);
+		}
+		for (size_t i = 0; i < 64; ++i)
+		{
+			auto ptr = (uint8_t*)blocks[i].ptr;
+			if (ptr[0] != uint8_t(args.global_invocation_id.x) || ptr[blocks[i].size - 1] != uint8_t(args.global_invocation_id.x))
+				++corrupted;
+			mn::free_from(buddy, blocks[i]);
+		}
+	});
+	mn::fabric_free(fabric);
+	CHECK(corrupted == 0);
+
+	auto stats = buddy->stats();
+	CHECK(stats.allocations_count == 0);
+	CHECK(stats.largest_free_block == buddy->max_alloc);
+	mn::allocator_free(buddy);
+}
+
+TEST_CASE("buddy benchmark")
+{
+	constexpr size_t SLOTS = 4096;
+	constexpr size_t HEAP_SIZE = 64ULL * 1024ULL * 1024ULL;
+
+	// keeps a window of live blocks with random sizes and replaces one of them each iteration
+	auto churn = [](mn::Allocator allocator, mn::Block* slots, uint64_t& state) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		auto& slot = slots[state % SLOTS];
+		if (slot.ptr)
+			mn::free_from(allocator, slot);
+		slot = mn::alloc_from(allocator, 16 + (state >> 32) % 2048, alignof(int));
+		ankerl::nanobench::doNotOptimizeAway(slot.ptr);
+	};
+
+	auto buddy = mn::allocator_buddy_new(HEAP_SIZE);
+	mn_defer{mn::allocator_free(buddy);};
+	auto striped_buddy = mn::allocator_buddy_new(HEAP_SIZE * 4, mn::memory::virtual_mem(), 4);
+	mn_defer{mn::allocator_free(striped_buddy);};
+
+	struct Variant
+	{
+		const char* name;
+		mn::Allocator allocator;
+	};
+	Variant variants[] = {
+		{"clib", mn::memory::clib()},
+		{"buddy", buddy},
+		{"striped buddy", striped_buddy},
+	};
+
+	ankerl::nanobench::Bench bench;
+	bench.title("alloc/free churn").relative(true).minEpochIterations(1000000);
+	for (const auto& variant: variants)
+	{
+		mn::Block slots[SLOTS]{};
+		uint64_t state = 0x9E3779B97F4A7C15ULL;
+		bench.run(variant.name, [&]{ churn(variant.allocator, slots, state); });
+		for (auto& slot: slots)
+			if (slot.ptr)
+				mn::free_from(variant.allocator, slot);
+	}
+}
+
 TEST_CASE("handle table generation check")
 {
 	auto table = mn::handle_table_new<int>();
@@ -1401,6 +2288,1402 @@ TEST_CASE("arena scopes")
 	CHECK(name == "my name is mostafa");
 }
 
+TEST_CASE("fabric sysmon")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	// the long jobs wait for the queued job to run with a generous timeout, so the checks don't depend on how fast
+	// the machine is, they only fail if the queued job is stuck behind the long jobs until the timeout
+	constexpr uint64_t TIMEOUT_IN_MS = 10000;
+
+	// an idle worker asks sysmon to steal the job queued behind the long job of the other worker
+	{
+		std::atomic<bool> queued_job_done = false;
+		std::atomic<bool> long_job_timed_out = false;
+		mn::Auto_Waitgroup wg;
+		wg.add(3);
+		mn::go(fabric, [&] {
+			auto start = mn::time_in_millis();
+			while (queued_job_done == false)
+			{
+				if (mn::time_in_millis() - start > TIMEOUT_IN_MS)
+				{
+					long_job_timed_out = true;
+					break;
+				}
+			}
+			wg.done();
+		});
+		mn::go(fabric, [&] { wg.done(); });
+		mn::go(fabric, [&] { queued_job_done = true; wg.done(); });
+		wg.wait();
+		CHECK(long_job_timed_out == false);
+	}
+
+	// workers which announce they're blocking get replaced when their coop blocking deadline expires, so the queued
+	// job doesn't wait for them
+	{
+		std::atomic<bool> queued_job_done = false;
+		std::atomic<size_t> blocking_jobs_timed_out = 0;
+		mn::Auto_Waitgroup wg;
+		wg.add(4);
+		for (size_t i = 0; i < 2; ++i)
+		{
+			mn::go(fabric, [&] {
+				mn::worker_block_ahead();
+				auto start = mn::time_in_millis();
+				while (queued_job_done == false)
+				{
+					if (mn::time_in_millis() - start > TIMEOUT_IN_MS)
+					{
+						blocking_jobs_timed_out++;
+						break;
+					}
+					mn::thread_sleep(1);
+				}
+				mn::worker_block_clear();
+				wg.done();
+			});
+		}
+		mn::go(fabric, [&] { queued_job_done = true; wg.done(); });
+		mn::go(fabric, [&] { wg.done(); });
+		wg.wait();
+		CHECK(blocking_jobs_timed_out == 0);
+	}
+}
+
+TEST_CASE("fabric tmp retention")
+{
+	{
+		auto checkpoint = mn::allocator_arena_checkpoint(mn::memory::tmp());
+		{
+			mn::memory::Arena_Scope scope{mn::memory::tmp()};
+			mn::str_tmpf("my name is {}", "mostafa");
+			CHECK(mn::memory::tmp()->used_mem > checkpoint.used_mem);
+		}
+		CHECK(mn::memory::tmp()->used_mem == checkpoint.used_mem);
+	}
+
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	settings.tmp_retain_size = 1ULL * 1024ULL * 1024ULL;
+	settings.tmp_decay_in_ms = 10;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	// jobs reuse the same tmp memory because each one runs inside its own tmp scope
+	std::atomic<void*> first_ptr = nullptr;
+	std::atomic<size_t> failures = 0;
+	for (size_t i = 0; i < 10; ++i)
+	{
+		mn::compute(fabric, {1, 1, 1}, {1, 1, 1}, [&](mn::Compute_Args) {
+			auto block = mn::memory::tmp()->alloc(8ULL * 1024ULL * 1024ULL, alignof(char));
+			::memset(block.ptr, 1, block.size);
+			void* expected = nullptr;
+			if (first_ptr.compare_exchange_strong(expected, block.ptr) == false && expected != block.ptr)
+				failures++;
+		});
+	}
+	CHECK(failures == 0);
+
+	// the idle worker returns the memory above the retain size after the decay duration
+	auto stats = mn::fabric_tmp_stats(fabric);
+	for (size_t i = 0; i < 100 && stats.release_count == 0; ++i)
+	{
+		mn::thread_sleep(10);
+		stats = mn::fabric_tmp_stats(fabric);
+	}
+	CHECK(stats.release_count == 1);
+	CHECK(stats.release_mem >= 7ULL * 1024ULL * 1024ULL);
+	CHECK(stats.retained_mem <= settings.tmp_retain_size + mn::memory::tmp()->block_size);
+}
+
+TEST_CASE("fabric tmp callbacks scope")
+{
+	// tmp allocations made by the worker callbacks are freed after each job instead of piling up
+	std::atomic<size_t> max_used_mem = 0;
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	settings.on_worker_start = mn::Task<void()>::make([] { mn::memory::tmp()->alloc(1024, alignof(char)); });
+	settings.after_each_job = mn::Task<void()>::make([&] {
+		auto used_mem = mn::memory::tmp()->used_mem;
+		if (used_mem > max_used_mem)
+			max_used_mem = used_mem;
+		mn::memory::tmp()->alloc(1024, alignof(char));
+	});
+	auto fabric = mn::fabric_new(settings);
+
+	constexpr size_t JOBS_COUNT = 1000;
+	auto wg = mn::waitgroup_new();
+	mn_defer{mn::waitgroup_free(wg);};
+	for (size_t i = 0; i < JOBS_COUNT; ++i)
+	{
+		mn::waitgroup_add(wg, 1);
+		mn::go(fabric, [wg] {
+			mn::memory::tmp()->alloc(1024, alignof(char));
+			mn::waitgroup_done(wg);
+		});
+	}
+	mn::waitgroup_wait(wg);
+	mn::fabric_free(fabric);
+
+	CHECK(max_used_mem <= 4ULL * 1024ULL);
+}
+
+TEST_CASE("fabric worker placement")
+{
+	auto nodes = mn::numa_nodes();
+	mn_defer{mn::buf_free(nodes);};
+	CHECK(nodes.count >= 1);
+	for (const auto& node: nodes)
+		CHECK(mn::cpu_set_count(node.cpus) > 0);
+	auto first_cpu = mn::cpu_set_nth(nodes[0].cpus, 0);
+	CHECK(mn::numa_node_of_cpu(nodes, first_cpu) == 0);
+
+	constexpr size_t COUNT = 16ULL * 1024ULL * 1024ULL;
+	constexpr size_t TILE = 64ULL * 1024ULL;
+	auto data = mn::buf_with_count<uint64_t>(COUNT);
+	mn_defer{mn::buf_free(data);};
+
+	mn::FABRIC_PLACEMENT placements[] = {
+		mn::FABRIC_PLACEMENT_NONE,
+		mn::FABRIC_PLACEMENT_CORE,
+		mn::FABRIC_PLACEMENT_NUMA_NODE,
+	};
+	const char* names[] = {"no placement", "core placement", "numa node placement"};
+
+	ankerl::nanobench::Bench bench;
+	bench.title("memory bound compute").relative(true).minEpochIterations(10);
+	for (size_t i = 0; i < 3; ++i)
+	{
+		mn::Fabric_Settings settings{};
+		settings.placement = placements[i];
+		auto fabric = mn::fabric_new(settings);
+		mn_defer{mn::fabric_free(fabric);};
+
+		// first touch the data from the workers so it's placed in their local memory
+		mn::compute(fabric, {COUNT, 1, 1}, {TILE, 1, 1}, [&](mn::Compute_Args args) {
+			for (size_t j = 0; j < args.tile_size.x; ++j)
+				data[args.global_invocation_id.x + j] = args.global_invocation_id.x + j;
+		});
+
+		std::atomic<uint64_t> sum = 0;
+		bench.run(names[i], [&]{
+			sum = 0;
+			mn::compute(fabric, {COUNT, 1, 1}, {TILE, 1, 1}, [&](mn::Compute_Args args) {
+				uint64_t tile_sum = 0;
+				for (size_t j = 0; j < args.tile_size.x; ++j)
+					tile_sum += data[args.global_invocation_id.x + j];
+				sum += tile_sum;
+			});
+			ankerl::nanobench::doNotOptimizeAway(sum.load());
+		});
+		CHECK(sum == COUNT * (COUNT - 1) / 2);
+	}
+}
+
+TEST_CASE("fabric priorities")
+{
+	struct Run_Order
+	{
+		std::mutex mtx;
+		mn::Buf<int> order;
+		mn::Waitgroup wg;
+	};
+
+	// the first task holds the only worker so the other tasks are queued behind it
+	auto run_order_go = [](mn::Fabric fabric, Run_Order& run, mn::FABRIC_PRIORITY priority, uint32_t deadline_in_ms, int value) {
+		mn::waitgroup_add(run.wg, 1);
+		mn::go(fabric, priority, deadline_in_ms, [&run, value]{
+			std::lock_guard<std::mutex> lock(run.mtx);
+			mn::buf_push(run.order, value);
+			mn::waitgroup_done(run.wg);
+		});
+	};
+
+	SUBCASE("priorities and deadlines")
+	{
+		mn::Fabric_Settings settings{};
+		settings.workers_count = 1;
+		settings.normal_latency_budget_in_ms = 1000;
+		settings.background_latency_budget_in_ms = 2000;
+		auto fabric = mn::fabric_new(settings);
+		mn_defer{mn::fabric_free(fabric);};
+
+		Run_Order run{};
+		run.order = mn::buf_new<int>();
+		mn_defer{mn::buf_free(run.order);};
+		run.wg = mn::waitgroup_new();
+		mn_defer{mn::waitgroup_free(run.wg);};
+
+		std::atomic<bool> release = false;
+		mn::go(fabric, mn::FABRIC_PRIORITY_CRITICAL, 0, [&]{
+			while (release == false)
+				std::this_thread::yield();
+		});
+
+		for (int i = 0; i < 8; ++i)
+		{
+			run_order_go(fabric, run, mn::FABRIC_PRIORITY_BACKGROUND, 0, 2);
+			run_order_go(fabric, run, mn::FABRIC_PRIORITY_NORMAL, 0, 1);
+			run_order_go(fabric, run, mn::FABRIC_PRIORITY_CRITICAL, 0, 0);
+		}
+		// the deadline moves the task ahead of the normal tasks but it's due after the queued critical tasks, and
+		// it's missed because the worker is held for longer than it
+		run_order_go(fabric, run, mn::FABRIC_PRIORITY_NORMAL, 1, 3);
+		mn::thread_sleep(5);
+		release = true;
+		mn::waitgroup_wait(run.wg);
+
+		int expected[] = {0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2};
+		CHECK(run.order.count == 25);
+		for (size_t i = 0; i < run.order.count && i < 25; ++i)
+			CHECK(run.order[i] == expected[i]);
+
+		// the worker reports its stats once it goes idle
+		mn::Fabric_Queue_Stats stats{};
+		for (int i = 0; i < 1000; ++i)
+		{
+			stats = mn::fabric_queue_stats(fabric);
+			if (stats.priorities[mn::FABRIC_PRIORITY_BACKGROUND].tasks_count == 8)
+				break;
+			mn::thread_sleep(1);
+		}
+		const auto& critical = stats.priorities[mn::FABRIC_PRIORITY_CRITICAL];
+		const auto& normal = stats.priorities[mn::FABRIC_PRIORITY_NORMAL];
+		const auto& background = stats.priorities[mn::FABRIC_PRIORITY_BACKGROUND];
+		CHECK(critical.tasks_count == 9);
+		CHECK(normal.tasks_count == 9);
+		CHECK(background.tasks_count == 8);
+		CHECK(critical.missed_deadlines_count == 0);
+		CHECK(normal.missed_deadlines_count == 1);
+		CHECK(normal.max_latency_in_us >= 5000);
+		CHECK(mn::fabric_priority_stats_latency_percentile(normal, 1) >= normal.max_latency_in_us);
+		CHECK(mn::fabric_priority_stats_latency_percentile(normal, 0) <= mn::fabric_priority_stats_latency_percentile(normal, 1));
+	}
+
+	SUBCASE("background tasks don't starve")
+	{
+		mn::Fabric_Settings settings{};
+		settings.workers_count = 1;
+		settings.background_latency_budget_in_ms = 1;
+		auto fabric = mn::fabric_new(settings);
+		mn_defer{mn::fabric_free(fabric);};
+
+		Run_Order run{};
+		run.order = mn::buf_new<int>();
+		mn_defer{mn::buf_free(run.order);};
+		run.wg = mn::waitgroup_new();
+		mn_defer{mn::waitgroup_free(run.wg);};
+
+		std::atomic<bool> release = false;
+		mn::go(fabric, mn::FABRIC_PRIORITY_CRITICAL, 0, [&]{
+			while (release == false)
+				std::this_thread::yield();
+		});
+
+		// the background task waited beyond its budget by the time the critical task is queued
+		run_order_go(fabric, run, mn::FABRIC_PRIORITY_BACKGROUND, 0, 2);
+		mn::thread_sleep(5);
+		run_order_go(fabric, run, mn::FABRIC_PRIORITY_CRITICAL, 0, 0);
+		release = true;
+		mn::waitgroup_wait(run.wg);
+
+		CHECK(run.order.count == 2);
+		CHECK(run.order[0] == 2);
+		CHECK(run.order[1] == 0);
+	}
+}
+
+TEST_CASE("fabric timers")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	SUBCASE("delayed and periodic timers")
+	{
+		auto wg = mn::waitgroup_new();
+		mn_defer{mn::waitgroup_free(wg);};
+
+		std::atomic<uint64_t> fired_time = 0;
+		mn::waitgroup_add(wg, 1);
+		auto start_time = mn::time_in_millis();
+		mn::fabric_do_after(fabric, 20, [&]{
+			fired_time = mn::time_in_millis();
+			mn::waitgroup_done(wg);
+		});
+
+		std::atomic<int> cancelled_calls = 0;
+		auto cancelled = mn::fabric_do_after(fabric, 10, [&]{ ++cancelled_calls; });
+		CHECK(mn::fabric_timer_cancel(fabric, cancelled));
+		CHECK(mn::fabric_timer_cancel(fabric, cancelled) == false);
+		CHECK(mn::fabric_timer_cancel(fabric, mn::Fabric_Timer{}) == false);
+
+		std::atomic<int> ticks = 0;
+		mn::waitgroup_add(wg, 1);
+		auto periodic = mn::fabric_do_every(fabric, 5, [&]{
+			if (++ticks == 5)
+				mn::waitgroup_done(wg);
+		});
+
+		mn::waitgroup_wait(wg);
+		CHECK(mn::fabric_timer_cancel(fabric, periodic));
+		CHECK(fired_time - start_time >= 20);
+		CHECK(ticks >= 5);
+		CHECK(cancelled_calls == 0);
+	}
+
+	SUBCASE("lots of timers")
+	{
+		// connection timeouts style usage, most of the timers are cancelled before they fire
+		constexpr size_t COUNT = 100000;
+		auto timers = mn::buf_with_count<mn::Fabric_Timer>(COUNT);
+		mn_defer{mn::buf_free(timers);};
+
+		std::atomic<size_t> fired = 0;
+		for (size_t i = 0; i < COUNT; ++i)
+			timers[i] = mn::fabric_do_after(fabric, uint32_t(1 + i % 100), [&]{ ++fired; });
+
+		size_t cancelled = 0;
+		for (size_t i = 0; i < COUNT; i += 2)
+			if (mn::fabric_timer_cancel(fabric, timers[i]))
+				++cancelled;
+
+		for (int i = 0; i < 5000 && fired + cancelled < COUNT; ++i)
+			mn::thread_sleep(1);
+		CHECK(cancelled > 0);
+		CHECK(fired + cancelled == COUNT);
+	}
+}
+
+TEST_CASE("fabric timers benchmark")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	// insert and cancel should cost the same regardless of the number of armed timers
+	ankerl::nanobench::Bench bench;
+	bench.title("fabric timers").minEpochIterations(1000);
+	for (size_t armed_count: {0, 1000, 100000})
+	{
+		auto armed = mn::buf_with_count<mn::Fabric_Timer>(armed_count);
+		mn_defer{mn::buf_free(armed);};
+		for (size_t i = 0; i < armed_count; ++i)
+			armed[i] = mn::fabric_do_after(fabric, uint32_t(60000 + i % 100000), []{});
+
+		uint32_t delay = 0;
+		bench.run(mn::str_tmpf("insert and cancel with {} armed timers", armed_count).ptr, [&]{
+			delay = delay % 100000 + 1;
+			auto timer = mn::fabric_do_after(fabric, delay, []{});
+			ankerl::nanobench::doNotOptimizeAway(mn::fabric_timer_cancel(fabric, timer));
+		});
+
+		for (auto timer: armed)
+			mn::fabric_timer_cancel(fabric, timer);
+	}
+}
+
+TEST_CASE("task graph")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	auto graph = mn::task_graph_new("frame \"graph\"");
+	mn_defer{mn::task_graph_free(graph);};
+
+	// each node records the order in which it finished
+	std::atomic<int> counter = 0;
+	int order[6] = {};
+	auto node = [&](const char* name, int index, uint64_t cost) {
+		return mn::task_graph_node(graph, name, [&, index]{ order[index] = counter++; }, cost);
+	};
+
+	// a short root with a diamond after it, and a long root which should start first because it has the longest
+	// critical path
+	auto a = node("a", 0, 1);
+	auto b = node("b", 1, 1);
+	auto c = node("c", 2, 5);
+	auto d = node("d", 3, 1);
+	auto long_root = node("long_root", 4, 100);
+	auto end = node("end", 5, 1);
+	mn::task_graph_edge(graph, a, b);
+	mn::task_graph_edge(graph, a, c);
+	mn::task_graph_edge(graph, b, d);
+	mn::task_graph_edge(graph, c, d);
+	mn::task_graph_edge(graph, d, end);
+	mn::task_graph_edge(graph, long_root, end);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		counter = 0;
+		mn::task_graph_run(graph, fabric);
+		mn::task_graph_wait(graph);
+
+		CHECK(counter == 6);
+		CHECK(order[4] == 0);
+		CHECK(order[0] < order[1]);
+		CHECK(order[0] < order[2]);
+		// c holds back more work than b so it runs first
+		CHECK(order[2] < order[1]);
+		CHECK(order[1] < order[3]);
+		CHECK(order[3] < order[5]);
+	}
+
+	auto trace = mn::task_graph_trace(graph, mn::memory::tmp());
+	auto [v, err] = mn::json::parse(trace);
+	CHECK(err == false);
+	mn_defer{mn::json::value_free(v);};
+	auto events = mn::json::value_object_lookup(v, "traceEvents");
+	CHECK(mn::json::value_array_iter(*events).count == 7);
+	auto process = mn::json::value_object_lookup(mn::json::value_array_at(*events, 0), "args");
+	CHECK(*mn::json::value_object_lookup(*process, "name")->as_string == R"(frame \"graph\")");
+	auto& long_root_event = mn::json::value_array_at(*events, 5);
+	CHECK(*mn::json::value_object_lookup(long_root_event, "name")->as_string == "long_root");
+	CHECK(mn::json::value_object_lookup(long_root_event, "tid")->as_number == 0);
+	auto long_root_args = mn::json::value_object_lookup(long_root_event, "args");
+	CHECK(mn::json::value_object_lookup(*long_root_args, "critical_path_in_us")->as_number == 101);
+
+	// a wide graph which fans out and back in many times on multiple workers
+	mn::Fabric_Settings wide_settings{};
+	wide_settings.workers_count = 4;
+	auto wide_fabric = mn::fabric_new(wide_settings);
+	mn_defer{mn::fabric_free(wide_fabric);};
+
+	auto wide = mn::task_graph_new();
+	mn_defer{mn::task_graph_free(wide);};
+
+	std::atomic<int> done = 0;
+	std::atomic<int> violations = 0;
+	auto prev = mn::task_graph_node(wide, "start", [&]{ ++done; });
+	for (int layer = 0; layer < 10; ++layer)
+	{
+		auto join = mn::task_graph_node(wide, "join", [&, layer]{
+			if (done != (layer + 1) * 33)
+				++violations;
+			++done;
+		});
+		for (int i = 0; i < 32; ++i)
+		{
+			auto n = mn::task_graph_node(wide, "work", [&]{ ++done; });
+			mn::task_graph_edge(wide, prev, n);
+			mn::task_graph_edge(wide, n, join);
+		}
+		prev = join;
+	}
+
+	for (int i = 0; i < 5; ++i)
+	{
+		done = 0;
+		mn::task_graph_run(wide, wide_fabric);
+		mn::task_graph_wait(wide);
+		CHECK(done == 331);
+	}
+	CHECK(violations == 0);
+}
+
+TEST_CASE("tracer")
+{
+	auto mtx = mn_mutex_new_with_srcloc("tracer test mutex");
+	mn_defer{mn::mutex_free(mtx);};
+
+	mn::Fabric_Settings settings{};
+	settings.name = "tracer test";
+	settings.workers_count = 2;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	mn::tracer_start();
+	CHECK(mn::tracer_is_recording());
+
+	// the waiter blocks on the mutex until the main thread releases it
+	mn::mutex_lock(mtx);
+	auto waiter = mn::thread_new([](void* arg) {
+		auto mtx = (mn::Mutex)arg;
+		mn::mutex_lock(mtx);
+		mn::mutex_unlock(mtx);
+	}, mtx, "tracer test waiter");
+	mn::thread_sleep(20);
+	mn::mutex_unlock(mtx);
+	mn::thread_join(waiter);
+	mn::thread_free(waiter);
+
+	constexpr int JOBS_COUNT = 16;
+	auto wg = mn::waitgroup_new();
+	mn_defer{mn::waitgroup_free(wg);};
+	for (int i = 0; i < JOBS_COUNT; ++i)
+	{
+		mn::waitgroup_add(wg, 1);
+		mn::go(fabric, [wg]{
+			auto numbers = mn::buf_new<int>();
+			mn::buf_push(numbers, 1);
+			mn::buf_free(numbers);
+			mn::thread_sleep(1);
+			mn::waitgroup_done(wg);
+		});
+	}
+	mn::waitgroup_wait(wg);
+
+	// the jobs signal the waitgroup before they return, so the last ones might still be finishing
+	auto recorded_jobs_count = [] {
+		uint64_t res = 0;
+		for (const auto& stats: mn::tracer_thread_stats(mn::memory::tmp()))
+			res += stats.jobs_count;
+		return res;
+	};
+	for (int i = 0; i < 1000 && recorded_jobs_count() < JOBS_COUNT; ++i)
+		mn::thread_sleep(1);
+
+	mn::tracer_stop();
+	CHECK(mn::tracer_is_recording() == false);
+
+	auto lock_stats = mn::tracer_lock_stats(mn::memory::tmp());
+	auto mtx_stats = std::find_if(begin(lock_stats), end(lock_stats), [](const mn::Tracer_Lock_Stats& stats) {
+		return stats.srcloc != nullptr && ::strcmp(stats.srcloc->name, "tracer test mutex") == 0;
+	});
+	CHECK(mtx_stats != end(lock_stats));
+	if (mtx_stats == end(lock_stats))
+		return;
+	CHECK(mtx_stats->locks_count == 2);
+	CHECK(mtx_stats->contended_count >= 1);
+	CHECK(mtx_stats->max_wait_in_ns >= 10 * 1000 * 1000);
+
+	uint64_t jobs_count = 0;
+	uint64_t allocations_count = 0;
+	double utilization = 0;
+	bool has_waiter = false;
+	auto thread_stats = mn::tracer_thread_stats(mn::memory::tmp());
+	for (const auto& stats: thread_stats)
+	{
+		jobs_count += stats.jobs_count;
+		allocations_count += stats.allocations_count;
+		utilization += stats.utilization;
+		if (::strcmp(stats.name, "tracer test waiter") == 0)
+			has_waiter = stats.lock_wait_in_ns >= 10 * 1000 * 1000;
+	}
+	CHECK(jobs_count == JOBS_COUNT);
+	CHECK(allocations_count >= JOBS_COUNT);
+	CHECK(utilization > 0);
+	CHECK(has_waiter);
+
+	auto trace = mn::tracer_chrome_trace(mn::memory::tmp());
+	auto [v, err] = mn::json::parse(trace);
+	CHECK(err == false);
+	mn_defer{mn::json::value_free(v);};
+	auto events = mn::json::value_object_lookup(v, "traceEvents");
+	CHECK(events != nullptr);
+	size_t jobs_events_count = 0;
+	size_t mutex_events_count = 0;
+	for (size_t i = 0; i < mn::json::value_array_iter(*events).count; ++i)
+	{
+		auto cat = mn::json::value_object_lookup(mn::json::value_array_at(*events, i), "cat");
+		if (cat && *cat->as_string == "fabric")
+			++jobs_events_count;
+		else if (cat && *cat->as_string == "mutex")
+			++mutex_events_count;
+	}
+	CHECK(jobs_events_count == JOBS_COUNT);
+	CHECK(mutex_events_count >= 1);
+
+	// the recording stopped so the later locks aren't counted
+	mn::mutex_lock(mtx);
+	mn::mutex_unlock(mtx);
+	auto later_stats = mn::tracer_lock_stats(mn::memory::tmp());
+	uint64_t later_locks_count = 0;
+	for (const auto& stats: later_stats)
+		if (stats.srcloc == mtx_stats->srcloc)
+			later_locks_count = stats.locks_count;
+	CHECK(later_locks_count == 2);
+}
+
+TEST_CASE("fabric fibers")
+{
+	// a single worker would deadlock if the fibers blocked it instead of parking
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	constexpr int ROUNDS = 1000;
+	auto ping = mn::chan_new<int>();
+	mn_defer{mn::chan_free(ping);};
+	auto pong = mn::chan_new<int>();
+	mn_defer{mn::chan_free(pong);};
+
+	mn::Auto_Waitgroup wg;
+	wg.add(2);
+	std::atomic<int> last = 0;
+	mn::go_fiber(fabric, [&]{
+		CHECK(mn::fiber_local() != nullptr);
+		for (int i = 0; i < ROUNDS; ++i)
+		{
+			mn::chan_send(ping, i);
+			last = mn::chan_recv(pong).res;
+		}
+		wg.done();
+	});
+	mn::go_fiber(fabric, [&]{
+		for (int i = 0; i < ROUNDS; ++i)
+			mn::chan_send(pong, mn::chan_recv(ping).res + 1);
+		wg.done();
+	});
+	wg.wait();
+	CHECK(last == ROUNDS);
+
+	// the fibers yield while holding the mutex so the others park on it
+	constexpr int FIBERS = 100;
+	auto mtx = mn::mutex_new();
+	mn_defer{mn::mutex_free(mtx);};
+	auto started = mn::waitgroup_new();
+	mn_defer{mn::waitgroup_free(started);};
+	mn::waitgroup_add(started, FIBERS);
+	int counter = 0;
+	wg.add(FIBERS + 1);
+	mn::go_fiber(fabric, [&]{
+		mn::waitgroup_wait(started);
+		wg.done();
+	});
+	for (int i = 0; i < FIBERS; ++i)
+	{
+		mn::go_fiber(fabric, [&]{
+			mn::waitgroup_done(started);
+			mn::mutex_lock(mtx);
+			auto value = counter;
+			mn::fiber_yield();
+			counter = value + 1;
+			mn::mutex_unlock(mtx);
+			wg.done();
+		});
+	}
+	wg.wait();
+	CHECK(counter == FIBERS);
+
+	// socket reads park the fiber until the data arrives
+	auto server = mn::socket_open(mn::SOCKET_FAMILY_IPV4, mn::SOCKET_TYPE_TCP);
+	mn_defer{mn::socket_close(server);};
+	CHECK(mn::socket_bind(server, "4751"));
+	CHECK(mn::socket_listen(server));
+
+	std::atomic<size_t> read_bytes = 0;
+	wg.add(2);
+	mn::go_fiber(fabric, [&]{
+		auto client = mn::socket_accept(server, {1000});
+		if (client)
+		{
+			char buffer[16] = {};
+			auto [size, err] = mn::socket_read(client, mn::block_from(buffer), {1000});
+			if (err == mn::MN_SOCKET_ERROR_OK)
+				read_bytes = size;
+			mn::socket_close(client);
+		}
+		wg.done();
+	});
+	mn::go_fiber(fabric, [&]{
+		auto client = mn::socket_open(mn::SOCKET_FAMILY_IPV4, mn::SOCKET_TYPE_TCP);
+		if (mn::socket_connect(client, "localhost", "4751"))
+		{
+			// let the server fiber park on its read first
+			mn::fiber_yield();
+			mn::socket_write(client, mn::block_lit("hello"));
+		}
+		mn::socket_close(client);
+		wg.done();
+	});
+	wg.wait();
+	CHECK(read_bytes == 5);
+}
+
+TEST_CASE("chan select")
+{
+	auto ints = mn::chan_new<int>();
+	mn_defer{mn::chan_free(ints);};
+	auto floats = mn::chan_new<float>();
+	mn_defer{mn::chan_free(floats);};
+
+	// the first ready case wins
+	mn::Recv_Result<int> int_res{};
+	mn::Recv_Result<float> float_res{};
+	mn::chan_send(floats, 1.5f);
+	auto index = mn::chan_select(mn::NO_TIMEOUT, mn::chan_select_recv(ints, int_res), mn::chan_select_recv(floats, float_res));
+	CHECK(index == 1);
+	CHECK(float_res.res == 1.5f);
+	CHECK(float_res.more == true);
+
+	// a send case completes once the channel has space
+	index = mn::chan_select(mn::INFINITE_TIMEOUT, mn::chan_select_recv(floats, float_res), mn::chan_select_send(ints, 42));
+	CHECK(index == 1);
+	CHECK(mn::chan_recv(ints).res == 42);
+
+	// the select sleeps until the timeout expires
+	auto start = mn::time_in_millis();
+	index = mn::chan_select(mn::Timeout{50}, mn::chan_select_recv(ints, int_res), mn::chan_select_recv(floats, float_res));
+	CHECK(index == -1);
+	CHECK(mn::time_in_millis() - start >= 50);
+
+	// the select is woken up exactly once by another thread even if both channels receive values
+	constexpr int ROUNDS = 1000;
+	auto sender = mn::thread_new([](void* arg) {
+		auto ints = *(mn::Chan<int>*)arg;
+		for (int i = 0; i < ROUNDS; ++i)
+			mn::chan_send(ints, i);
+	}, &ints, "chan select sender");
+	int sum = 0;
+	for (int i = 0; i < ROUNDS; ++i)
+	{
+		index = mn::chan_select(mn::Timeout{1000}, mn::chan_select_recv(floats, float_res), mn::chan_select_recv(ints, int_res));
+		CHECK(index == 1);
+		sum += int_res.res;
+	}
+	mn::thread_join(sender);
+	mn::thread_free(sender);
+	CHECK(sum == ROUNDS * (ROUNDS - 1) / 2);
+
+	// a closed channel completes its receive case with more = false
+	auto closer = mn::thread_new([](void* arg) {
+		mn::thread_sleep(10);
+		mn::chan_close(*(mn::Chan<float>*)arg);
+	}, &floats, "chan select closer");
+	index = mn::chan_select(mn::INFINITE_TIMEOUT, mn::chan_select_recv(ints, int_res), mn::chan_select_recv(floats, float_res));
+	mn::thread_join(closer);
+	mn::thread_free(closer);
+	CHECK(index == 1);
+	CHECK(float_res.more == false);
+}
+
+TEST_CASE("chan stream buffered")
+{
+	auto stream = mn::chan_stream_buffered_new(3, 4);
+	mn_defer{mn::chan_stream_free(stream);};
+
+	// writes return once the bytes are copied even if there's no reader yet
+	CHECK(mn::stream_write(stream, mn::block_lit("hello ")) == 6);
+	auto buffer = mn::chan_stream_write_acquire(stream);
+	CHECK(buffer.size == 4);
+	::memcpy(buffer.ptr, "wo", 2);
+	mn::chan_stream_write_commit(stream, 2);
+
+	auto thread = mn::thread_new([](void* arg) {
+		auto stream = (mn::Chan_Stream)arg;
+		mn::stream_write(stream, mn::block_lit("rld"));
+		mn::chan_stream_close(stream);
+	}, stream, "chan stream writer");
+	mn_defer{mn::thread_free(thread);};
+
+	auto str = mn::str_new();
+	mn_defer{mn::str_free(str);};
+	while (true)
+	{
+		auto data = mn::chan_stream_read_acquire(stream);
+		if (data.size == 0)
+			break;
+		mn::str_block_push(str, data);
+		mn::chan_stream_read_release(stream, data.size);
+	}
+	mn::thread_join(thread);
+	CHECK(str == "hello world");
+
+	char c = 0;
+	CHECK(mn::stream_read(stream, mn::block_from(c)) == 0);
+}
+
+// simulates the processing of a pipeline stage (e.g. compression or encryption)
+inline static void
+_chan_stream_pipeline_work(mn::Block data)
+{
+	auto ptr = (uint8_t*)data.ptr;
+	for (size_t i = 0; i < data.size; ++i)
+		for (int j = 0; j < 8; ++j)
+			ptr[i] = uint8_t(ptr[i] * 167 + 13);
+}
+
+TEST_CASE("chan stream pipeline benchmark")
+{
+	constexpr size_t SIZE = 4 * 1024 * 1024;
+	constexpr size_t CHUNK = 16 * 1024;
+
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto fabric = mn::fabric_new(settings);
+	mn_defer{mn::fabric_free(fabric);};
+
+	// the three stages are a producer, a transform, and a consumer which sums the bytes
+	auto pipeline = [&](mn::Chan_Stream a, mn::Chan_Stream b, bool zero_copy) {
+		mn::go(fabric, [a]{
+			char chunk[CHUNK];
+			for (size_t i = 0; i < SIZE; i += CHUNK)
+			{
+				::memset(chunk, int(i / CHUNK), CHUNK);
+				_chan_stream_pipeline_work(mn::block_from(chunk));
+				mn::stream_write(a, mn::block_from(chunk));
+			}
+			mn::chan_stream_close(a);
+		});
+
+		mn::go(fabric, [a, b, zero_copy]{
+			if (zero_copy)
+			{
+				while (true)
+				{
+					auto in = mn::chan_stream_read_acquire(a);
+					if (in.size == 0)
+						break;
+					auto out = mn::chan_stream_write_acquire(b);
+					auto size = in.size < out.size ? in.size : out.size;
+					::memcpy(out.ptr, in.ptr, size);
+					_chan_stream_pipeline_work(mn::Block{out.ptr, size});
+					mn::chan_stream_write_commit(b, size);
+					mn::chan_stream_read_release(a, size);
+				}
+			}
+			else
+			{
+				char chunk[CHUNK];
+				while (auto size = mn::stream_read(a, mn::block_from(chunk)))
+				{
+					_chan_stream_pipeline_work(mn::Block{chunk, size});
+					mn::stream_write(b, mn::Block{chunk, size});
+				}
+			}
+			mn::chan_stream_close(b);
+		});
+
+		uint64_t sum = 0;
+		size_t total = 0;
+		char chunk[CHUNK];
+		while (auto size = mn::stream_read(b, mn::block_from(chunk)))
+		{
+			_chan_stream_pipeline_work(mn::Block{chunk, size});
+			for (size_t i = 0; i < size; ++i)
+				sum += uint8_t(chunk[i]);
+			total += size;
+		}
+		CHECK(total == SIZE);
+		return sum;
+	};
+
+	uint64_t expected = 0;
+	ankerl::nanobench::Bench bench;
+	bench.title("three stage chan stream pipeline").relative(true).minEpochIterations(5);
+
+	bench.run("rendezvous", [&]{
+		auto a = mn::chan_stream_new();
+		mn_defer{mn::chan_stream_free(a);};
+		auto b = mn::chan_stream_new();
+		mn_defer{mn::chan_stream_free(b);};
+		expected = pipeline(a, b, false);
+	});
+
+	bench.run("buffered", [&]{
+		auto a = mn::chan_stream_buffered_new(4, 64 * 1024);
+		mn_defer{mn::chan_stream_free(a);};
+		auto b = mn::chan_stream_buffered_new(4, 64 * 1024);
+		mn_defer{mn::chan_stream_free(b);};
+		CHECK(pipeline(a, b, false) == expected);
+	});
+
+	bench.run("buffered zero copy", [&]{
+		auto a = mn::chan_stream_buffered_new(4, 64 * 1024);
+		mn_defer{mn::chan_stream_free(a);};
+		auto b = mn::chan_stream_buffered_new(4, 64 * 1024);
+		mn_defer{mn::chan_stream_free(b);};
+		CHECK(pipeline(a, b, true) == expected);
+	});
+}
+
+// runs the given op on the given number of threads, each thread calls it ops_count / threads_count times with its
+// thread index
+template<typename TOp>
+static void
+_mutex_contention_run(size_t threads_count, size_t ops_count, TOp&& op)
+{
+	struct Contender
+	{
+		size_t index;
+		size_t ops_count;
+		TOp* op;
+	};
+
+	auto contenders = mn::buf_with_count<Contender>(threads_count);
+	mn_defer{mn::buf_free(contenders);};
+	auto threads = mn::buf_new<mn::Thread>();
+	mn_defer{mn::buf_free(threads);};
+	for (size_t i = 0; i < threads_count; ++i)
+	{
+		contenders[i] = Contender{i, ops_count / threads_count, &op};
+		buf_push(threads, mn::thread_new([](void* arg) {
+			auto self = (Contender*)arg;
+			for (size_t j = 0; j < self->ops_count; ++j)
+				(*self->op)(self->index);
+		}, &contenders[i], "mutex contender"));
+	}
+	for (auto thread: threads)
+	{
+		mn::thread_join(thread);
+		mn::thread_free(thread);
+	}
+}
+
+TEST_CASE("mutex contention benchmark")
+{
+	constexpr size_t OPS = 64 * 1024;
+	auto mtx = mn::mutex_new("contention benchmark mutex");
+	mn_defer{mn::mutex_free(mtx);};
+	std::mutex std_mtx;
+
+	ankerl::nanobench::Bench bench;
+	bench.title("mutex contention").epochs(3).minEpochIterations(1);
+	for (size_t threads_count = 1; threads_count <= 64; threads_count *= 2)
+	{
+		size_t counter = 0;
+		bench.run(mn::str_tmpf("mn::Mutex {} threads", threads_count).ptr, [&]{
+			counter = 0;
+			_mutex_contention_run(threads_count, OPS, [&](size_t) {
+				mn::mutex_lock(mtx);
+				++counter;
+				mn::mutex_unlock(mtx);
+			});
+			CHECK(counter == OPS / threads_count * threads_count);
+		});
+		bench.run(mn::str_tmpf("std::mutex {} threads", threads_count).ptr, [&]{
+			counter = 0;
+			_mutex_contention_run(threads_count, OPS, [&](size_t) {
+				std_mtx.lock();
+				++counter;
+				std_mtx.unlock();
+			});
+			CHECK(counter == OPS / threads_count * threads_count);
+		});
+	}
+}
+
+TEST_CASE("mutex rw reader biased")
+{
+	auto mtx = mn::mutex_rw_reader_biased_new();
+	mn_defer{mn::mutex_rw_free(mtx);};
+
+	// the writer keeps both values equal, so readers should never see them differ
+	size_t a = 0, b = 0;
+	std::atomic<size_t> mismatches = 0;
+	_mutex_contention_run(4, 4 * 10000, [&](size_t index) {
+		if (index == 0)
+		{
+			mn::mutex_write_lock(mtx);
+			++a;
+			++b;
+			mn::mutex_write_unlock(mtx);
+		}
+		else
+		{
+			mn::mutex_read_lock(mtx);
+			if (a != b)
+				++mismatches;
+			mn::mutex_read_unlock(mtx);
+		}
+	});
+	CHECK(mismatches == 0);
+	CHECK(a == 10000);
+	CHECK(b == 10000);
+}
+
+TEST_CASE("mutex rw read benchmark")
+{
+	constexpr size_t OPS = 256 * 1024;
+	auto pthread_mtx = mn::mutex_rw_new("pthread mutex rw");
+	mn_defer{mn::mutex_rw_free(pthread_mtx);};
+	auto biased_mtx = mn::mutex_rw_reader_biased_new("reader biased mutex rw");
+	mn_defer{mn::mutex_rw_free(biased_mtx);};
+
+	size_t table[16] = {};
+	ankerl::nanobench::Bench bench;
+	bench.title("mutex rw reads").epochs(3).minEpochIterations(1);
+	for (size_t threads_count = 1; threads_count <= 64; threads_count *= 2)
+	{
+		mn::Mutex_RW mutexes[] = {pthread_mtx, biased_mtx};
+		const char* names[] = {"pthread", "reader biased"};
+		for (size_t i = 0; i < 2; ++i)
+		{
+			bench.run(mn::str_tmpf("{} {} threads", names[i], threads_count).ptr, [&]{
+				_mutex_contention_run(threads_count, OPS, [&](size_t index) {
+					mn::mutex_read_lock(mutexes[i]);
+					ankerl::nanobench::doNotOptimizeAway(table[index % 16]);
+					mn::mutex_read_unlock(mutexes[i]);
+				});
+			});
+		}
+	}
+}
+
+struct Epoch_Snapshot
+{
+	size_t a, b;
+	std::atomic<size_t>* freed;
+
+	~Epoch_Snapshot() { ++*freed; }
+};
+
+TEST_CASE("epoch reclamation")
+{
+	std::atomic<size_t> freed = 0;
+	auto snapshot_new = [&](size_t value) {
+		auto res = mn::alloc<Epoch_Snapshot>();
+		res->a = value;
+		res->b = value;
+		res->freed = &freed;
+		return res;
+	};
+
+	SUBCASE("retired memory outlives the readers")
+	{
+		mn::Rcu_Pointer<Epoch_Snapshot> ptr{};
+		mn::rcu_pointer_publish(ptr, snapshot_new(1));
+
+		// the reader enters a critical section and holds the first snapshot until we let it go
+		struct Reader
+		{
+			mn::Rcu_Pointer<Epoch_Snapshot>* ptr;
+			std::atomic<int> state;
+			size_t value;
+		};
+		Reader reader{&ptr, 0, 0};
+		auto thread = mn::thread_new([](void* arg) {
+			auto self = (Reader*)arg;
+			mn::Epoch_Scope scope;
+			auto snapshot = mn::rcu_pointer_read(*self->ptr);
+			self->state = 1;
+			while (self->state != 2)
+				mn::thread_sleep(1);
+			self->value = snapshot->a;
+		}, &reader, "epoch reader");
+
+		while (reader.state != 1)
+			mn::thread_sleep(1);
+		mn::rcu_pointer_replace(ptr, snapshot_new(2));
+		for (int i = 0; i < 10; ++i)
+			mn::epoch_collect();
+		CHECK(freed == 0);
+
+		reader.state = 2;
+		mn::thread_join(thread);
+		mn::thread_free(thread);
+		CHECK(reader.value == 1);
+
+		mn::epoch_synchronize();
+		CHECK(freed == 1);
+
+		mn::free_destruct(mn::rcu_pointer_publish(ptr, (Epoch_Snapshot*)nullptr));
+		CHECK(freed == 2);
+	}
+
+	SUBCASE("fabric readers")
+	{
+		constexpr size_t PUBLISH_COUNT = 1000;
+		mn::Fabric_Settings settings{};
+		settings.workers_count = 4;
+		auto fabric = mn::fabric_new(settings);
+
+		auto freed_before = freed.load();
+		mn::Rcu_Pointer<Epoch_Snapshot> ptr{};
+		mn::rcu_pointer_publish(ptr, snapshot_new(0));
+
+		// fabric jobs are inside a critical section so they read the pointer directly, and the fibers leave it each
+		// time they yield which lets the retired snapshots be freed while they're running
+		std::atomic<size_t> mismatches = 0;
+		std::atomic<bool> done = false;
+		for (size_t i = 0; i < 4; ++i)
+		{
+			mn::go_fiber(fabric, [&]{
+				while (done == false)
+				{
+					auto snapshot = mn::rcu_pointer_read(ptr);
+					if (snapshot->a != snapshot->b)
+						++mismatches;
+					mn::fiber_yield();
+				}
+			});
+		}
+
+		for (size_t i = 1; i <= PUBLISH_COUNT; ++i)
+			mn::rcu_pointer_replace(ptr, snapshot_new(i));
+		done = true;
+		mn::fabric_free(fabric);
+
+		mn::epoch_synchronize();
+		CHECK(mismatches == 0);
+		CHECK(freed - freed_before == PUBLISH_COUNT);
+		mn::free_destruct(mn::rcu_pointer_publish(ptr, (Epoch_Snapshot*)nullptr));
+	}
+
+	SUBCASE("fabric jobs synchronize")
+	{
+		mn::Fabric_Settings settings{};
+		settings.workers_count = 2;
+		auto fabric = mn::fabric_new(settings);
+
+		// a blocking job leaves its worker critical section while it blocks so it doesn't stall the reclamation
+		std::atomic<bool> blocked = false;
+		std::atomic<bool> done = false;
+		mn::go(fabric, [&]{
+			mn::worker_block_ahead();
+			blocked = true;
+			while (done == false)
+				mn::thread_sleep(1);
+			mn::worker_block_clear();
+		});
+		while (blocked == false)
+			mn::thread_sleep(1);
+
+		// and jobs can synchronize from inside their worker critical section
+		auto freed_before = freed.load();
+		std::atomic<size_t> freed_count = 0;
+		std::atomic<bool> active_after = false;
+		mn::Auto_Waitgroup wg;
+		wg.add(1);
+		mn::go(fabric, [&]{
+			mn::defer_free_destruct(snapshot_new(1));
+			mn::epoch_synchronize();
+			freed_count = freed - freed_before;
+			active_after = mn::epoch_active();
+			wg.done();
+		});
+		wg.wait();
+		done = true;
+		mn::fabric_free(fabric);
+
+		CHECK(freed_count == 1);
+		CHECK(active_after);
+	}
+
+	SUBCASE("fibers park inside critical sections")
+	{
+		mn::Fabric_Settings settings{};
+		settings.workers_count = 2;
+		auto fabric = mn::fabric_new(settings);
+		auto c = mn::chan_new<int>();
+		mn_defer{mn::chan_free(c);};
+
+		auto freed_before = freed.load();
+		mn::Rcu_Pointer<Epoch_Snapshot> ptr{};
+		mn::rcu_pointer_publish(ptr, snapshot_new(1));
+
+		// the fiber parks while it holds the snapshot inside its own critical section
+		constexpr uint64_t TIMEOUT_IN_MS = 10000;
+		std::atomic<mn::Worker> parked_worker = nullptr;
+		std::atomic<mn::Worker> resumed_worker = nullptr;
+		std::atomic<size_t> value = 0;
+		std::atomic<bool> done = false;
+		mn::Auto_Waitgroup wg;
+		wg.add(2);
+		mn::go_fiber(fabric, [&]{
+			{
+				mn::Epoch_Scope scope;
+				auto snapshot = mn::rcu_pointer_read(ptr);
+				parked_worker = mn::worker_local();
+				mn::chan_recv(c);
+				resumed_worker = mn::worker_local();
+				value = snapshot->a;
+			}
+			done = true;
+			wg.done();
+		});
+		while (parked_worker == nullptr)
+			mn::thread_sleep(1);
+
+		mn::rcu_pointer_replace(ptr, snapshot_new(2));
+		for (int i = 0; i < 10; ++i)
+			mn::epoch_collect();
+		CHECK(freed == freed_before);
+
+		// the fiber's worker blocks until the fiber is done, so sysmon replaces it and the fiber is resumed on the
+		// replacement worker
+		std::atomic<bool> timed_out = false;
+		mn::go(parked_worker.load(), [&]{
+			mn::worker_block_ahead();
+			auto start = mn::time_in_millis();
+			while (done == false)
+			{
+				if (mn::time_in_millis() - start > TIMEOUT_IN_MS)
+				{
+					timed_out = true;
+					break;
+				}
+				mn::thread_sleep(1);
+			}
+			mn::worker_block_clear();
+			wg.done();
+		});
+		mn::chan_send(c, 1);
+		wg.wait();
+		CHECK(timed_out == false);
+		CHECK(resumed_worker != parked_worker);
+		CHECK(value == 1);
+
+		// the workers left the critical sections the fiber took with it
+		std::atomic<size_t> unbalanced = 0;
+		wg.add(4);
+		for (size_t i = 0; i < 4; ++i)
+		{
+			mn::go(fabric, [&]{
+				mn::epoch_synchronize();
+				mn::Epoch_Scope scope;
+				mn::worker_block_ahead();
+				if (mn::epoch_active() == false)
+					++unbalanced;
+				mn::worker_block_clear();
+				wg.done();
+			});
+		}
+		wg.wait();
+		mn::fabric_free(fabric);
+		CHECK(unbalanced == 0);
+
+		mn::epoch_synchronize();
+		CHECK(freed - freed_before == 1);
+		mn::free_destruct(mn::rcu_pointer_publish(ptr, (Epoch_Snapshot*)nullptr));
+	}
+}
+
+TEST_CASE("concurrent map")
+{
+	auto map = mn::concurrent_map_new<int, int>(4);
+	mn_defer{mn::concurrent_map_free(map);};
+
+	// the shards grow a few times while the threads are writing, so some of the lookups happen mid migration
+	constexpr int KEYS_COUNT = 4096;
+	_mutex_contention_run(4, 4 * KEYS_COUNT, [&](size_t index) {
+		thread_local int next = 0;
+		auto key = next++ % KEYS_COUNT;
+		if (index == 0)
+		{
+			mn::concurrent_map_insert(map, key, key * 2);
+		}
+		else if (index == 1)
+		{
+			mn::concurrent_map_insert_or_update(map, key + KEYS_COUNT, [](int& value, bool) { ++value; });
+		}
+		else
+		{
+			int value = 0;
+			if (mn::concurrent_map_lookup(map, key, &value))
+				CHECK(value == key * 2);
+		}
+	});
+	CHECK(mn::concurrent_map_count(map) == 2 * KEYS_COUNT);
+
+	for (int i = 0; i < KEYS_COUNT; ++i)
+	{
+		int value = 0;
+		CHECK(mn::concurrent_map_lookup(map, i, &value));
+		CHECK(value == i * 2);
+		CHECK(mn::concurrent_map_lookup(map, i + KEYS_COUNT, &value));
+		CHECK(value == 1);
+	}
+
+	CHECK(mn::concurrent_map_insert(map, 0, 42) == false);
+	CHECK(mn::concurrent_map_insert_or_update(map, -1, [](int& value, bool inserted) { CHECK(inserted); value = 7; }));
+	CHECK(mn::concurrent_map_read(map, -1, [](const int& value) { CHECK(value == 7); }));
+
+	for (int i = 0; i < KEYS_COUNT; i += 2)
+		CHECK(mn::concurrent_map_remove(map, i));
+	CHECK(mn::concurrent_map_remove(map, 0) == false);
+	CHECK(mn::concurrent_map_lookup(map, 0) == false);
+	CHECK(mn::concurrent_map_lookup(map, 1));
+
+	auto snapshot = mn::concurrent_map_snapshot(map);
+	mn_defer{mn::map_free(snapshot);};
+	CHECK(snapshot.count == mn::concurrent_map_count(map));
+	CHECK(snapshot.count == KEYS_COUNT / 2 + KEYS_COUNT + 1);
+	for (const auto& [key, value]: snapshot)
+	{
+		if (key >= KEYS_COUNT)
+			CHECK(value == 1);
+		else if (key >= 0)
+			CHECK(value == key * 2);
+	}
+}
+
+TEST_CASE("concurrent map benchmark")
+{
+	constexpr size_t OPS = 256 * 1024;
+	constexpr int KEYS_COUNT = 16 * 1024;
+
+	auto map = mn::concurrent_map_new<int, int>();
+	mn_defer{mn::concurrent_map_free(map);};
+	auto locked_map = mn::map_new<int, int>();
+	mn_defer{mn::map_free(locked_map);};
+	auto locked_map_mtx = mn::mutex_rw_new("locked map mutex");
+	mn_defer{mn::mutex_rw_free(locked_map_mtx);};
+	for (int i = 0; i < KEYS_COUNT; i += 2)
+	{
+		mn::concurrent_map_insert(map, i, i);
+		mn::map_insert(locked_map, i, i);
+	}
+
+	ankerl::nanobench::Bench bench;
+	bench.title("concurrent map").epochs(3).minEpochIterations(1);
+	for (size_t writes_percent: {10, 50})
+	{
+		for (size_t threads_count = 1; threads_count <= 64; threads_count *= 2)
+		{
+			// each op picks a pseudo random key, and writes alternate between inserting and removing it so the
+			// number of keys stays around the same
+			auto op_key = [](size_t index) {
+				thread_local uint32_t state = 0;
+				state = state * 1664525u + 1013904223u + uint32_t(index);
+				return state;
+			};
+
+			bench.run(mn::str_tmpf("Concurrent_Map {}/{} {} threads", 100 - writes_percent, writes_percent, threads_count).ptr, [&]{
+				_mutex_contention_run(threads_count, OPS, [&](size_t index) {
+					auto r = op_key(index);
+					auto key = int((r >> 8) % KEYS_COUNT);
+					if (r % 100 < writes_percent)
+					{
+						if (r & 0x80)
+							mn::concurrent_map_insert(map, key, key);
+						else
+							mn::concurrent_map_remove(map, key);
+					}
+					else
+					{
+						int value = 0;
+						ankerl::nanobench::doNotOptimizeAway(mn::concurrent_map_lookup(map, key, &value));
+					}
+				});
+			});
+
+			bench.run(mn::str_tmpf("Map + Mutex_RW {}/{} {} threads", 100 - writes_percent, writes_percent, threads_count).ptr, [&]{
+				_mutex_contention_run(threads_count, OPS, [&](size_t index) {
+					auto r = op_key(index);
+					auto key = int((r >> 8) % KEYS_COUNT);
+					if (r % 100 < writes_percent)
+					{
+						mn::mutex_write_lock(locked_map_mtx);
+						if (r & 0x80)
+							mn::map_insert(locked_map, key, key);
+						else
+							mn::map_remove(locked_map, key);
+						mn::mutex_write_unlock(locked_map_mtx);
+					}
+					else
+					{
+						mn::mutex_read_lock(locked_map_mtx);
+						ankerl::nanobench::doNotOptimizeAway(mn::map_lookup(locked_map, key));
+						mn::mutex_read_unlock(locked_map_mtx);
+					}
+				});
+			});
+		}
+	}
+}
+
 TEST_CASE("str push blobs")
 {
 	auto str1 = mn::str_tmp("hello ");
@@ -1516,3 +3799,142 @@ TEST_CASE("folder_make_recursive")
 	CHECK(mn::folder_make_recursive(""));
 	CHECK(mn::folder_make_recursive("\\"));
 }
+
+TEST_CASE("ipc shared memory")
+{
+	auto segment = mn::ipc::shared_memory_new("mn_unittest_shared_memory", 64 * 1024);
+	CHECK(segment != nullptr);
+
+	auto other = mn::ipc::shared_memory_open("mn_unittest_shared_memory");
+	CHECK(other != nullptr);
+	CHECK(other->data.size >= segment->data.size);
+
+	// the live segment isn't replaced by another segment with the same name
+	CHECK(mn::ipc::shared_memory_new("mn_unittest_shared_memory", 64 * 1024) == nullptr);
+
+	auto allocator = mn::ipc::shared_allocator_new(segment);
+	auto nums = mn::buf_with_allocator<int>(allocator);
+	for (int i = 0; i < 1000; ++i)
+		mn::buf_push(nums, i);
+
+	auto other_nums = (int*)mn::ipc::shared_memory_ptr(other, mn::ipc::shared_memory_offset(segment, nums.ptr));
+	for (int i = 0; i < 1000; ++i)
+		CHECK(other_nums[i] == i);
+
+	auto too_big = mn::alloc_from(allocator, 128 * 1024, alignof(int));
+	CHECK(mn::block_is_empty(too_big));
+
+	mn::buf_free(nums);
+	CHECK(allocator->used_mem() == 0);
+
+	// blocks freed in any order are merged and reused
+	mn::Block blocks[4];
+	for (auto& block: blocks)
+		block = mn::alloc_from(allocator, 100, alignof(int));
+	CHECK(allocator->used_mem() == 4 * 112);
+	mn::free_from(allocator, blocks[1]);
+	mn::free_from(allocator, blocks[2]);
+	auto merged = mn::alloc_from(allocator, 200, alignof(int));
+	CHECK(merged.ptr == blocks[1].ptr);
+	auto aligned = mn::alloc_from(allocator, 8, 64);
+	CHECK(uintptr_t(mn::ipc::shared_memory_offset(segment, aligned.ptr)) % 64 == 0);
+	mn::free_from(allocator, blocks[0]);
+	mn::free_from(allocator, aligned);
+	mn::free_from(allocator, blocks[3]);
+	mn::free_from(allocator, merged);
+	CHECK(allocator->used_mem() == 0);
+	auto whole = mn::alloc_from(allocator, 48 * 1024, alignof(int));
+	CHECK(mn::block_is_empty(whole) == false);
+	mn::free_from(allocator, whole);
+	mn::allocator_free(allocator);
+	mn::ipc::shared_memory_free(other);
+	mn::ipc::shared_memory_free(segment);
+}
+
+TEST_CASE("ipc shared queue")
+{
+	SUBCASE("spsc")
+	{
+		auto producer = mn::ipc::shared_queue_new("mn_unittest_shared_queue", 64);
+		auto consumer = mn::ipc::shared_queue_open("mn_unittest_shared_queue");
+		CHECK(consumer != nullptr);
+		CHECK(mn::ipc::shared_queue_new("mn_unittest_shared_queue", 64) == nullptr);
+
+		// the stream size is the number of bytes available to read
+		uint64_t probe = 42;
+		CHECK(mn::stream_write(producer, mn::block_from(probe)) == sizeof(probe));
+		CHECK(mn::stream_size(consumer) == sizeof(probe));
+		probe = 0;
+		CHECK(mn::stream_read(consumer, mn::block_from(probe)) == sizeof(probe));
+		CHECK(probe == 42);
+		CHECK(mn::stream_size(consumer) == 0);
+
+		auto thread = mn::thread_new([](void* arg) {
+			auto producer = (mn::ipc::Shared_Queue)arg;
+			for (uint32_t i = 0; i < 10000; ++i)
+				mn::stream_copy(producer, mn::block_from(i));
+			mn::ipc::shared_queue_close(producer);
+		}, producer);
+
+		uint64_t sum = 0;
+		uint32_t expected = 0;
+		bool ordered = true;
+		uint32_t value = 0;
+		while (mn::stream_copy(mn::block_from(value), consumer) == sizeof(value))
+		{
+			ordered &= value == expected++;
+			sum += value;
+		}
+		CHECK(ordered);
+		CHECK(sum == 49995000);
+		CHECK(mn::ipc::shared_queue_closed(consumer));
+
+		mn::thread_join(thread);
+		mn::thread_free(thread);
+		mn::ipc::shared_queue_free(consumer);
+		mn::ipc::shared_queue_free(producer);
+	}
+
+	SUBCASE("mpsc")
+	{
+		constexpr size_t PRODUCERS_COUNT = 4;
+		auto consumer = mn::ipc::shared_queue_new("mn_unittest_shared_queue", 256, mn::ipc::SHARED_QUEUE_MODE_MPSC);
+
+		mn::Thread threads[PRODUCERS_COUNT];
+		for (auto& thread: threads)
+		{
+			thread = mn::thread_new([](void*) {
+				auto producer = mn::ipc::shared_queue_open("mn_unittest_shared_queue");
+				for (uint64_t i = 1; i <= 1000; ++i)
+				{
+					// each message is written in a single write so it shouldn't be interleaved with other producers
+					uint64_t msg[2] = {i, ~i};
+					mn::ipc::shared_queue_write(producer, mn::block_from(msg));
+				}
+				mn::ipc::shared_queue_free(producer);
+			}, nullptr);
+		}
+
+		uint64_t sum = 0;
+		bool intact = true;
+		for (size_t i = 0; i < PRODUCERS_COUNT * 1000; ++i)
+		{
+			uint64_t msg[2] = {};
+			mn::stream_copy(mn::block_from(msg), consumer);
+			intact &= msg[1] == ~msg[0];
+			sum += msg[0];
+		}
+		CHECK(intact);
+		CHECK(sum == PRODUCERS_COUNT * 500500);
+
+		uint8_t byte = 0;
+		CHECK(mn::ipc::shared_queue_read(consumer, mn::block_from(byte), mn::Timeout{10}) == 0);
+
+		for (auto thread: threads)
+		{
+			mn::thread_join(thread);
+			mn::thread_free(thread);
+		}
+		mn::ipc::shared_queue_free(consumer);
+	}
+}